@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Test helper program for exercising the pmEventIterInit(3) family,
+ * walking packed PM_TYPE_EVENT and PM_TYPE_HIGHRES_EVENT values in
+ * place, including arrays with no records, records with no parameters,
+ * missed records and values that fail the integrity checks.
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/pmda.h>
+#include "libpcp.h"
+
+static int mydomain = 29;
+
+static pmID	pmid_type;
+static pmID	pmid_32;
+static pmID	pmid_64;
+static pmID	pmid_u64;
+static pmID	pmid_float;
+static pmID	pmid_double;
+static pmID	pmid_string;
+static pmID	pmid_aggregate;
+
+static char	aggrval[] = { '\01', '\03', '\07', '\017', '\037', '\077', '\177', '\377' };
+static pmValueBlock	*aggr;
+
+static void
+check(int sts, const char *what)
+{
+    if (sts < 0) {
+	fprintf(stderr, "%s: %s failed: %s\n", pmGetProgname(), what, pmErrStr(sts));
+	exit(1);
+    }
+}
+
+static pmValueSet *
+newvset(int numval)
+{
+    pmValueSet	*vsp;
+    int		i;
+
+    vsp = (pmValueSet *)calloc(1, sizeof(pmValueSet) + (numval - 1) * sizeof(pmValue));
+    if (vsp == NULL) {
+	fprintf(stderr, "%s: out of memory\n", pmGetProgname());
+	exit(1);
+    }
+    vsp->pmid = pmID_build(mydomain, 0, 136);	/* event.records */
+    vsp->numval = numval;
+    vsp->valfmt = PM_VAL_DPTR;
+    for (i = 0; i < numval; i++)
+	vsp->vlist[i].inst = i;
+    return vsp;
+}
+
+static void
+printvalue(const pmEventParam *param)
+{
+    const unsigned char	*p = (const unsigned char *)param->vbuf;
+    __int32_t		l;
+    __int64_t		ll;
+    float		f;
+    double		d;
+    int			i;
+
+    /* values are in place and not necessarily aligned */
+    switch (param->type) {
+	case PM_TYPE_32:
+	    memcpy(&l, p, sizeof(l));
+	    printf("%d", l);
+	    break;
+	case PM_TYPE_U32:
+	    memcpy(&l, p, sizeof(l));
+	    printf("%u", (__uint32_t)l);
+	    break;
+	case PM_TYPE_64:
+	    memcpy(&ll, p, sizeof(ll));
+	    printf("%" FMT_INT64, ll);
+	    break;
+	case PM_TYPE_U64:
+	    memcpy(&ll, p, sizeof(ll));
+	    printf("%" FMT_UINT64, (__uint64_t)ll);
+	    break;
+	case PM_TYPE_FLOAT:
+	    memcpy(&f, p, sizeof(f));
+	    printf("%g", (double)f);
+	    break;
+	case PM_TYPE_DOUBLE:
+	    memcpy(&d, p, sizeof(d));
+	    printf("%g", d);
+	    break;
+	case PM_TYPE_STRING:
+	    printf("\"%.*s\"", param->vlen, (const char *)p);
+	    break;
+	default:
+	    for (i = 0; i < param->vlen; i++)
+		printf("%s%02x", i ? " " : "[", p[i]);
+	    printf("]");
+	    break;
+    }
+}
+
+/*
+ * Walk every instance of vsp - visit at most maxparams parameters of
+ * each record (-1 for all of them), leaving pmEventIterNextRecord()
+ * to step over the rest.
+ */
+static void
+walk(const char *what, pmValueSet *vsp, int maxparams)
+{
+    pmEventIter		iter;
+    pmEventParam	param;
+    int			i, n, sts;
+    int			nrecords, nparams;
+
+    printf("\n=== %s ===\n", what);
+    for (i = 0; i < vsp->numval || i == 0; i++) {
+	if ((sts = pmEventIterInit(&iter, vsp, i)) < 0) {
+	    printf("pmEventIterInit: %s\n", pmErrStr(sts));
+	    return;
+	}
+	if (vsp->numval < 1) {
+	    printf("pmEventIterInit: %d\n", sts);
+	    /* nothing to visit, and that is not an error */
+	    printf("NextRecord: %d\n", pmEventIterNextRecord(&iter));
+	    return;
+	}
+	printf("[inst %d] %d records%s\n", vsp->vlist[i].inst, sts,
+		iter.highres ? " (highres)" : "");
+	if (pmEventIterNextParam(&iter, &param) != 0)
+	    printf("  Error: parameter before the first record\n");
+	nrecords = 0;
+	while (pmEventIterNextRecord(&iter)) {
+	    printf("  record %d: %lld.%09ld flags 0x%x",
+		    iter.record, (long long)iter.timestamp.tv_sec,
+		    (long)iter.timestamp.tv_nsec, iter.flags);
+	    if (iter.flags & PM_EVENT_FLAG_MISSED)
+		printf(" missed %d", iter.missed);
+	    printf(" nparams %d\n", iter.nparams);
+	    nparams = 0;
+	    while (maxparams < 0 || nparams < maxparams) {
+		if ((n = pmEventIterNextParam(&iter, &param)) == 0)
+		    break;
+		nparams++;
+		printf("    %s %s vlen %d = ", pmIDStr(param.pmid),
+			pmTypeStr(param.type), param.vlen);
+		printvalue(&param);
+		printf("\n");
+	    }
+	    nrecords++;
+	}
+	if (nrecords != sts)
+	    printf("  Error: visited %d records, expected %d\n", nrecords, sts);
+	/* past the end, nothing more is returned */
+	if (pmEventIterNextRecord(&iter) != 0)
+	    printf("  Error: record after the last record\n");
+	if (pmEventIterNextParam(&iter, &param) != 0)
+	    printf("  Error: parameter after the last record\n");
+    }
+}
+
+/* each instance's array is independently reset and refilled */
+static void
+fill(int idx, int highres, int inst)
+{
+    struct timespec	ts = { 1000000000 + 10 * inst, 123456789 };
+    struct timeval	tv = { 1000000000 + 10 * inst, 123456 };
+    pmAtomValue		atom;
+
+#define RECORD(flags) \
+    check(highres ? pmdaEventAddHighResRecord(idx, &ts, flags) : \
+		    pmdaEventAddRecord(idx, &tv, flags), "add record"); \
+    ts.tv_sec++; tv.tv_sec++
+#define MISSED(count) \
+    check(highres ? pmdaEventAddHighResMissedRecord(idx, &ts, count) : \
+		    pmdaEventAddMissedRecord(idx, &tv, count), "add missed"); \
+    ts.tv_sec++; tv.tv_sec++
+#define PARAM(pmid, type) \
+    check(highres ? pmdaEventAddHighResParam(idx, pmid, type, &atom) : \
+		    pmdaEventAddParam(idx, pmid, type, &atom), "add param")
+
+    switch (inst) {
+	case 0:		/* no records at all */
+	    break;
+	case 1:		/* one record, no parameters */
+	    RECORD(PM_EVENT_FLAG_POINT);
+	    break;
+	case 2:		/* missed records between records of every type */
+	    MISSED(3);
+	    RECORD(PM_EVENT_FLAG_POINT);
+	    atom.ul = 4;
+	    PARAM(pmid_type, PM_TYPE_U32);
+	    atom.ll = -5;
+	    PARAM(pmid_64, PM_TYPE_64);
+	    atom.cp = "six";
+	    PARAM(pmid_string, PM_TYPE_STRING);
+	    RECORD(PM_EVENT_FLAG_START|PM_EVENT_FLAG_ID);
+	    atom.l = -7;
+	    PARAM(pmid_32, PM_TYPE_32);
+	    atom.ull = 8;
+	    PARAM(pmid_u64, PM_TYPE_U64);
+	    atom.f = -9.5;
+	    PARAM(pmid_float, PM_TYPE_FLOAT);
+	    atom.d = 10.25;
+	    PARAM(pmid_double, PM_TYPE_DOUBLE);
+	    MISSED(11);
+	    RECORD(PM_EVENT_FLAG_END);
+	    atom.cp = "twelve";
+	    PARAM(pmid_string, PM_TYPE_STRING);
+	    atom.vbp = aggr;
+	    PARAM(pmid_aggregate, PM_TYPE_AGGREGATE);
+	    break;
+    }
+}
+
+static void
+events(int highres)
+{
+    pmValueSet		*vsp;
+    pmValueBlock	*vbp;
+    pmEventArray	*eap;
+    pmHighResEventArray	*hreap;
+    int			array[3];
+    int			i, vlen;
+    const char		*kind = highres ? "highres" : "event";
+    char		what[64];
+
+    for (i = 0; i < 3; i++) {
+	array[i] = highres ? pmdaEventNewHighResArray() : pmdaEventNewArray();
+	check(array[i], "new array");
+	fill(array[i], highres, i);
+    }
+    vsp = newvset(3);
+    for (i = 0; i < 3; i++) {
+	if (highres)
+	    vsp->vlist[i].value.pval = (pmValueBlock *)pmdaEventGetHighResAddr(array[i]);
+	else
+	    vsp->vlist[i].value.pval = (pmValueBlock *)pmdaEventGetAddr(array[i]);
+    }
+
+    /* first instance has no records, later instances must still be seen */
+    pmsprintf(what, sizeof(what), "%s: all parameters", kind);
+    walk(what, vsp, -1);
+    pmsprintf(what, sizeof(what), "%s: first parameter only", kind);
+    walk(what, vsp, 1);
+    pmsprintf(what, sizeof(what), "%s: no parameters", kind);
+    walk(what, vsp, 0);
+
+    vsp->numval = 0;
+    pmsprintf(what, sizeof(what), "%s: no values", kind);
+    walk(what, vsp, -1);
+    vsp->numval = PM_ERR_AGAIN;
+    pmsprintf(what, sizeof(what), "%s: error in place of values", kind);
+    walk(what, vsp, -1);
+    vsp->numval = 3;
+
+    vsp->valfmt = PM_VAL_INSITU;
+    pmsprintf(what, sizeof(what), "%s: insitu value", kind);
+    walk(what, vsp, -1);
+    vsp->valfmt = PM_VAL_DPTR;
+
+    /* integrity checks on the last instance, restored after each */
+    vbp = vsp->vlist[2].value.pval;
+    eap = (pmEventArray *)vbp;
+    hreap = (pmHighResEventArray *)vbp;
+    vlen = vbp->vlen;
+
+    vbp->vtype = PM_TYPE_U32;
+    pmsprintf(what, sizeof(what), "%s: bad value type", kind);
+    walk(what, vsp, -1);
+    vbp->vtype = highres ? PM_TYPE_HIGHRES_EVENT : PM_TYPE_EVENT;
+
+    vbp->vlen = PM_VAL_HDR_SIZE;
+    pmsprintf(what, sizeof(what), "%s: value too small", kind);
+    walk(what, vsp, -1);
+    vbp->vlen = vlen;
+
+    vbp->vlen = vlen - 1;
+    pmsprintf(what, sizeof(what), "%s: truncated parameter", kind);
+    walk(what, vsp, -1);
+    vbp->vlen = vlen;
+
+    if (highres)
+	hreap->ea_nrecords = -1;
+    else
+	eap->ea_nrecords = -1;
+    pmsprintf(what, sizeof(what), "%s: negative record count", kind);
+    walk(what, vsp, -1);
+
+    free(vsp);
+    for (i = 0; i < 3; i++) {
+	if (highres)
+	    pmdaEventReleaseHighResArray(array[i]);
+	else
+	    pmdaEventReleaseArray(array[i]);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    int		sts;
+    int		errflag = 0;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "D:")) != EOF) {
+	switch (c) {
+
+	case 'D':	/* debug options */
+	    sts = pmSetDebug(optarg);
+	    if (sts < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc) {
+	fprintf(stderr, "Usage: %s [-D debug]\n", pmGetProgname());
+	exit(1);
+    }
+
+    pmid_type = pmID_build(mydomain, 0, 127);		/* event.type */
+    pmid_32 = pmID_build(mydomain, 0, 128);		/* event.param_32 */
+    pmid_64 = pmID_build(mydomain, 0, 130);		/* event.param_64 */
+    pmid_u64 = pmID_build(mydomain, 0, 131);		/* event.param_u64 */
+    pmid_float = pmID_build(mydomain, 0, 132);		/* event.param_float */
+    pmid_double = pmID_build(mydomain, 0, 133);		/* event.param_double */
+    pmid_string = pmID_build(mydomain, 0, 134);		/* event.param_string */
+    pmid_aggregate = pmID_build(mydomain, 0, 135);	/* event.param_aggregate */
+
+    aggr = (pmValueBlock *)malloc(PM_VAL_HDR_SIZE + sizeof(aggrval));
+    if (aggr == NULL) {
+	fprintf(stderr, "%s: out of memory\n", pmGetProgname());
+	exit(1);
+    }
+    aggr->vtype = PM_TYPE_AGGREGATE;
+    aggr->vlen = PM_VAL_HDR_SIZE + sizeof(aggrval);
+    memcpy(aggr->vbuf, (void *)aggrval, sizeof(aggrval));
+
+    events(0);
+    events(1);
+
+    free(aggr);
+    exit(0);
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Test helper program for exercising pmGetInstancesLabelsList(3) and
+ * the client-side instance labels cache (__pmLabelCache).
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+static pmLongOptions longopts[] = {
+    PMAPI_OPTIONS_HEADER("General options"),
+    PMOPT_ARCHIVE,
+    PMOPT_DEBUG,
+    PMOPT_HOST,
+    PMOPT_LOCALPMDA,
+    PMOPT_SPECLOCAL,
+    PMOPT_NAMESPACE,
+    PMOPT_HELP,
+    PMAPI_OPTIONS_END
+};
+
+static pmOptions opts = {
+    .short_options = "a:D:h:K:Ln:?",
+    .long_options = longopts,
+    .short_usage = "[options] metric [...]",
+};
+
+#define NOSUCHINST	999999
+
+static void
+dumpsets(const char *what, int nsets, pmLabelSet *sets)
+{
+    int		i;
+
+    printf("%s: %d sets\n", what, nsets);
+    for (i = 0; i < nsets; i++)
+	printf("  Inst[%d]:\t%.*s\n", sets[i].inst, sets[i].jsonlen, sets[i].json);
+}
+
+/* instance labels from the full set, for instances listed in instlist */
+static int
+matchsets(int nall, pmLabelSet *all, int numinst, int *instlist,
+	int nsets, pmLabelSet *sets)
+{
+    int		i, j, n = 0;
+
+    for (i = 0; i < nall; i++) {
+	for (j = 0; j < numinst; j++)
+	    if (all[i].inst == instlist[j])
+		break;
+	if (j == numinst)
+	    continue;
+	for (j = 0; j < nsets; j++)
+	    if (sets[j].inst == all[i].inst)
+		break;
+	if (j == nsets || !__pmEqualLabelSet(&all[i], &sets[j]))
+	    return 0;
+	n++;
+    }
+    return n == nsets;
+}
+
+static void
+dumpcache(__pmLabelCache *cache, pmInDom indom, int numinst, int *instlist)
+{
+    pmLabelSet	*set;
+    int		i, sts;
+
+    for (i = 0; i < numinst; i++) {
+	if ((sts = __pmLabelCacheLookup(cache, indom, instlist[i], &set)) < 0)
+	    printf("  Inst[%d]:\t%s\n", instlist[i], pmErrStr(sts));
+	else if (set == NULL)
+	    printf("  Inst[%d]:\tgeneration %d, no labels\n", instlist[i], sts);
+	else
+	    printf("  Inst[%d]:\tgeneration %d, %.*s\n", instlist[i], sts,
+			set->jsonlen, set->json);
+    }
+}
+
+static void
+update(__pmLabelCache *cache, pmInDom indom, int numinst, int *instlist,
+	int *install, int nall, const char *what)
+{
+    pmLabelSet	*sets;
+    int		prior, sts, nsets;
+
+    prior = __pmLabelCacheGeneration(cache, indom);
+    if ((sts = __pmLabelCacheUpdate(cache, indom, numinst, instlist)) < 0) {
+	printf("%s: %s\n", what, pmErrStr(sts));
+	return;
+    }
+    printf("%s: generation %s\n", what, sts == prior ? "unchanged" : "advanced");
+    dumpcache(cache, indom, nall, install);
+    if ((nsets = __pmLabelCacheGetSets(cache, indom, &sets)) < 0) {
+	printf("  cached sets: %s\n", pmErrStr(nsets));
+	return;
+    }
+    printf("  cached sets: %d\n", nsets);
+    if (nsets > 0)
+	pmFreeLabelSets(sets, nsets);
+}
+
+static void
+labelcache(const char *metric, pmID pmid)
+{
+    __pmLabelCache	cache;
+    pmResult	*rp;
+    pmLabelSet	*all, *sets;
+    pmDesc	desc;
+    char	**names;
+    int		*instlist, *sublist, *install;
+    int		i, sts, nall, nsets, numinst, nsub;
+
+    if ((sts = pmLookupDesc(pmid, &desc)) < 0) {
+	fprintf(stderr, "%s: cannot lookup descriptor for %s: %s\n",
+			pmGetProgname(), metric, pmErrStr(sts));
+	exit(1);
+    }
+    if (desc.indom == PM_INDOM_NULL) {
+	fprintf(stderr, "%s: %s has no instance domain\n",
+			pmGetProgname(), metric);
+	return;
+    }
+
+    /* position archives after the first labels, and check values */
+    if ((sts = pmFetch(1, &pmid, &rp)) < 0) {
+	fprintf(stderr, "%s: cannot fetch %s: %s\n",
+			pmGetProgname(), metric, pmErrStr(sts));
+	exit(1);
+    }
+    printf("%s: %d values\n", metric, rp->vset[0]->numval);
+    pmFreeResult(rp);
+
+    if (opts.context == PM_CONTEXT_ARCHIVE)
+	sts = pmGetInDomArchive(desc.indom, &instlist, &names);
+    else
+	sts = pmGetInDom(desc.indom, &instlist, &names);
+    if (sts < 0) {
+	fprintf(stderr, "%s: cannot get instances of %s: %s\n",
+			pmGetProgname(), metric, pmErrStr(sts));
+	exit(1);
+    }
+    numinst = sts;
+    free(names);
+
+    /* all current instances plus one that does not exist */
+    install = (int *)malloc((numinst + 1) * sizeof(int));
+    sublist = (int *)malloc((numinst + 1) * sizeof(int));
+    if (install == NULL || sublist == NULL) {
+	fprintf(stderr, "%s: out of memory\n", pmGetProgname());
+	exit(1);
+    }
+    memcpy(install, instlist, numinst * sizeof(int));
+    install[numinst] = NOSUCHINST;
+    for (i = nsub = 0; i < numinst; i += 2)
+	sublist[nsub++] = instlist[i];
+
+    if ((sts = nall = pmGetInstancesLabels(desc.indom, &all)) < 0) {
+	fprintf(stderr, "%s: cannot get instance labels for %s: %s\n",
+			pmGetProgname(), metric, pmErrStr(sts));
+	exit(1);
+    }
+    dumpsets("pmGetInstancesLabels", nall, all);
+
+    /* restrict the context instance profile to the second instance */
+    if (numinst > 1) {
+	pmDelProfile(desc.indom, 0, NULL);
+	pmAddProfile(desc.indom, 1, &instlist[1]);
+    }
+
+    if ((nsets = pmGetInstancesLabelsList(desc.indom, nsub, sublist, &sets)) < 0)
+	printf("pmGetInstancesLabelsList: %s\n", pmErrStr(nsets));
+    else {
+	dumpsets("pmGetInstancesLabelsList, every other instance", nsets, sets);
+	printf("  same as all instances: %s\n",
+		matchsets(nall, all, nsub, sublist, nsets, sets) ? "yes" : "no");
+	pmFreeLabelSets(sets, nsets);
+    }
+
+    sublist[0] = NOSUCHINST;
+    if ((nsets = pmGetInstancesLabelsList(desc.indom, 1, sublist, &sets)) < 0)
+	printf("pmGetInstancesLabelsList: %s\n", pmErrStr(nsets));
+    else {
+	dumpsets("pmGetInstancesLabelsList, no such instance", nsets, sets);
+	pmFreeLabelSets(sets, nsets);
+    }
+    nsets = pmGetInstancesLabelsList(desc.indom, 0, NULL, &sets);
+    printf("pmGetInstancesLabelsList, no instances: %d sets\n", nsets);
+    nsets = pmGetInstancesLabelsList(desc.indom, -1, NULL, &sets);
+    printf("pmGetInstancesLabelsList, bad count: %s\n", pmErrStr(nsets));
+
+    /* the context instance profile is in use again after a subset */
+    if ((sts = pmFetch(1, &pmid, &rp)) < 0)
+	printf("pmFetch: %s\n", pmErrStr(sts));
+    else {
+	printf("%s: %d values\n", metric, rp->vset[0]->numval);
+	pmFreeResult(rp);
+    }
+    pmAddProfile(desc.indom, 0, NULL);
+
+    __pmLabelCacheInit(&cache);
+    printf("\n");
+    update(&cache, desc.indom, numinst, instlist, install, numinst + 1,
+		"cache all instances");
+    update(&cache, desc.indom, numinst, instlist, install, numinst + 1,
+		"cache same instances");
+    for (i = nsub = 0; i < numinst; i += 2)
+	sublist[nsub++] = instlist[i];
+    update(&cache, desc.indom, nsub, sublist, install, numinst + 1,
+		"cache every other instance");
+    update(&cache, desc.indom, -1, NULL, install, numinst + 1,
+		"cache refresh");
+    update(&cache, desc.indom, -1, NULL, install, numinst + 1,
+		"cache refresh again");
+    __pmLabelCacheFree(&cache);
+    update(&cache, desc.indom, numinst, instlist, install, numinst + 1,
+		"cache after flush");
+    __pmLabelCacheFree(&cache);
+
+    pmFreeLabelSets(all, nall);
+    free(instlist);
+    free(install);
+    free(sublist);
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    int		sts;
+    int		exitsts;
+    int		nmetrics;
+    const char	*metric;
+    const char	*source;
+    pmID	pmid;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = pmGetOptions(argc, argv, &opts)) != EOF) {
+	switch (c) {
+	    default:
+		opts.errors++;
+		break;
+	}
+    }
+
+    nmetrics = argc - opts.optind;
+    if (opts.errors || nmetrics < 1 || (opts.flags & PM_OPTFLAG_EXIT)) {
+	exitsts = !(opts.flags & PM_OPTFLAG_EXIT);
+	pmUsageMessage(&opts);
+	exit(exitsts);
+    }
+
+    if (opts.context == PM_CONTEXT_ARCHIVE)
+	source = opts.archives[0];
+    else if (opts.context == PM_CONTEXT_HOST)
+	source = opts.hosts[0];
+    else if (opts.context == PM_CONTEXT_LOCAL)
+	source = NULL;
+    else {
+	opts.context = PM_CONTEXT_HOST;
+	source = "local:";
+    }
+    if ((sts = pmNewContext(opts.context, source)) < 0) {
+	fprintf(stderr, "%s: Cannot create context for \"%s\": %s\n",
+			pmGetProgname(), source ? source : "localhost",
+			pmErrStr(sts));
+	exit(1);
+    }
+
+    for (c = 0; c < nmetrics; c++) {
+	metric = argv[opts.optind++];
+	if ((sts = pmLookupName(1, &metric, &pmid)) < 0) {
+	    fprintf(stderr, "%s: cannot lookup name %s: %s\n",
+			pmGetProgname(), metric, pmErrStr(sts));
+	    exit(1);
+	}
+	if (c > 0)
+	    printf("\n");
+	labelcache(metric, pmid);
+    }
+
+    exit(0);
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Hold many client connections to pmcd, then fetch from the first and
+ * the last of them (after an optional delay, so agents can be started
+ * by the caller in the meantime and be given high descriptor numbers
+ * within pmcd).  libpcp limits each client process to FD_SETSIZE pmcd
+ * connections, so run several of these to get beyond that in pmcd.
+ *
+ * One metric name per argument.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+
+static pmLongOptions longopts[] = {
+    PMOPT_DEBUG,	/* -D */
+    PMOPT_HOST,		/* -h */
+    { "count", 1, 'c', "N", "number of contexts to hold open [default 500]" },
+    { "wait", 1, 'w', "SEC", "delay after the contexts are open [default 0]" },
+    PMAPI_OPTIONS_END
+};
+
+static pmOptions opts = {
+    .short_options = "c:D:h:w:",
+    .long_options = longopts,
+    .short_usage = "[options] metric ...",
+};
+
+static void
+dofetch(int ctx, int numpmid, pmID *pmidlist, pmDesc *desclist, char **names)
+{
+    pmResult	*rp;
+    int		i, sts;
+
+    if ((sts = pmUseContext(ctx)) < 0) {
+	fprintf(stderr, "pmUseContext(%d): %s\n", ctx, pmErrStr(sts));
+	return;
+    }
+    if ((sts = pmFetch(numpmid, pmidlist, &rp)) < 0) {
+	printf("pmFetch: %s\n", pmErrStr(sts));
+	return;
+    }
+    for (i = 0; i < rp->numpmid; i++) {
+	pmValueSet	*vsp = rp->vset[i];
+
+	printf("%s: ", names[i]);
+	if (vsp->numval < 0)
+	    printf("%s\n", pmErrStr(vsp->numval));
+	else if (vsp->numval == 0)
+	    printf("no values\n");
+	else if (desclist[i].indom != PM_INDOM_NULL)
+	    printf("some values\n");
+	else {
+	    pmPrintValue(stdout, vsp->valfmt, desclist[i].type, &vsp->vlist[0], 1);
+	    putchar('\n');
+	}
+    }
+    pmFreeResult(rp);
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    int		i;
+    int		sts;
+    int		count = 500;
+    int		delay = 0;
+    int		*ctxlist;
+    int		numpmid;
+    char	*host = "localhost";
+    char	*endnum;
+    char	**names;
+    pmID	*pmidlist;
+    pmDesc	*desclist;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = pmGetOptions(argc, argv, &opts)) != EOF) {
+	switch (c) {
+	    case 'c':
+		count = (int)strtol(opts.optarg, &endnum, 10);
+		if (*endnum != '\0' || count < 1) {
+		    pmprintf("%s: -c requires a positive numeric argument\n", pmGetProgname());
+		    opts.errors++;
+		}
+		break;
+	    case 'w':
+		delay = (int)strtol(opts.optarg, &endnum, 10);
+		if (*endnum != '\0' || delay < 0) {
+		    pmprintf("%s: -w requires a numeric argument\n", pmGetProgname());
+		    opts.errors++;
+		}
+		break;
+	}
+    }
+
+    if (opts.errors || opts.optind >= argc) {
+	pmUsageMessage(&opts);
+	exit(EXIT_FAILURE);
+    }
+    if (opts.nhosts > 0)
+	host = opts.hosts[0];
+
+    if ((ctxlist = (int *)malloc(count * sizeof(int))) == NULL) {
+	fprintf(stderr, "ctxlist[%d] malloc failed\n", count);
+	exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < count; i++) {
+	if ((ctxlist[i] = pmNewContext(PM_CONTEXT_HOST, host)) < 0) {
+	    fprintf(stderr, "%s: context #%d to host \"%s\": %s\n",
+		    pmGetProgname(), i, host, pmErrStr(ctxlist[i]));
+	    exit(EXIT_FAILURE);
+	}
+    }
+    printf("opened %d contexts\n", count);
+    fflush(stdout);
+
+    if (delay > 0)
+	sleep(delay);
+
+    numpmid = argc - opts.optind;
+    names = &argv[opts.optind];
+    pmidlist = (pmID *)malloc(numpmid * sizeof(pmID));
+    desclist = (pmDesc *)malloc(numpmid * sizeof(pmDesc));
+    if (pmidlist == NULL || desclist == NULL) {
+	fprintf(stderr, "pmidlist[%d] malloc failed\n", numpmid);
+	exit(EXIT_FAILURE);
+    }
+    pmUseContext(ctxlist[count-1]);
+    if ((sts = pmLookupName(numpmid, (const char **)names, pmidlist)) < 0) {
+	fprintf(stderr, "pmLookupName: %s\n", pmErrStr(sts));
+	exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < numpmid; i++) {
+	if ((sts = pmLookupDesc(pmidlist[i], &desclist[i])) < 0) {
+	    fprintf(stderr, "pmLookupDesc(%s): %s\n", names[i], pmErrStr(sts));
+	    exit(EXIT_FAILURE);
+	}
+    }
+
+    printf("fetch from last context\n");
+    dofetch(ctxlist[count-1], numpmid, pmidlist, desclist, names);
+    printf("fetch from first context\n");
+    dofetch(ctxlist[0], numpmid, pmidlist, desclist, names);
+
+    for (i = 0; i < count; i++)
+	pmDestroyContext(ctxlist[i]);
+    free(ctxlist);
+    free(pmidlist);
+    free(desclist);
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Update metric values through handles resolved once up front
+ * Build via: cc -g -Wall -lpcp_mmv -o mmv_handles mmv_handles.c
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/mmv_stats.h>
+
+static mmv_metric2_t metrics[] = {
+    {   .name = "requests",
+	.item = 1,
+	.type = MMV_TYPE_U64,
+	.semantics = MMV_SEM_COUNTER,
+	.dimension = MMV_UNITS(0,0,1,0,0,PM_COUNT_ONE),
+	.indom = 1,
+	.shorttext = "per-method counter",
+    },
+    {   .name = "bytes",
+	.item = 2,
+	.type = MMV_TYPE_DOUBLE,
+	.semantics = MMV_SEM_COUNTER,
+	.dimension = MMV_UNITS(1,0,0,PM_SPACE_BYTE,0,0),
+	.shorttext = "floating point counter",
+    },
+    {   .name = "level",
+	.item = 3,
+	.type = MMV_TYPE_I32,
+	.semantics = MMV_SEM_INSTANT,
+	.dimension = MMV_UNITS(0,0,0,0,0,0),
+	.shorttext = "set after increments",
+    },
+    {   .name = "busy",
+	.item = 4,
+	.type = MMV_TYPE_ELAPSED,
+	.semantics = MMV_SEM_COUNTER,
+	.dimension = MMV_UNITS(0,1,0,0,PM_TIME_USEC,0),
+	.shorttext = "elapsed time",
+    },
+};
+
+static mmv_instances2_t methods[] = {
+    {   .internal = 0, .external = "get" },
+    {   .internal = 1, .external = "put" },
+};
+
+int
+main(int argc, char **argv)
+{
+    int			i;
+    char		*file = (argc > 1) ? argv[1] : "handles";
+    void		*map;
+    mmv_handle_t	get, put, bytes, level, busy, bad;
+    mmv_registry_t	*registry;
+
+    registry = mmv_stats_registry(file, 325, MMV_FLAG_SHARDED);
+    if (!registry) {
+	fprintf(stderr, "mmv_stats_registry: %s - %s\n", file, strerror(errno));
+	return 1;
+    }
+
+    mmv_stats_add_indom(registry, 1, "request methods", NULL);
+    for (i = 0; i < sizeof(methods) / sizeof(mmv_instances2_t); i++)
+	mmv_stats_add_instance(registry, 1,
+			 methods[i].internal, methods[i].external);
+    for (i = 0; i < sizeof(metrics) / sizeof(mmv_metric2_t); i++)
+	mmv_stats_add_metric(registry,
+			 metrics[i].name, metrics[i].item, metrics[i].type,
+			 metrics[i].semantics, metrics[i].dimension,
+			 metrics[i].indom, metrics[i].shorttext,
+			 metrics[i].helptext);
+
+    map = mmv_stats_start(registry);
+    if (!map) {
+	fprintf(stderr, "mmv_stats_start: %s - %s\n", file, strerror(errno));
+	return 1;
+    }
+
+    if (mmv_lookup_handle(map, "requests", "get", &get) < 0 ||
+	mmv_lookup_handle(map, "requests", "put", &put) < 0 ||
+	mmv_lookup_handle(map, "bytes", NULL, &bytes) < 0 ||
+	mmv_lookup_handle(map, "level", NULL, &level) < 0 ||
+	mmv_lookup_handle(map, "busy", NULL, &busy) < 0) {
+	fprintf(stderr, "mmv_lookup_handle: %s\n", strerror(errno));
+	return 1;
+    }
+    if (mmv_lookup_handle(map, "requests", "post", &bad) < 0)
+	printf("mmv_lookup_handle: no instance: %s\n", strerror(errno));
+    if (mmv_lookup_handle(map, "missing", NULL, &bad) < 0)
+	printf("mmv_lookup_handle: no metric: %s\n", strerror(errno));
+
+    for (i = 0; i < 1000; i++) {
+	mmv_handle_inc(&get);
+	if (i % 4 == 0)
+	    mmv_handle_inc(&put);
+	mmv_handle_add(&bytes, 1.5);
+	mmv_handle_inc(&level);
+    }
+
+    /* setting a value discards any increments held in the shards */
+    mmv_handle_set(&level, -7);
+
+    /* elapsed time - start and end of an interval */
+    mmv_handle_add(&busy, -1000);
+    mmv_handle_add(&busy, 1250);
+
+    mmv_stats_free(registry);
+    return 0;
+}
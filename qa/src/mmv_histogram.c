@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Record the distribution of values in a histogram metric
+ * Build via: cc -g -Wall -lpcp_mmv -o mmv_histogram mmv_histogram.c
+ */
+
+#include <pcp/pmapi.h>
+#include <pcp/mmv_stats.h>
+
+static mmv_metric2_t metrics[] = {
+    {   .name = "latency",
+	.item = 1,
+	.type = MMV_TYPE_HISTOGRAM,
+	.semantics = MMV_SEM_INSTANT,
+	.dimension = MMV_UNITS(0,1,0,0,PM_TIME_USEC,0),
+	.indom = MMV_INDOM_NULL,
+	.shorttext = "request latency",
+    },
+    {   .name = "empty",
+	.item = 2,
+	.type = MMV_TYPE_HISTOGRAM,
+	.semantics = MMV_SEM_INSTANT,
+	.dimension = MMV_UNITS(0,0,0,0,0,0),
+	.indom = MMV_INDOM_NULL,
+	.shorttext = "nothing recorded",
+    },
+    {   .name = "requests",
+	.item = 3,
+	.type = MMV_TYPE_U64,
+	.semantics = MMV_SEM_COUNTER,
+	.dimension = MMV_UNITS(0,0,1,0,0,PM_COUNT_ONE),
+	.indom = MMV_INDOM_NULL,
+	.shorttext = "regular counter",
+    },
+};
+
+int
+main(int argc, char **argv)
+{
+    int			i;
+    char		*file = (argc > 1) ? argv[1] : "histogram";
+    void		*map;
+    pmAtomValue		*latency, *empty, *requests, one = { .ull = 1 };
+    mmv_handle_t	handle;
+    mmv_registry_t	*registry, *bad;
+
+    registry = mmv_stats_registry(file, 326, 0);
+    if (!registry) {
+	fprintf(stderr, "mmv_stats_registry: %s - %s\n", file, strerror(errno));
+	return 1;
+    }
+
+    for (i = 0; i < sizeof(metrics) / sizeof(mmv_metric2_t); i++)
+	mmv_stats_add_metric(registry,
+			 metrics[i].name, metrics[i].item, metrics[i].type,
+			 metrics[i].semantics, metrics[i].dimension,
+			 metrics[i].indom, metrics[i].shorttext,
+			 metrics[i].helptext);
+
+    /* histograms with an instance domain are rejected */
+    if ((bad = mmv_stats_registry("histogram-bad", 327, 0)) != NULL) {
+	mmv_stats_add_indom(bad, 1, "an indom", NULL);
+	mmv_stats_add_instance(bad, 1, 0, "zero");
+	mmv_stats_add_metric(bad, "bad", 1, MMV_TYPE_HISTOGRAM,
+		MMV_SEM_INSTANT, metrics[1].dimension, 1, NULL, NULL);
+	if (mmv_stats_start(bad) == NULL)
+	    printf("mmv_stats_start: indom histogram: %s\n", strerror(errno));
+	mmv_stats_free(bad);
+    }
+
+    map = mmv_stats_start(registry);
+    if (!map) {
+	fprintf(stderr, "mmv_stats_start: %s - %s\n", file, strerror(errno));
+	return 1;
+    }
+
+    latency = mmv_lookup_value_desc(map, "latency", NULL);
+    empty = mmv_lookup_value_desc(map, "empty", NULL);
+    requests = mmv_lookup_value_desc(map, "requests", NULL);
+    if (!latency || !empty || !requests ||
+	mmv_lookup_handle(map, "latency", NULL, &handle) < 0) {
+	fprintf(stderr, "lookup failed: %s\n", strerror(errno));
+	return 1;
+    }
+
+    /* 1..1000 once each, so quantiles are known up to bucket widths */
+    for (i = 1; i <= 1000; i++) {
+	if (i % 2)
+	    mmv_inc_value(map, latency, i);
+	else
+	    mmv_handle_add(&handle, i);
+	mmv_inc(map, requests);
+    }
+    mmv_inc_value(map, latency, -5);	/* ignored */
+    mmv_set_value(map, latency, 12345);	/* ignored */
+    mmv_inc_atomvalue(map, latency, &one);
+    mmv_stats_add(map, "latency", NULL, 1000000);
+
+    mmv_stats_free(registry);
+    return 0;
+}
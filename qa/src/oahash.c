@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Exercise libpcp open-addressed hash table interfaces
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+#include <stdint.h>
+
+static int	ndel;
+
+__pmHashWalkState
+walker(const __pmOAHashNode *n, void *v)
+{
+    /* delete every odd key, and count the visits */
+    (*(int *)v)++;
+    if (n->key & 1) {
+	ndel++;
+	return PM_HASH_WALK_DELETE_NEXT;
+    }
+    return PM_HASH_WALK_NEXT;
+}
+
+int
+main(int argc, char **argv)
+{
+    __pmOAHashCtl	hc;
+    __pmOAHashNode	*n;
+    unsigned int	key;
+    int			i, sts, count, errors = 0;
+    int			nkeys = 100000;
+
+    __pmOAHashInit(&hc);
+
+    printf("dense keys, walk order\n");
+    for (i = 0; i < 10; i++)
+	__pmOAHashAdd(i, (void *)(__psint_t)(i * 10), &hc);
+    for (n = __pmOAHashWalk(&hc, PM_HASH_WALK_START); n != NULL;
+	 n = __pmOAHashWalk(&hc, PM_HASH_WALK_NEXT))
+	printf(" %u=>%d", n->key, (int)(__psint_t)n->data);
+    putchar('\n');
+    printf("duplicate add -> %d\n", __pmOAHashAdd(3, NULL, &hc));
+    printf("search 3 -> %d\n", (int)(__psint_t)__pmOAHashSearch(3, &hc)->data);
+    sts = __pmOAHashDel(3, &hc);
+    printf("delete 3 -> %d, again -> %d\n", sts, __pmOAHashDel(3, &hc));
+    printf("search 3 -> %s\n", __pmOAHashSearch(3, &hc) ? "found" : "NULL");
+    __pmOAHashFree(&hc);
+
+    /* sparse, colliding keys (PMID-like), pre-sized */
+    printf("sparse keys\n");
+    if ((sts = __pmOAHashPreAlloc(nkeys, &hc)) < 0)
+	printf("__pmOAHashPreAlloc: %s\n", pmErrStr(sts));
+    for (i = 0; i < nkeys; i++) {
+	key = ((i % 512) << 22) | ((i / 512) << 10) | (i % 7);
+	if ((sts = __pmOAHashAdd(key, (void *)(__psint_t)i, &hc)) != 1) {
+	    printf("add %d (key %u) -> %d\n", i, key, sts);
+	    errors++;
+	}
+    }
+    if (hc.nodes != nkeys) {
+	printf("nodes %u != %d\n", hc.nodes, nkeys);
+	errors++;
+    }
+    for (i = 0; i < nkeys; i++) {
+	key = ((i % 512) << 22) | ((i / 512) << 10) | (i % 7);
+	n = __pmOAHashSearch(key, &hc);
+	if (n == NULL || (int)(__psint_t)n->data != i) {
+	    printf("search %d (key %u) failed\n", i, key);
+	    errors++;
+	}
+    }
+
+    printf("walk deleting odd keys\n");
+    count = 0;
+    __pmOAHashWalkCB(walker, &count, &hc);
+    if (count != nkeys) {
+	printf("visited %d != %d\n", count, nkeys);
+	errors++;
+    }
+    if (hc.nodes != nkeys - ndel) {
+	printf("nodes %u != %d\n", hc.nodes, nkeys - ndel);
+	errors++;
+    }
+    for (i = 0; i < nkeys; i++) {
+	key = ((i % 512) << 22) | ((i / 512) << 10) | (i % 7);
+	n = __pmOAHashSearch(key, &hc);
+	if ((key & 1) ? (n != NULL) : (n == NULL)) {
+	    printf("after delete: search %d (key %u) wrong\n", i, key);
+	    errors++;
+	}
+    }
+    __pmOAHashFree(&hc);
+
+    printf("%d errors\n", errors);
+    exit(errors != 0);
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Exercise the PDU buffer size-class pool - pin/unpin via interior
+ * pointers, reuse of released buffers, buffers released by a thread
+ * other than the one that allocated them, and the hit/miss counters
+ * (including once the pool's address space is used up and buffers
+ * come from malloc instead).  Run with PCP_PDUBUF_POOL=0 in the environment to exercise the
+ * malloc path instead.
+ */
+
+#include <pcp/pmapi.h>
+#include "libpcp.h"
+#include <pthread.h>
+
+#define NTHREAD	4
+#define NBUF	64
+#define NBIG	(256 * 1024 / 64 + 16)	/* 64K buffers, > 256M arena */
+
+static char	*bufs[NBUF];
+static __pmPDUBufStats	prev;
+
+static void
+delta(const char *what)
+{
+    __pmPDUBufStats	now;
+
+    __pmGetPDUBufStats(&now);
+    printf("%s: hits +%llu misses +%llu\n", what,
+	    (unsigned long long)(now.hits - prev.hits),
+	    (unsigned long long)(now.misses - prev.misses));
+    prev = now;
+}
+
+static void *
+release(void *arg)
+{
+    int		i, first = (int)(__psint_t)arg;
+
+    for (i = first; i < NBUF; i += NTHREAD) {
+	if (__pmUnpinPDUBuf(bufs[i]) != 1)
+	    fprintf(stderr, "thread %d: unpin %d failed\n", first, i);
+    }
+    return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+    static int	sizes[] = { 100, 1000, 4000, 16000, 60000, 100000 };
+    pthread_t	tid[NTHREAD];
+    char	*buf, *last;
+    char	**big;
+    __pmPDUBufStats	now;
+    int		alloc, nfree;
+    int		c, i, errflag = 0;
+
+    pmSetProgname(argv[0]);
+    while ((c = getopt(argc, argv, "D:")) != EOF) {
+	switch (c) {
+	case 'D':
+	    if (pmSetDebug(optarg) < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+			pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+    if (errflag || optind != argc) {
+	fprintf(stderr, "Usage: %s [-D debug]\n", pmGetProgname());
+	exit(1);
+    }
+
+    __pmGetPDUBufStats(&prev);
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+	printf("=== size %d ===\n", sizes[i]);
+	buf = (char *)__pmFindPDUBuf(sizes[i]);
+	last = buf + ((sizes[i] - sizeof(int)) & ~(sizeof(int) - 1));
+	__pmPinPDUBuf(last);
+	printf("unpin first -> %d\n", __pmUnpinPDUBuf(buf));
+	printf("unpin last -> %d\n", __pmUnpinPDUBuf(last));
+	printf("unpin released -> %d\n", __pmUnpinPDUBuf(buf));
+	delta("first allocation");
+	buf = (char *)__pmFindPDUBuf(sizes[i]);
+	delta("second allocation");
+	__pmUnpinPDUBuf(buf);
+    }
+
+    printf("=== %d buffers released by %d threads ===\n", NBUF, NTHREAD);
+    for (i = 0; i < NBUF; i++)
+	bufs[i] = (char *)__pmFindPDUBuf(sizes[i % 3]);
+    __pmCountPDUBuf(0, &alloc, &nfree);
+    printf("in use: %d\n", alloc);
+    for (i = 0; i < NTHREAD; i++)
+	pthread_create(&tid[i], NULL, release, (void *)(__psint_t)i);
+    for (i = 0; i < NTHREAD; i++)
+	pthread_join(tid[i], NULL);
+    __pmCountPDUBuf(0, &alloc, &nfree);
+    printf("in use: %d\n", alloc);
+    __pmGetPDUBufStats(&prev);
+    for (i = 0; i < NBUF; i++)
+	bufs[i] = (char *)__pmFindPDUBuf(sizes[i % 3]);
+    delta("reallocation");
+    for (i = 0; i < NBUF; i++)
+	__pmUnpinPDUBuf(bufs[i]);
+    __pmCountPDUBuf(0, &alloc, &nfree);
+    printf("in use: %d\n", alloc);
+
+    printf("=== %d buffers, more than the pool holds ===\n", NBIG);
+    if ((big = (char **)malloc(NBIG * sizeof(char *))) == NULL) {
+	fprintf(stderr, "malloc failed\n");
+	exit(1);
+    }
+    __pmGetPDUBufStats(&prev);
+    for (i = 0; i < NBIG; i++)
+	big[i] = (char *)__pmFindPDUBuf(sizes[4]);
+    __pmGetPDUBufStats(&now);
+    if ((now.hits - prev.hits) + (now.misses - prev.misses) == NBIG)
+	printf("one hit or miss per allocation\n");
+    else
+	printf("hits +%llu misses +%llu for %d allocations\n",
+		(unsigned long long)(now.hits - prev.hits),
+		(unsigned long long)(now.misses - prev.misses), NBIG);
+    for (i = 0; i < NBIG; i++)
+	__pmUnpinPDUBuf(big[i]);
+    free(big);
+    __pmCountPDUBuf(0, &alloc, &nfree);
+    printf("in use: %d\n", alloc);
+
+    return 0;
+}
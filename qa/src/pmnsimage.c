@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Load a PMNS with pmLoadNameSpace (so the binary image may be used)
+ * and look up some names in it
+ */
+
+#include <pcp/pmapi.h>
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    int		sts;
+    int		errflag = 0;
+    pmID	pmid;
+    char	*name;
+    char	strbuf[20];
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "D:")) != EOF) {
+	switch (c) {
+
+	case 'D':	/* debug options */
+	    if ((sts = pmSetDebug(optarg)) < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind > argc - 1) {
+	fprintf(stderr, "Usage: %s [-D debug] pmnsfile [name ...]\n", pmGetProgname());
+	exit(1);
+    }
+
+    if ((sts = pmLoadNameSpace(argv[optind])) < 0) {
+	printf("pmLoadNameSpace(%s): %s\n", argv[optind], pmErrStr(sts));
+	exit(1);
+    }
+
+    for (optind++; optind < argc; optind++) {
+	name = argv[optind];
+	if ((sts = pmLookupName(1, (const char **)&name, &pmid)) < 0)
+	    printf("%s: %s\n", name, pmErrStr(sts));
+	else
+	    printf("%s %s\n", name, pmIDStr_r(pmid, strbuf, sizeof(strbuf)));
+    }
+
+    pmUnloadNameSpace();
+    exit(0);
+}
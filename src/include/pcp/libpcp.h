@@ -166,10 +166,14 @@ typedef struct __pmnsTree {
     __pmnsNode		**htab; /* hash table of nodes keyed on pmid */
     int			htabsize;     /* number of nodes in the table */
     int			mark_state;   /* the total mark value for trimming */
+    void		*image;	/* mapped binary PMNS image, if any */
+    size_t		imagelen;	/* length of the image mapping */
+    __pmnsNode		*nodes;	/* all nodes, when loaded from an image */
 } __pmnsTree;
 
 /* used by pmnsmerge/pmnsdel */
 PCP_CALL extern __pmnsTree *__pmExportPMNS(void); 
+PCP_CALL extern int __pmSavePMNSImage(const char *);
 
 /* for PMNS in archives and PMDA use */
 PCP_CALL extern int __pmNewPMNS(__pmnsTree **);
@@ -437,6 +441,23 @@ PCP_CALL extern __pmPDU *__pmFindPDUBuf(int);
 PCP_CALL extern void __pmPinPDUBuf(void *);
 PCP_CALL extern int __pmUnpinPDUBuf(void *);
 PCP_CALL extern void __pmCountPDUBuf(int, int *, int *);
+typedef struct {
+    __uint64_t	hits;		/* requests satisfied from a freelist */
+    __uint64_t	misses;		/* requests needing new memory */
+    __uint64_t	bytes;		/* memory held for PDU buffers */
+} __pmPDUBufStats;
+PCP_CALL extern void __pmGetPDUBufStats(__pmPDUBufStats *);
+
+/* xz decompression block cache statistics, for all xz files */
+typedef struct {
+    __uint64_t	hits;		/* reads satisfied from a cached block */
+    __uint64_t	misses;		/* blocks decompressed on demand */
+    __uint64_t	readahead;	/* blocks decompressed in the background */
+    __uint64_t	rahits;		/* misses satisfied by readahead */
+    __uint64_t	nsec;		/* time spent decompressing */
+    __uint64_t	bytes;		/* uncompressed bytes currently cached */
+} __pmXZCacheStats;
+PCP_CALL extern int __pmGetXZCacheStats(__pmXZCacheStats *);
 
 /* PDU counting services */
 PCP_DATA extern unsigned int *__pmPDUCntIn;
@@ -542,6 +563,29 @@ PCP_CALL extern int __pmHashDel(unsigned int, void *, __pmHashCtl *);
 PCP_CALL extern void __pmHashClear(__pmHashCtl *);
 PCP_CALL extern void __pmHashFree(__pmHashCtl *);
 
+/* Open-addressed hash tables with inline keys, unique keys only */
+typedef struct __pmOAHashNode {
+    unsigned int	key;
+    unsigned int	dist;		/* probe distance + 1, 0 if empty */
+    void		*data;
+} __pmOAHashNode;
+typedef struct __pmOAHashCtl {
+    unsigned int	nodes;
+    unsigned int	hsize;		/* power of 2, or 0 */
+    __pmOAHashNode	*hash;
+    unsigned int	start;		/* __pmOAHashWalk state */
+    unsigned int	index;
+} __pmOAHashCtl;
+PCP_CALL extern void __pmOAHashInit(__pmOAHashCtl *);
+PCP_CALL extern int __pmOAHashPreAlloc(int, __pmOAHashCtl *);
+typedef __pmHashWalkState(*__pmOAHashWalkCallback)(const __pmOAHashNode *, void *);
+PCP_CALL extern void __pmOAHashWalkCB(__pmOAHashWalkCallback, void *, __pmOAHashCtl *);
+PCP_CALL extern __pmOAHashNode *__pmOAHashWalk(__pmOAHashCtl *, __pmHashWalkState);
+PCP_CALL extern __pmOAHashNode *__pmOAHashSearch(unsigned int, const __pmOAHashCtl *);
+PCP_CALL extern int __pmOAHashAdd(unsigned int, void *, __pmOAHashCtl *);
+PCP_CALL extern int __pmOAHashDel(unsigned int, __pmOAHashCtl *);
+PCP_CALL extern void __pmOAHashFree(__pmOAHashCtl *);
+
 
 /*
  * Host specification allowing one or more pmproxy host, and port numbers
@@ -656,6 +700,17 @@ PCP_CALL extern int __pmEqualLabelSet(const pmLabelSet *, const pmLabelSet *);
 PCP_CALL extern int __pmGetContextLabels(pmLabelSet **);
 PCP_CALL extern int __pmGetDomainLabels(int, const char *, pmLabelSet **);
 
+/* client-side cache of instance labels, keyed by (indom, instance) */
+typedef struct __pmLabelCache {
+    __pmHashCtl		indoms;		/* per-indom instance label tables */
+} __pmLabelCache;
+PCP_CALL extern void __pmLabelCacheInit(__pmLabelCache *);
+PCP_CALL extern void __pmLabelCacheFree(__pmLabelCache *);
+PCP_CALL extern int __pmLabelCacheUpdate(__pmLabelCache *, pmInDom, int, int *);
+PCP_CALL extern int __pmLabelCacheGeneration(__pmLabelCache *, pmInDom);
+PCP_CALL extern int __pmLabelCacheLookup(__pmLabelCache *, pmInDom, int, pmLabelSet **);
+PCP_CALL extern int __pmLabelCacheGetSets(__pmLabelCache *, pmInDom, pmLabelSet **);
+
 /* internal archive data structures */
 /*
  * record header in the metadata file ... len (by itself) also is
@@ -822,6 +877,8 @@ typedef struct {
     struct __pmnsTree *pmns;	/* namespace from meta data */
     int		numpmid;	/* no. names in namespace */
     int		multi;		/* part of a multi-archive context */
+    __pmFILE	*tidxfp;	/* (when writing) dense temporal index */
+    struct __pmLogTIdx *tidx;	/* (when reading) dense temporal index */
 } __pmLogCtl;
 
 /* state values */
@@ -883,7 +940,7 @@ typedef struct {
  * using the indom as the key from trimindom.
  */
 typedef struct {
-    __pmHashCtl	hashinst;		/* nested hash on inst for this indom */
+    __pmOAHashCtl	hashinst;		/* nested hash on inst for this indom */
 } __pmLogTrimInDom;
 
 PCP_CALL extern void __pmFreeLogInDom(__pmLogInDom *);
@@ -943,6 +1000,22 @@ PCP_CALL extern int __pmLogPutResult2(__pmArchCtl *, __pmPDU *);
 PCP_CALL extern int __pmLogPutResult3(__pmArchCtl *, __pmPDU *);
 PCP_CALL extern int __pmLogPutIndex(const __pmArchCtl *, const __pmTimestamp *);
 PCP_CALL extern int __pmLogLoadIndex(__pmLogCtl *);
+
+/* dense temporal index, see logtidx.c */
+typedef struct {
+    __pmTimestamp	stamp;		/* record timestamp */
+    int			vol;		/* data volume */
+    off_t		off;		/* start of record in vol */
+} __pmLogTIdxEntry;
+PCP_CALL extern int __pmLogTIdxLoad(__pmLogCtl *);
+PCP_CALL extern void __pmLogTIdxFree(__pmLogCtl *);
+PCP_CALL extern int __pmLogTIdxCount(const __pmLogCtl *);
+PCP_CALL extern int __pmLogTIdxGet(const __pmLogCtl *, int, __pmLogTIdxEntry *);
+PCP_CALL extern int __pmLogTIdxSearch(const __pmLogCtl *, const __pmTimestamp *, int);
+PCP_CALL extern int __pmLogTIdxFindPMID(const __pmLogCtl *, pmID, int, int);
+PCP_CALL extern int __pmLogTIdxCreate(__pmArchCtl *, const char *);
+PCP_CALL extern int __pmLogTIdxBuild(__pmArchCtl *);
+
 PCP_CALL extern int __pmLogEncodeLabels(__pmLogCtl *, unsigned int, unsigned int, int, pmLabelSet *, const __pmTimestamp *, __int32_t **);
 PCP_CALL extern int __pmLogPutLabels(__pmArchCtl *, unsigned int, unsigned int, int, pmLabelSet *, const __pmTimestamp *);
 PCP_CALL extern int __pmLogPutText(__pmArchCtl *, unsigned int, unsigned int, char *, int);
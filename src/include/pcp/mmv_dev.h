@@ -19,6 +19,8 @@
 #define MMV_VERSION1	1	/* original on-disk format */
 #define MMV_VERSION2	2	/* + mmv_disk_{metric2,instance2}_t */
 #define MMV_VERSION3	3	/* + labels support */
+#define MMV_VERSION4	4	/* + per-CPU counter shards */
+#define MMV_VERSION5	5	/* + histogram values */
 #define MMV_VERSION     1	/* default, upgrading to v3 only if needed */
 
 typedef enum mmv_toc_type {
@@ -28,6 +30,8 @@ typedef enum mmv_toc_type {
     MMV_TOC_VALUES	= 4,	/* mmv_disk_value_t */
     MMV_TOC_STRINGS	= 5,	/* mmv_disk_string_t */
     MMV_TOC_LABELS	= 6,	/* mmv_disk_label_t */
+    MMV_TOC_SHARDS	= 7,	/* per-CPU pmAtomValue arrays */
+    MMV_TOC_HISTOGRAMS	= 8,	/* mmv_disk_histogram_t */
 } mmv_toc_type_t;
 
 /* The way the Table Of Contents is written into the file */
@@ -101,6 +105,44 @@ typedef struct mmv_disk_value {
     __uint64_t		instance;	/* Offset into the instance section */
 } mmv_disk_value_t;
 
+/*
+ * The shards section (v4) holds one array of pmAtomValue per shard,
+ * with an entry for each entry of the values section (in the same
+ * order).  Each array starts on its own cache line, and readers add
+ * the entries from every shard to the value to get the current total.
+ */
+#define MMV_CACHELINE	64
+#define MMV_SHARD_STRIDE(nvalues) \
+	(((nvalues) * sizeof(pmAtomValue) + MMV_CACHELINE - 1) & \
+	 ~((__uint64_t)MMV_CACHELINE - 1))
+
+/*
+ * Histogram values (v5) are log-linear, as for HdrHistogram: values
+ * below 2^MMV_HIST_SUBBITS each have their own bucket, and above that
+ * each power of two range is split into 2^(MMV_HIST_SUBBITS-1) equal
+ * sized buckets.  So a value v >= 2^MMV_HIST_SUBBITS with most
+ * significant bit m is counted in bucket
+ *	((m - MMV_HIST_SUBBITS + 1) << (MMV_HIST_SUBBITS - 1)) +
+ *	(v >> (m - MMV_HIST_SUBBITS + 1))
+ * and buckets are at most 1/16th of their lower bound wide, covering
+ * the whole unsigned 64-bit range.  The value entry of a histogram
+ * metric holds the offset of its mmv_disk_histogram_t in "extra".
+ *
+ * Histogram metrics have no instance domain, and pmdammv exports each
+ * with a second PMID, its item with the MMV_HIST_SUMMARY bit set.
+ */
+#define MMV_HIST_SUBBITS	5
+#define MMV_HIST_BUCKETS	((64 - MMV_HIST_SUBBITS + 2) << (MMV_HIST_SUBBITS - 1))
+#define MMV_HIST_SUMMARY	(1 << 9)
+
+typedef struct mmv_disk_histogram {
+    __uint64_t		count;		/* Number of values recorded */
+    __uint64_t		sum;		/* Sum of values recorded */
+    __uint64_t		min;		/* Smallest value (~0 if none) */
+    __uint64_t		max;		/* Largest value */
+    __uint64_t		buckets[MMV_HIST_BUCKETS];
+} mmv_disk_histogram_t;
+
 typedef struct mmv_disk_header {
     char		magic[4];	/* MMV\0 */
     __int32_t		version;	/* version */
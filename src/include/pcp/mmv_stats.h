@@ -34,6 +34,7 @@ typedef enum mmv_metric_type {
     MMV_TYPE_DOUBLE    = PM_TYPE_DOUBLE,/* 64-bit floating point */
     MMV_TYPE_STRING    = PM_TYPE_STRING,/* NULL-terminate string */
     MMV_TYPE_ELAPSED   = 9,		/* 64-bit elapsed time */
+    MMV_TYPE_HISTOGRAM = 10,		/* histogram of 64-bit values */
 } mmv_metric_type_t;
 
 typedef enum mmv_metric_sem {
@@ -105,6 +106,7 @@ typedef enum mmv_stats_flags {
     MMV_FLAG_NOPREFIX  = 0x1,  /* Don't prefix metric names by filename */ 
     MMV_FLAG_PROCESS   = 0x2,  /* Indicates process check on PID needed */ 
     MMV_FLAG_SENTINEL  = 0x4,  /* Sentinel values == no-value-available */ 
+    MMV_FLAG_SHARDED   = 0x8,  /* Per-CPU counter shards (v4 format) */
 } mmv_stats_flags_t;
 
 typedef enum mmv_value_type {
@@ -148,6 +150,26 @@ extern void mmv_stats_free(mmv_registry_t *);
 
 extern pmAtomValue * mmv_lookup_value_desc(void *, const char *, const char *);
 
+/*
+ * A value handle holds everything needed to update one metric value,
+ * resolved once by name - the fastest way to update metrics, with no
+ * lookups at all on each update.
+ */
+typedef struct mmv_handle {
+    void		*addr;		/* mapping from mmv_stats_start */
+    pmAtomValue		*value;		/* value within the mapping */
+    char		*shards;	/* its entry in the first shard */
+    __uint64_t		stride;		/* bytes between shard entries */
+    __int32_t		nshards;	/* per-CPU shards (or zero) */
+    mmv_metric_type_t	type;		/* metric value type */
+} mmv_handle_t;
+
+extern int mmv_lookup_handle(void *, const char *, const char *,
+				mmv_handle_t *);
+extern void mmv_handle_inc(mmv_handle_t *);
+extern void mmv_handle_add(mmv_handle_t *, double);
+extern void mmv_handle_set(mmv_handle_t *, double);
+
 /*
  * Use these interfaces for updating metrics prefentially to
  * the by-metric-name lookup based interfaces (see below).
@@ -615,6 +615,7 @@ PCP_CALL extern int pmGetInDomLabels(pmInDom, pmLabelSet **);
 PCP_CALL extern int pmGetClusterLabels(pmID, pmLabelSet **);
 PCP_CALL extern int pmGetItemLabels(pmID, pmLabelSet **);
 PCP_CALL extern int pmGetInstancesLabels(pmInDom, pmLabelSet **);
+PCP_CALL extern int pmGetInstancesLabelsList(pmInDom, int, int *, pmLabelSet **);
 
 PCP_CALL extern int pmLookupLabels(pmID, pmLabelSet **);
 
@@ -1176,6 +1177,34 @@ PCP_CALL extern int pmUnpackHighResEventRecords(pmValueSet *, int, pmHighResResu
 /* Free set of pmHighResResults from pmUnpackEventRecords */
 PCP_CALL extern void pmFreeHighResEventResult(pmHighResResult **);
 
+/*
+ * Walk the packed records of a PM_TYPE_EVENT or PM_TYPE_HIGHRES_EVENT
+ * value in place - nothing is allocated or copied, so parameter values
+ * reference the packed array and may not be suitably aligned.
+ */
+typedef struct pmEventIter {
+    const char		*base;		/* next unread byte of the array */
+    int			highres;	/* 1 for PM_TYPE_HIGHRES_EVENT */
+    int			nrecords;	/* number of records in the array */
+    int			record;		/* current record, -1 before first */
+    int			nparams;	/* parameters in the current record */
+    int			param;		/* parameters returned so far */
+    unsigned int	flags;		/* er_flags of the current record */
+    int			missed;		/* for PM_EVENT_FLAG_MISSED records */
+    struct timespec	timestamp;	/* time of the current record */
+} pmEventIter;
+
+typedef struct pmEventParam {
+    pmID		pmid;		/* metric identifier */
+    int			type;		/* PM_TYPE_* of the value */
+    int			vlen;		/* bytes in vbuf[] */
+    const void		*vbuf;		/* value, in place and unaligned */
+} pmEventParam;
+
+PCP_CALL extern int pmEventIterInit(pmEventIter *, pmValueSet *, int);
+PCP_CALL extern int pmEventIterNextRecord(pmEventIter *);
+PCP_CALL extern int pmEventIterNextParam(pmEventIter *, pmEventParam *);
+
 /* Service discovery, for clients. */
 #define PM_SERVER_SERVICE_SPEC	"pmcd"
 #define PM_SERVER_PROXY_SPEC	"pmproxy"
@@ -24,6 +24,9 @@
 #ifdef HAVE_NETIOAPI_H
 #include <netioapi.h>
 #endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
 #define SOCKET_INTERNAL
 #include "internal.h"
 
@@ -1632,6 +1635,21 @@ __pmSocketReady(int fd, struct timeval *timeout)
     if (fd < 0)
 	return -EBADF;
 
+#ifdef HAVE_POLL_H
+    if (fd >= FD_SETSIZE) {
+	/* select(2) cannot handle this descriptor, e.g. busy pmcd */
+	struct pollfd	pfd;
+	int		msec = -1;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if (timeout != NULL)
+	    msec = timeout->tv_sec * 1000 + timeout->tv_usec / 1000;
+	return poll(&pfd, 1, msec);
+    }
+#endif
+
     FD_ZERO(&onefd);
     FD_SET(fd, &onefd);
     return select(fd+1, &onefd, NULL, NULL, timeout);
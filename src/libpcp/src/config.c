@@ -559,6 +559,11 @@ extern const char *compress_suffix_list(void);
 #else
 #define LZMA_DECOMPRESS		disabled
 #endif
+#if defined(HAVE_ZSTD_DECOMPRESSION)
+#define ZSTD_DECOMPRESS		enabled
+#else
+#define ZSTD_DECOMPRESS		disabled
+#endif
 #if defined(HAVE_TRANSPARENT_DECOMPRESSION)
 #define TRANSPARENT_DECOMPRESS	enabled
 #else
@@ -598,6 +603,7 @@ static struct {
 	{ "v3_archives",	enabled },			/* from pcp-6.0.0 */
 	{ "archive_features",	myfeatures },			/* from pcp-6.0.0 */
 	{ "y2038_safe",		Y2038_SAFE },			/* from pcp-6.3.0 */
+	{ "zstd_decompress",	ZSTD_DECOMPRESS },		/* from pcp-7.0.0 */
 };
 
 void
@@ -63,6 +63,12 @@ typedef struct {		/* dynamic information for an expression node */
     val_t		*last_ivlist;	/* values from previous fetch for delta() or rate() */
     struct timespec	last_stamp;	/* timestamp from previous fetch for rate() */
     int			bind;		/* for N_COLON: BIND_LEFT, _RIGHT or _BOTH */
+    int			*join;		/* binary operators: left,right ivlist[] index pairs */
+    int			numjoin;	/* number of pairs in join[] */
+    int			join_lnum;	/* left numval when join[] was built */
+    int			join_rnum;	/* right numval when join[] was built */
+    pmAtomValue		*opval;		/* binary operators: promoted operand values */
+    int			maxopval;	/* length of opval[] */
 } info_t;
 
 typedef struct {			/* for instance filtering */
@@ -233,432 +233,240 @@ free_ivlist(node_t *np)
 }
 
 /*
- * Binary arithmetic.
+ * Instance join for binary operators.
  *
- * result = <a> <op> <b>
- * ltype, rtype and type are the types of <a>, <b> and the result
- * respectively
+ * Build join[] as <i,j> pairs such that result value k is
+ * left->ivlist[i] <op> right->ivlist[j], i.e. each left instance
+ * with a matching right instance (in left order), or each value of
+ * the operand with an instance domain when the other is singular.
  *
- * If type is PM_TYPE_DOUBLE then lmul, ldiv, rmul and rdiv are
- * the scale factors for units scale conversion of <a> and <b>
- * respectively, so lmul*<a>/ldiv ... all are 1 in the common cases.
+ * The join is reused from the previous fetch when it is known to be
+ * unchanged, which is the common case as both operands are generally
+ * over the same instance domain, fetched with the same profile.  With
+ * unique instances within each operand, the cached join is complete if
+ * every pair still matches and all of the instances of one side
+ * are used.
+ *
+ * Returns the number of pairs, i.e. the number of result values.
  */
-static pmAtomValue
-bin_op(int type, int op, pmAtomValue a, int ltype, int lmul, int ldiv, pmAtomValue b, int rtype, int rmul, int rdiv)
+static int
+join_ivlist(node_t *np)
 {
-    pmAtomValue	res;
-    pmAtomValue	l;
-    pmAtomValue	r;
-
-    l = a;	/* struct assignments */
-    r = b;
-
-    /* 
-     * Promote each operand to the type of the result ... there are limited
-     * cases to be considered here, see promote[][] and map_desc().
-     */
-    switch (type) {
-	case PM_TYPE_32:
-	case PM_TYPE_U32:
-	    /* do nothing */
-	    break;
-	case PM_TYPE_64:
-	    switch (ltype) {
-		case PM_TYPE_32:
-		    l.ll = a.l;
-		    break;
-		case PM_TYPE_U32:
-		    l.ll = a.ul;
-		    break;
-		case PM_TYPE_64:
-		case PM_TYPE_U64:
-		    /* do nothing */
+    info_t	*ip = np->data.info;
+    info_t	*lp = np->left->data.info;
+    info_t	*rp = np->right->data.info;
+    int		both = np->left->desc.indom != PM_INDOM_NULL &&
+		       np->right->desc.indom != PM_INDOM_NULL;
+    int		*tmp_join;
+    int		i, j, k;
+
+    if (ip->join != NULL &&
+	ip->join_lnum == lp->numval && ip->join_rnum == rp->numval) {
+	if (!both)
+	    return ip->numjoin;
+	if (ip->numjoin == lp->numval || ip->numjoin == rp->numval) {
+	    for (k = 0; k < ip->numjoin; k++) {
+		if (lp->ivlist[ip->join[2*k]].inst != rp->ivlist[ip->join[2*k+1]].inst)
 		    break;
 	    }
-	    switch (rtype) {
-		case PM_TYPE_32:
-		    r.ll = b.l;
-		    break;
-		case PM_TYPE_U32:
-		    r.ll = b.ul;
-		    break;
-		case PM_TYPE_64:
-		case PM_TYPE_U64:
-		    /* do nothing */
-		    break;
+	    if (k == ip->numjoin)
+		return ip->numjoin;
+	}
+    }
+
+    /*
+     * (re)build the join ... no more pairs than instances in the
+     * left (or right) operand
+     */
+    if (np->left->desc.indom == PM_INDOM_NULL)
+	k = rp->numval;
+    else
+	k = lp->numval;
+    if ((tmp_join = (int *)realloc(ip->join, 2*k*sizeof(int))) == NULL) {
+	pmNoMem("join_ivlist: join", 2*k*sizeof(int), PM_FATAL_ERR);
+	/*NOTREACHED*/
+    }
+    ip->join = tmp_join;
+    ip->join_lnum = lp->numval;
+    ip->join_rnum = rp->numval;
+
+    if (np->left->desc.indom == PM_INDOM_NULL) {
+	for (j = 0; j < rp->numval; j++) {
+	    ip->join[2*j] = 0;
+	    ip->join[2*j+1] = np->right->desc.indom == PM_INDOM_NULL ? 0 : j;
+	}
+	return ip->numjoin = rp->numval;
+    }
+    if (np->right->desc.indom == PM_INDOM_NULL) {
+	for (i = 0; i < lp->numval; i++) {
+	    ip->join[2*i] = i;
+	    ip->join[2*i+1] = 0;
+	}
+	return ip->numjoin = lp->numval;
+    }
+
+    for (i = j = k = 0; i < lp->numval; i++) {
+	if (j >= rp->numval || lp->ivlist[i].inst != rp->ivlist[j].inst) {
+	    /*
+	     * left ith inst != right jth inst ... search in right
+	     * (this is sort of expected for FILTERINST nodes)
+	     */
+	    if ((pmDebugOptions.derive && pmDebugOptions.appl2) &&
+		np->left->type != N_FILTERINST &&
+		np->right->type != N_FILTERINST && j < rp->numval) {
+		fprintf(stderr, "join_ivlist: %s: inst[%d] mismatch left [%d]=%d right [%d]=%d\n",
+		    __dmnode_type_str(np->type), k,
+		    i, lp->ivlist[i].inst, j, rp->ivlist[j].inst);
 	    }
-	    break;
-	case PM_TYPE_U64:
-	    switch (ltype) {
-		case PM_TYPE_32:
-		    l.ull = a.l;
-		    break;
-		case PM_TYPE_U32:
-		    l.ull = a.ul;
-		    break;
-		case PM_TYPE_64:
-		case PM_TYPE_U64:
-		    /* do nothing */
+	    for (j = 0; j < rp->numval; j++) {
+		if (lp->ivlist[i].inst == rp->ivlist[j].inst)
 		    break;
 	    }
-	    switch (rtype) {
-		case PM_TYPE_32:
-		    r.ull = b.l;
-		    break;
-		case PM_TYPE_U32:
-		    r.ull = b.ul;
-		    break;
-		case PM_TYPE_64:
-		case PM_TYPE_U64:
-		    /* do nothing */
-		    break;
+	    if (j == rp->numval) {
+		/* no match, so next instance on left operand */
+		j = 0;
+		continue;
 	    }
+	}
+	ip->join[2*k] = i;
+	ip->join[2*k+1] = j;
+	k++;
+	j++;
+    }
+    return ip->numjoin = k;
+}
+
+/*
+ * Gather the operand values selected by one side of join[] (every
+ * second entry, starting at join[0] or join[1]) into val[], promoting
+ * each to the computation type ... there are limited cases to be
+ * considered here, see promote[][] and map_desc().
+ *
+ * If type is PM_TYPE_DOUBLE then the operand's mul_scale and div_scale
+ * are applied for units scale conversion, so mul*<value>/div ... both
+ * are 1 in the common cases.
+ */
+#define GATHER(to, from) \
+    for (k = 0; k < n; k++) val[k].to = src[join[2*k]].value.from
+
+static void
+gather_operand(int type, node_t *xp, const int *join, int n, pmAtomValue *val)
+{
+    val_t	*src = xp->data.info->ivlist;
+    int		k;
+
+    switch (type) {
+	case PM_TYPE_64:
+	case PM_TYPE_U64:
+	    if (xp->desc.type == PM_TYPE_32)
+		GATHER(ll, l);
+	    else if (xp->desc.type == PM_TYPE_U32)
+		GATHER(ll, ul);
+	    else
+		GATHER(ll, ll);
 	    break;
 	case PM_TYPE_FLOAT:
-	    switch (ltype) {
-		case PM_TYPE_32:
-		    l.f = a.l;
-		    break;
-		case PM_TYPE_U32:
-		    l.f = a.ul;
-		    break;
-		case PM_TYPE_64:
-		    l.f = a.ll;
-		    break;
-		case PM_TYPE_U64:
-		    l.f = a.ull;
-		    break;
-		case PM_TYPE_FLOAT:
-		    /* do nothing */
-		    break;
-	    }
-	    switch (rtype) {
-		case PM_TYPE_32:
-		    r.f = b.l;
-		    break;
-		case PM_TYPE_U32:
-		    r.f = b.ul;
-		    break;
-		case PM_TYPE_64:
-		    r.f = b.ll;
-		    break;
-		case PM_TYPE_U64:
-		    r.f = b.ull;
-		    break;
-		case PM_TYPE_FLOAT:
-		    /* do nothing */
-		    break;
-	    }
+	    if (xp->desc.type == PM_TYPE_32)
+		GATHER(f, l);
+	    else if (xp->desc.type == PM_TYPE_U32)
+		GATHER(f, ul);
+	    else if (xp->desc.type == PM_TYPE_64)
+		GATHER(f, ll);
+	    else if (xp->desc.type == PM_TYPE_U64)
+		GATHER(f, ull);
+	    else
+		GATHER(f, f);
 	    break;
 	case PM_TYPE_DOUBLE:
-	    switch (ltype) {
-		case PM_TYPE_32:
-		    l.d = a.l;
-		    break;
-		case PM_TYPE_U32:
-		    l.d = a.ul;
-		    break;
-		case PM_TYPE_64:
-		    l.d = a.ll;
-		    break;
-		case PM_TYPE_U64:
-		    l.d = a.ull;
-		    break;
-		case PM_TYPE_FLOAT:
-		    l.d = a.f;
-		    break;
-		case PM_TYPE_DOUBLE:
-		    /* do nothing */
-		    break;
-	    }
-	    l.d = (l.d / ldiv) * lmul;
-	    switch (rtype) {
-		case PM_TYPE_32:
-		    r.d = b.l;
-		    break;
-		case PM_TYPE_U32:
-		    r.d = b.ul;
-		    break;
-		case PM_TYPE_64:
-		    r.d = b.ll;
-		    break;
-		case PM_TYPE_U64:
-		    r.d = b.ull;
-		    break;
-		case PM_TYPE_FLOAT:
-		    r.d = b.f;
-		    break;
-		case PM_TYPE_DOUBLE:
-		    /* do nothing */
-		    break;
+	    if (xp->desc.type == PM_TYPE_32)
+		GATHER(d, l);
+	    else if (xp->desc.type == PM_TYPE_U32)
+		GATHER(d, ul);
+	    else if (xp->desc.type == PM_TYPE_64)
+		GATHER(d, ll);
+	    else if (xp->desc.type == PM_TYPE_U64)
+		GATHER(d, ull);
+	    else if (xp->desc.type == PM_TYPE_FLOAT)
+		GATHER(d, f);
+	    else
+		GATHER(d, d);
+	    if (xp->data.info->mul_scale != 1 || xp->data.info->div_scale != 1) {
+		for (k = 0; k < n; k++)
+		    val[k].d = (val[k].d / xp->data.info->div_scale) * xp->data.info->mul_scale;
 	    }
-	    r.d = (r.d / rdiv) * rmul;
 	    break;
+	default:
+	    /* PM_TYPE_32 and PM_TYPE_U32, do nothing */
+	    for (k = 0; k < n; k++)
+		val[k] = src[join[2*k]].value;
+	    break;
+    }
+}
+
+/*
+ * Binary arithmetic over whole arrays.
+ *
+ * res[k] = l[k] <op> r[k], for operands already promoted to type
+ * (see gather_operand()) ... type and op are resolved once for the
+ * array, not for each value.
+ */
+#define VEC_OP(f, expr) \
+    for (k = 0; k < n; k++) res[k].value.f = (expr)
+
+#define VEC_BIN_OP(f) \
+    switch (op) { \
+	case N_PLUS: VEC_OP(f, l[k].f + r[k].f); break; \
+	case N_MINUS: VEC_OP(f, l[k].f - r[k].f); break; \
+	case N_STAR: VEC_OP(f, l[k].f * r[k].f); break; \
+	case N_LT: VEC_OP(f, l[k].f < r[k].f); break; \
+	case N_LEQ: VEC_OP(f, l[k].f <= r[k].f); break; \
+	case N_EQ: VEC_OP(f, l[k].f == r[k].f); break; \
+	case N_GEQ: VEC_OP(f, l[k].f >= r[k].f); break; \
+	case N_GT: VEC_OP(f, l[k].f > r[k].f); break; \
+	case N_NEQ: VEC_OP(f, l[k].f != r[k].f); break; \
+	case N_AND: VEC_OP(f, (l[k].f != 0) && (r[k].f != 0)); break; \
+	case N_OR: VEC_OP(f, (l[k].f != 0) || (r[k].f != 0)); break; \
+	default:	/* should not happen */ \
+	    fprintf(stderr, "bin_op: botch: " #f " op=%d\n", op); \
+	    VEC_OP(f, 0); \
+	    break; \
     }
 
-    /*
-     * Do the operators ... messy!
-     */
+static void
+bin_op(int type, int op, const pmAtomValue *l, const pmAtomValue *r, int n, val_t *res)
+{
+    int		k;
+
     switch (type) {
 	case PM_TYPE_32:
-	    switch (op) {
-		case N_PLUS:
-		    res.l = l.l + r.l;
-		    break;
-		case N_MINUS:
-		    res.l = l.l - r.l;
-		    break;
-		case N_STAR:
-		    res.l = l.l * r.l;
-		    break;
-		/* semantics enforce no N_SLASH for integer results */
-		case N_LT:
-		    res.l = l.l < r.l;
-		    break;
-		case N_LEQ:
-		    res.l = l.l <= r.l;
-		    break;
-		case N_EQ:
-		    res.l = l.l == r.l;
-		    break;
-		case N_GEQ:
-		    res.l = l.l >= r.l;
-		    break;
-		case N_GT:
-		    res.l = l.l > r.l;
-		    break;
-		case N_NEQ:
-		    res.l = l.l != r.l;
-		    break;
-		case N_AND:
-		    res.l = (l.l != 0) && (r.l != 0);
-		    break;
-		case N_OR:
-		    res.l = (l.l != 0) || (r.l != 0);
-		    break;
-		default:	/* should not happen */
-		    fprintf(stderr, "bin_op: botch: 32 op=%d\n", op);
-		    res.l = 0;
-		    break;
-	    }
+	    /* semantics enforce no N_SLASH for integer results */
+	    VEC_BIN_OP(l);
 	    break;
 	case PM_TYPE_U32:
-	    switch (op) {
-		case N_PLUS:
-		    res.ul = l.ul + r.ul;
-		    break;
-		case N_MINUS:
-		    res.ul = l.ul - r.ul;
-		    break;
-		case N_STAR:
-		    res.ul = l.ul * r.ul;
-		    break;
-		/* semantics enforce no N_SLASH for integer results */
-		case N_LT:
-		    res.ul = l.ul < r.ul;
-		    break;
-		case N_LEQ:
-		    res.ul = l.ul <= r.ul;
-		    break;
-		case N_EQ:
-		    res.ul = l.ul == r.ul;
-		    break;
-		case N_GEQ:
-		    res.ul = l.ul >= r.ul;
-		    break;
-		case N_GT:
-		    res.ul = l.ul > r.ul;
-		    break;
-		case N_NEQ:
-		    res.ul = (l.ul != r.ul);
-		    break;
-		case N_AND:
-		    res.ul = (l.ul != 0) && (r.ul != 0);
-		    break;
-		case N_OR:
-		    res.ul = (l.ul != 0) || (r.ul != 0);
-		    break;
-		default:	/* should not happen */
-		    fprintf(stderr, "bin_op: botch: U32 op=%d\n", op);
-		    res.ul = 0;
-	    }
+	    VEC_BIN_OP(ul);
 	    break;
 	case PM_TYPE_64:
-	    switch (op) {
-		case N_PLUS:
-		    res.ll = l.ll + r.ll;
-		    break;
-		case N_MINUS:
-		    res.ll = l.ll - r.ll;
-		    break;
-		case N_STAR:
-		    res.ll = l.ll * r.ll;
-		    break;
-		/* semantics enforce no N_SLASH for integer results */
-		case N_LT:
-		    res.ll = l.ll < r.ll;
-		    break;
-		case N_LEQ:
-		    res.ll = l.ll <= r.ll;
-		    break;
-		case N_EQ:
-		    res.ll = l.ll == r.ll;
-		    break;
-		case N_GEQ:
-		    res.ll = l.ll >= r.ll;
-		    break;
-		case N_GT:
-		    res.ll = l.ll > r.ll;
-		    break;
-		case N_NEQ:
-		    res.ll = l.ll != r.ll;
-		    break;
-		case N_AND:
-		    res.ll = (l.ll != 0) && (r.ll != 0);
-		    break;
-		case N_OR:
-		    res.ll = (l.ll != 0) || (r.ll != 0);
-		    break;
-		default:	/* should not happen */
-		    fprintf(stderr, "bin_op: botch: 64 op=%d\n", op);
-		    res.ll = 0;
-	    }
+	    VEC_BIN_OP(ll);
 	    break;
 	case PM_TYPE_U64:
-	    switch (op) {
-		case N_PLUS:
-		    res.ull = l.ull + r.ull;
-		    break;
-		case N_MINUS:
-		    res.ull = l.ull - r.ull;
-		    break;
-		case N_STAR:
-		    res.ull = l.ull * r.ull;
-		    break;
-		/* semantics enforce no N_SLASH for integer results */
-		case N_LT:
-		    res.ull = l.ull < r.ull;
-		    break;
-		case N_LEQ:
-		    res.ull = l.ull <= r.ull;
-		    break;
-		case N_EQ:
-		    res.ull = l.ull == r.ull;
-		    break;
-		case N_GEQ:
-		    res.ull = l.ull >= r.ull;
-		    break;
-		case N_GT:
-		    res.ull = l.ull > r.ull;
-		    break;
-		case N_NEQ:
-		    res.ull = l.ull != r.ull;
-		    break;
-		case N_AND:
-		    res.ull = (l.ull != 0) && (r.ull != 0);
-		    break;
-		case N_OR:
-		    res.ull = (l.ull != 0) || (r.ull != 0);
-		    break;
-		default:	/* should not happen */
-		    fprintf(stderr, "bin_op: botch: U64 op=%d\n", op);
-		    res.ull = 0;
-	    }
+	    VEC_BIN_OP(ull);
 	    break;
 	case PM_TYPE_FLOAT:
-	    switch (op) {
-		case N_PLUS:
-		    res.f = l.f + r.f;
-		    break;
-		case N_MINUS:
-		    res.f = l.f - r.f;
-		    break;
-		case N_STAR:
-		    res.f = l.f * r.f;
-		    break;
-		/* semantics enforce no N_SLASH for float results */
-		case N_LT:
-		    res.f = l.f < r.f;
-		    break;
-		case N_LEQ:
-		    res.f = l.f <= r.f;
-		    break;
-		case N_EQ:
-		    res.f = l.f == r.f;
-		    break;
-		case N_GEQ:
-		    res.f = l.f >= r.f;
-		    break;
-		case N_GT:
-		    res.f = l.f > r.f;
-		    break;
-		case N_NEQ:
-		    res.f = l.f != r.f;
-		    break;
-		case N_AND:
-		    res.f = (l.f != 0) && (r.f != 0);
-		    break;
-		case N_OR:
-		    res.f = (l.f != 0) || (r.f != 0);
-		    break;
-		default:	/* should not happen */
-		    fprintf(stderr, "bin_op: botch: FLOAT op=%d\n", op);
-		    res.f = 0;
-	    }
+	    /* semantics enforce no N_SLASH for float results */
+	    VEC_BIN_OP(f);
 	    break;
 	case PM_TYPE_DOUBLE:
-	    switch (op) {
-		case N_PLUS:
-		    res.d = l.d + r.d;
-		    break;
-		case N_MINUS:
-		    res.d = l.d - r.d;
-		    break;
-		case N_STAR:
-		    res.d = l.d * r.d;
-		    break;
-		case N_SLASH:
-		    if (l.d == 0)
-			res.d = 0;
-		    else
-			res.d = l.d / r.d;
-		    break;
-		case N_LT:
-		    res.d = l.d < r.d;
-		    break;
-		case N_LEQ:
-		    res.d = l.d <= r.d;
-		    break;
-		case N_EQ:
-		    res.d = l.d == r.d;
-		    break;
-		case N_GEQ:
-		    res.d = l.d >= r.d;
-		    break;
-		case N_GT:
-		    res.d = l.d > r.d;
-		    break;
-		case N_NEQ:
-		    res.d = l.d != r.d;
-		    break;
-		case N_AND:
-		    res.d = (l.d != 0) && (r.d != 0);
-		    break;
-		case N_OR:
-		    res.d = (l.d != 0) || (r.d != 0);
-		    break;
-		default:	/* should not happen */
-		    fprintf(stderr, "bin_op: botch: DOUBLE op=%d\n", op);
-		    res.d = 0;
+	    if (op == N_SLASH) {
+		VEC_OP(d, l[k].d == 0 ? 0 : l[k].d / r[k].d);
+		break;
 	    }
+	    VEC_BIN_OP(d);
 	    break;
 	default:	/* should not happen, but coverity does not know that */
 	    fprintf(stderr, "bin_op: botch: type=%d is invalid\n", type);
-	    res.ll = 0;	/* not great, but the best we can do */
+	    VEC_OP(ll, 0);	/* not great, but the best we can do */
 	    break;
     }
-
-    return res;
 }
 
 /*
@@ -821,6 +629,7 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
     int		i;
     int		j;
     int		k;
+    int		numjoin;
     size_t	need;
     char	strbuf[20];
 
@@ -1835,137 +1644,75 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
 	    /*
 	     * really got some work to do ...
 	     */
-	    if (np->left->desc.indom == PM_INDOM_NULL)
-		np->data.info->numval = np->right->data.info->numval;
-	    else if (np->right->desc.indom == PM_INDOM_NULL)
-		np->data.info->numval = np->left->data.info->numval;
-	    else {
-		/*
-		 * Generally have the same number of instances because
-		 * both operands are over the same instance domain,
-		 * fetched with the same profile.  When not the case,
-		 * the result can contain no more instances than in
-		 * the smaller of the operands.
-		 */
-		if (np->left->data.info->numval <= np->right->data.info->numval)
-		    np->data.info->numval = np->left->data.info->numval;
-		else
-		    np->data.info->numval = np->right->data.info->numval;
-	    }
-	    if ((np->data.info->ivlist = (val_t *)malloc(np->data.info->numval*sizeof(val_t))) == NULL) {
-		pmNoMem("eval_expr: expr ivlist", np->data.info->numval*sizeof(val_t), PM_FATAL_ERR);
+	    numjoin = join_ivlist(np);
+	    np->data.info->numval = numjoin;
+	    if (numjoin == 0)
+		return np->data.info->numval;
+	    if ((np->data.info->ivlist = (val_t *)malloc(numjoin*sizeof(val_t))) == NULL) {
+		pmNoMem("eval_expr: expr ivlist", numjoin*sizeof(val_t), PM_FATAL_ERR);
 		/*NOTREACHED*/
 	    }
-	    /*
-	     * ivlist[k] = left->ivlist[i] <op> right->ivlist[j]
-	     */
-	    for (i = j = k = 0; k < np->data.info->numval; ) {
-		if (i >= np->left->data.info->numval || j >= np->right->data.info->numval) {
-		    /* run out of operand instances, quit */
-		    np->data.info->numval = k;
-		    break;
-		}
-		if (np->left->desc.indom != PM_INDOM_NULL &&
-		    np->right->desc.indom != PM_INDOM_NULL) {
-		    if (np->left->data.info->ivlist[i].inst != np->right->data.info->ivlist[j].inst) {
-			/*
-			 * left ith inst != right jth inst ... search in right
-			 * (this is sort of expected for FILTERINST nodes)
-			 */
-			if ((pmDebugOptions.derive && pmDebugOptions.appl2) &&
-			    np->left->type != N_FILTERINST &&
-			    np->right->type != N_FILTERINST) {
-			    fprintf(stderr, "eval_expr: %s: inst[%d] mismatch left [%d]=%d right [%d]=%d\n",
-				__dmnode_type_str(np->type), k,
-				i, np->left->data.info->ivlist[i].inst,
-				j, np->right->data.info->ivlist[j].inst);
-			}
-			for (j = 0; j < np->right->data.info->numval; j++) {
-			    if (np->left->data.info->ivlist[i].inst == np->right->data.info->ivlist[j].inst)
-				break;
-			}
-			if (j == np->right->data.info->numval) {
-			    /*
-			     * no match, so next instance on left operand,
-			     * and reset to start from first instance of
-			     * right operand
-			     */
-			    i++;
-			    j = 0;
-			    continue;
-			}
-			else {
-			    if ((pmDebugOptions.derive && pmDebugOptions.appl2) &&
-				np->left->type != N_FILTERINST &&
-				np->right->type != N_FILTERINST) {
-				fprintf(stderr, "eval_expr: recover @ right [%d]=%d\n", j, np->right->data.info->ivlist[j].inst);
-			    }
-			}
-		    }
-		}
-		if (np->type == N_LT || np->type == N_LEQ || np->type == N_EQ ||
-		    np->type == N_GEQ || np->type == N_GT || np->type == N_NEQ ||
-		    np->type == N_AND || np->type == N_OR) {
-		    /*
-		     * relational and boolean operators need to perform
-		     * the comparions with operand type promotion, but
-		     * then cast the result back to a U32 value
-		     */
-		    int	res_type = promote[np->left->desc.type][np->right->desc.type];
-		    pmAtomValue	res;
-		    res = bin_op(res_type, np->type,
-			   np->left->data.info->ivlist[i].value, np->left->desc.type,
-			   np->left->data.info->mul_scale, np->left->data.info->div_scale,
-			   np->right->data.info->ivlist[j].value, np->right->desc.type,
-			   np->right->data.info->mul_scale, np->right->data.info->div_scale);
-		    switch (res_type) {
-			case PM_TYPE_32:
-			    np->data.info->ivlist[k].value.ul = (__uint32_t)res.l;
-			    break;
-			case PM_TYPE_U32:
-			    np->data.info->ivlist[k].value.ul = (__uint32_t)res.ul;
-			    break;
-			case PM_TYPE_64:
-			    np->data.info->ivlist[k].value.ul = (__uint32_t)res.ll;
-			    break;
-			case PM_TYPE_U64:
-			    np->data.info->ivlist[k].value.ul = (__uint32_t)res.ull;
-			    break;
-			case PM_TYPE_FLOAT:
-			    np->data.info->ivlist[k].value.ul = (__uint32_t)res.f;
-			    break;
-			case PM_TYPE_DOUBLE:
-			    np->data.info->ivlist[k].value.ul = (__uint32_t)res.d;
-			    break;
-		    }
-		}
-		else {
-		    /* arithmetic operators, just do it */
-		    np->data.info->ivlist[k].value = bin_op(np->desc.type, np->type,
-			   np->left->data.info->ivlist[i].value, np->left->desc.type,
-			   np->left->data.info->mul_scale, np->left->data.info->div_scale,
-			   np->right->data.info->ivlist[j].value, np->right->desc.type,
-			   np->right->data.info->mul_scale, np->right->data.info->div_scale);
+	    if (2*numjoin > np->data.info->maxopval) {
+		pmAtomValue	*tmp_opval;
+		if ((tmp_opval = (pmAtomValue *)realloc(np->data.info->opval, 2*numjoin*sizeof(pmAtomValue))) == NULL) {
+		    pmNoMem("eval_expr: expr opval", 2*numjoin*sizeof(pmAtomValue), PM_FATAL_ERR);
+		    /*NOTREACHED*/
 		}
+		np->data.info->opval = tmp_opval;
+		np->data.info->maxopval = 2*numjoin;
+	    }
+	    for (k = 0; k < numjoin; k++) {
 		if (np->left->desc.indom != PM_INDOM_NULL)
-		    np->data.info->ivlist[k].inst = np->left->data.info->ivlist[i].inst;
+		    np->data.info->ivlist[k].inst = np->left->data.info->ivlist[np->data.info->join[2*k]].inst;
 		else
-		    np->data.info->ivlist[k].inst = np->right->data.info->ivlist[j].inst;
-		k++;
-		if (np->left->desc.indom != PM_INDOM_NULL) {
-		    i++;
-		    if (np->right->desc.indom != PM_INDOM_NULL) {
-			j++;
-			if (j >= np->right->data.info->numval) {
-			    /* rescan if need be */
-			    j = 0;
-			}
-		    }
-		}
-		else if (np->right->desc.indom != PM_INDOM_NULL) {
-		    j++;
+		    np->data.info->ivlist[k].inst = np->right->data.info->ivlist[np->data.info->join[2*k+1]].inst;
+	    }
+	    /*
+	     * ivlist[k] = left->ivlist[join[2k]] <op> right->ivlist[join[2k+1]]
+	     */
+	    if (np->type == N_LT || np->type == N_LEQ || np->type == N_EQ ||
+		np->type == N_GEQ || np->type == N_GT || np->type == N_NEQ ||
+		np->type == N_AND || np->type == N_OR) {
+		/*
+		 * relational and boolean operators need to perform
+		 * the comparions with operand type promotion, but
+		 * then cast the result back to a U32 value
+		 */
+		int	res_type = promote[np->left->desc.type][np->right->desc.type];
+		val_t	*vp = np->data.info->ivlist;
+
+		gather_operand(res_type, np->left, &np->data.info->join[0], numjoin, &np->data.info->opval[0]);
+		gather_operand(res_type, np->right, &np->data.info->join[1], numjoin, &np->data.info->opval[numjoin]);
+		bin_op(res_type, np->type, &np->data.info->opval[0], &np->data.info->opval[numjoin], numjoin, vp);
+		switch (res_type) {
+		    case PM_TYPE_32:
+			for (k = 0; k < numjoin; k++)
+			    vp[k].value.ul = (__uint32_t)vp[k].value.l;
+			break;
+		    case PM_TYPE_64:
+			for (k = 0; k < numjoin; k++)
+			    vp[k].value.ul = (__uint32_t)vp[k].value.ll;
+			break;
+		    case PM_TYPE_U64:
+			for (k = 0; k < numjoin; k++)
+			    vp[k].value.ul = (__uint32_t)vp[k].value.ull;
+			break;
+		    case PM_TYPE_FLOAT:
+			for (k = 0; k < numjoin; k++)
+			    vp[k].value.ul = (__uint32_t)vp[k].value.f;
+			break;
+		    case PM_TYPE_DOUBLE:
+			for (k = 0; k < numjoin; k++)
+			    vp[k].value.ul = (__uint32_t)vp[k].value.d;
+			break;
 		}
 	    }
+	    else {
+		/* arithmetic operators, just do it */
+		gather_operand(np->desc.type, np->left, &np->data.info->join[0], numjoin, &np->data.info->opval[0]);
+		gather_operand(np->desc.type, np->right, &np->data.info->join[1], numjoin, &np->data.info->opval[numjoin]);
+		bin_op(np->desc.type, np->type, &np->data.info->opval[0], &np->data.info->opval[numjoin], numjoin, np->data.info->ivlist);
+	    }
 	    return np->data.info->numval;
 
     }
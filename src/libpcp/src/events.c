@@ -714,3 +714,130 @@ pmFreeHighResEventResult(pmHighResResult **rset)
 	__pmFreeHighResResult(rset[r]);
     free(rset);
 }
+
+/*
+ * Iterator over the packed event records of the idx'th instance of
+ * an event record metric value.  Unlike pmUnpackEventRecords() and
+ * pmUnpackHighResEventRecords() nothing is allocated - records and
+ * parameters are visited in place, and callers copy only the values
+ * they want to keep.
+ *
+ * Returns the number of records, else a negative error code if the
+ * packed array fails the integrity checks.
+ */
+int
+pmEventIterInit(pmEventIter *iter, pmValueSet *vsp, int idx)
+{
+    pmValueBlock	*vbp;
+    int			highres;
+    int			sts;
+
+    memset(iter, 0, sizeof(*iter));
+    iter->record = -1;
+
+    if (vsp->numval < 1)
+	return vsp->numval;
+    if (vsp->valfmt != PM_VAL_DPTR && vsp->valfmt != PM_VAL_SPTR)
+	return PM_ERR_CONV;
+    vbp = vsp->vlist[idx].value.pval;
+    highres = (vbp->vtype == PM_TYPE_HIGHRES_EVENT);
+
+    if ((sts = check_event_records(vsp, idx, highres)) < 0) {
+	dump_event_records(stderr, vsp, idx, highres);
+	return sts;
+    }
+
+    iter->highres = highres;
+    if (highres) {
+	pmHighResEventArray	*hreap = (pmHighResEventArray *)vbp;
+
+	iter->nrecords = hreap->ea_nrecords;
+	iter->base = (const char *)&hreap->ea_record[0];
+    }
+    else {
+	pmEventArray		*eap = (pmEventArray *)vbp;
+
+	iter->nrecords = eap->ea_nrecords;
+	iter->base = (const char *)&eap->ea_record[0];
+    }
+    return iter->nrecords;
+}
+
+/*
+ * Step past the parameters of the current record not yet visited by
+ * pmEventIterNextParam(), then position the iterator at the start of
+ * the next record.  Returns 1 for a new record, 0 when none remain.
+ */
+int
+pmEventIterNextRecord(pmEventIter *iter)
+{
+    const pmEventParameter	*epp;
+    size_t			size;
+
+    if (iter->record >= iter->nrecords)
+	return 0;
+    while (iter->param < iter->nparams) {
+	epp = (const pmEventParameter *)iter->base;
+	iter->base += sizeof(epp->ep_pmid) + PM_PDU_SIZE_BYTES(epp->ep_len);
+	iter->param++;
+    }
+    if (++iter->record >= iter->nrecords)
+	return 0;
+
+    if (iter->highres) {
+	const pmHighResEventRecord	*hrerp;
+
+	hrerp = (const pmHighResEventRecord *)iter->base;
+	size = sizeof(hrerp->er_timestamp) + sizeof(hrerp->er_flags) +
+	       sizeof(hrerp->er_nparams);
+	iter->timestamp.tv_sec = hrerp->er_timestamp.tv_sec;
+	iter->timestamp.tv_nsec = hrerp->er_timestamp.tv_nsec;
+	iter->flags = hrerp->er_flags;
+	iter->nparams = hrerp->er_nparams;
+    }
+    else {
+	const pmEventRecord	*erp;
+
+	erp = (const pmEventRecord *)iter->base;
+	size = sizeof(erp->er_timestamp) + sizeof(erp->er_flags) +
+	       sizeof(erp->er_nparams);
+	iter->timestamp.tv_sec = erp->er_timestamp.tv_sec;
+	iter->timestamp.tv_nsec = erp->er_timestamp.tv_usec * 1000;
+	iter->flags = erp->er_flags;
+	iter->nparams = erp->er_nparams;
+    }
+    iter->base += size;
+    iter->param = 0;
+    iter->missed = 0;
+
+    if (iter->flags & PM_EVENT_FLAG_MISSED) {
+	/* no parameters here, just a count of missed records */
+	iter->missed = iter->nparams;
+	iter->nparams = 0;
+    }
+    return 1;
+}
+
+/*
+ * Describe the next parameter of the current record, with the value
+ * left in place.  Returns 1 for a parameter, 0 when none remain.
+ */
+int
+pmEventIterNextParam(pmEventIter *iter, pmEventParam *param)
+{
+    const pmEventParameter	*epp;
+
+    if (iter->record < 0 || iter->record >= iter->nrecords ||
+	iter->param >= iter->nparams)
+	return 0;
+
+    epp = (const pmEventParameter *)iter->base;
+    param->pmid = epp->ep_pmid;
+    param->type = epp->ep_type;
+    param->vlen = epp->ep_len - PM_VAL_HDR_SIZE;
+    param->vbuf = (const char *)epp + sizeof(epp->ep_pmid) + sizeof(int);
+
+    iter->base += sizeof(epp->ep_pmid) + PM_PDU_SIZE_BYTES(epp->ep_len);
+    iter->param++;
+    return 1;
+}
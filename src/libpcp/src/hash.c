@@ -252,3 +252,279 @@ __pmHashFree(__pmHashCtl *hcp)
 
     __pmHashClear(hcp);
 }
+
+/*
+ * Open-addressed hash tables (Robin Hood hashing with linear probing).
+ *
+ * Keys and data pointers are stored inline in a single power-of-two
+ * sized array, so there is no per-entry allocation and a search touches
+ * one or two cache lines.  Unlike __pmHashAdd, keys are unique.
+ *
+ * Each occupied slot records its probe distance plus one in dist (0 is
+ * an empty slot).  On insert, an entry that has probed further than the
+ * resident entry takes the slot and the resident entry moves on, which
+ * keeps probe sequences short and lets a search stop early.  On delete,
+ * the following entries are shifted back one slot, so no tombstones.
+ *
+ * Small keys (below 2^16) hash to themselves, so a table of densely
+ * numbered instances is walked in ascending key order.
+ */
+
+#define OAHASH_MINSIZE	8
+
+static inline unsigned int
+oahash(unsigned int key, unsigned int mask)
+{
+    return (key ^ (key >> 16)) & mask;
+}
+
+/*
+ * Insert key (known not to be present) without any resizing.
+ */
+static void
+oahash_insert(unsigned int key, void *data, __pmOAHashCtl *hcp)
+{
+    __pmOAHashNode	node, tmp;
+    unsigned int	mask = hcp->hsize - 1;
+    unsigned int	k = oahash(key, mask);
+
+    node.key = key;
+    node.dist = 1;
+    node.data = data;
+    for (;;) {
+	if (hcp->hash[k].dist == 0) {
+	    hcp->hash[k] = node;
+	    break;
+	}
+	if (hcp->hash[k].dist < node.dist) {
+	    /* rob from the rich ... */
+	    tmp = hcp->hash[k];
+	    hcp->hash[k] = node;
+	    node = tmp;
+	}
+	node.dist++;
+	k = (k + 1) & mask;
+    }
+    hcp->nodes++;
+}
+
+static int
+oahash_resize(unsigned int hsize, __pmOAHashCtl *hcp)
+{
+    __pmOAHashNode	*old = hcp->hash;
+    unsigned int	oldsize = hcp->hsize;
+    unsigned int	i;
+
+    if ((hcp->hash = (__pmOAHashNode *)calloc(hsize, sizeof(__pmOAHashNode))) == NULL) {
+	hcp->hash = old;
+	return -oserror();
+    }
+    hcp->hsize = hsize;
+    hcp->nodes = 0;
+    for (i = 0; i < oldsize; i++) {
+	if (old[i].dist != 0)
+	    oahash_insert(old[i].key, old[i].data, hcp);
+    }
+    free(old);
+    return 0;
+}
+
+void
+__pmOAHashInit(__pmOAHashCtl *hcp)
+{
+    memset(hcp, 0, sizeof(*hcp));
+}
+
+/*
+ * Size the table to hold at least nodes entries without further
+ * resizing, e.g. from instance or metric counts in archive metadata.
+ * Unlike __pmHashPreAlloc this may be called at any time, it only
+ * ever grows the table.
+ */
+int
+__pmOAHashPreAlloc(int nodes, __pmOAHashCtl *hcp)
+{
+    unsigned int	hsize = OAHASH_MINSIZE;
+
+    if (nodes < 0)
+	return -EINVAL;
+    /* maximum load factor is 7/8 */
+    while (hsize - hsize / 8 < (unsigned int)nodes) {
+	if (hsize >= 0x80000000U)
+	    return -ENOMEM;
+	hsize *= 2;
+    }
+    if (hsize <= hcp->hsize)
+	return 0;
+    return oahash_resize(hsize, hcp);
+}
+
+__pmOAHashNode *
+__pmOAHashSearch(unsigned int key, const __pmOAHashCtl *hcp)
+{
+    __pmOAHashNode	*hp;
+    unsigned int	mask, k, dist;
+
+    if (hcp->nodes == 0)
+	return NULL;
+
+    mask = hcp->hsize - 1;
+    k = oahash(key, mask);
+    for (dist = 1; ; dist++) {
+	hp = &hcp->hash[k];
+	if (hp->dist < dist)
+	    return NULL;	/* empty, or key would have displaced this */
+	if (hp->key == key)
+	    return hp;
+	k = (k + 1) & mask;
+    }
+}
+
+/*
+ * Returns 1 if key was added, 0 if key was already present (and the
+ * table is unchanged), else a negative error code.
+ */
+int
+__pmOAHashAdd(unsigned int key, void *data, __pmOAHashCtl *hcp)
+{
+    unsigned int	hsize;
+    int			sts;
+
+    if (__pmOAHashSearch(key, hcp) != NULL)
+	return 0;
+    if (hcp->hsize == 0 || hcp->nodes + 1 > hcp->hsize - hcp->hsize / 8) {
+	if (hcp->hsize >= 0x80000000U)
+	    return -ENOMEM;
+	hsize = hcp->hsize ? hcp->hsize * 2 : OAHASH_MINSIZE;
+	if ((sts = oahash_resize(hsize, hcp)) < 0)
+	    return sts;
+    }
+    oahash_insert(key, data, hcp);
+    return 1;
+}
+
+/*
+ * Remove the entry at slot k by shifting subsequent displaced entries
+ * back one slot.
+ */
+static void
+oahash_remove(unsigned int k, __pmOAHashCtl *hcp)
+{
+    unsigned int	mask = hcp->hsize - 1;
+    unsigned int	next = (k + 1) & mask;
+
+    while (hcp->hash[next].dist > 1) {
+	hcp->hash[k] = hcp->hash[next];
+	hcp->hash[k].dist--;
+	k = next;
+	next = (next + 1) & mask;
+    }
+    memset(&hcp->hash[k], 0, sizeof(__pmOAHashNode));
+    hcp->nodes--;
+}
+
+int
+__pmOAHashDel(unsigned int key, __pmOAHashCtl *hcp)
+{
+    __pmOAHashNode	*hp;
+
+    if ((hp = __pmOAHashSearch(key, hcp)) == NULL)
+	return 0;
+    oahash_remove((unsigned int)(hp - hcp->hash), hcp);
+    return 1;
+}
+
+/*
+ * Walks start at the first slot that is empty or holds an entry in
+ * its home slot.  Deleting the current entry only ever shifts entries
+ * not yet visited back into the current slot, so deletion during a
+ * walk visits every entry exactly once.
+ */
+static unsigned int
+oahash_walkstart(const __pmOAHashCtl *hcp)
+{
+    unsigned int	k;
+
+    for (k = 0; k < hcp->hsize; k++) {
+	if (hcp->hash[k].dist <= 1)
+	    break;
+    }
+    return k;
+}
+
+/*
+ * As for __pmHashWalkCB, PM_HASH_WALK_DELETE_* remove the current entry
+ * (the callback remains responsible for any data it points to).
+ */
+void
+__pmOAHashWalkCB(__pmOAHashWalkCallback cb, void *cdata, __pmOAHashCtl *hcp)
+{
+    unsigned int	start, n, k, mask;
+
+    if (hcp->nodes == 0)
+	return;
+
+    mask = hcp->hsize - 1;
+    start = oahash_walkstart(hcp);
+    for (n = 0; n < hcp->hsize; ) {
+	k = (start + n) & mask;
+	if (hcp->hash[k].dist == 0) {
+	    n++;
+	    continue;
+	}
+	switch ((*cb)(&hcp->hash[k], cdata)) {
+	case PM_HASH_WALK_DELETE_STOP:
+	    oahash_remove(k, hcp);
+	    return;
+
+	case PM_HASH_WALK_NEXT:
+	    n++;
+	    break;
+
+	case PM_HASH_WALK_DELETE_NEXT:
+	    /* NB: do not advance, a later entry may now be in slot k */
+	    oahash_remove(k, hcp);
+	    break;
+
+	case PM_HASH_WALK_STOP:
+	default:
+	    return;
+	}
+    }
+}
+
+/*
+ * Walk a hash table; state flow is START ... NEXT ... NEXT ...
+ * The table must not be modified during the walk.
+ */
+__pmOAHashNode *
+__pmOAHashWalk(__pmOAHashCtl *hcp, __pmHashWalkState state)
+{
+    __pmOAHashNode	*hp;
+
+    if (hcp->nodes == 0)
+	return NULL;
+
+    if (state == PM_HASH_WALK_START) {
+	hcp->start = oahash_walkstart(hcp);
+	hcp->index = 0;
+    }
+    while (hcp->index < hcp->hsize) {
+	hp = &hcp->hash[(hcp->start + hcp->index++) & (hcp->hsize - 1)];
+	if (hp->dist != 0)
+	    return hp;
+    }
+    return NULL;
+}
+
+/*
+ * Free the table and reset to empty ... as for __pmHashFree, the
+ * caller must already have freed anything hanging off hp->data.
+ */
+void
+__pmOAHashFree(__pmOAHashCtl *hcp)
+{
+    if (hcp->hash != NULL)
+	free(hcp->hash);
+    memset(hcp, 0, sizeof(*hcp));
+}
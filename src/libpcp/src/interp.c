@@ -105,7 +105,7 @@ typedef struct pmidcntl {		/* metric control */
     int			valfmt;		/* used to build result */
     int			numval;		/* number of instances in this result */
     int			last_numval;	/* number of instances in previous result */
-    __pmHashCtl		hc;		/* metric-instances */
+    __pmOAHashCtl	hc;		/* metric-instances */
 } pmidcntl_t;
 
 typedef struct {
@@ -400,7 +400,7 @@ update_bounds(__pmContext *ctxp, double t_req, __pmResult *logrp, int do_mark, i
     int			i;
     __pmHashCtl		*hcp = &ctxp->c_archctl->ac_pmid_hc;
     __pmHashNode	*hp;
-    __pmHashNode	*ihp;
+    __pmOAHashNode	*ihp;
     pmidcntl_t		*pcp;
     instcntl_t		*icp;
     double		t_this;
@@ -708,9 +708,9 @@ check:
 	for (i = 0; i < logrp->vset[k]->numval; i++) {
 	    pmInDom vlistIndom = logrp->vset[k]->vlist[i].inst;
 
-	    ihp = __pmHashSearch((int)vlistIndom, &pcp->hc);
+	    ihp = __pmOAHashSearch((int)vlistIndom, &pcp->hc);
 	    if (ihp == NULL) {
-		ihp = __pmHashSearch(PM_IN_NULL, &pcp->hc);
+		ihp = __pmOAHashSearch(PM_IN_NULL, &pcp->hc);
 		if (ihp == NULL)
 		    continue;
 	    }
@@ -889,7 +889,7 @@ time_caliper(__pmContext *ctxp, instcntl_t *icp)
     double		t_indom_prior;
     __pmLogCtl		*lcp;
     __pmHashNode	*hp;
-    __pmHashNode	*ip;
+    __pmOAHashNode	*ip;
     __pmHashNode	*jp;
     __pmLogTrimInDom	*indomp;
     __pmLogTrimInst	*instp;
@@ -924,7 +924,7 @@ time_caliper(__pmContext *ctxp, instcntl_t *icp)
 	    pmNoMem("time_caliper.__pmLogTrimInDom", sizeof(__pmLogTrimInDom), PM_FATAL_ERR);
 	    /*NOTREACHED*/
 	}
-	indomp->hashinst.nodes = indomp->hashinst.hsize = 0;
+	__pmOAHashInit(&indomp->hashinst);
 	sts = __pmHashAdd((unsigned int)icp->metric->desc.indom, (void *)indomp, &lcp->trimindom);
 	if (sts < 0) {
 	    char	strbuf[20];
@@ -956,6 +956,12 @@ time_caliper(__pmContext *ctxp, instcntl_t *icp)
 	}
 	if (maxinst < HASH_THRESHOLD)
 	    return;
+	/* size for the largest snapshot to avoid most rehashing */
+	if ((sts = __pmOAHashPreAlloc(maxinst, &indomp->hashinst)) < 0) {
+	    char	strbuf[20];
+	    fprintf(stderr, "time_caliper: Botch: indom %s hashinst __pmOAHashPreAlloc(%d) failed: %d\n", pmInDomStr_r(icp->metric->desc.indom, strbuf, sizeof(strbuf)), maxinst, sts);
+	    return;
+	}
 
 	if (pmDebugOptions.qa) {
 	    char	strbuf[20];
@@ -966,7 +972,7 @@ time_caliper(__pmContext *ctxp, instcntl_t *icp)
 	for (idp = (__pmLogInDom *)jp->data; idp != NULL; idp = idp->next) {
 	    t_indom = __pmTimestampSub(&idp->stamp, __pmLogStartTime(ctxp->c_archctl));
 	    for (j = 0; j < idp->numinst; j++) {
-		if ((ip = __pmHashSearch((unsigned int)idp->instlist[j], &indomp->hashinst)) == NULL) {
+		if ((ip = __pmOAHashSearch((unsigned int)idp->instlist[j], &indomp->hashinst)) == NULL) {
 		    /*
 		     * this instance has not been seen before (remember we
 		     * are going backwards in time)
@@ -977,18 +983,13 @@ time_caliper(__pmContext *ctxp, instcntl_t *icp)
 		    }
 		    instp->t_birth = t_indom;
 		    instp->t_death = t_indom_prior;
-		    sts = __pmHashAdd((unsigned int)idp->instlist[j], (void *)instp, &indomp->hashinst);
+		    sts = __pmOAHashAdd((unsigned int)idp->instlist[j], (void *)instp, &indomp->hashinst);
 		    if (sts < 0) {
 			char	strbuf[20];
-			fprintf(stderr, "time_caliper: Botch: indom %s inst %d hashinst __pmHashAdd failed: %d\n", pmInDomStr_r(icp->metric->desc.indom, strbuf, sizeof(strbuf)), idp->instlist[j], sts);
+			fprintf(stderr, "time_caliper: Botch: indom %s inst %d hashinst __pmOAHashAdd failed: %d\n", pmInDomStr_r(icp->metric->desc.indom, strbuf, sizeof(strbuf)), idp->instlist[j], sts);
 			free(instp);
 			return;
 		    }
-		    if (__pmHashSearch((unsigned int)idp->instlist[j], &indomp->hashinst) == NULL) {
-			char	strbuf[20];
-			fprintf(stderr, "time_caliper: Botch: indom %s inst %d hashinst __pmHashSearch failed\n", pmInDomStr_r(icp->metric->desc.indom, strbuf, sizeof(strbuf)), idp->instlist[j]);
-			return;
-		    }
 		}
 		else {
 		    instp = (__pmLogTrimInst *)ip->data;
@@ -1002,7 +1003,7 @@ time_caliper(__pmContext *ctxp, instcntl_t *icp)
     if (hp != NULL) {
 	/* found indom, now for instance ... */
 	indomp = (__pmLogTrimInDom *)hp->data;
-	if ((ip = __pmHashSearch((unsigned int)icp->inst, &indomp->hashinst)) != NULL) {
+	if ((ip = __pmOAHashSearch((unsigned int)icp->inst, &indomp->hashinst)) != NULL) {
 	    instp = (__pmLogTrimInst *)ip->data;
 	    icp->t_birth = instp->t_birth;
 	    icp->t_death = instp->t_death;
@@ -1016,6 +1017,52 @@ time_caliper(__pmContext *ctxp, instcntl_t *icp)
     return;
 }
 
+/*
+ * Use the presence section of a dense temporal index (see pmlogindex(1))
+ * to decide if there are no records at all for icp's metric at or before
+ * (PM_MODE_BACK) or at or after (PM_MODE_FORW) the current origin, in
+ * which case searching would read to the end of the archive and find
+ * nothing.
+ *
+ * Only for a single archive with no <mark> records (a <mark> stops the
+ * search and is noted in seen_mark), and only if the index reaches the
+ * end of the archive.  *usable caches this, -1 means not yet known.
+ */
+static int
+tidx_absent(__pmContext *ctxp, instcntl_t *icp, int mode, int *usable)
+{
+    __pmArchCtl		*acp = ctxp->c_archctl;
+    __pmLogCtl		*lcp = acp->ac_log;
+    __pmLogTIdxEntry	last;
+    int			from;
+    int			n;
+    int			vol;
+    long		posn;
+
+    if (*usable < 0) {
+	*usable = 0;
+	if (acp->ac_num_logs == 1 &&
+	    __pmLogTIdxFindPMID(lcp, PM_ID_NULL, 0, PM_MODE_FORW) == PM_ERR_EOL &&
+	    (n = __pmLogTIdxCount(lcp)) > 0 &&
+	    __pmLogTIdxGet(lcp, n - 1, &last) == 0 &&
+	    last.vol == lcp->maxvol) {
+	    /* check the last entry is the end of the archive */
+	    vol = acp->ac_curvol;
+	    posn = __pmFtell(acp->ac_mfp);
+	    if (__pmLogChangeVol(acp, last.vol) >= 0 &&
+		__pmLogCheckTIdx(acp, &last, 1) == 0)
+		*usable = 1;
+	    if (__pmLogChangeVol(acp, vol) >= 0)
+		__pmFseek(acp->ac_mfp, posn, SEEK_SET);
+	}
+    }
+    if (*usable == 0)
+	return 0;
+
+    from = __pmLogTIdxSearch(lcp, &ctxp->c_origin, mode);
+    return __pmLogTIdxFindPMID(lcp, icp->metric->desc.pmid, from, mode) == PM_ERR_EOL;
+}
+
 /*
  * classes of "unbound" list instcntl_t scanning effort ...
  * counted in nuis[] below
@@ -1036,7 +1083,8 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
     double		t_req, t_this;
     __pmResult		*rp, *logrp;
     __pmHashCtl		*hcp = &ctxp->c_archctl->ac_pmid_hc;
-    __pmHashNode	*hp, *ihp;
+    __pmHashNode	*hp;
+    __pmOAHashNode	*ihp;
     pmidcntl_t		*pcp = NULL;	/* initialize to pander to gcc */
     instcntl_t		*icp = NULL;	/* initialize to pander to gcc */
     instcntl_t		*ub, *ub_prev;
@@ -1045,6 +1093,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
     int			done;
     int			done_roll;
     int			seen_mark;
+    int			tidx = -1;
     static int		dowrap = -1;
     __pmTimestamp	tmp;
     long		nuis[] = { 0, 0, 0, 0, 0, 0, 0, 0 };
@@ -1119,7 +1168,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	    }
 	    pcp->valfmt = -1;
 	    pcp->last_numval = -1;
-	    __pmHashInit(&pcp->hc);
+	    __pmOAHashInit(&pcp->hc);
 	    sts = __pmHashAdd((int)pmidlist[j], (void *)pcp, hcp);
 	    if (sts < 0) {
 		free(pcp);
@@ -1146,7 +1195,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 		    sts = pmGetInDomArchive_ctx(ctxp, pcp->desc.indom, &instlist, &namelist);
 		    if (sts > 0) {
 			/* Pre allocate enough space for the instance domain. */
-			hsts = __pmHashPreAlloc(sts, &pcp->hc);
+			hsts = __pmOAHashPreAlloc(sts, &pcp->hc);
 			if (hsts < 0) {
 			    free(pcp);
 			    goto done_icp;
@@ -1165,10 +1214,12 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 		    SET_UNDEFINED(icp->s_next);
 		    icp->v_prior.pval = icp->v_next.pval = NULL;
 		    time_caliper(ctxp, icp);
-		    hsts = __pmHashAdd((int)instlist[i], (void *)icp, &pcp->hc);
-		    if (hsts < 0) {
+		    hsts = __pmOAHashAdd((int)instlist[i], (void *)icp, &pcp->hc);
+		    if (hsts <= 0) {
+			/* error, or duplicate instance in the indom */
 			free(icp);
-			goto done_icp;
+			if (hsts < 0)
+			    goto done_icp;
 		    }
 		}
 	    done_icp:
@@ -1191,7 +1242,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	else if (pcp->desc.indom != PM_INDOM_NULL) {
 	    /* use the profile to filter the instances to be returned */
 	    for (i = 0; i < pcp->hc.hsize; i++) {
-		for (ihp = pcp->hc.hash[i]; ihp != NULL; ihp = ihp->next) {
+		if ((ihp = &pcp->hc.hash[i])->dist != 0) {
 		    icp = (instcntl_t *)ihp->data;
 		    icp->search = 0;
 		    if (__pmInProfile(pcp->desc.indom, ctxp->c_instprof, icp->inst)) {
@@ -1207,7 +1258,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	}
 	else {
 	    /* There will be only one instance */
-	    ihp = __pmHashWalk(&pcp->hc, PM_HASH_WALK_START);
+	    ihp = __pmOAHashWalk(&pcp->hc, PM_HASH_WALK_START);
 	    assert(ihp);
 	    icp = (instcntl_t *)ihp->data;
 	    icp->inresult = 1;
@@ -1215,7 +1266,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	    icp->want = (instcntl_t *)ctxp->c_archctl->ac_want;
 	    ctxp->c_archctl->ac_want = icp;
 	    pcp->numval = 1;
-	    ihp = __pmHashWalk(&pcp->hc, PM_HASH_WALK_NEXT);
+	    ihp = __pmOAHashWalk(&pcp->hc, PM_HASH_WALK_NEXT);
 	    assert(!ihp);
 	}
     }
@@ -1339,6 +1390,17 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	if ((IS_UNDEFINED(icp->s_prior) && !IS_SCANNED(icp->s_prior)) ||
 	    (icp->t_prior > t_req && (ctxp->c_direction < 0 || !IS_SCANNED(icp->s_prior))) ||
 	    (IS_MARK(icp->s_next) && icp->t_prior == t_req)) {
+	    if (!IS_MARK(icp->s_next) &&
+		tidx_absent(ctxp, icp, PM_MODE_BACK, &tidx)) {
+		/* no earlier records for this metric, trim as for a search */
+		if (icp->t_first < t_req) {
+		    icp->t_first = t_req;
+		    SET_SCANNED(icp->s_prior);
+		    if (pmDebugOptions.interp)
+			dumpicp("dense index, no values before t_first", icp);
+		}
+		continue;
+	    }
 	    back++;
 	    icp->search = 1;
 	    /* Add it to the unbound list in descending order of t_first */
@@ -1484,6 +1546,17 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	if ((IS_UNDEFINED(icp->s_next) && !IS_SCANNED(icp->s_next)) ||
 	    (icp->t_next < t_req && (ctxp->c_direction > 0 || !IS_SCANNED(icp->s_next))) ||
 	    (IS_MARK(icp->s_prior) && icp->t_next == t_req)) {
+	    if (!IS_MARK(icp->s_prior) &&
+		tidx_absent(ctxp, icp, PM_MODE_FORW, &tidx)) {
+		/* no later records for this metric, trim as for a search */
+		if (icp->t_last < 0 || t_req < icp->t_last) {
+		    icp->t_last = t_req;
+		    SET_SCANNED(icp->s_next);
+		    if (pmDebugOptions.interp)
+			dumpicp("dense index, no values after t_last", icp);
+		}
+		continue;
+	    }
 	    forw++;
 	    icp->search = 1;
 
@@ -1690,7 +1763,7 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_CALL);
 	i = 0;
 	if (pcp->numval > 0) {
 	    for (k = 0; k < pcp->hc.hsize; k++) {
-		for (ihp = pcp->hc.hash[k]; ihp != NULL; ihp = ihp->next) {
+		if ((ihp = &pcp->hc.hash[k])->dist != 0) {
 		    icp = (instcntl_t *)ihp->data;
 		    if (!icp->inresult)
 			continue;
@@ -2192,7 +2265,7 @@ __pmLogResetInterp(__pmContext *ctxp)
     __pmHashCtl	*hcp = &ctxp->c_archctl->ac_pmid_hc;
     double	t_req;
     __pmHashNode	*hp;
-    __pmHashNode	*ihp;
+    __pmOAHashNode	*ihp;
     int		i, k;
     pmidcntl_t	*pcp;
     instcntl_t	*icp;
@@ -2205,7 +2278,7 @@ __pmLogResetInterp(__pmContext *ctxp)
 	for (hp = hcp->hash[k]; hp != NULL; hp = hp->next) {
 	    pcp = (pmidcntl_t *)hp->data;
 	    for (i = 0; i < pcp->hc.hsize; i++) {
-		for (ihp = pcp->hc.hash[i]; ihp != NULL; ihp = ihp->next) {
+		if ((ihp = &pcp->hc.hash[i])->dist != 0) {
 		    icp = (instcntl_t *)ihp->data;
 		    if (icp->t_prior > t_req || icp->t_next < t_req) {
 			icp->t_prior = icp->t_next = -1;
@@ -2240,7 +2313,7 @@ __pmFreeInterpData(__pmContext *ctxp)
 	/* we have done some interpolation ... */
 	__pmHashCtl	*hcp = &ctxp->c_archctl->ac_pmid_hc;
 	__pmHashNode	*hp;
-	__pmHashNode	*ihp;
+	__pmOAHashNode	*ihp;
 	pmidcntl_t	*pcp;
 	instcntl_t	*icp;
 	int		i, j;
@@ -2250,14 +2323,11 @@ __pmFreeInterpData(__pmContext *ctxp)
 	    /*
 	     * Don't free __pmHashNode until hp->next has been traversed,
 	     * hence free lags one node in the chain (last_hp used for free).
-	     * Same for linked list of instcntl_t structs (use last_ihp
-	     * for free in this case).
 	     */
 	    for (hp = hcp->hash[j]; hp != NULL; hp = hp->next) {
 		pcp = (pmidcntl_t *)hp->data;
 		for (i = 0; i < pcp->hc.hsize; i++) {
-		    __pmHashNode	*last_ihp = NULL;
-		    for (ihp = pcp->hc.hash[i]; ihp != NULL; ihp = ihp->next) {
+		    if ((ihp = &pcp->hc.hash[i])->dist != 0) {
 			icp = (instcntl_t *)ihp->data;
 			if (pcp->valfmt != PM_VAL_INSITU) {
 			    /*
@@ -2282,25 +2352,10 @@ __pmFreeInterpData(__pmContext *ctxp)
 				__pmUnpinPDUBuf((void *)icp->v_next.pval);
 			    }
 			}
-			if (last_ihp != NULL) {
-			    if (last_ihp->data != NULL)
-				free(last_ihp->data);
-			    free(last_ihp);
-			}
-			last_ihp = ihp;
-		    }
-		    if (last_ihp != NULL) {
-			if (last_ihp->data != NULL)
-			    free(last_ihp->data);
-			free(last_ihp);
+			free(icp);
 		    }
 		}
-		if (pcp->hc.hash) {
-		    free(pcp->hc.hash);
-		    /* just being paranoid here */
-		    pcp->hc.hash = NULL;
-		}
-		pcp->hc.hsize = 0;
+		__pmOAHashFree(&pcp->hc);
 		if (last_hp != NULL) {
 		    if (last_hp->data != NULL)
 			free(last_hp->data);
@@ -28,6 +28,9 @@ extern __pm_fops __pm_stdio;
 #if HAVE_TRANSPARENT_DECOMPRESSION && HAVE_LZMA_DECOMPRESSION
 extern __pm_fops __pm_xz;
 #endif
+#if HAVE_TRANSPARENT_DECOMPRESSION && HAVE_ZSTD_DECOMPRESSION
+extern __pm_fops __pm_zstd;
+#endif
 
 /*
  * Suffixes and associated compresssion application for compressed filenames.
@@ -46,6 +49,11 @@ extern __pm_fops __pm_xz;
 #else
 #define TRANSPARENT_XZ NULL
 #endif
+#if HAVE_TRANSPARENT_DECOMPRESSION && HAVE_ZSTD_DECOMPRESSION
+#define TRANSPARENT_ZSTD (&__pm_zstd)
+#else
+#define TRANSPARENT_ZSTD NULL
+#endif
 
 static const struct {
     const char	*suffix;
@@ -59,7 +67,7 @@ static const struct {
     { ".gz",	USE_GZIP,	NULL },
     { ".Z",	USE_GZIP,	NULL },
     { ".z",	USE_GZIP,	NULL },
-    { ".zst",	USE_ZSTD,	NULL },
+    { ".zst",	USE_ZSTD,	TRANSPARENT_ZSTD },
 };
 static const int ncompress = sizeof(compress_ctl) / sizeof(compress_ctl[0]);
 
@@ -109,6 +117,11 @@ __pmLogBaseNameVol(char *name, int *vol)
 	    strip = 1;
 	    goto done;
 	}
+	if (strcmp(q, ".tidx") == 0) {
+	    /* optional dense temporal index, see logtidx.c */
+	    strip = 1;
+	    goto done;
+	}
 	/*
 	 * Check for a string of digits as the suffix.
 	 */
@@ -528,6 +541,17 @@ __pmFopen(const char *path, const char *mode)
      */
     if (f->fops->__pmopen(f, path, mode) == NULL) {
 	free(f);
+	if (compress_ix >= 0 && oserror() == EOPNOTSUPP) {
+	    /*
+	     * The on-the-fly handler cannot provide random access to this
+	     * file, e.g. a .zst file written as one huge frame by zstd(1)
+	     * ... decompress it externally after all.
+	     */
+	    if (pmDebugOptions.log)
+		fprintf(stderr, "__pmFopen(\"%s\", \"%s\"): on-the-fly declined\n", path, mode);
+	    f = fopen_compress(path, compress_ix);
+	    goto done;
+	}
     	return NULL;
     }
 
@@ -782,3 +806,50 @@ compress_suffix_list(void)
 
     return sbuf;
 }
+
+/*
+ * Size limit for the cache of decompressed blocks used by the on-the-fly
+ * decompression handlers, from the environment variable name (with an
+ * optional K, M or G suffix), else dflt.
+ */
+size_t
+__pmDecompressCacheSize(const char *name, size_t dflt)
+{
+    char	*env, *end;
+    double	size;
+
+    if ((env = getenv(name)) == NULL)
+	return dflt;
+    size = strtod(env, &end);
+    switch (*end) {
+	case 'g': case 'G':
+	    size *= 1024;
+	    /* FALLTHROUGH */
+	case 'm': case 'M':
+	    size *= 1024;
+	    /* FALLTHROUGH */
+	case 'k': case 'K':
+	    size *= 1024;
+	    end++;
+	    break;
+    }
+    if (end == env || *end != '\0' || size < 0) {
+	if (pmDebugOptions.compress)
+	    fprintf(stderr, "__pmDecompressCacheSize: ignored bad %s=%s\n",
+			name, env);
+	return dflt;
+    }
+    return (size_t)size;
+}
+
+#if !HAVE_LZMA_DECOMPRESSION
+/*
+ * No xz support, so no block cache - see io_xz.c for the real thing.
+ */
+int
+__pmGetXZCacheStats(__pmXZCacheStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    return -EOPNOTSUPP;
+}
+#endif
@@ -44,9 +44,10 @@
 #include <lzma.h>
 #include "pmapi.h"
 #include "libpcp.h"
+#include "internal.h"
 
-#ifndef PCP_XZ_CACHE_BLOCKS
-#define PCP_XZ_CACHE_BLOCKS 4 /* 4 blocks in the cache, for now */
+#ifndef PCP_XZ_CACHE_SIZE
+#define PCP_XZ_CACHE_SIZE (64 * 1024 * 1024) /* default bytes of uncompressed blocks */
 #endif
 
 #define XZ_HEADER_MAGIC     "\xfd" "7zXZ\0"
@@ -54,13 +55,28 @@
 #define XZ_FOOTER_MAGIC     "YZ"
 #define XZ_FOOTER_MAGIC_LEN 2
 
-/* A block cache. Implemented as a very simple LRU list with a fixed depth. */
-#if 0 /* not used yet */
+/*
+ * A block cache. Implemented as a simple LRU list, bounded by the total
+ * size of the uncompressed blocks it holds (PCP_XZ_CACHE_SIZE in the
+ * environment) rather than by a fixed number of blocks, so that reverse
+ * and interpolated scans over an archive volume do not keep decompressing
+ * the same blocks.
+ */
 typedef struct blkcache_stats {
-    size_t hits;
-    size_t misses;
+    __uint64_t hits;		/* reads satisfied from a cached block */
+    __uint64_t misses;		/* blocks decompressed on demand */
+    __uint64_t readahead;	/* blocks decompressed in the background */
+    __uint64_t rahits;		/* misses satisfied by readahead */
+    __uint64_t nsec;		/* time spent decompressing */
 } blkcache_stats;
-#endif
+
+/* Totals for all xz files, see __pmGetXZCacheStats() */
+static __uint64_t xz_hits;
+static __uint64_t xz_misses;
+static __uint64_t xz_readahead;
+static __uint64_t xz_rahits;
+static __uint64_t xz_nsec;
+static __uint64_t xz_bytes;
 
 /* A buffer of uncompressed blocks */
 typedef struct block {
@@ -71,13 +87,31 @@ typedef struct block {
 } block;
 
 typedef struct blkcache {
-    int maxdepth;
+    int maxdepth;		/* slots allocated */
+    int depth;			/* slots in use, most recently used first */
+    size_t bytes;		/* uncompressed bytes held */
+    size_t maxbytes;		/* ... and the limit on this */
     block *blocks;
-#if 0 /* not used yet */
     blkcache_stats stats;
-#endif
 } blkcache;
 
+#ifdef PM_MULTI_THREAD
+/*
+ * Readahead - when a forward scan moves into the next block, the block
+ * after that is decompressed by a background thread while the current
+ * block is being consumed.  Disabled with PCP_XZ_READAHEAD=0.
+ */
+typedef struct xzreadahead {
+    int busy;			/* thread started, not yet joined */
+    pthread_t thread;
+    uint64_t offset;		/* in the block to decompress */
+    uint64_t start;		/* results ... */
+    uint64_t size;
+    __uint64_t nsec;
+    char *data;			/* NULL on failure */
+} xzreadahead;
+#endif
+
 /* The file handle */
 typedef struct xzfile {
     FILE *f;
@@ -89,6 +123,12 @@ typedef struct xzfile {
     off_t uncompressed_offset;
   __uint64_t uncompressed_size;
   __uint64_t max_uncompressed_block_size;
+    uint64_t cur_start;		/* current block, for forward scan detection */
+    uint64_t cur_end;
+#ifdef PM_MULTI_THREAD
+    int ra_enabled;
+    xzreadahead ra;
+#endif
 } xzfile;
 
 static void
@@ -105,26 +145,24 @@ xz_debug(const char *fmt, ...)
 }
 
 blkcache *
-new_blkcache(size_t maxdepth)
+new_blkcache(size_t maxbytes)
 {
   blkcache *c;
 
-  c = malloc(sizeof *c);
+  c = calloc(1, sizeof *c);
   if (!c) {
     xz_debug("malloc: %m");
     return NULL;
   }
 
-  c->blocks = calloc(maxdepth, sizeof(block));
+  c->maxdepth = 4;
+  c->blocks = calloc(c->maxdepth, sizeof(block));
   if (!c->blocks) {
     xz_debug("calloc: %m");
     free(c);
     return NULL;
   }
-  c->maxdepth = maxdepth;
-#if 0 /* not used yet */
-  c->stats.hits = c->stats.misses = 0;
-#endif
+  c->maxbytes = maxbytes;
 
   return c;
 }
@@ -132,21 +170,32 @@ new_blkcache(size_t maxdepth)
 void
 free_blkcache(blkcache *c)
 {
-  size_t i;
+  int i;
 
-  for (i = 0; i < c->maxdepth; ++i)
+  for (i = 0; i < c->depth; ++i)
     free(c->blocks[i].data);
+  __sync_fetch_and_sub(&xz_bytes, c->bytes);
   free(c->blocks);
   free(c);
 }
 
-#if 0 /* not used yet */
 void
 blkcache_get_stats(blkcache *c, blkcache_stats *ret)
 {
   memcpy(ret, &c->stats, sizeof(c->stats));
 }
-#endif
+
+int
+__pmGetXZCacheStats(__pmXZCacheStats *stats)
+{
+    stats->hits = __sync_fetch_and_add(&xz_hits, 0);
+    stats->misses = __sync_fetch_and_add(&xz_misses, 0);
+    stats->readahead = __sync_fetch_and_add(&xz_readahead, 0);
+    stats->rahits = __sync_fetch_and_add(&xz_rahits, 0);
+    stats->nsec = __sync_fetch_and_add(&xz_nsec, 0);
+    stats->bytes = __sync_fetch_and_add(&xz_bytes, 0);
+    return 0;
+}
 
 static int
 xz_feof(__pmFILE *f)
@@ -430,8 +479,22 @@ init(xzfile *xz)
 
   xz->uncompressed_size = lzma_index_uncompressed_size(xz->idx);
   xz->uncompressed_offset = 0;
-  xz->cache = new_blkcache(PCP_XZ_CACHE_BLOCKS);
-  
+  xz->cache = new_blkcache(__pmDecompressCacheSize("PCP_XZ_CACHE_SIZE",
+						   PCP_XZ_CACHE_SIZE));
+  if (xz->cache == NULL) {
+      lzma_index_end(xz->idx, NULL);
+      return 1; /* error */
+  }
+  xz->cur_start = xz->cur_end = 0;
+#ifdef PM_MULTI_THREAD
+  {
+      char *env = getenv("PCP_XZ_READAHEAD");
+
+      xz->ra_enabled = (env == NULL || strcmp(env, "0") != 0);
+      xz->ra.busy = 0;
+  }
+#endif
+
   return 0; /* ok */
 }
 
@@ -551,20 +614,6 @@ xz_tell(__pmFILE *f)
     return xz->uncompressed_offset;
 }
 
-static block *
-cache_block_used(blkcache *cache, int slot)
-{
-    /* Move this block into the first slot, if it is not already there */
-    if (slot != 0) {
-	block used = cache->blocks[slot];
-	int i;
-	for (i = slot; i > 0; --i)
-	    cache->blocks[i] = cache->blocks[i - 1];
-	cache->blocks[0] = used;
-    }
-    return &cache->blocks[0];
-}
-
 static char *
 read_block(xzfile *xz, uint64_t offset,
                    uint64_t *start_rtn, uint64_t *size_rtn)
@@ -578,6 +627,7 @@ read_block(xzfile *xz, uint64_t offset,
   char *data;
   ssize_t n;
   size_t i;
+  off_t pos;
 
   /* Locate the block containing the uncompressed offset. */
   lzma_index_iter_init(&iter, xz->idx);
@@ -590,20 +640,18 @@ read_block(xzfile *xz, uint64_t offset,
   *start_rtn = iter.block.uncompressed_file_offset;
   *size_rtn = iter.block.uncompressed_size;
 
-  xz_debug("%s(%d, ...) lseek: block number %d at file offset %lu",
+  xz_debug("%s(%d, ...): block number %d at file offset %lu",
 		__func__, xz->fd,
                 (int) iter.block.number_in_file,
                 (uint64_t) iter.block.compressed_file_offset);
 
-  if (lseek(xz->fd, iter.block.compressed_file_offset, SEEK_SET) == -1) {
-    xz_debug("%s(%d, ...): lseek: %m", __func__, xz->fd);
-    return NULL;
-  }
+  /* Use pread(2) throughout, this may run concurrently with readahead. */
+  pos = iter.block.compressed_file_offset;
 
   /* Read the block header.  Start by reading a single byte which
    * tell us how big the block header is.
    */
-  n = read(xz->fd, header, 1);
+  n = pread(xz->fd, header, 1, pos);
   if (n == 0) {
     xz_debug("%s(%d, ...): read: unexpected end of file reading block header byte",
     		__func__, xz->fd);
@@ -631,8 +679,10 @@ read_block(xzfile *xz, uint64_t offset,
     return NULL;
   }
 
+  pos += n;
+
   /* Now read and decode the block header. */
-  n = read(xz->fd, &header[1], blk.header_size-1);
+  n = pread(xz->fd, &header[1], blk.header_size-1, pos);
   if (n >= 0 && n != blk.header_size-1) {
     xz_debug("%s(%d, ...): read: unexpected end of file reading block header",
     		__func__, xz->fd);
@@ -642,6 +692,7 @@ read_block(xzfile *xz, uint64_t offset,
     xz_debug("%s(%d, ...): read: %m", __func__, xz->fd);
     return NULL;
   }
+  pos += n;
 
   r = lzma_block_header_decode(&blk, NULL, header);
   if (r != LZMA_OK) {
@@ -684,11 +735,12 @@ read_block(xzfile *xz, uint64_t offset,
 
     if (strm.avail_in == 0) {
       strm.next_in = buf;
-      n = read(xz->fd, buf, sizeof buf);
+      n = pread(xz->fd, buf, sizeof buf, pos);
       if (n == -1) {
         xz_debug("%s(%d, ...): read: %m", __func__, xz->fd);
         goto err2;
       }
+      pos += n;
       strm.avail_in = n;
       if (n == 0)
         action = LZMA_FINISH;
@@ -721,75 +773,239 @@ read_block(xzfile *xz, uint64_t offset,
   return NULL;
 }
 
-static block *
-read_new_block(xzfile *xz, int slot)
+static __uint64_t
+now_nsec(void)
 {
-    blkcache *cache;
-    block *blk;
-    char *data;
-    uint64_t start = 0, size = 0; /* silence coverity */
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
 
-    /* Decompress a new block into the given slot. */
-    data = read_block(xz, xz->uncompressed_offset, &start, &size);
-    if (data == NULL)
-	return NULL;
+/*
+ * Decompress the block containing offset, and time it.
+ */
+static char *
+decompress_block(xzfile *xz, uint64_t offset,
+		 uint64_t *start_rtn, uint64_t *size_rtn, __uint64_t *nsec_rtn)
+{
+    __uint64_t	t0 = now_nsec();
+    char	*data;
 
-    /* Add the data to this block */
-    cache = xz->cache;
-    blk = &cache->blocks[slot];
-    if (blk->data != NULL)
+    data = read_block(xz, offset, start_rtn, size_rtn);
+    *nsec_rtn = now_nsec() - t0;
+    return data;
+}
+
+/*
+ * Add a newly decompressed block as the most recently used, evicting
+ * least recently used blocks to stay within the size limit ... the
+ * new block is always kept, and so is the current (previously most
+ * recently used) block if this is a readahead block.
+ */
+static block *
+cache_insert(blkcache *cache, char *data, uint64_t start, uint64_t size,
+		int keep)
+{
+    block	*blk;
+    int		i;
+
+    while (cache->depth > keep && cache->bytes + size > cache->maxbytes) {
+	blk = &cache->blocks[--cache->depth];
+	xz_debug("%s: evict block at %llu (%llu bytes)", __func__,
+		(unsigned long long)blk->start, (unsigned long long)blk->size);
 	free(blk->data);
+	blk->data = NULL;
+	cache->bytes -= blk->size;
+	__sync_fetch_and_sub(&xz_bytes, blk->size);
+    }
+    if (cache->depth == cache->maxdepth) {
+	int	maxdepth = cache->maxdepth * 2;
+
+	blk = realloc(cache->blocks, maxdepth * sizeof(block));
+	if (blk == NULL) {
+	    pmNoMem("xz cache_insert", maxdepth * sizeof(block), PM_RECOV_ERR);
+	    free(data);
+	    return NULL;
+	}
+	cache->blocks = blk;
+	cache->maxdepth = maxdepth;
+    }
+    for (i = cache->depth; i > 0; --i)
+	cache->blocks[i] = cache->blocks[i - 1];
+    cache->depth++;
+    blk = &cache->blocks[0];
     blk->data = data;
     blk->start = start;
     blk->size = size;
-    blk->current_offset = xz->uncompressed_offset - blk->start;
-
-    /* Mark this block as most recently used */
-    blk = cache_block_used(cache, slot);
-	    
+    blk->current_offset = 0;
+    cache->bytes += size;
+    __sync_fetch_and_add(&xz_bytes, size);
     return blk;
 }
 
-/*
- * Find the block containing the current uncompressed offset and update the
- * current offset within that block..
- */
+/* Move the block in slot to the front of the LRU list. */
 static block *
-reposition(xzfile *xz)
+cache_block_used(blkcache *cache, int slot)
 {
-    blkcache *cache;
-    block *blk;
-    int slot;
+    if (slot != 0) {
+	block used = cache->blocks[slot];
+	int i;
+	for (i = slot; i > 0; --i)
+	    cache->blocks[i] = cache->blocks[i - 1];
+	cache->blocks[0] = used;
+    }
+    return &cache->blocks[0];
+}
+
+static int
+cache_find(blkcache *cache, uint64_t offset)
+{
+    block	*blk;
+    int		slot;
 
     /*
-     * Search the cache for the block we want.
      * The cache is sorted by most recently used blocks. This works out well
      * since the data we want is most often in the block which will be checked
      * first.
      */
-    cache = xz->cache;
-    for (slot = 0; slot < cache->maxdepth; ++slot) {
+    for (slot = 0; slot < cache->depth; ++slot) {
 	blk = &cache->blocks[slot];
-	if (blk->data == NULL)
-	    break; /* end of cache */
-
-	if (xz->uncompressed_offset >= blk->start &&
-	    xz->uncompressed_offset < blk->start + blk->size) {
-	    /* found it */
-	    blk->current_offset = xz->uncompressed_offset - blk->start;
-	    blk = cache_block_used(cache, slot);
-	    return blk;
+	if (offset >= blk->start && offset < blk->start + blk->size)
+	    return slot;
+    }
+    return -1;
+}
+
+#ifdef PM_MULTI_THREAD
+static void *
+readahead_thread(void *arg)
+{
+    xzfile	*xz = (xzfile *)arg;
+    xzreadahead	*ra = &xz->ra;
+
+    ra->data = decompress_block(xz, ra->offset, &ra->start, &ra->size, &ra->nsec);
+    return NULL;
+}
+
+/*
+ * Wait for any readahead to finish and add the result to the cache.
+ */
+static void
+readahead_collect(xzfile *xz)
+{
+    xzreadahead	*ra = &xz->ra;
+    blkcache	*cache = xz->cache;
+
+    if (!ra->busy)
+	return;
+    pthread_join(ra->thread, NULL);
+    ra->busy = 0;
+    if (ra->data == NULL)
+	return;
+    cache->stats.readahead++;
+    cache->stats.nsec += ra->nsec;
+    __sync_fetch_and_add(&xz_readahead, 1);
+    __sync_fetch_and_add(&xz_nsec, ra->nsec);
+    if (cache_find(cache, ra->start) >= 0) {
+	free(ra->data);		/* raced with a demand read */
+	return;
+    }
+    /* behind the current block, which must not be evicted */
+    if (cache_insert(cache, ra->data, ra->start, ra->size, 1) != NULL && cache->depth > 1) {
+	block	tmp = cache->blocks[0];
+
+	cache->blocks[0] = cache->blocks[1];
+	cache->blocks[1] = tmp;
+    }
+}
+
+static void
+readahead_start(xzfile *xz, uint64_t offset)
+{
+    xzreadahead	*ra = &xz->ra;
+    int		sts;
+
+    if (!xz->ra_enabled || ra->busy || offset >= xz->uncompressed_size)
+	return;
+    if (cache_find(xz->cache, offset) >= 0)
+	return;
+    ra->offset = offset;
+    ra->data = NULL;
+    if ((sts = pthread_create(&ra->thread, NULL, readahead_thread, xz)) != 0) {
+	xz_debug("%s(%d, ...): pthread_create: %s, readahead disabled",
+		__func__, xz->fd, pmErrStr(-sts));
+	xz->ra_enabled = 0;
+	return;
+    }
+    ra->busy = 1;
+    xz_debug("%s(%d, ...): readahead from offset %llu",
+		__func__, xz->fd, (unsigned long long)offset);
+}
+#endif
+
+/*
+ * Find the block containing the current uncompressed offset and update the
+ * current offset within that block..
+ */
+static block *
+reposition(xzfile *xz)
+{
+    blkcache	*cache = xz->cache;
+    block	*blk;
+    char	*data;
+    uint64_t	start = 0, size = 0; /* silence coverity */
+    __uint64_t	nsec;
+    int		slot;
+
+    if ((slot = cache_find(cache, xz->uncompressed_offset)) >= 0) {
+	cache->stats.hits++;
+	__sync_fetch_and_add(&xz_hits, 1);
+    }
+#ifdef PM_MULTI_THREAD
+    else if (xz->ra.busy) {
+	/* the block we want may be on its way */
+	readahead_collect(xz);
+	if ((slot = cache_find(cache, xz->uncompressed_offset)) >= 0) {
+	    cache->stats.rahits++;
+	    __sync_fetch_and_add(&xz_rahits, 1);
 	}
     }
+#endif
 
-    /*
-     * No cached block contains the uncompressed offset that we want.
-     * Decompress a new block into an empty slot, or into the least recently
-     * used slot, which is the last one.
-     */
-    if (slot >= cache->maxdepth)
-	slot = cache->maxdepth - 1;
-    blk = read_new_block(xz, slot);
+    if (slot >= 0)
+	blk = cache_block_used(cache, slot);
+    else {
+	/*
+	 * No cached block contains the uncompressed offset that we want.
+	 * Decompress a new block, evicting the least recently used blocks
+	 * if needed.
+	 */
+	data = decompress_block(xz, xz->uncompressed_offset, &start, &size, &nsec);
+	if (data == NULL)
+	    return NULL;
+	cache->stats.misses++;
+	cache->stats.nsec += nsec;
+	__sync_fetch_and_add(&xz_misses, 1);
+	__sync_fetch_and_add(&xz_nsec, nsec);
+	if ((blk = cache_insert(cache, data, start, size, 0)) == NULL)
+	    return NULL;
+    }
+    blk->current_offset = xz->uncompressed_offset - blk->start;
+
+    if (blk->start != xz->cur_start || blk->start + blk->size != xz->cur_end) {
+	/* moved to a different block ... forward scan into the next one? */
+	int	forward = (blk->start == xz->cur_end);
+
+	xz->cur_start = blk->start;
+	xz->cur_end = blk->start + blk->size;
+#ifdef PM_MULTI_THREAD
+	if (forward)
+	    readahead_start(xz, xz->cur_end);
+#else
+	(void)forward;
+#endif
+    }
 
     return blk;
 }
@@ -907,8 +1123,22 @@ static int
 xz_close(__pmFILE *f)
 {
     xzfile *xz = f->priv;
+    blkcache_stats stats;
     int sts;
-    
+
+#ifdef PM_MULTI_THREAD
+    readahead_collect(xz);
+#endif
+    if (pmDebugOptions.compress) {
+	blkcache_get_stats(xz->cache, &stats);
+	fprintf(stderr, "%s(%d): cache hits %llu misses %llu readahead %llu "
+		"(used %llu) decompress %.3f sec, %zu blocks %zu bytes\n",
+		__func__, xz->fd, (unsigned long long)stats.hits,
+		(unsigned long long)stats.misses,
+		(unsigned long long)stats.readahead,
+		(unsigned long long)stats.rahits, (double)stats.nsec / 1e9,
+		(size_t)xz->cache->depth, xz->cache->bytes);
+    }
     lzma_index_end (xz->idx, NULL);
     sts = fclose(xz->f);
     free_blkcache(xz->cache);
@@ -0,0 +1,647 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+/*
+ * On-the-fly zstd decompression with random access.
+ *
+ * A zstd file is a sequence of independently decompressible frames.
+ * Files written by pmlogzstd(1) (or any other zstd "seekable format"
+ * writer) end with a seek table in a skippable frame giving the
+ * compressed and decompressed size of every frame, so any uncompressed
+ * offset can be mapped to the one frame that must be decompressed.
+ * Without a seek table the frame headers are scanned instead, which
+ * works for any multi-frame file where the frames record their content
+ * size (zstd(1) does this when compressing a regular file).
+ *
+ * Decompressed frames are kept in an LRU cache bounded by the total
+ * number of decompressed bytes (PCP_ZSTD_CACHE_SIZE in the environment).
+ * If the largest frame would not fit in the cache, or a frame size is
+ * not known, open fails with EOPNOTSUPP and __pmFopen() falls back to
+ * decompressing the whole file with zstd(1).
+ *
+ * Seekable format, all integers little-endian:
+ *
+ *	frame 0 ... frame N-1
+ *	skippable frame magic	0x184D2A5E		u32
+ *	skippable frame size	N * entry size + 9	u32
+ *	N entries of:
+ *	    compressed size					u32
+ *	    decompressed size					u32
+ *	    [checksum, if descriptor bit 7 is set]		u32
+ *	N							u32
+ *	descriptor						u8
+ *	seekable magic		0x8F92EAB1		u32
+ */
+#include "config.h"
+#if HAVE_ZSTD_DECOMPRESSION
+#include <stdarg.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <zstd.h>
+#include "pmapi.h"
+#include "libpcp.h"
+#include "internal.h"
+
+#ifndef PCP_ZSTD_CACHE_SIZE
+#define PCP_ZSTD_CACHE_SIZE (64 * 1024 * 1024) /* default bytes of uncompressed frames */
+#endif
+
+#define ZSTD_SKIPPABLE_MAGIC	0x184D2A50	/* low 4 bits are user defined */
+#define ZSTD_SKIPPABLE_MASK	0xFFFFFFF0
+#define SEEKTABLE_SKIPPABLE	0x184D2A5E
+#define SEEKTABLE_MAGIC		0x8F92EAB1
+#define SEEKTABLE_FOOTER	9
+#define SEEKTABLE_CHECKSUM	0x80		/* descriptor flags */
+#define SEEKTABLE_RESERVED	0x7C
+
+typedef struct zframe {
+    __uint64_t	coffset;	/* compressed offset ... */
+    __uint64_t	csize;		/* ... and size */
+    __uint64_t	uoffset;	/* uncompressed offset ... */
+    __uint64_t	usize;		/* ... and size */
+    char	*data;		/* decompressed frame, if cached */
+} zframe;
+
+typedef struct zstdfile {
+    int		fd;
+    const unsigned char	*map;	/* the whole compressed file */
+    size_t	maplen;
+    ZSTD_DCtx	*dctx;
+    int		nframes;
+    zframe	*frames;
+    int		seektable;	/* frame index from a seek table? */
+    __uint64_t	size;		/* uncompressed */
+    __uint64_t	offset;		/* current uncompressed offset */
+    int		cur;		/* frame containing offset, or -1 */
+    int		*lru;		/* cached frames, most recently used first */
+    int		depth;
+    size_t	bytes;		/* uncompressed bytes held ... */
+    size_t	maxbytes;	/* ... and the limit on this */
+    __uint64_t	hits;		/* diag counters */
+    __uint64_t	misses;
+    __uint64_t	nsec;
+} zstdfile;
+
+static void
+zstd_debug(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (pmDebugOptions.compress) {
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	fputc('\n', stderr);
+	va_end(ap);
+    }
+}
+
+static __uint32_t
+le32(const unsigned char *p)
+{
+    return (__uint32_t)p[0] | ((__uint32_t)p[1] << 8) |
+	   ((__uint32_t)p[2] << 16) | ((__uint32_t)p[3] << 24);
+}
+
+static int
+add_frame(zstdfile *zp, __uint64_t coffset, __uint64_t csize, __uint64_t usize)
+{
+    zframe	*fp;
+    size_t	need;
+
+    if (usize == 0)
+	return 0;	/* never contains an offset, don't index it */
+    if ((zp->nframes & (zp->nframes - 1)) == 0) {
+	/* grow to the next power of 2 */
+	need = (zp->nframes ? zp->nframes * 2 : 16) * sizeof(zframe);
+	if ((fp = realloc(zp->frames, need)) == NULL) {
+	    pmNoMem("zstd add_frame", need, PM_RECOV_ERR);
+	    return -ENOMEM;
+	}
+	zp->frames = fp;
+    }
+    fp = &zp->frames[zp->nframes++];
+    fp->coffset = coffset;
+    fp->csize = csize;
+    fp->uoffset = zp->size;
+    fp->usize = usize;
+    fp->data = NULL;
+    zp->size += usize;
+    return 0;
+}
+
+/*
+ * Build the frame index from a trailing seek table.  Returns 1 if
+ * there is a valid seek table, 0 if there is none, else a PCP error
+ * code.
+ */
+static int
+parse_seektable(zstdfile *zp)
+{
+    const unsigned char	*p, *end = zp->map + zp->maplen;
+    __uint64_t	coffset = 0;
+    __uint32_t	nentries, entsize, i;
+    size_t	tablesize;
+    int		desc, sts;
+
+    if (zp->maplen < SEEKTABLE_FOOTER + 8 ||
+	le32(end - 4) != SEEKTABLE_MAGIC)
+	return 0;
+    nentries = le32(end - SEEKTABLE_FOOTER);
+    desc = end[-5];
+    if (desc & SEEKTABLE_RESERVED) {
+	zstd_debug("%s(%d): reserved descriptor bits 0x%x set", __func__,
+			zp->fd, desc);
+	return PM_ERR_LOGREC;
+    }
+    entsize = (desc & SEEKTABLE_CHECKSUM) ? 12 : 8;
+    tablesize = (size_t)nentries * entsize + SEEKTABLE_FOOTER;
+    if (tablesize + 8 > zp->maplen ||
+	le32(end - tablesize - 8) != SEEKTABLE_SKIPPABLE ||
+	le32(end - tablesize - 4) != tablesize) {
+	zstd_debug("%s(%d): bad seek table, %u entries", __func__,
+			zp->fd, nentries);
+	return PM_ERR_LOGREC;
+    }
+    for (i = 0, p = end - tablesize; i < nentries; i++, p += entsize) {
+	if ((sts = add_frame(zp, coffset, le32(p), le32(p + 4))) < 0)
+	    return sts;
+	coffset += le32(p);
+    }
+    if (coffset != zp->maplen - tablesize - 8) {
+	zstd_debug("%s(%d): seek table covers %llu bytes, expected %llu",
+			__func__, zp->fd, (unsigned long long)coffset,
+			(unsigned long long)(zp->maplen - tablesize - 8));
+	return PM_ERR_LOGREC;
+    }
+    return 1;
+}
+
+/*
+ * No seek table, so build the frame index from the frame headers.
+ */
+static int
+scan_frames(zstdfile *zp)
+{
+    const unsigned char	*p;
+    unsigned long long	usize;
+    size_t	pos, left, csize;
+    int		sts;
+
+    for (pos = 0; pos < zp->maplen; pos += csize) {
+	p = zp->map + pos;
+	left = zp->maplen - pos;
+	if (left >= 8 && (le32(p) & ZSTD_SKIPPABLE_MASK) == ZSTD_SKIPPABLE_MAGIC) {
+	    csize = (size_t)le32(p + 4) + 8;
+	    if (csize > left)
+		return PM_ERR_LOGREC;
+	    continue;
+	}
+	csize = ZSTD_findFrameCompressedSize(p, left);
+	if (ZSTD_isError(csize)) {
+	    zstd_debug("%s(%d): bad frame at offset %zu: %s", __func__,
+			zp->fd, pos, ZSTD_getErrorName(csize));
+	    return PM_ERR_LOGREC;
+	}
+	usize = ZSTD_getFrameContentSize(p, left);
+	if (usize == ZSTD_CONTENTSIZE_ERROR)
+	    return PM_ERR_LOGREC;
+	if (usize == ZSTD_CONTENTSIZE_UNKNOWN) {
+	    zstd_debug("%s(%d): frame at offset %zu has no content size",
+			__func__, zp->fd, pos);
+	    return -EOPNOTSUPP;
+	}
+	if ((sts = add_frame(zp, pos, csize, usize)) < 0)
+	    return sts;
+    }
+    return 0;
+}
+
+static void
+zstd_free(zstdfile *zp)
+{
+    int		i;
+
+    for (i = 0; i < zp->nframes; i++)
+	free(zp->frames[i].data);
+    free(zp->frames);
+    free(zp->lru);
+    if (zp->dctx != NULL)
+	ZSTD_freeDCtx(zp->dctx);
+    if (zp->map != NULL)
+	munmap((void *)zp->map, zp->maplen);
+    free(zp);
+}
+
+static void *
+zstd_init(__pmFILE *f, int fd)
+{
+    zstdfile	*zp;
+    struct stat	sbuf;
+    __uint64_t	maxframe = 0;
+    int		i, sts;
+
+    if ((zp = calloc(1, sizeof(*zp))) == NULL) {
+	pmNoMem("zstd_init", sizeof(*zp), PM_RECOV_ERR);
+	setoserror(ENOMEM);
+	return NULL;
+    }
+    zp->fd = fd;
+    zp->cur = -1;
+    if (fstat(fd, &sbuf) < 0) {
+	sts = -oserror();
+	goto fail;
+    }
+    zp->maplen = sbuf.st_size;
+    if (zp->maplen > 0) {
+	zp->map = mmap(NULL, zp->maplen, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (zp->map == MAP_FAILED) {
+	    zp->map = NULL;
+	    sts = -oserror();
+	    goto fail;
+	}
+    }
+    if ((sts = parse_seektable(zp)) == 0)
+	sts = scan_frames(zp);
+    else if (sts > 0)
+	zp->seektable = 1;
+    if (sts < 0)
+	goto fail;
+
+    for (i = 0; i < zp->nframes; i++) {
+	if (zp->frames[i].usize > maxframe)
+	    maxframe = zp->frames[i].usize;
+    }
+    zp->maxbytes = __pmDecompressCacheSize("PCP_ZSTD_CACHE_SIZE",
+					   PCP_ZSTD_CACHE_SIZE);
+    if (maxframe > zp->maxbytes) {
+	zstd_debug("%s(%d): largest frame (%llu bytes) exceeds cache size "
+			"(%zu bytes)", __func__, fd,
+			(unsigned long long)maxframe, zp->maxbytes);
+	sts = -EOPNOTSUPP;
+	goto fail;
+    }
+    if ((zp->lru = malloc((zp->nframes + 1) * sizeof(int))) == NULL ||
+	(zp->dctx = ZSTD_createDCtx()) == NULL) {
+	sts = -ENOMEM;
+	goto fail;
+    }
+    zstd_debug("%s(%d): %d frames (%s), %llu bytes uncompressed, "
+		"largest frame %llu bytes", __func__, fd, zp->nframes,
+		zp->seektable ? "seek table" : "scanned",
+		(unsigned long long)zp->size, (unsigned long long)maxframe);
+    f->priv = zp;
+    return zp;
+
+fail:
+    zstd_debug("%s(%d): %s", __func__, fd, pmErrStr(sts));
+    zstd_free(zp);
+    setoserror(-sts);
+    return NULL;
+}
+
+static void *
+zstd_open(__pmFILE *f, const char *path, const char *mode)
+{
+    void	*zp;
+    int		fd, sts;
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+	zstd_debug("%s(..., %s, ...): open: %s", __func__, path, osstrerror());
+	return NULL;
+    }
+    if ((zp = zstd_init(f, fd)) == NULL) {
+	sts = oserror();
+	close(fd);
+	setoserror(sts);
+    }
+    return zp;
+}
+
+static void *
+zstd_fdopen(__pmFILE *f, int fd, const char *mode)
+{
+    return zstd_init(f, fd);
+}
+
+/* binary search for the frame containing offset */
+static int
+find_frame(zstdfile *zp, __uint64_t offset)
+{
+    int		lo = 0, hi = zp->nframes - 1, mid;
+    zframe	*fp;
+
+    if (zp->cur >= 0) {
+	fp = &zp->frames[zp->cur];
+	if (offset >= fp->uoffset && offset < fp->uoffset + fp->usize)
+	    return zp->cur;
+    }
+    while (lo <= hi) {
+	mid = (lo + hi) / 2;
+	fp = &zp->frames[mid];
+	if (offset < fp->uoffset)
+	    hi = mid - 1;
+	else if (offset >= fp->uoffset + fp->usize)
+	    lo = mid + 1;
+	else
+	    return mid;
+    }
+    return -1;
+}
+
+static __uint64_t
+now_nsec(void)
+{
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Make frame n the most recently used, decompressing it (and evicting
+ * least recently used frames) if it is not already cached.
+ */
+static zframe *
+load_frame(zstdfile *zp, int n)
+{
+    zframe	*fp = &zp->frames[n];
+    zframe	*victim;
+    __uint64_t	t0;
+    size_t	sts;
+    int		i;
+
+    if (fp->data != NULL) {
+	zp->hits++;
+	for (i = 0; zp->lru[i] != n; i++)
+	    ;
+    }
+    else {
+	while (zp->depth > 0 && zp->bytes + fp->usize > zp->maxbytes) {
+	    victim = &zp->frames[zp->lru[--zp->depth]];
+	    zstd_debug("%s(%d): evict frame at %llu (%llu bytes)", __func__,
+			zp->fd, (unsigned long long)victim->uoffset,
+			(unsigned long long)victim->usize);
+	    free(victim->data);
+	    victim->data = NULL;
+	    zp->bytes -= victim->usize;
+	}
+	if ((fp->data = malloc(fp->usize)) == NULL) {
+	    pmNoMem("zstd load_frame", fp->usize, PM_RECOV_ERR);
+	    return NULL;
+	}
+	t0 = now_nsec();
+	sts = ZSTD_decompressDCtx(zp->dctx, fp->data, fp->usize,
+				  zp->map + fp->coffset, fp->csize);
+	zp->nsec += now_nsec() - t0;
+	if (ZSTD_isError(sts) || sts != fp->usize) {
+	    zstd_debug("%s(%d): frame %d at offset %llu: %s", __func__,
+			zp->fd, n, (unsigned long long)fp->coffset,
+			ZSTD_isError(sts) ? ZSTD_getErrorName(sts) : "short frame");
+	    free(fp->data);
+	    fp->data = NULL;
+	    setoserror(-PM_ERR_LOGREC);
+	    return NULL;
+	}
+	zp->misses++;
+	zp->bytes += fp->usize;
+	i = zp->depth++;
+    }
+    for (; i > 0; i--)
+	zp->lru[i] = zp->lru[i - 1];
+    zp->lru[0] = n;
+    zp->cur = n;
+    return fp;
+}
+
+static zframe *
+reposition(zstdfile *zp)
+{
+    int		n;
+
+    if (zp->offset >= zp->size)
+	return NULL;
+    if (zp->cur >= 0 && zp->cur == zp->lru[0]) {
+	zframe	*fp = &zp->frames[zp->cur];
+
+	/* fast path, still in the most recently used frame */
+	if (zp->offset >= fp->uoffset && zp->offset < fp->uoffset + fp->usize) {
+	    zp->hits++;
+	    return fp;
+	}
+    }
+    if ((n = find_frame(zp, zp->offset)) < 0)
+	return NULL;
+    return load_frame(zp, n);
+}
+
+static int
+zstd_seek(__pmFILE *f, off_t offset, int whence)
+{
+    zstdfile	*zp = (zstdfile *)f->priv;
+    __int64_t	new_offset;
+
+    switch (whence) {
+    case SEEK_SET:
+	new_offset = offset;
+	break;
+    case SEEK_CUR:
+	new_offset = zp->offset + offset;
+	break;
+    case SEEK_END:
+	new_offset = zp->size + offset;
+	break;
+    default:
+	setoserror(EINVAL);
+	return -1;
+    }
+    if (new_offset < 0) {
+	setoserror(EINVAL);
+	return -1;
+    }
+    /* decompression is deferred until the next read */
+    zp->offset = new_offset;
+    return 0;
+}
+
+static off_t
+zstd_lseek(__pmFILE *f, off_t offset, int whence)
+{
+    zstdfile	*zp = (zstdfile *)f->priv;
+
+    if (zstd_seek(f, offset, whence) < 0)
+	return -1;
+    return zp->offset;
+}
+
+static void
+zstd_rewind(__pmFILE *f)
+{
+    zstdfile	*zp = (zstdfile *)f->priv;
+
+    zp->offset = 0;
+}
+
+static off_t
+zstd_tell(__pmFILE *f)
+{
+    zstdfile	*zp = (zstdfile *)f->priv;
+
+    return zp->offset;
+}
+
+static int
+zstd_getc(__pmFILE *f)
+{
+    zstdfile	*zp = (zstdfile *)f->priv;
+    zframe	*fp;
+
+    if ((fp = reposition(zp)) == NULL)
+	return EOF;
+    return (unsigned char)fp->data[zp->offset++ - fp->uoffset];
+}
+
+static size_t
+zstd_read(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    zstdfile	*zp = (zstdfile *)f->priv;
+    zframe	*fp;
+    size_t	want, n, copied = 0;
+
+    if (size == 0)
+	return 0;
+    want = size * nmemb;
+    while (copied < want) {
+	if ((fp = reposition(zp)) == NULL)
+	    break;
+	n = fp->uoffset + fp->usize - zp->offset;
+	if (n > want - copied)
+	    n = want - copied;
+	memcpy((char *)ptr + copied, fp->data + (zp->offset - fp->uoffset), n);
+	copied += n;
+	zp->offset += n;
+    }
+    return copied / size;
+}
+
+static size_t
+zstd_write(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    zstd_debug("libpcp internal error: %s not implemented", __func__);
+    return 0;
+}
+
+static int
+zstd_flush(__pmFILE *f)
+{
+    zstd_debug("libpcp internal error: %s not implemented", __func__);
+    return EOF;
+}
+
+static int
+zstd_fsync(__pmFILE *f)
+{
+    zstd_debug("libpcp internal error: %s not implemented", __func__);
+    return -1;
+}
+
+static int
+zstd_fileno(__pmFILE *f)
+{
+    zstdfile	*zp = (zstdfile *)f->priv;
+
+    return zp->fd;
+}
+
+static int
+zstd_fstat(__pmFILE *f, struct stat *buf)
+{
+    zstdfile	*zp = (zstdfile *)f->priv;
+    int		sts;
+
+    /* what the caller really wants for st_size is the uncompressed size */
+    if ((sts = fstat(zp->fd, buf)) == 0)
+	buf->st_size = zp->size;
+    return sts;
+}
+
+static int
+zstd_feof(__pmFILE *f)
+{
+    zstdfile	*zp = (zstdfile *)f->priv;
+
+    return zp->offset >= zp->size;
+}
+
+static int
+zstd_ferror(__pmFILE *f)
+{
+    return 0;
+}
+
+static void
+zstd_clearerr(__pmFILE *f)
+{
+}
+
+static int
+zstd_setvbuf(__pmFILE *f, char *buf, int mode, size_t size)
+{
+    zstd_debug("libpcp internal error: %s not implemented", __func__);
+    return -1;
+}
+
+static int
+zstd_close(__pmFILE *f)
+{
+    zstdfile	*zp = (zstdfile *)f->priv;
+    int		sts;
+
+    if (pmDebugOptions.compress) {
+	fprintf(stderr, "%s(%d): cache hits %llu misses %llu "
+		"decompress %.3f sec, %d frames %zu bytes\n",
+		__func__, zp->fd, (unsigned long long)zp->hits,
+		(unsigned long long)zp->misses, (double)zp->nsec / 1e9,
+		zp->depth, zp->bytes);
+    }
+    sts = close(zp->fd);
+    zstd_free(zp);
+    return sts;
+}
+
+__pm_fops __pm_zstd = {
+    /*
+     * zstd decompression
+     */
+    .__pmopen = zstd_open,
+    .__pmfdopen = zstd_fdopen,
+    .__pmseek = zstd_seek,
+    .__pmrewind = zstd_rewind,
+    .__pmtell = zstd_tell,
+    .__pmfgetc = zstd_getc,
+    .__pmread = zstd_read,
+    .__pmwrite = zstd_write,
+    .__pmflush = zstd_flush,
+    .__pmfsync = zstd_fsync,
+    .__pmfileno = zstd_fileno,
+    .__pmlseek = zstd_lseek,
+    .__pmfstat = zstd_fstat,
+    .__pmfeof = zstd_feof,
+    .__pmferror = zstd_ferror,
+    .__pmclearerr = zstd_clearerr,
+    .__pmsetvbuf = zstd_setvbuf,
+    .__pmclose = zstd_close
+};
+#endif /* HAVE_ZSTD_DECOMPRESSION */
@@ -1337,8 +1337,12 @@ lookup_domain(int ident, int type)
     return -EINVAL;
 }
 
+/*
+ * For PM_LABEL_INSTANCES requests, an optional profile (prof) restricts
+ * the instances reported by pmcd to a subset of the context profile.
+ */
 static int
-getlabels(int ident, int type, pmLabelSet **sets, int *nsets)
+getlabels(int ident, int type, pmProfile *prof, pmLabelSet **sets, int *nsets)
 {
     __pmContext	*ctxp;
     int		ctx, sts;
@@ -1357,18 +1361,23 @@ getlabels(int ident, int type, pmLabelSet **sets, int *nsets)
 	    sts = PM_ERR_NOLABELS;	/* lack pmcd support */
 	else {
 	    sts = 0;
-	    if ((type & PM_LABEL_INSTANCES) && ctxp->c_sent == 0) {
+	    if ((type & PM_LABEL_INSTANCES) && (prof || ctxp->c_sent == 0)) {
 	    	/* profile not current for label instances request */
+		if (prof == NULL)
+		    prof = ctxp->c_instprof;
 		if (pmDebugOptions.profile || pmDebugOptions.labels) {
 		    fprintf(stderr, "dolabels: sent profile, indom=%d\n", ident);
-		    __pmDumpProfile(stderr, ident, ctxp->c_instprof);
+		    __pmDumpProfile(stderr, ident, prof);
 		}
 		if ((sts = __pmSendProfile(fd, __pmPtrToHandle(ctxp),
-                                   ctxp->c_slot, ctxp->c_instprof)) < 0)
+                                   ctxp->c_slot, prof)) < 0)
 		    sts = __pmMapErrno(sts);
 		else {
-		    /* no reply expected for profile */
-		    ctxp->c_sent = 1;
+		    /*
+		     * no reply expected for profile; a subset profile must
+		     * be replaced by the context profile before next use
+		     */
+		    ctxp->c_sent = (prof == ctxp->c_instprof);
 		}
 	    }
 	    if (sts >= 0) {
@@ -1441,7 +1450,7 @@ dolabels(int ident, int type, pmLabelSet **labels)
     pmLabelSet	*sets = NULL;
     int		sts, nsets = 0;
 
-    if ((sts = getlabels(ident, type, &sets, &nsets)) < 0)
+    if ((sts = getlabels(ident, type, NULL, &sets, &nsets)) < 0)
 	return sts;
 
     if (nsets) {
@@ -1564,6 +1573,407 @@ fail:
     return sts;
 }
 
+static int
+instcmp(const void *a, const void *b)
+{
+    int		ia = *(const int *)a, ib = *(const int *)b;
+
+    return (ia > ib) - (ia < ib);
+}
+
+/*
+ * Detach the labels, json and hash of a labelset, leaving it empty -
+ * ownership moves with the structure copied out beforehand.
+ */
+static void
+labelset_detach(pmLabelSet *set)
+{
+    set->nlabels = 0;
+    set->labels = NULL;
+    set->json = NULL;
+    set->jsonlen = 0;
+    set->compound = 0;
+    set->hash = NULL;
+}
+
+/*
+ * Labels for a subset of the instances of indom.  For pmcd contexts
+ * a temporary instance profile selects just those instances, so the
+ * cost on the wire and in parsing is proportional to the instances
+ * requested rather than the size of the instance domain.  Other
+ * context types report every instance, and are filtered here.
+ */
+int
+pmGetInstancesLabelsList(pmInDom indom, int numinst, int *instlist,
+			pmLabelSet **labels)
+{
+    pmInDomProfile	subset;
+    pmProfile		prof;
+    pmLabelSet		*sets = NULL;
+    int			*sorted;
+    int			i, j, sts, nsets = 0;
+
+    *labels = NULL;
+    if (numinst < 0 || (numinst > 0 && instlist == NULL))
+	return -EINVAL;
+    if (numinst == 0)
+	return 0;
+
+    if ((sorted = malloc(numinst * sizeof(int))) == NULL)
+	return -oserror();
+    memcpy(sorted, instlist, numinst * sizeof(int));
+    qsort(sorted, numinst, sizeof(int), instcmp);
+
+    /* exclude all instances of indom except those requested */
+    subset.indom = indom;
+    subset.state = PM_PROFILE_EXCLUDE;
+    subset.instances_len = numinst;
+    subset.instances = sorted;
+    prof.state = PM_PROFILE_INCLUDE;
+    prof.profile_len = 1;
+    prof.profile = &subset;
+
+    if ((sts = getlabels(indom, PM_LABEL_INSTANCES, &prof, &sets, &nsets)) < 0) {
+	free(sorted);
+	return sts;
+    }
+
+    for (i = j = 0; i < nsets; i++) {
+	if (bsearch(&sets[i].inst, sorted, numinst, sizeof(int), instcmp)) {
+	    if (i != j) {
+		sets[j] = sets[i];
+		labelset_detach(&sets[i]);
+	    }
+	    j++;
+	}
+    }
+    free(sorted);
+    if (j == 0) {
+	pmFreeLabelSets(sets, nsets);
+	return 0;
+    }
+    if (j < nsets) {
+	/* release the labels of instances filtered out above */
+	for (i = j; i < nsets; i++) {
+	    if (sets[i].nlabels > 0)
+		free(sets[i].labels);
+	    if (sets[i].json)
+		free(sets[i].json);
+	    if (sets[i].compound && sets[i].hash) {
+		labels_hash_destroy(sets[i].hash);
+		free(sets[i].hash);
+	    }
+	}
+    }
+    *labels = sets;
+    return j;
+}
+
+/*
+ * Client-side instance labels cache, keyed by (indom, instance).
+ *
+ * Each indom has a generation number, advanced whenever instances are
+ * added, removed or have different labels after an update, and each
+ * instance records the generation in which it last changed.  Clients
+ * compare generations to find what changed rather than comparing the
+ * labels of every instance again.
+ */
+typedef struct {
+    int			generation;	/* indom generation when last changed */
+    unsigned int	pass;		/* last update that saw this instance */
+    pmLabelSet		*set;		/* labels, NULL if the instance has none */
+} labelcache_inst_t;
+
+typedef struct {
+    int			generation;	/* advanced on any instance change */
+    unsigned int	pass;		/* count of updates to this indom */
+    __pmOAHashCtl	insts;		/* instance -> labelcache_inst_t */
+} labelcache_indom_t;
+
+void
+__pmLabelCacheInit(__pmLabelCache *cache)
+{
+    __pmHashInit(&cache->indoms);
+}
+
+static __pmHashWalkState
+labelcache_inst_free_callback(const __pmOAHashNode *hp, void *cp)
+{
+    labelcache_inst_t	*ip = (labelcache_inst_t *)hp->data;
+
+    (void)cp;
+    if (ip->set)
+	pmFreeLabelSets(ip->set, 1);
+    free(ip);
+    return PM_HASH_WALK_DELETE_NEXT;
+}
+
+static __pmHashWalkState
+labelcache_indom_free_callback(const __pmHashNode *tp, void *cp)
+{
+    labelcache_indom_t	*dp = (labelcache_indom_t *)tp->data;
+
+    (void)cp;
+    __pmOAHashWalkCB(labelcache_inst_free_callback, NULL, &dp->insts);
+    __pmOAHashFree(&dp->insts);
+    free(dp);
+    return PM_HASH_WALK_DELETE_NEXT;
+}
+
+void
+__pmLabelCacheFree(__pmLabelCache *cache)
+{
+    __pmHashWalkCB(labelcache_indom_free_callback, NULL, &cache->indoms);
+    __pmHashClear(&cache->indoms);
+}
+
+static labelcache_indom_t *
+labelcache_indom(__pmLabelCache *cache, pmInDom indom)
+{
+    __pmHashNode	*hp;
+
+    if ((hp = __pmHashSearch(indom, &cache->indoms)) != NULL)
+	return (labelcache_indom_t *)hp->data;
+    return NULL;
+}
+
+/*
+ * Store labels for one instance, taking ownership of the contents of
+ * set (if any).  Returns 1 if the cached labels changed, else 0.
+ */
+static int
+labelcache_store(labelcache_indom_t *dp, int inst, pmLabelSet *set,
+		int generation)
+{
+    labelcache_inst_t	*ip;
+    __pmOAHashNode	*hp;
+    pmLabelSet		*copy = NULL;
+    int			sts;
+
+    if (set) {
+	if ((copy = malloc(sizeof(pmLabelSet))) == NULL)
+	    return -oserror();
+	*copy = *set;
+	labelset_detach(set);
+    }
+
+    if ((hp = __pmOAHashSearch(inst, &dp->insts)) != NULL) {
+	ip = (labelcache_inst_t *)hp->data;
+	ip->pass = dp->pass;
+	if (ip->set == NULL && copy == NULL)
+	    return 0;
+	if (ip->set && copy && __pmEqualLabelSet(ip->set, copy)) {
+	    pmFreeLabelSets(copy, 1);
+	    return 0;
+	}
+	if (ip->set)
+	    pmFreeLabelSets(ip->set, 1);
+    }
+    else {
+	if ((ip = (labelcache_inst_t *)malloc(sizeof(*ip))) == NULL) {
+	    sts = -oserror();
+	    if (copy)
+		pmFreeLabelSets(copy, 1);
+	    return sts;
+	}
+	if ((sts = __pmOAHashAdd(inst, ip, &dp->insts)) < 0) {
+	    free(ip);
+	    if (copy)
+		pmFreeLabelSets(copy, 1);
+	    return sts;
+	}
+	ip->pass = dp->pass;
+    }
+    ip->set = copy;
+    ip->generation = generation;
+    return 1;
+}
+
+static __pmHashWalkState
+labelcache_expire_callback(const __pmOAHashNode *hp, void *cp)
+{
+    labelcache_inst_t	*ip = (labelcache_inst_t *)hp->data;
+    unsigned int	pass = *(unsigned int *)cp;
+
+    if (ip->pass == pass)
+	return PM_HASH_WALK_NEXT;
+    return labelcache_inst_free_callback(hp, NULL);
+}
+
+/*
+ * Bring the cached labels for indom up to date with its current list of
+ * instances.  Only instances not already cached are requested, in one
+ * pmGetInstancesLabelsList call, and cached instances absent from the
+ * list are dropped.  With numinst < 0 the labels of all instances are
+ * requested and compared with those cached.
+ *
+ * Returns the (possibly advanced) indom generation, else an error code.
+ */
+int
+__pmLabelCacheUpdate(__pmLabelCache *cache, pmInDom indom, int numinst, int *instlist)
+{
+    labelcache_indom_t	*dp;
+    pmLabelSet		*sets = NULL;
+    int			*missing = NULL;
+    int			i, sts, nsets = 0, nmissing = 0;
+    int			generation, changed = 0;
+
+    if ((dp = labelcache_indom(cache, indom)) == NULL) {
+	if ((dp = (labelcache_indom_t *)calloc(1, sizeof(*dp))) == NULL)
+	    return -oserror();
+	__pmOAHashInit(&dp->insts);
+	if ((sts = __pmHashAdd(indom, dp, &cache->indoms)) < 0) {
+	    free(dp);
+	    return sts;
+	}
+    }
+    generation = dp->generation + 1;
+    dp->pass++;
+
+    if (numinst < 0) {
+	if ((sts = nsets = pmGetInstancesLabels(indom, &sets)) < 0)
+	    return sts;
+	for (i = 0; i < nsets; i++) {
+	    if ((sts = labelcache_store(dp, sets[i].inst, &sets[i], generation)) < 0)
+		goto done;
+	    changed |= sts;
+	}
+    }
+    else {
+	for (i = 0; i < numinst; i++) {
+	    __pmOAHashNode	*hp;
+
+	    if ((hp = __pmOAHashSearch(instlist[i], &dp->insts)) != NULL) {
+		((labelcache_inst_t *)hp->data)->pass = dp->pass;
+		continue;
+	    }
+	    if (missing == NULL &&
+		(missing = (int *)malloc((numinst - i) * sizeof(int))) == NULL) {
+		sts = -oserror();
+		goto done;
+	    }
+	    missing[nmissing++] = instlist[i];
+	}
+	if (nmissing > 0) {
+	    if ((sts = nsets = pmGetInstancesLabelsList(indom,
+					nmissing, missing, &sets)) < 0)
+		goto done;
+	    for (i = 0; i < nsets; i++) {
+		if ((sts = labelcache_store(dp, sets[i].inst, &sets[i], generation)) < 0)
+		    goto done;
+	    }
+	    /* remember instances without labels, to not ask again */
+	    for (i = 0; i < nmissing; i++) {
+		if (__pmOAHashSearch(missing[i], &dp->insts) != NULL)
+		    continue;
+		if ((sts = labelcache_store(dp, missing[i], NULL, generation)) < 0)
+		    goto done;
+	    }
+	    changed = 1;
+	}
+    }
+
+    /* everything seen in this pass is cached, so any extras are stale */
+    if (dp->insts.nodes > (numinst < 0 ? nsets : numinst)) {
+	__pmOAHashWalkCB(labelcache_expire_callback, &dp->pass, &dp->insts);
+	changed = 1;
+    }
+    sts = 0;
+
+done:
+    if (changed)
+	dp->generation = generation;
+    if (sets)
+	pmFreeLabelSets(sets, nsets);
+    if (missing)
+	free(missing);
+    return sts < 0 ? sts : dp->generation;
+}
+
+/*
+ * Current generation of the cached labels for indom, zero if none.
+ */
+int
+__pmLabelCacheGeneration(__pmLabelCache *cache, pmInDom indom)
+{
+    labelcache_indom_t	*dp;
+
+    if ((dp = labelcache_indom(cache, indom)) == NULL)
+	return 0;
+    return dp->generation;
+}
+
+/*
+ * Cached labels for one instance, without copying - *set is NULL when
+ * the instance has no labels.  Returns the generation in which these
+ * labels last changed, else PM_ERR_INST if the instance is not cached.
+ */
+int
+__pmLabelCacheLookup(__pmLabelCache *cache, pmInDom indom, int inst,
+			pmLabelSet **set)
+{
+    labelcache_indom_t	*dp;
+    labelcache_inst_t	*ip;
+    __pmOAHashNode	*hp;
+
+    *set = NULL;
+    if ((dp = labelcache_indom(cache, indom)) == NULL ||
+	(hp = __pmOAHashSearch(inst, &dp->insts)) == NULL)
+	return PM_ERR_INST;
+    ip = (labelcache_inst_t *)hp->data;
+    *set = ip->set;
+    return ip->generation;
+}
+
+static int
+labelsetcmp(const void *a, const void *b)
+{
+    const pmLabelSet	*la = (const pmLabelSet *)a;
+    const pmLabelSet	*lb = (const pmLabelSet *)b;
+
+    return (la->inst > lb->inst) - (la->inst < lb->inst);
+}
+
+/*
+ * Copy of all cached instance labelsets for indom, in instance order,
+ * suitable for pmFreeLabelSets(3).  Returns the number of labelsets.
+ */
+int
+__pmLabelCacheGetSets(__pmLabelCache *cache, pmInDom indom, pmLabelSet **sets)
+{
+    labelcache_indom_t	*dp;
+    labelcache_inst_t	*ip;
+    __pmOAHashNode	*hp;
+    pmLabelSet		*list, *dup;
+    int			n = 0;
+
+    *sets = NULL;
+    if ((dp = labelcache_indom(cache, indom)) == NULL || dp->insts.nodes == 0)
+	return 0;
+    if ((list = (pmLabelSet *)calloc(dp->insts.nodes, sizeof(pmLabelSet))) == NULL)
+	return -oserror();
+    for (hp = __pmOAHashWalk(&dp->insts, PM_HASH_WALK_START);
+	 hp != NULL;
+	 hp = __pmOAHashWalk(&dp->insts, PM_HASH_WALK_NEXT)) {
+	ip = (labelcache_inst_t *)hp->data;
+	if (ip->set == NULL)
+	    continue;
+	if ((dup = __pmDupLabelSets(ip->set, 1)) == NULL) {
+	    pmFreeLabelSets(list, n);
+	    return -ENOMEM;
+	}
+	list[n++] = *dup;
+	free(dup);
+    }
+    if (n == 0) {
+	free(list);
+	return 0;
+    }
+    qsort(list, n, sizeof(pmLabelSet), labelsetcmp);
+    *sets = list;
+    return n;
+}
+
 void
 pmPrintLabelSets(FILE *fp, int ident, int type, pmLabelSet *sets, int nsets)
 {
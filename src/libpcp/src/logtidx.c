@@ -0,0 +1,683 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+/*
+ * Dense temporal index for archives - the optional <archive>.tidx file.
+ *
+ * Unlike the .index file (one entry per volume switch, flush or so many
+ * records), there is one fixed size entry for every data record, giving
+ * the timestamp, volume and offset of the start of the record.  Entries
+ * are in time order, so __pmLogSetTime() can binary search directly to
+ * the record it needs rather than reading forwards from the nearest
+ * .index entry.  The file is memory mapped when the archive is opened
+ * and all fields are in network byte order.
+ *
+ * pmlogger -i writes the entries as each record is written, and
+ * pmlogindex(1) (re)builds the file after the fact.  A rebuilt file also
+ * has a presence section appended: the distinct sets of PMIDs that appear
+ * together in records, a PMID bitmap for each set, and for each set the
+ * (ascending) list of entries with that set.  This allows the next or
+ * previous record containing a given PMID to be found with one binary
+ * search per set containing that PMID.
+ *
+ * Layout:
+ *	tidx_hdr_t
+ *	tidx_ent_t [nentry]
+ *	presence section (optional, 32-bit words):
+ *	    pmid[npmid]			ascending
+ *	    setmap[nset][(npmid+31)/32]	bit i set => pmid[i] in set
+ *	    setstart[nset+1]		index into setlist[] for each set
+ *	    setlist[nentry]		entries, grouped by set
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "internal.h"
+#include <sys/stat.h>
+
+#define TIDX_MAGIC	0x50544958	/* "PTIX" */
+#define TIDX_VERSION	1
+#define TIDX_NOSET	0xffffffff
+
+typedef struct {
+    __uint32_t	magic;
+    __uint32_t	version;
+    __int32_t	start[3];	/* archive label start timestamp */
+    __int32_t	pid;		/* archive label pid */
+    __uint32_t	nentry;		/* entries, 0 if still being appended */
+    __uint32_t	npmid;		/* PMIDs in presence section */
+    __uint32_t	nset;		/* distinct sets of PMIDs */
+    __int32_t	presence[2];	/* offset to presence section, or 0 */
+    __uint32_t	pad[5];
+} tidx_hdr_t;
+
+typedef struct {
+    __int32_t	stamp[3];	/* record timestamp */
+    __int32_t	vol;		/* data volume */
+    __int32_t	off[2];		/* offset of start of record in vol */
+    __uint32_t	set;		/* set of PMIDs, or TIDX_NOSET */
+    __uint32_t	pad;
+} tidx_ent_t;
+
+struct __pmLogTIdx {
+    void		*addr;		/* mapping */
+    size_t		len;
+    int			nentry;
+    const tidx_ent_t	*ent;
+    int			npmid;
+    int			nset;
+    int			words;		/* per set bitmap */
+    const __uint32_t	*pmid;
+    const __uint32_t	*setmap;
+    const __uint32_t	*setstart;
+    const __uint32_t	*setlist;
+};
+
+static char *
+tidx_name(const char *base, char *buf, size_t buflen)
+{
+    pmsprintf(buf, buflen, "%s.tidx", base);
+    return buf;
+}
+
+static void
+tidx_entry(const tidx_ent_t *ep, __pmLogTIdxEntry *tp)
+{
+    __int32_t		off[2];
+    __pmoff64_t		off64;
+
+    __pmLoadTimestamp(ep->stamp, &tp->stamp);
+    tp->vol = ntohl(ep->vol);
+    off[0] = ep->off[0];
+    off[1] = ep->off[1];
+    __ntohll((char *)off);
+    memcpy(&off64, off, sizeof(off64));
+    tp->off = (off_t)off64;
+}
+
+static int
+tidx_cmp(const tidx_ent_t *ep, const __pmTimestamp *tsp)
+{
+    __pmTimestamp	stamp;
+
+    __pmLoadTimestamp(ep->stamp, &stamp);
+    if (stamp.sec != tsp->sec)
+	return stamp.sec < tsp->sec ? -1 : 1;
+    if (stamp.nsec != tsp->nsec)
+	return stamp.nsec < tsp->nsec ? -1 : 1;
+    return 0;
+}
+
+/*
+ * Map <archive>.tidx if it exists and belongs to this archive.
+ * A missing or unusable dense index is not an error, the archive
+ * is simply accessed without it.
+ */
+int
+__pmLogTIdxLoad(__pmLogCtl *lcp)
+{
+    struct __pmLogTIdx	*tip;
+    const tidx_hdr_t	*hp;
+    __pmTimestamp	start;
+    struct stat		sbuf;
+    char		path[MAXPATHLEN];
+    size_t		need;
+    __int32_t		pres[2];
+    __pmoff64_t		presence;
+    void		*addr;
+    int			fd;
+
+    lcp->tidx = NULL;
+    if (lcp->name == NULL)
+	return 0;
+    tidx_name(lcp->name, path, sizeof(path));
+    if ((fd = open(path, O_RDONLY)) < 0)
+	return 0;
+    if (fstat(fd, &sbuf) < 0 || sbuf.st_size < (off_t)sizeof(tidx_hdr_t)) {
+	close(fd);
+	return 0;
+    }
+    addr = __pmMemoryMap(fd, sbuf.st_size, 0);
+    close(fd);
+    if (addr == NULL)
+	return 0;
+
+    hp = (const tidx_hdr_t *)addr;
+    __pmLoadTimestamp(hp->start, &start);
+    if (ntohl(hp->magic) != TIDX_MAGIC || ntohl(hp->version) != TIDX_VERSION ||
+	(int)ntohl(hp->pid) != lcp->label.pid ||
+	start.sec != lcp->label.start.sec ||
+	start.nsec != lcp->label.start.nsec) {
+	if (pmDebugOptions.log)
+	    fprintf(stderr, "__pmLogTIdxLoad: %s: not for this archive, ignored\n", path);
+	goto fail;
+    }
+
+    if ((tip = (struct __pmLogTIdx *)calloc(1, sizeof(*tip))) == NULL)
+	goto fail;
+    tip->addr = addr;
+    tip->len = sbuf.st_size;
+    tip->ent = (const tidx_ent_t *)&hp[1];
+    pres[0] = hp->presence[0];
+    pres[1] = hp->presence[1];
+    __ntohll((char *)pres);
+    memcpy(&presence, pres, sizeof(presence));
+    if (presence == 0) {
+	/* entries only, possibly still being appended by pmlogger */
+	tip->nentry = (sbuf.st_size - sizeof(tidx_hdr_t)) / sizeof(tidx_ent_t);
+    }
+    else {
+	tip->nentry = ntohl(hp->nentry);
+	tip->npmid = ntohl(hp->npmid);
+	tip->nset = ntohl(hp->nset);
+	tip->words = (tip->npmid + 31) / 32;
+	need = presence + sizeof(__uint32_t) * ((size_t)tip->npmid +
+		(size_t)tip->nset * tip->words + tip->nset + 1 + tip->nentry);
+	if (presence < sizeof(tidx_hdr_t) + (size_t)tip->nentry * sizeof(tidx_ent_t) ||
+	    need > (size_t)sbuf.st_size) {
+	    if (pmDebugOptions.log)
+		fprintf(stderr, "__pmLogTIdxLoad: %s: truncated, ignored\n", path);
+	    free(tip);
+	    goto fail;
+	}
+	tip->pmid = (const __uint32_t *)((const char *)addr + presence);
+	tip->setmap = tip->pmid + tip->npmid;
+	tip->setstart = tip->setmap + tip->nset * tip->words;
+	tip->setlist = tip->setstart + tip->nset + 1;
+    }
+    if (pmDebugOptions.log)
+	fprintf(stderr, "__pmLogTIdxLoad: %s: %d entries, %d PMIDs, %d sets\n",
+		path, tip->nentry, tip->npmid, tip->nset);
+    lcp->tidx = tip;
+    return 0;
+
+fail:
+    __pmMemoryUnmap(addr, sbuf.st_size);
+    return 0;
+}
+
+void
+__pmLogTIdxFree(__pmLogCtl *lcp)
+{
+    struct __pmLogTIdx	*tip = lcp->tidx;
+
+    if (tip != NULL) {
+	__pmMemoryUnmap(tip->addr, tip->len);
+	free(tip);
+	lcp->tidx = NULL;
+    }
+}
+
+/*
+ * Number of dense index entries, 0 if there is no dense index.
+ */
+int
+__pmLogTIdxCount(const __pmLogCtl *lcp)
+{
+    return lcp->tidx ? lcp->tidx->nentry : 0;
+}
+
+int
+__pmLogTIdxGet(const __pmLogCtl *lcp, int i, __pmLogTIdxEntry *tp)
+{
+    if (lcp->tidx == NULL || i < 0 || i >= lcp->tidx->nentry)
+	return PM_ERR_EOL;
+    tidx_entry(&lcp->tidx->ent[i], tp);
+    return 0;
+}
+
+/*
+ * For PM_MODE_FORW, return the first entry at or after *tsp (or the
+ * number of entries if there is none).  For PM_MODE_BACK, return the
+ * last entry at or before *tsp (or -1 if there is none).
+ */
+int
+__pmLogTIdxSearch(const __pmLogCtl *lcp, const __pmTimestamp *tsp, int mode)
+{
+    const tidx_ent_t	*ent;
+    int			lo = 0, hi, mid;
+
+    if (lcp->tidx == NULL)
+	return mode == PM_MODE_BACK ? -1 : 0;
+    ent = lcp->tidx->ent;
+    hi = lcp->tidx->nentry;
+    while (lo < hi) {
+	mid = lo + (hi - lo) / 2;
+	if (mode == PM_MODE_BACK ? tidx_cmp(&ent[mid], tsp) <= 0 :
+				   tidx_cmp(&ent[mid], tsp) < 0)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return mode == PM_MODE_BACK ? lo - 1 : lo;
+}
+
+/*
+ * Find the next (PM_MODE_FORW) entry at or after from, or previous
+ * (PM_MODE_BACK) entry at or before from, of a record containing pmid,
+ * or of a <mark> record (no PMIDs at all) if pmid is PM_ID_NULL.
+ * Returns the entry, PM_ERR_EOL if there is no such record, or -ENOENT
+ * if there is no dense index with a presence section.
+ */
+int
+__pmLogTIdxFindPMID(const __pmLogCtl *lcp, pmID pmid, int from, int mode)
+{
+    const struct __pmLogTIdx	*tip = lcp->tidx;
+    const __uint32_t		*list;
+    int				lo, hi, mid, n;
+    int				bit = -1, set;
+    int				best = -1;
+
+    if (tip == NULL || tip->pmid == NULL)
+	return -ENOENT;
+
+    if (pmid != PM_ID_NULL) {
+	/* PMID to bit number */
+	lo = 0;
+	hi = tip->npmid;
+	while (lo < hi) {
+	    mid = lo + (hi - lo) / 2;
+	    if (ntohl(tip->pmid[mid]) < pmid)
+		lo = mid + 1;
+	    else
+		hi = mid;
+	}
+	if (lo == tip->npmid || ntohl(tip->pmid[lo]) != pmid)
+	    return PM_ERR_EOL;
+	bit = lo;
+    }
+
+    for (set = 0; set < tip->nset; set++) {
+	if (bit < 0) {
+	    /* <mark> records, the set with no PMIDs */
+	    for (n = 0; n < tip->words; n++) {
+		if (tip->setmap[set * tip->words + n] != 0)
+		    break;
+	    }
+	    if (n < tip->words)
+		continue;
+	}
+	else if ((ntohl(tip->setmap[set * tip->words + bit / 32]) & (1U << (bit % 32))) == 0)
+	    continue;
+	list = &tip->setlist[ntohl(tip->setstart[set])];
+	n = ntohl(tip->setstart[set+1]) - ntohl(tip->setstart[set]);
+	/* first entry in this set >= from (FORW), or > from (BACK) */
+	lo = 0;
+	hi = n;
+	while (lo < hi) {
+	    mid = lo + (hi - lo) / 2;
+	    if (mode == PM_MODE_BACK ? (int)ntohl(list[mid]) <= from :
+				       (int)ntohl(list[mid]) < from)
+		lo = mid + 1;
+	    else
+		hi = mid;
+	}
+	if (mode == PM_MODE_BACK) {
+	    if (lo > 0 && (best < 0 || (int)ntohl(list[lo-1]) > best))
+		best = ntohl(list[lo-1]);
+	}
+	else {
+	    if (lo < n && (best < 0 || (int)ntohl(list[lo]) < best))
+		best = ntohl(list[lo]);
+	}
+    }
+    return best >= 0 ? best : PM_ERR_EOL;
+}
+
+static void
+tidx_puthdr(tidx_hdr_t *hp, const __pmLogLabel *lp, int nentry,
+	    int npmid, int nset, __pmoff64_t presence)
+{
+    __int32_t		pres[2];
+
+    memset(hp, 0, sizeof(*hp));
+    hp->magic = htonl(TIDX_MAGIC);
+    hp->version = htonl(TIDX_VERSION);
+    __pmPutTimestamp(&lp->start, hp->start);
+    hp->pid = htonl(lp->pid);
+    hp->nentry = htonl(nentry);
+    hp->npmid = htonl(npmid);
+    hp->nset = htonl(nset);
+    memcpy(pres, &presence, sizeof(pres));
+    __htonll((char *)pres);
+    hp->presence[0] = pres[0];
+    hp->presence[1] = pres[1];
+}
+
+static void
+tidx_putent(tidx_ent_t *ep, const __pmTimestamp *tsp, int vol, off_t off,
+	    __uint32_t set)
+{
+    __pmoff64_t		off64 = off;
+    __int32_t		tmp[2];
+
+    memset(ep, 0, sizeof(*ep));
+    __pmPutTimestamp(tsp, ep->stamp);
+    ep->vol = htonl(vol);
+    memcpy(tmp, &off64, sizeof(tmp));
+    __htonll((char *)tmp);
+    ep->off[0] = tmp[0];
+    ep->off[1] = tmp[1];
+    ep->set = htonl(set);
+}
+
+/*
+ * Start writing a dense temporal index alongside a new archive, after
+ * __pmLogCreate().  Entries are added as each record is written by
+ * __pmLogPutResult*().
+ */
+int
+__pmLogTIdxCreate(__pmArchCtl *acp, const char *base)
+{
+    __pmLogCtl	*lcp = acp->ac_log;
+    char	path[MAXPATHLEN];
+    int		sts;
+
+    tidx_name(base, path, sizeof(path));
+    if ((lcp->tidxfp = __pmFopen(path, "w")) == NULL) {
+	sts = -oserror();
+	pmNotifyErr(LOG_WARNING, "__pmLogTIdxCreate: cannot create \"%s\": %s\n",
+			path, pmErrStr(sts));
+	return sts;
+    }
+    /* one fwrite per entry, as for the other archive files */
+    __pmSetvbuf(lcp->tidxfp, NULL, _IONBF, 0);
+    return 0;
+}
+
+/*
+ * Called from __pmLogPutResult*() with the position of the record
+ * about to be written.
+ */
+int
+__pmLogPutTIdx(__pmArchCtl *acp, const __pmTimestamp *tsp, off_t off)
+{
+    __pmLogCtl	*lcp = acp->ac_log;
+    tidx_hdr_t	hdr;
+    tidx_ent_t	ent;
+
+    if (__pmFtell(lcp->tidxfp) == 0) {
+	tidx_puthdr(&hdr, &lcp->label, 0, 0, 0, 0);
+	if (__pmFwrite(&hdr, 1, sizeof(hdr), lcp->tidxfp) != sizeof(hdr))
+	    goto fail;
+    }
+    tidx_putent(&ent, tsp, acp->ac_curvol, off, TIDX_NOSET);
+    if (__pmFwrite(&ent, 1, sizeof(ent), lcp->tidxfp) != sizeof(ent))
+	goto fail;
+    return 0;
+
+fail:
+    /* stop indexing, a partial index is dropped at the next open */
+    pmNotifyErr(LOG_ERR, "__pmLogPutTIdx: write failed: %s\n", osstrerror());
+    __pmFclose(lcp->tidxfp);
+    lcp->tidxfp = NULL;
+    return -oserror();
+}
+
+/*
+ * Build support - distinct PMID sets seen in records.
+ */
+typedef struct {
+    int		npmid;
+    pmID	*pmids;		/* ascending */
+    int		nent;		/* entries with this set */
+} tidx_set_t;
+
+static int
+pmid_cmp(const void *a, const void *b)
+{
+    pmID	pa = *(const pmID *)a;
+    pmID	pb = *(const pmID *)b;
+
+    return pa < pb ? -1 : (pa > pb ? 1 : 0);
+}
+
+static unsigned int
+set_hash(const pmID *pmids, int n)
+{
+    unsigned int	h = 2166136261U;	/* FNV-1a */
+    int			i;
+
+    for (i = 0; i < n; i++) {
+	h ^= pmids[i];
+	h *= 16777619U;
+    }
+    return h;
+}
+
+/*
+ * (Re)build <archive>.tidx by reading every data record of the
+ * archive, including the presence section.  The file is written to
+ * a temporary name and renamed into place.
+ */
+int
+__pmLogTIdxBuild(__pmArchCtl *acp)
+{
+    __pmLogCtl		*lcp = acp->ac_log;
+    __pmResult		*rp;
+    __pmHashCtl		sethash;
+    __pmHashNode	*hp;
+    tidx_set_t		*sets = NULL, *sp;
+    __uint32_t		*entset = NULL;
+    tidx_ent_t		*ents = NULL;
+    pmID		*pmids = NULL, *allpmids = NULL;
+    __uint32_t		*words = NULL;
+    int			nents = 0, maxents = 0;
+    int			nsets = 0, maxsets = 0;
+    int			maxpmids = 0, nall = 0;
+    int			i, j, k, n, vol, nwords;
+    int			sts;
+    unsigned int	key;
+    off_t		off;
+    __pmoff64_t		presence;
+    tidx_hdr_t		hdr;
+    FILE		*fp = NULL;
+    char		path[MAXPATHLEN];
+    char		tmppath[MAXPATHLEN];
+
+    __pmHashInit(&sethash);
+
+    for (vol = lcp->minvol; vol <= lcp->maxvol; vol++) {
+	if (__pmLogChangeVol(acp, vol) >= 0)
+	    break;
+    }
+    if (vol > lcp->maxvol)
+	return PM_ERR_LOGFILE;
+    __pmFseek(acp->ac_mfp, (long)__pmLogLabelSize(lcp), SEEK_SET);
+
+    for ( ; ; ) {
+	vol = acp->ac_curvol;
+	off = __pmFtell(acp->ac_mfp);
+	if ((sts = __pmLogRead(acp, PM_MODE_FORW, NULL, &rp, PMLOGREAD_NEXT)) < 0)
+	    break;
+	if (acp->ac_curvol != vol) {
+	    /* moved to the next volume, record follows its label */
+	    vol = acp->ac_curvol;
+	    off = __pmLogLabelSize(lcp);
+	}
+
+	/* canonical (sorted) set of PMIDs in this record */
+	if (rp->numpmid > maxpmids) {
+	    maxpmids = rp->numpmid;
+	    if ((pmids = (pmID *)realloc(pmids, maxpmids * sizeof(pmID))) == NULL)
+		goto nomem;
+	}
+	for (i = 0; i < rp->numpmid; i++)
+	    pmids[i] = rp->vset[i]->pmid;
+	qsort(pmids, rp->numpmid, sizeof(pmID), pmid_cmp);
+	for (i = n = 0; i < rp->numpmid; i++) {
+	    if (n == 0 || pmids[n-1] != pmids[i])
+		pmids[n++] = pmids[i];
+	}
+
+	key = set_hash(pmids, n);
+	for (hp = __pmHashSearch(key, &sethash); hp != NULL; hp = hp->next) {
+	    if (hp->key != key)
+		continue;
+	    sp = &sets[(__psint_t)hp->data];
+	    if (sp->npmid == n && memcmp(sp->pmids, pmids, n * sizeof(pmID)) == 0)
+		break;
+	}
+	if (hp == NULL) {
+	    if (nsets == maxsets) {
+		maxsets = maxsets ? maxsets * 2 : 16;
+		if ((sp = (tidx_set_t *)realloc(sets, maxsets * sizeof(*sp))) == NULL)
+		    goto nomem;
+		sets = sp;
+	    }
+	    sp = &sets[nsets];
+	    sp->npmid = n;
+	    sp->nent = 0;
+	    if ((sp->pmids = (pmID *)malloc((n ? n : 1) * sizeof(pmID))) == NULL)
+		goto nomem;
+	    memcpy(sp->pmids, pmids, n * sizeof(pmID));
+	    if (__pmHashAdd(key, (void *)(__psint_t)nsets, &sethash) < 0)
+		goto nomem;
+	    j = nsets++;
+	}
+	else
+	    j = (int)(__psint_t)hp->data;
+
+	if (nents == maxents) {
+	    maxents = maxents ? maxents * 2 : 1024;
+	    if ((ents = (tidx_ent_t *)realloc(ents, maxents * sizeof(*ents))) == NULL)
+		goto nomem;
+	    if ((entset = (__uint32_t *)realloc(entset, maxents * sizeof(*entset))) == NULL)
+		goto nomem;
+	}
+	tidx_putent(&ents[nents], &rp->timestamp, vol, off, j);
+	entset[nents++] = j;
+	sets[j].nent++;
+	__pmFreeResult(rp);
+    }
+    if (sts != PM_ERR_EOL)
+	goto done;
+
+    /* all distinct PMIDs, ascending */
+    for (j = n = 0; j < nsets; j++)
+	n += sets[j].npmid;
+    if ((allpmids = (pmID *)malloc((n ? n : 1) * sizeof(pmID))) == NULL)
+	goto nomem;
+    for (j = n = 0; j < nsets; j++) {
+	memcpy(&allpmids[n], sets[j].pmids, sets[j].npmid * sizeof(pmID));
+	n += sets[j].npmid;
+    }
+    qsort(allpmids, n, sizeof(pmID), pmid_cmp);
+    for (i = nall = 0; i < n; i++) {
+	if (nall == 0 || allpmids[nall-1] != allpmids[i])
+	    allpmids[nall++] = allpmids[i];
+    }
+    nwords = (nall + 31) / 32;
+
+    tidx_name(lcp->name, path, sizeof(path));
+    pmsprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+    if ((fp = fopen(tmppath, "w")) == NULL) {
+	sts = -oserror();
+	goto done;
+    }
+    presence = sizeof(hdr) + (__pmoff64_t)nents * sizeof(tidx_ent_t);
+    tidx_puthdr(&hdr, &lcp->label, nents, nall, nsets, presence);
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	(nents && fwrite(ents, sizeof(tidx_ent_t), nents, fp) != nents))
+	goto werr;
+
+    /* pmid[] */
+    for (i = 0; i < nall; i++) {
+	key = htonl(allpmids[i]);
+	if (fwrite(&key, sizeof(key), 1, fp) != 1)
+	    goto werr;
+    }
+    /* setmap[][] */
+    if ((words = (__uint32_t *)calloc(nwords ? nwords : 1, sizeof(*words))) == NULL)
+	goto nomem;
+    for (j = 0; j < nsets; j++) {
+	memset(words, 0, nwords * sizeof(*words));
+	for (k = 0; k < sets[j].npmid; k++) {
+	    pmID	*bp = bsearch(&sets[j].pmids[k], allpmids, nall,
+				      sizeof(pmID), pmid_cmp);
+	    i = bp - allpmids;
+	    words[i / 32] |= 1U << (i % 32);
+	}
+	for (k = 0; k < nwords; k++)
+	    words[k] = htonl(words[k]);
+	if (nwords && fwrite(words, sizeof(*words), nwords, fp) != nwords)
+	    goto werr;
+    }
+    /* setstart[] */
+    for (j = n = 0; j <= nsets; j++) {
+	key = htonl(n);
+	if (fwrite(&key, sizeof(key), 1, fp) != 1)
+	    goto werr;
+	if (j < nsets) {
+	    k = sets[j].nent;
+	    sets[j].nent = n;	/* now the next free slot in setlist[] */
+	    n += k;
+	}
+    }
+    /* setlist[], entries are visited in order so each list ascends */
+    if (nents) {
+	__uint32_t	*list;
+
+	if ((list = (__uint32_t *)malloc(nents * sizeof(*list))) == NULL)
+	    goto nomem;
+	for (i = 0; i < nents; i++)
+	    list[sets[entset[i]].nent++] = htonl(i);
+	n = fwrite(list, sizeof(*list), nents, fp);
+	free(list);
+	if (n != nents)
+	    goto werr;
+    }
+    if (fclose(fp) != 0) {
+	fp = NULL;
+	goto werr;
+    }
+    fp = NULL;
+    if (rename(tmppath, path) < 0) {
+	sts = -oserror();
+	unlink(tmppath);
+	goto done;
+    }
+    if (pmDebugOptions.log)
+	fprintf(stderr, "__pmLogTIdxBuild: %s: %d entries, %d PMIDs, %d sets\n",
+		path, nents, nall, nsets);
+    sts = nents;
+    goto done;
+
+werr:
+    sts = oserror() ? -oserror() : -EIO;
+    if (fp != NULL)
+	fclose(fp);
+    fp = NULL;
+    unlink(tmppath);
+    goto done;
+
+nomem:
+    sts = -ENOMEM;
+    if (fp != NULL) {
+	fclose(fp);
+	unlink(tmppath);
+    }
+
+done:
+    for (j = 0; j < nsets; j++)
+	free(sets[j].pmids);
+    free(sets);
+    free(ents);
+    free(entset);
+    free(pmids);
+    free(allpmids);
+    free(words);
+    __pmHashFree(&sethash);
+    return sts;
+}
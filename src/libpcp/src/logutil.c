@@ -302,7 +302,8 @@ __pmLogCreate(const char *host, const char *base, int log_version,
     lcp->trimindom.nodes = lcp->trimindom.hsize = 0;
     lcp->hashlabels.nodes = lcp->hashlabels.hsize = 0;
     lcp->hashtext.nodes = lcp->hashtext.hsize = 0;
-    lcp->tifp = lcp->mdfp = acp->ac_mfp = NULL;
+    lcp->tifp = lcp->mdfp = acp->ac_mfp = lcp->tidxfp = NULL;
+    lcp->tidx = NULL;
 
     if ((lcp->tifp = __pmLogNewFile(base, PM_LOG_VOL_TI)) != NULL) {
 	if ((lcp->mdfp = __pmLogNewFile(base, PM_LOG_VOL_META)) != NULL) {
@@ -422,9 +423,8 @@ logFreeTrimInDom(__pmHashCtl *hcp)
 {
     __pmHashNode	*hp;
     __pmHashNode	*prior_hp;
-    __pmHashCtl		*icp;
-    __pmHashNode	*ip;
-    __pmHashNode	*prior_ip;
+    __pmOAHashCtl	*icp;
+    __pmOAHashNode	*ip;
     __pmLogTrimInDom	*indomp;
     int			h;
     int			i;
@@ -436,17 +436,11 @@ logFreeTrimInDom(__pmHashCtl *hcp)
 	    icp = &indomp->hashinst;
 	    /* loop over all instances for this indom */
 	    for (i = 0; i < icp->hsize; i++) {
-		for (ip = icp->hash[i], prior_ip = NULL; ip != NULL; ip = ip->next) {
+		ip = &icp->hash[i];
+		if (ip->dist != 0)
 		    free((__pmLogTrimInst *)ip->data);
-		    if (prior_ip != NULL)
-			free(prior_ip);
-		    prior_ip = ip;
-		}
-		if (prior_ip != NULL)
-		    free(prior_ip);
 	    }
-	    if (icp->hsize > 0)
-		free(icp->hash);
+	    __pmOAHashFree(icp);
 	    free(indomp);
 	    if (prior_hp != NULL)
 		free(prior_hp);
@@ -598,6 +592,11 @@ __pmLogClose(__pmArchCtl *acp)
 	__pmFclose(acp->ac_mfp);
 	acp->ac_mfp = NULL;
     }
+    if (lcp->tidxfp != NULL) {
+	__pmFclose(lcp->tidxfp);
+	lcp->tidxfp = NULL;
+    }
+    __pmLogTIdxFree(lcp);
     if (lcp->name != NULL) {
 	free(lcp->name);
 	lcp->name = NULL;
@@ -691,8 +690,9 @@ __pmLogFindOpen(__pmArchCtl *acp, const char *name)
     }
 
     lcp->minvol = -1;
-    lcp->tifp = lcp->mdfp = acp->ac_mfp = NULL;
+    lcp->tifp = lcp->mdfp = acp->ac_mfp = lcp->tidxfp = NULL;
     lcp->ti = NULL;
+    lcp->tidx = NULL;
     lcp->numseen = 0; lcp->seen = NULL;
 
     blen = (int)strlen(base);
@@ -935,6 +935,9 @@ __pmLogOpen(const char *name, __pmContext *ctxp)
 		sts = PM_ERR_LABEL;
 		goto cleanup;
 	}
+
+	/* optional, so any error here is not fatal */
+	__pmLogTIdxLoad(lcp);
     }
     /*
      * label is the one from the metadata file via
@@ -990,6 +993,7 @@ logputresult(int version, __pmArchCtl *acp, __pmPDU *pb)
     int			sz;
     int			sts = 0;
     int			save_from;
+    off_t		off;
 
     if (lcp->state == PM_LOG_STATE_NEW) {
 	/*
@@ -1016,6 +1020,7 @@ logputresult(int version, __pmArchCtl *acp, __pmPDU *pb)
 	fprintf(stderr, "logputresult: pdubuf=" PRINTF_P_PFX "%p input len=%d output len=%d posn=%ld\n", pb, pb[0], sz, (long)__pmFtell(acp->ac_mfp));
     }
 
+    off = __pmFtell(acp->ac_mfp);
     save_from = start[0];
     start[0] = htonl(sz);	/* swab */
 
@@ -1052,6 +1057,16 @@ logputresult(int version, __pmArchCtl *acp, __pmPDU *pb)
     /* restore and unswab */
     start[0] = save_from;
 
+    if (sts >= 0 && lcp->tidxfp != NULL) {
+	__pmTimestamp	stamp;
+
+	if (version >= 3)
+	    __pmLoadTimestamp((__int32_t *)&pb[3], &stamp);
+	else
+	    __pmLoadTimeval((__int32_t *)&pb[3], &stamp);
+	__pmLogPutTIdx(acp, &stamp, off);
+    }
+
     return sts;
 }
 
@@ -2176,6 +2191,136 @@ VolSkip(__pmArchCtl *acp, int mode, int j)
     return PM_ERR_EOL;
 }
 
+/*
+ * Check a dense temporal index entry against the data volume (already
+ * open): the record at the entry's offset must have the same timestamp
+ * and, if this is the last record of the volume (atend), must end at
+ * the end of the volume.  Returns 0 if the entry is good, 1 if the
+ * last volume is still being written and the entry cannot be checked
+ * yet, else -1 (stale entry).
+ */
+int
+__pmLogCheckTIdx(__pmArchCtl *acp, const __pmLogTIdxEntry *ep, int atend)
+{
+    __pmLogCtl		*lcp = acp->ac_log;
+    __pmFILE		*f = acp->ac_mfp;
+    __int32_t		buf[4];		/* length and timestamp */
+    __pmTimestamp	stamp;
+    struct stat		sbuf;
+    size_t		need;
+    __uint32_t		len;
+
+    need = (__pmLogVersion(lcp) >= PM_LOG_VERS03 ? 4 : 3) * sizeof(__int32_t);
+    if (__pmFstat(f, &sbuf) < 0)
+	return -1;
+    if (ep->off + (off_t)need > sbuf.st_size)
+	return ep->vol == lcp->maxvol ? 1 : -1;
+    if (__pmFseek(f, (long)ep->off, SEEK_SET) < 0 ||
+	__pmFread(buf, 1, need, f) != need) {
+	__pmClearerr(f);
+	return -1;
+    }
+    len = ntohl(buf[0]);
+    if (len < need + sizeof(__int32_t))
+	return -1;
+    if (__pmLogVersion(lcp) >= PM_LOG_VERS03)
+	__pmLoadTimestamp(&buf[1], &stamp);
+    else
+	__pmLoadTimeval(&buf[1], &stamp);
+    if (stamp.sec != ep->stamp.sec || stamp.nsec != ep->stamp.nsec)
+	return -1;
+    if (atend && ep->off + (off_t)len != sbuf.st_size) {
+	/* last volume may still be growing */
+	if (ep->vol == lcp->maxvol && ep->off + (off_t)len < sbuf.st_size)
+	    return 1;
+	return -1;
+    }
+    return 0;
+}
+
+/*
+ * Position using the dense temporal index, if there is one.  Every
+ * data record has an entry giving its start offset, so we can go
+ * straight to the first record at or after the origin (FORW) or just
+ * past the last record at or before the origin (BACK).  Returns -1
+ * if the dense index cannot be used (missing volume, truncated last
+ * volume, ...) and the caller falls back to the .index file.
+ */
+static int
+LogSetTimeTIdx(__pmContext *ctxp, int mode)
+{
+    __pmArchCtl		*acp = ctxp->c_archctl;
+    __pmLogCtl		*lcp = acp->ac_log;
+    __pmLogTIdxEntry	ent;
+    int			n = __pmLogTIdxCount(lcp);
+    int			j;
+    int			sts;
+    int			whence = SEEK_SET;
+
+    if (n == 0)
+	return -1;
+    if (mode == PM_MODE_FORW) {
+	j = __pmLogTIdxSearch(lcp, &ctxp->c_origin, PM_MODE_FORW);
+	if (j == n) {
+	    j = n - 1;
+	    whence = SEEK_END;
+	}
+	__pmLogTIdxGet(lcp, j, &ent);
+    }
+    else {
+	j = __pmLogTIdxSearch(lcp, &ctxp->c_origin, PM_MODE_BACK) + 1;
+	if (j == n) {
+	    __pmLogTIdxGet(lcp, n - 1, &ent);
+	    whence = SEEK_END;
+	}
+	else {
+	    __pmLogTIdxGet(lcp, j, &ent);
+	    if (j > 0) {
+		__pmLogTIdxEntry	prev;
+
+		/* first record of a volume, so end of the previous volume */
+		__pmLogTIdxGet(lcp, j - 1, &prev);
+		if (prev.vol != ent.vol) {
+		    ent = prev;
+		    whence = SEEK_END;
+		}
+	    }
+	}
+    }
+
+    if (ent.vol < lcp->minvol || ent.vol > lcp->maxvol ||
+	__pmLogChangeVol(acp, ent.vol) < 0)
+	return -1;
+    if ((sts = __pmLogCheckTIdx(acp, &ent, whence == SEEK_END)) > 0) {
+	/* dense index may be ahead of a truncated last volume */
+	return -1;
+    }
+    if (sts < 0) {
+	/* stale, the data volumes have been rewritten, stop using it */
+	if (pmDebugOptions.log)
+	    fprintf(stderr, " dense index tidx[%d] does not match vol %d, ignored\n",
+		    j, ent.vol);
+	__pmLogTIdxFree(lcp);
+	return -1;
+    }
+    if (whence == SEEK_END)
+	__pmFseek(acp->ac_mfp, (long)0, SEEK_END);
+    else
+	__pmFseek(acp->ac_mfp, (long)ent.off, SEEK_SET);
+    acp->ac_serial = 1;
+
+    if (pmDebugOptions.log) {
+	fprintf(stderr, " dense index ");
+	if (whence == SEEK_END)
+	    fprintf(stderr, "end of vol %d", ent.vol);
+	else {
+	    fprintf(stderr, "tidx[%d]@", j);
+	    __pmPrintTimestamp(stderr, &ent.stamp);
+	}
+    }
+    return 0;
+}
+
 int
 __pmLogSetTime(__pmContext *ctxp)
 {
@@ -2231,7 +2376,11 @@ __pmLogSetTime(__pmContext *ctxp)
     ctxp->c_origin = save_origin;
     ctxp->c_mode = save_mode;
 
-    if (lcp->numti) {
+    if (lcp->tidx != NULL && LogSetTimeTIdx(ctxp, mode) == 0) {
+	/* positioned from the dense temporal index */
+	;
+    }
+    else if (lcp->numti) {
 	/* we have a temporal index, use it! */
 	int		j = -1;
 	int		try;
@@ -25,17 +25,41 @@
 #include <assert.h>
 #include <search.h>
 #include <stdint.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+/*
+ * PDU buffers up to PDUBUF_MAXPOOL bytes are carved from a pool of
+ * power-of-two size classes.  Each size class owns whole PDUBUF_SEGSIZE
+ * segments of one contiguous, reserved address range, so any address
+ * inside a pooled buffer (not only its start) maps to the owning bufctl_t
+ * header with arithmetic alone.  That makes __pmPinPDUBuf() and
+ * __pmUnpinPDUBuf() O(1) atomic pin count operations with no lock.
+ * Released buffers go onto a small per-thread freelist first, then onto
+ * a per-class freelist - they are never returned to the system.
+ *
+ * Larger buffers (and all buffers if the pool is unavailable or disabled
+ * via PCP_PDUBUF_POOL=0 in the environment) use malloc(3) and are tracked
+ * in a tsearch(3) tree, keyed by address range, under pdubuf_lock.
+ */
+#if defined(HAVE_SYS_MMAN_H) && defined(MAP_ANONYMOUS) && \
+    defined(__GNUC__) && !defined(IS_MINGW)
+#define PDUBUF_POOL	1
+#endif
 
 typedef struct bufctl
 {
     int		bc_pincnt;
     int		bc_size;
     char	*bc_buf;
+    struct bufctl *bc_next;	/* pool freelist linkage */
     /* The actual buffer happens to follow this struct. */
 } bufctl_t;
 
 /* Protected by the pdubuf_lock mutex. */
 static void *buf_tree;
+static __uint64_t buf_tree_bytes;
 
 #ifdef PM_MULTI_THREAD
 static pthread_mutex_t	pdubuf_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -54,6 +78,266 @@ __pmIsPdubufLock(void *lock)
 }
 #endif
 
+/* hit/miss counters, updated atomically if PDUBUF_POOL is defined */
+static __uint64_t	pdubuf_hits;
+static __uint64_t	pdubuf_misses;
+
+#ifdef PDUBUF_POOL
+#define PDUBUF_MINSHIFT	9			/* smallest class, 512 bytes */
+#define PDUBUF_NCLASS	8			/* 512 bytes ... 64 Kbytes */
+#define PDUBUF_CLASSIZE(c)	((size_t)1 << (PDUBUF_MINSHIFT + (c)))
+#define PDUBUF_MAXPOOL	(PDUBUF_CLASSIZE(PDUBUF_NCLASS-1) - sizeof(bufctl_t))
+#define PDUBUF_SEGSIZE	((size_t)256 * 1024)
+#define PDUBUF_ARENA	(sizeof(void *) == 4 ? \
+			 (size_t)32 * 1024 * 1024 : (size_t)256 * 1024 * 1024)
+#define PDUBUF_MAXSEGS	(256 * 1024 * 1024 / (256 * 1024))
+#define PDUBUF_CACHE	8			/* per-thread, per-class */
+
+typedef struct {
+#ifdef PM_MULTI_THREAD
+    pthread_mutex_t	lock;
+#else
+    void		*lock;
+#endif
+    bufctl_t		*freelist;	/* released buffers */
+    char		*carve;		/* next never-used buffer ... */
+    char		*carve_end;	/* ... in the current segment */
+    unsigned int	inuse;		/* pinned buffers (atomic) */
+    unsigned int	nfree;		/* buffers on any freelist (atomic) */
+} bufclass_t;
+
+static int		pool_state;	/* 0 unknown, 1 enabled, -1 disabled */
+static bufclass_t	pool_class[PDUBUF_NCLASS];
+static char		*arena_lo;	/* reserved address range */
+static char		*arena_hi;
+static char		*arena_next;	/* next unused segment, pdubuf_lock */
+static unsigned char	seg_class[PDUBUF_MAXSEGS];	/* class + 1, 0 unused */
+
+#if defined(PM_MULTI_THREAD) && defined(HAVE___THREAD)
+#define PDUBUF_TLS	1
+typedef struct {
+    bufctl_t		*head[PDUBUF_NCLASS];
+    int			count[PDUBUF_NCLASS];
+} bufcache_t;
+
+static __thread bufcache_t	bufcache;
+static __thread int		bufcache_keyed;
+static pthread_key_t		bufcache_key;
+
+static void pool_flush(void *);
+#endif
+
+/*
+ * Called once, with pdubuf_lock held.
+ */
+static void
+pool_init(void)
+{
+    char	*env;
+    void	*p;
+    int		c;
+
+    if ((env = getenv("PCP_PDUBUF_POOL")) != NULL && strcmp(env, "0") == 0) {
+	pool_state = -1;
+	return;
+    }
+    /* reserve address space only, segments are made accessible on demand */
+    p = mmap(NULL, PDUBUF_ARENA, PROT_NONE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+	if (pmDebugOptions.pdubuf)
+	    fprintf(stderr, "pool_init: mmap(%zu) failed: %s\n",
+			PDUBUF_ARENA, osstrerror());
+	pool_state = -1;
+	return;
+    }
+    arena_lo = arena_next = (char *)p;
+    arena_hi = arena_lo + PDUBUF_ARENA;
+    for (c = 0; c < PDUBUF_NCLASS; c++) {
+#ifdef PM_MULTI_THREAD
+	pthread_mutex_init(&pool_class[c].lock, NULL);
+#endif
+    }
+#ifdef PDUBUF_TLS
+    pthread_key_create(&bufcache_key, pool_flush);
+#endif
+    pool_state = 1;
+}
+
+static inline int
+pool_enabled(void)
+{
+    if (likely(pool_state != 0))
+	return pool_state > 0;
+    PM_LOCK(pdubuf_lock);
+    if (pool_state == 0)
+	pool_init();
+    PM_UNLOCK(pdubuf_lock);
+    return pool_state > 0;
+}
+
+/*
+ * Map any address inside a pooled buffer to its header, else NULL.
+ */
+static inline bufctl_t *
+pool_lookup(const void *handle)
+{
+    const char	*p = (const char *)handle;
+    char	*seg;
+    size_t	segno, size;
+    int		c;
+
+    if (p < arena_lo || p >= arena_hi)
+	return NULL;
+    segno = (p - arena_lo) / PDUBUF_SEGSIZE;
+    if ((c = seg_class[segno]) == 0)
+	return NULL;
+    size = PDUBUF_CLASSIZE(c - 1);
+    seg = arena_lo + segno * PDUBUF_SEGSIZE;
+    return (bufctl_t *)(seg + ((p - seg) / size) * size);
+}
+
+static inline int
+pool_classof(const bufctl_t *pcp)
+{
+    return seg_class[((const char *)pcp - arena_lo) / PDUBUF_SEGSIZE] - 1;
+}
+
+/*
+ * Carve a never-used buffer for class c, with the class lock held.
+ */
+static bufctl_t *
+pool_carve(int c)
+{
+    bufclass_t	*bcp = &pool_class[c];
+    bufctl_t	*pcp;
+    char	*seg = NULL;
+    size_t	size = PDUBUF_CLASSIZE(c);
+
+    if (bcp->carve == NULL || bcp->carve + size > bcp->carve_end) {
+	PM_LOCK(pdubuf_lock);
+	if (arena_next + PDUBUF_SEGSIZE <= arena_hi) {
+	    seg = arena_next;
+	    if (mprotect(seg, PDUBUF_SEGSIZE, PROT_READ | PROT_WRITE) < 0)
+		seg = NULL;
+	    else {
+		seg_class[(seg - arena_lo) / PDUBUF_SEGSIZE] = c + 1;
+		arena_next += PDUBUF_SEGSIZE;
+	    }
+	}
+	PM_UNLOCK(pdubuf_lock);
+	if (seg == NULL)
+	    return NULL;	/* arena exhausted, caller uses malloc */
+	bcp->carve = seg;
+	bcp->carve_end = seg + PDUBUF_SEGSIZE;
+    }
+    pcp = (bufctl_t *)bcp->carve;
+    bcp->carve += size;
+    pcp->bc_size = (int)(size - sizeof(*pcp));
+    pcp->bc_buf = ((char *)pcp) + sizeof(*pcp);
+    return pcp;
+}
+
+static bufctl_t *
+pool_get(int need)
+{
+    bufclass_t	*bcp;
+    bufctl_t	*pcp;
+    int		c;
+
+    for (c = 0; c < PDUBUF_NCLASS; c++)
+	if (PDUBUF_CLASSIZE(c) - sizeof(bufctl_t) >= (size_t)need)
+	    break;
+    bcp = &pool_class[c];
+
+#ifdef PDUBUF_TLS
+    if ((pcp = bufcache.head[c]) != NULL) {
+	bufcache.head[c] = pcp->bc_next;
+	bufcache.count[c]--;
+	__sync_fetch_and_add(&pdubuf_hits, 1);
+	goto done;
+    }
+#endif
+    PM_LOCK(bcp->lock);
+    if ((pcp = bcp->freelist) != NULL) {
+	bcp->freelist = pcp->bc_next;
+	PM_UNLOCK(bcp->lock);
+	__sync_fetch_and_add(&pdubuf_hits, 1);
+	goto done;
+    }
+    pcp = pool_carve(c);
+    PM_UNLOCK(bcp->lock);
+    if (pcp == NULL)
+	/* caller falls back to malloc, and counts the miss there */
+	return NULL;
+    __sync_fetch_and_add(&pdubuf_misses, 1);
+    __sync_fetch_and_add(&bcp->inuse, 1);
+    pcp->bc_pincnt = 1;
+    pcp->bc_next = NULL;
+    return pcp;
+
+done:
+    __sync_fetch_and_sub(&bcp->nfree, 1);
+    __sync_fetch_and_add(&bcp->inuse, 1);
+    pcp->bc_pincnt = 1;
+    pcp->bc_next = NULL;
+    return pcp;
+}
+
+static void
+pool_put(bufctl_t *pcp)
+{
+    int		c = pool_classof(pcp);
+    bufclass_t	*bcp = &pool_class[c];
+
+    __sync_fetch_and_sub(&bcp->inuse, 1);
+    __sync_fetch_and_add(&bcp->nfree, 1);
+#ifdef PDUBUF_TLS
+    if (bufcache.count[c] < PDUBUF_CACHE) {
+	if (unlikely(!bufcache_keyed)) {
+	    /* arrange to flush this thread's cache when it exits */
+	    pthread_setspecific(bufcache_key, &bufcache);
+	    bufcache_keyed = 1;
+	}
+	pcp->bc_next = bufcache.head[c];
+	bufcache.head[c] = pcp;
+	bufcache.count[c]++;
+	return;
+    }
+#endif
+    PM_LOCK(bcp->lock);
+    pcp->bc_next = bcp->freelist;
+    bcp->freelist = pcp;
+    PM_UNLOCK(bcp->lock);
+}
+
+#ifdef PDUBUF_TLS
+/*
+ * Thread exit - return any per-thread cached buffers to the class lists.
+ */
+static void
+pool_flush(void *arg)
+{
+    bufcache_t	*cache = (bufcache_t *)arg;
+    bufclass_t	*bcp;
+    bufctl_t	*pcp;
+    int		c;
+
+    for (c = 0; c < PDUBUF_NCLASS; c++) {
+	bcp = &pool_class[c];
+	while ((pcp = cache->head[c]) != NULL) {
+	    cache->head[c] = pcp->bc_next;
+	    PM_LOCK(bcp->lock);
+	    pcp->bc_next = bcp->freelist;
+	    bcp->freelist = pcp;
+	    PM_UNLOCK(bcp->lock);
+	}
+	cache->count[c] = 0;
+    }
+}
+#endif
+#endif /* PDUBUF_POOL */
+
 static void
 pdubufdump1(const void *nodep, const VISIT which, const int depth)
 {
@@ -68,11 +352,20 @@ pdubufdump1(const void *nodep, const VISIT which, const int depth)
 static void
 pdubufdump(void)
 {
-    /*
-     * There is no longer a pdubuf free list, ergo no
-     * fprintf(stderr, "   free pdubuf[size]:\n");
-     */
     PM_LOCK(pdubuf_lock);
+#ifdef PDUBUF_POOL
+    if (pool_state > 0) {
+	int	c;
+
+	fprintf(stderr, "   pool pdubuf[size](inuse,free):");
+	for (c = 0; c < PDUBUF_NCLASS; c++)
+	    fprintf(stderr, " [%d](%u,%u)",
+		    (int)(PDUBUF_CLASSIZE(c) - sizeof(bufctl_t)),
+		    pool_class[c].inuse, pool_class[c].nfree);
+	fprintf(stderr, " hits=%" FMT_UINT64 " misses=%" FMT_UINT64 "\n",
+		pdubuf_hits, pdubuf_misses);
+    }
+#endif
     if (buf_tree != NULL) {
 	fprintf(stderr, "   pinned pdubuf[size](pincnt):");
 	/* THREADSAFE - no locks acquired in pdubufdump1() */
@@ -112,6 +405,12 @@ __pmFindPDUBuf(int need)
 	return NULL;
     }
 
+#ifdef PDUBUF_POOL
+    if (need <= PDUBUF_MAXPOOL && pool_enabled() &&
+	(pcp = pool_get(need)) != NULL)
+	goto done;
+#endif
+
     if ((pcp = (bufctl_t *)malloc(sizeof(*pcp) + need)) == NULL) {
 	return NULL;
     }
@@ -119,6 +418,7 @@ __pmFindPDUBuf(int need)
     pcp->bc_pincnt = 1;
     pcp->bc_size = need;
     pcp->bc_buf = ((char *)pcp) + sizeof(*pcp);
+    pcp->bc_next = NULL;
 
     PM_LOCK(pdubuf_lock);
     /* Insert the node in the tree. */
@@ -129,8 +429,18 @@ __pmFindPDUBuf(int need)
 	free(pcp);
 	return NULL;
     }
+    buf_tree_bytes += sizeof(*pcp) + need;
+#ifdef PDUBUF_POOL
+    __sync_fetch_and_add(&pdubuf_misses, 1);
+#else
+    pdubuf_misses++;
+#endif
     PM_UNLOCK(pdubuf_lock);
 
+#ifdef PDUBUF_POOL
+done:
+#endif
+
     if (unlikely(pmDebugOptions.pdubuf)) {
 	fprintf(stderr, "__pmFindPDUBuf(%d) -> " PRINTF_P_PFX "%p\n",
 		need, pcp->bc_buf);
@@ -152,6 +462,19 @@ __pmPinPDUBuf(void *handle)
      * only its bc_buf & bc_size fields need to be set, as that's
      * all that bufctl_t_compare will look at.
      */
+#ifdef PDUBUF_POOL
+    if (pool_state > 0 && (pcp = pool_lookup(handle)) != NULL) {
+	int	pincnt = __sync_add_and_fetch(&pcp->bc_pincnt, 1);
+
+	assert(pincnt > 1);
+	if (unlikely(pmDebugOptions.pdubuf))
+	    fprintf(stderr, "__pmPinPDUBuf(" PRINTF_P_PFX "%p) -> pdubuf="
+			PRINTF_P_PFX "%p, pincnt=%d\n", handle,
+		    pcp->bc_buf, pincnt);
+	return;
+    }
+#endif
+
     pcp_search.bc_buf = handle;
     pcp_search.bc_size = 1;
 
@@ -190,6 +513,26 @@ __pmUnpinPDUBuf(void *handle)
     void	*bcp;
 
     assert(((__psint_t)handle % sizeof(int)) == 0);
+
+#ifdef PDUBUF_POOL
+    if (pool_state > 0 && (pcp = pool_lookup(handle)) != NULL) {
+	int	pincnt = __sync_sub_and_fetch(&pcp->bc_pincnt, 1);
+
+	if (unlikely(pmDebugOptions.pdubuf))
+	    fprintf(stderr, "__pmUnpinPDUBuf(" PRINTF_P_PFX "%p) -> pdubuf="
+			PRINTF_P_PFX "%p, pincnt=%d\n", handle,
+		    pcp->bc_buf, pincnt);
+	if (likely(pincnt == 0))
+	    pool_put(pcp);
+	else if (unlikely(pincnt < 0)) {
+	    /* not pinned, so not really allocated ... undo */
+	    __sync_add_and_fetch(&pcp->bc_pincnt, 1);
+	    return 0;
+	}
+	return 1;
+    }
+#endif
+
     PM_LOCK(pdubuf_lock);
 
     /*
@@ -229,6 +572,7 @@ __pmUnpinPDUBuf(void *handle)
     if (likely(--pcp->bc_pincnt == 0)) {
 	/* THREADSAFE - no locks acquired in bufctl_t_compare() */
 	tdelete(pcp, &buf_tree, &bufctl_t_compare);
+	buf_tree_bytes -= sizeof(*pcp) + pcp->bc_size;
 	PM_UNLOCK(pdubuf_lock);
 	free(pcp);
     }
@@ -267,7 +611,37 @@ __pmCountPDUBuf(int need, int *alloc, int *free)
     twalk(buf_tree, &pdubufcount);
     *alloc = pdu_bufcnt;
 
-    *free = 0;			/* We don't retain freed nodes. */
+    *free = 0;			/* We don't retain freed malloc'd nodes. */
+
+#ifdef PDUBUF_POOL
+    if (pool_state > 0) {
+	int	c;
+
+	for (c = 0; c < PDUBUF_NCLASS; c++) {
+	    if (PDUBUF_CLASSIZE(c) - sizeof(bufctl_t) < (size_t)need)
+		continue;
+	    *alloc += pool_class[c].inuse;
+	    *free += pool_class[c].nfree;
+	}
+    }
+#endif
 
     PM_UNLOCK(pdubuf_lock);
 }
+
+/*
+ * PDU buffer pool statistics, for the pmcd.buf metrics.
+ */
+void
+__pmGetPDUBufStats(__pmPDUBufStats *stats)
+{
+    PM_LOCK(pdubuf_lock);
+    stats->hits = pdubuf_hits;
+    stats->misses = pdubuf_misses;
+    stats->bytes = buf_tree_bytes;
+#ifdef PDUBUF_POOL
+    if (pool_state > 0)
+	stats->bytes += arena_next - arena_lo;
+#endif
+    PM_UNLOCK(pdubuf_lock);
+}
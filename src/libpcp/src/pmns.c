@@ -69,6 +69,7 @@ static __pmnsNode *seen; /* list of pass-1 subtree nodes */
 
 /* size and last modification time for loading main_pmns file. */
 static off_t	last_size;
+static uid_t	last_uid;
 #if defined(HAVE_STAT_TIMESTRUC)
 static timestruc_t	last_mtim;
 #elif defined(HAVE_STAT_TIMESPEC)
@@ -938,6 +939,9 @@ pass2(int dupok)
     main_pmns->htab = NULL;
     main_pmns->htabsize = 0;
     main_pmns->mark_state = UNKNOWN_MARK_STATE;
+    main_pmns->image = NULL;
+    main_pmns->imagelen = 0;
+    main_pmns->nodes = NULL;
 
     /* Get the root subtree out of the seen list */
     if ((main_pmns->root = findseen("root")) == NULL) {
@@ -1054,6 +1058,9 @@ __pmNewPMNS(__pmnsTree **pmns)
     t->htab = NULL;
     t->htabsize = 0;
     t->mark_state = UNKNOWN_MARK_STATE;
+    t->image = NULL;
+    t->imagelen = 0;
+    t->nodes = NULL;
 
     *pmns = t;
     return 0;
@@ -1482,11 +1489,457 @@ pmapi_return:
     return sts;
 }
 
+/*
+ * Binary PMNS image.
+ *
+ * When the PMNS is rebuilt (pmnsmerge, pmnsdel) the tree and both hash
+ * tables are saved alongside the ASCII PMNS file in a binary image file,
+ * and loads without pmcpp use the image while the ASCII file is unchanged
+ * (same size and modification time as recorded in the image header).
+ * Loading a PMNS never writes the image, and an image is only used if
+ * it is owned by root or the owner of the ASCII file and is not group
+ * or world writable.
+ *
+ * The image is relocatable ... all references are node indices or
+ * string table offsets ... so it is mapped read-only and shared by
+ * all processes loading the same PMNS.  Only the nodes themselves are
+ * built per-process (in one allocation), as the mark bits used by
+ * pmTrimNameSpace() are stored in the node pmids.
+ *
+ * Layout: header, nodes[numnodes], pmid htab[htabsize], name
+ * nhtab[nhtabsize], then strings[strsize].  Node 0 is the root.  All
+ * values are in native byte order, an image from a host with other
+ * byte order fails the magic number check and is simply replaced.
+ */
+#define IMAGE_SUFFIX	"image"
+#define IMAGE_MAGIC	0x504d4e49	/* "PMNI" */
+#define IMAGE_VERSION	1
+#define IMAGE_NONE	0xffffffff	/* no node */
+
+typedef struct {
+    __uint32_t	magic;
+    __uint32_t	version;
+    __uint32_t	numnodes;
+    __uint32_t	htabsize;	/* pmid hash table size */
+    __uint32_t	nhtabsize;	/* full name hash table size */
+    __uint32_t	strsize;	/* bytes of strings */
+    __uint32_t	dupok;		/* dupok when the ASCII PMNS was loaded */
+    __uint32_t	pad;
+    __int64_t	size;		/* ASCII PMNS file size and ... */
+    char	mtim[32];	/* ... modification time when saved */
+} image_hdr_t;
+
+typedef struct {
+    __uint32_t	parent;
+    __uint32_t	next;
+    __uint32_t	first;
+    __uint32_t	hash;		/* next node in pmid hash chain */
+    __uint32_t	nhash;		/* next node in name hash chain */
+    __uint32_t	name;		/* string offset of last name component */
+    __uint32_t	fullname;	/* string offset of full metric name */
+    __uint32_t	pmid;
+} image_node_t;
+
+typedef struct {
+    image_node_t	*nodes;
+    __uint32_t		numnodes;
+    __uint32_t		*htab;
+    __uint32_t		htabsize;
+    __uint32_t		*nhtab;
+    __uint32_t		nhtabsize;
+    char		*strings;
+    __uint32_t		strsize;
+    __uint32_t		maxstrsize;
+} image_t;
+
+static __uint32_t
+image_hash(const char *name)
+{
+    __uint32_t	h = 2166136261U;	/* FNV-1a */
+
+    while (*name) {
+	h ^= (unsigned char)*name++;
+	h *= 16777619U;
+    }
+    return h;
+}
+
+static void
+image_path(char *path, size_t len)
+{
+    pmsprintf(path, len, "%s.%s", fname, IMAGE_SUFFIX);
+}
+
+static __uint32_t
+image_count(__pmnsNode *np)
+{
+    __uint32_t	count = 1;
+
+    for (np = np->first; np != NULL; np = np->next)
+	count += image_count(np);
+    return count;
+}
+
+static int
+image_addname(image_t *ip, __uint32_t parent, const char *name)
+{
+    __uint32_t	offset = ip->strsize;
+    size_t	plen = parent ? strlen(&ip->strings[ip->nodes[parent].fullname]) + 1 : 0;
+    size_t	need = plen + strlen(name) + 1;
+    char	*tmp_strings;
+
+    if (ip->strsize + need > ip->maxstrsize) {
+	while (ip->strsize + need > ip->maxstrsize)
+	    ip->maxstrsize = ip->maxstrsize ? 2 * ip->maxstrsize : 4096;
+	if ((tmp_strings = realloc(ip->strings, ip->maxstrsize)) == NULL)
+	    return -oserror();
+	ip->strings = tmp_strings;
+    }
+    if (plen) {
+	memcpy(&ip->strings[offset], &ip->strings[ip->nodes[parent].fullname], plen - 1);
+	ip->strings[offset + plen - 1] = '.';
+    }
+    strcpy(&ip->strings[offset + plen], name);
+    ip->strsize += need;
+    return offset;
+}
+
+/*
+ * Visit the children of np (image node self) in the same order as
+ * backlink(), so the pmid hash chains are the same as for the tree
+ * built from the ASCII PMNS.
+ */
+static int
+image_walk(image_t *ip, __pmnsNode *np, __uint32_t self)
+{
+    image_node_t	*inp;
+    __uint32_t		prev = IMAGE_NONE;
+    __uint32_t		idx, h;
+    int			offset;
+    int			sts;
+
+    for (np = np->first; np != NULL; np = np->next) {
+	idx = ip->numnodes++;
+	if ((offset = image_addname(ip, self, np->name)) < 0)
+	    return offset;
+	inp = &ip->nodes[idx];
+	inp->parent = self;
+	inp->next = inp->first = inp->hash = IMAGE_NONE;
+	inp->fullname = offset;
+	inp->name = offset + strlen(&ip->strings[offset]) - strlen(np->name);
+	inp->pmid = np->pmid;
+	if (prev == IMAGE_NONE)
+	    ip->nodes[self].first = idx;
+	else
+	    ip->nodes[prev].next = idx;
+	prev = idx;
+
+	h = image_hash(&ip->strings[offset]) % ip->nhtabsize;
+	inp->nhash = ip->nhtab[h];
+	ip->nhtab[h] = idx;
+	/* as per backlink(), which is called before the marks are cleared */
+	if ((np->pmid & PMID_MASK) != (PM_ID_NULL & PMID_MASK)) {
+	    h = np->pmid % ip->htabsize;
+	    inp->hash = ip->htab[h];
+	    ip->htab[h] = idx;
+	}
+	if ((sts = image_walk(ip, np, idx)) < 0)
+	    return sts;
+    }
+    return 0;
+}
+
+/*
+ * Save the just-loaded main_pmns as a binary image, replacing any
+ * existing image atomically.
+ */
+static int
+saveimage(int dupok)
+{
+    image_hdr_t	hdr;
+    image_t	image;
+    __uint32_t	i;
+    FILE	*fp = NULL;
+    char	path[MAXPATHLEN];
+    char	tmppath[MAXPATHLEN+32];
+    int		fd;
+    int		sts;
+
+    PM_ASSERT_IS_LOCKED(pmns_lock);
+
+    memset(&image, 0, sizeof(image));
+    image.numnodes = image_count(main_pmns->root);
+    image.htabsize = main_pmns->htabsize;
+    image.nhtabsize = image.numnodes / 2;
+    if (image.nhtabsize % 2 == 0) image.nhtabsize++;
+    if (image.nhtabsize % 3 == 0) image.nhtabsize += 2;
+    if (image.nhtabsize % 5 == 0) image.nhtabsize += 2;
+    if ((image.nodes = (image_node_t *)malloc(image.numnodes * sizeof(image_node_t))) == NULL ||
+	(image.htab = (__uint32_t *)malloc(image.htabsize * sizeof(__uint32_t))) == NULL ||
+	(image.nhtab = (__uint32_t *)malloc(image.nhtabsize * sizeof(__uint32_t))) == NULL) {
+	sts = -oserror();
+	goto done;
+    }
+    for (i = 0; i < image.htabsize; i++)
+	image.htab[i] = IMAGE_NONE;
+    for (i = 0; i < image.nhtabsize; i++)
+	image.nhtab[i] = IMAGE_NONE;
+
+    /* root node, not hashed by name */
+    image.nodes[0].parent = image.nodes[0].next = image.nodes[0].first = IMAGE_NONE;
+    image.nodes[0].hash = image.nodes[0].nhash = IMAGE_NONE;
+    image.nodes[0].pmid = main_pmns->root->pmid;
+    if ((sts = image_addname(&image, 0, main_pmns->root->name)) < 0)
+	goto done;
+    image.nodes[0].name = image.nodes[0].fullname = sts;
+    image.numnodes = 1;
+    if ((sts = image_walk(&image, main_pmns->root, 0)) < 0)
+	goto done;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = IMAGE_MAGIC;
+    hdr.version = IMAGE_VERSION;
+    hdr.numnodes = image.numnodes;
+    hdr.htabsize = image.htabsize;
+    hdr.nhtabsize = image.nhtabsize;
+    hdr.strsize = image.strsize;
+    hdr.dupok = dupok;
+    hdr.size = last_size;
+    memcpy(hdr.mtim, &last_mtim, sizeof(last_mtim));
+
+    image_path(path, sizeof(path));
+    pmsprintf(tmppath, sizeof(tmppath), "%s.%" FMT_PID, path, (pid_t)getpid());
+    unlink(tmppath);
+    if ((fd = open(tmppath, O_WRONLY|O_CREAT|O_EXCL, 0644)) < 0) {
+	sts = -oserror();
+	goto done;
+    }
+    if ((fp = fdopen(fd, "w")) == NULL) {
+	sts = -oserror();
+	close(fd);
+	unlink(tmppath);
+	goto done;
+    }
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	fwrite(image.nodes, sizeof(image_node_t), image.numnodes, fp) != image.numnodes ||
+	fwrite(image.htab, sizeof(__uint32_t), image.htabsize, fp) != image.htabsize ||
+	fwrite(image.nhtab, sizeof(__uint32_t), image.nhtabsize, fp) != image.nhtabsize ||
+	fwrite(image.strings, 1, image.strsize, fp) != image.strsize) {
+	sts = oserror() ? -oserror() : -EIO;
+	fclose(fp);
+	unlink(tmppath);
+	goto done;
+    }
+    if (fclose(fp) != 0 || rename(tmppath, path) < 0) {
+	sts = -oserror();
+	unlink(tmppath);
+	goto done;
+    }
+    sts = 0;
+
+done:
+    if (pmDebugOptions.pmns) {
+	char	errmsg[PM_MAXERRMSGLEN];
+
+	if (sts < 0)
+	    fprintf(stderr, "saveimage: %s.%s: %s\n", fname, IMAGE_SUFFIX,
+			pmErrStr_r(sts, errmsg, sizeof(errmsg)));
+	else
+	    fprintf(stderr, "saveimage: %s.%s: %u nodes\n", fname, IMAGE_SUFFIX,
+			image.numnodes);
+    }
+    free(image.nodes);
+    free(image.htab);
+    free(image.nhtab);
+    free(image.strings);
+    return sts;
+}
+
+static __pmnsNode *
+image_node(__pmnsTree *tree, __uint32_t idx)
+{
+    return idx == IMAGE_NONE ? NULL : &tree->nodes[idx];
+}
+
+/*
+ * Load main_pmns from the binary image, if there is one and it is
+ * current.  Returns 0 on success, else a negative value and the
+ * caller falls back to the ASCII PMNS.
+ */
+static int
+loadimage(int dupok)
+{
+    image_hdr_t		*hp;
+    image_node_t	*inp;
+    __uint32_t		*htab, *nhtab;
+    __pmnsTree		*tree = NULL;
+    struct stat		sbuf;
+    char		path[MAXPATHLEN];
+    char		mtim[sizeof(hp->mtim)];
+    char		*strings;
+    void		*addr = NULL;
+    size_t		len = 0;
+    __uint32_t		i;
+    int			fd;
+    int			sts = PM_ERR_PMNS;
+
+    PM_ASSERT_IS_LOCKED(pmns_lock);
+
+    image_path(path, sizeof(path));
+    if ((fd = open(path, O_RDONLY)) < 0)
+	return -oserror();
+    if (fstat(fd, &sbuf) < 0 || !S_ISREG(sbuf.st_mode) ||
+	sbuf.st_size < (off_t)sizeof(image_hdr_t)) {
+	close(fd);
+	return PM_ERR_PMNS;
+    }
+#if !defined(IS_MINGW)
+    /* only trust an image nobody but root or the PMNS owner could write */
+    if ((sbuf.st_uid != 0 && sbuf.st_uid != last_uid) ||
+	(sbuf.st_mode & (S_IWGRP|S_IWOTH)) != 0) {
+	if (pmDebugOptions.pmns)
+	    fprintf(stderr, "loadimage: %s: uid %d mode %o not trusted, load ASCII PMNS\n",
+		    path, (int)sbuf.st_uid, (unsigned int)(sbuf.st_mode & 0777));
+	close(fd);
+	return PM_ERR_PERMISSION;
+    }
+#endif
+    len = sbuf.st_size;
+    addr = __pmMemoryMap(fd, len, 0);
+    close(fd);
+    if (addr == NULL)
+	return -oserror();
+
+    /* is the image for this version, this host and the current PMNS? */
+    hp = (image_hdr_t *)addr;
+    memset(mtim, 0, sizeof(mtim));
+    memcpy(mtim, &last_mtim, sizeof(last_mtim));
+    if (hp->magic != IMAGE_MAGIC || hp->version != IMAGE_VERSION ||
+	hp->size != last_size || memcmp(hp->mtim, mtim, sizeof(mtim)) != 0 ||
+	(hp->dupok != NO_DUPS && dupok == NO_DUPS) ||
+	hp->numnodes == 0 || hp->htabsize == 0 || hp->nhtabsize == 0 ||
+	hp->strsize == 0 ||
+	len != sizeof(image_hdr_t) + (size_t)hp->numnodes * sizeof(image_node_t) +
+	       ((size_t)hp->htabsize + hp->nhtabsize) * sizeof(__uint32_t) +
+	       hp->strsize)
+	goto fail;
+    inp = (image_node_t *)&hp[1];
+    htab = (__uint32_t *)&inp[hp->numnodes];
+    nhtab = &htab[hp->htabsize];
+    strings = (char *)&nhtab[hp->nhtabsize];
+    if (strings[hp->strsize - 1] != '\0')
+	goto fail;
+
+    if ((tree = (__pmnsTree *)calloc(1, sizeof(*tree))) == NULL ||
+	(tree->nodes = (__pmnsNode *)malloc(hp->numnodes * sizeof(__pmnsNode))) == NULL ||
+	(tree->htab = (__pmnsNode **)malloc(hp->htabsize * sizeof(__pmnsNode *))) == NULL) {
+	sts = -oserror();
+	goto fail;
+    }
+
+    /* relocate ... indices become pointers, offsets become strings */
+#define BADIDX(x) ((x) != IMAGE_NONE && (x) >= hp->numnodes)
+    for (i = 0; i < hp->numnodes; i++, inp++) {
+	if (BADIDX(inp->parent) || BADIDX(inp->next) || BADIDX(inp->first) ||
+	    BADIDX(inp->hash) || BADIDX(inp->nhash) ||
+	    inp->name >= hp->strsize || inp->fullname >= hp->strsize)
+	    goto fail;
+	tree->nodes[i].parent = image_node(tree, inp->parent);
+	tree->nodes[i].next = image_node(tree, inp->next);
+	tree->nodes[i].first = image_node(tree, inp->first);
+	tree->nodes[i].hash = image_node(tree, inp->hash);
+	tree->nodes[i].name = &strings[inp->name];
+	tree->nodes[i].pmid = inp->pmid;
+    }
+    for (i = 0; i < hp->htabsize; i++) {
+	if (BADIDX(htab[i]))
+	    goto fail;
+	tree->htab[i] = image_node(tree, htab[i]);
+    }
+    for (i = 0; i < hp->nhtabsize; i++) {
+	if (BADIDX(nhtab[i]))
+	    goto fail;
+    }
+#undef BADIDX
+    tree->root = &tree->nodes[0];
+    tree->htabsize = hp->htabsize;
+    tree->mark_state = 0;
+    tree->image = addr;
+    tree->imagelen = len;
+    main_pmns = tree;
+
+    if (pmDebugOptions.pmns)
+	fprintf(stderr, "Loaded PMNS image %s: %u nodes\n", path, hp->numnodes);
+    return 0;
+
+fail:
+    if (pmDebugOptions.pmns)
+	fprintf(stderr, "loadimage: %s: not usable, load ASCII PMNS\n", path);
+    if (tree != NULL) {
+	free(tree->nodes);
+	free(tree->htab);
+	free(tree);
+    }
+    __pmMemoryUnmap(addr, len);
+    return sts;
+}
+
+/*
+ * Find the named node using the full name hash table from the image,
+ * respecting the mark bits as per locate().
+ */
+static __pmnsNode *
+image_locate(const char *name, __pmnsTree *tree)
+{
+    image_hdr_t		*hp = (image_hdr_t *)tree->image;
+    image_node_t	*inp = (image_node_t *)&hp[1];
+    __uint32_t		*nhtab = (__uint32_t *)&inp[hp->numnodes] + hp->htabsize;
+    char		*strings = (char *)&nhtab[hp->nhtabsize];
+    __pmnsNode		*np, *pp;
+    __uint32_t		idx;
+
+    idx = nhtab[image_hash(name) % hp->nhtabsize];
+    for ( ; idx != IMAGE_NONE; idx = inp[idx].nhash) {
+	if (strcmp(name, &strings[inp[idx].fullname]) != 0)
+	    continue;
+	np = &tree->nodes[idx];
+	for (pp = np; pp != tree->root; pp = pp->parent) {
+	    if (pp->pmid & MARK_BIT)
+		return NULL;
+	}
+	return np;
+    }
+    return NULL;
+}
+
+/*
+ * Note owner, size and modification time of the PMNS file (fname).
+ */
+static int
+notestat(void)
+{
+    struct stat statbuf;
+
+    if (stat(fname, &statbuf) < 0)
+	return -oserror();
+    last_uid = statbuf.st_uid;
+    last_size = statbuf.st_size;
+#if defined(HAVE_ST_MTIME_WITH_E)
+    last_mtim = statbuf.st_mtime; /* possible struct assignment */
+#elif defined(HAVE_ST_MTIME_WITH_SPEC)
+    last_mtim = statbuf.st_mtimespec; /* possible struct assignment */
+#else
+    last_mtim = statbuf.st_mtim; /* possible struct assignment */
+#endif
+    return 0;
+}
+
 static int
 load(const char *filename, int dupok, int use_cpp)
 {
     const char	*f;
     int 	i = 0;
+    int		have_stat = 0;
 
     PM_ASSERT_IS_LOCKED(pmns_lock);
 
@@ -1515,20 +1968,7 @@ load(const char *filename, int dupok, int use_cpp)
 		filename, dupok, use_cpp, i, fname);
 
     /* Note size and modification time of pmns file */
-    {
-	struct stat statbuf;
-
-	if (stat(fname, &statbuf) == 0) {
-	    last_size = statbuf.st_size;
-#if defined(HAVE_ST_MTIME_WITH_E)
-	    last_mtim = statbuf.st_mtime; /* possible struct assignment */
-#elif defined(HAVE_ST_MTIME_WITH_SPEC)
-	    last_mtim = statbuf.st_mtimespec; /* possible struct assignment */
-#else
-	    last_mtim = statbuf.st_mtim; /* possible struct assignment */
-#endif
-	}
-    }
+    have_stat = (notestat() == 0);
 
     /*
      * use_cpp passed in is a hint ... if it is USE_CPP and filename
@@ -1539,11 +1979,62 @@ load(const char *filename, int dupok, int use_cpp)
 	use_cpp = NO_CPP;
 
     /*
-     * load ASCII PMNS
+     * without pmcpp, use the binary image of the PMNS if it is current
+     * and trusted, else load the ASCII PMNS ... the image is only ever
+     * written by the PMNS tools, see __pmSavePMNSImage()
      */
+    if (use_cpp == NO_CPP && have_stat && loadimage(dupok) == 0)
+	return 0;
     return loadascii(dupok, use_cpp);
 }
 
+/*
+ * Build (or rebuild) the binary image for the ASCII PMNS in filename,
+ * for pmnsmerge and pmnsdel ... any loaded PMNS is left untouched.
+ */
+int
+__pmSavePMNSImage(const char *filename)
+{
+    ctx_ctl_t	ctx_ctl = { NULL, 0, 0 };
+    __pmnsTree	*save_pmns;
+    char	save_fname[sizeof(fname)];
+    char	save_mtim[sizeof(last_mtim)];
+    off_t	save_size;
+    uid_t	save_uid;
+    int		sts;
+
+    if (filename == NULL)
+	return PM_ERR_GENERIC;
+
+    lock_ctx_and_pmns(NULL, &ctx_ctl);
+
+    save_pmns = main_pmns;
+    memcpy(save_fname, fname, sizeof(fname));
+    memcpy(save_mtim, &last_mtim, sizeof(last_mtim));
+    save_size = last_size;
+    save_uid = last_uid;
+
+    main_pmns = NULL;
+    pmstrncpy(fname, sizeof(fname), filename);
+    if ((sts = notestat()) == 0 &&
+	(sts = loadascii(DUPS_OK, NO_CPP)) == 0)
+	sts = saveimage(DUPS_OK);
+    __pmFreePMNS(main_pmns);
+
+    main_pmns = save_pmns;
+    memcpy(fname, save_fname, sizeof(fname));
+    memcpy(&last_mtim, save_mtim, sizeof(last_mtim));
+    last_size = save_size;
+    last_uid = save_uid;
+
+    if (ctx_ctl.need_pmns_unlock)
+	PM_UNLOCK(pmns_lock);
+    if (ctx_ctl.need_ctx_unlock)
+	PM_UNLOCK(ctx_ctl.ctxp->c_lock);
+
+    return sts;
+}
+
 /*
  * just for pmnsmerge to use
  */
@@ -1598,6 +2089,18 @@ locate(const char *name, __pmnsNode *root)
 	return locate(tail+1, np); /* try matching with rest of pathname */
 }
 
+/*
+ * Find and return the named node in the tree, using the name hash
+ * table if the tree was loaded from a binary image.
+ */
+static __pmnsNode *
+lookup(const char *name, __pmnsTree *tree)
+{
+    if (tree->image != NULL)
+	return image_locate(name, tree);
+    return locate(name, tree->root);
+}
+
 /*
  * PMAPI routines from here down
  */
@@ -1672,7 +2175,13 @@ __pmFreePMNS(__pmnsTree *pmns)
 {
     if (pmns != NULL) {
 	free(pmns->htab);
-	FreeTraversePMNS(pmns->root);
+	if (pmns->image != NULL) {
+	    /* nodes allocated together, names are in the image */
+	    free(pmns->nodes);
+	    __pmMemoryUnmap(pmns->image, pmns->imagelen);
+	}
+	else
+	    FreeTraversePMNS(pmns->root);
 	free(pmns);
     }
 }
@@ -1785,7 +2294,7 @@ pmLookupName_ctx(__pmContext *ctxp, int derive_locked, int numpmid, const char *
 	     * if we locate the name and it is a leaf in the PMNS
 	     * this is good
 	     */
-	    np = locate(namelist[i], PM_TPD(curr_pmns)->root);
+	    np = lookup(namelist[i], PM_TPD(curr_pmns));
 	    if (np != NULL ) {
 		if (np->first == NULL) {
 		    /* looks good from local PMNS */
@@ -1815,7 +2324,7 @@ pmLookupName_ctx(__pmContext *ctxp, int derive_locked, int numpmid, const char *
 	    while ((xp = rindex(xname, '.')) != NULL) {
 		*xp = '\0';
 		lsts = 0;
-		np = locate(xname, PM_TPD(curr_pmns)->root);
+		np = lookup(xname, PM_TPD(curr_pmns));
 		if (np != NULL && np->first == NULL &&
 		    IS_DYNAMIC_ROOT(np->pmid)) {
 		    /* root of dynamic subtree */
@@ -2301,7 +2810,7 @@ getchildren(__pmContext *ctxp, int needlocks, const char *name, char ***offsprin
 	if (*name == '\0')
 	    np = PM_TPD(curr_pmns)->root; /* use "" to name the root of the PMNS */
 	else
-	    np = locate(name, PM_TPD(curr_pmns)->root);
+	    np = lookup(name, PM_TPD(curr_pmns));
 	if (np == NULL) {
 	    if (ctxp != NULL && ctxp->c_type == PM_CONTEXT_LOCAL) {
 		/*
@@ -2319,7 +2828,7 @@ getchildren(__pmContext *ctxp, int needlocks, const char *name, char ***offsprin
 		}
 		while ((xp = rindex(xname, '.')) != NULL) {
 		    *xp = '\0';
-		    np = locate(xname, PM_TPD(curr_pmns)->root);
+		    np = lookup(xname, PM_TPD(curr_pmns));
 		    if (np != NULL && np->first == NULL &&
 			IS_DYNAMIC_ROOT(np->pmid)) {
 			int		domain = ((__pmID_int *)&np->pmid)->cluster;
@@ -23,6 +23,9 @@
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include <sys/stat.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
 #ifdef HAVE_TERMIOS_H
 #include <termios.h>
 #else
@@ -1490,6 +1493,21 @@ __pmSocketReady(int fd, struct timeval *timeout)
 	if (SSL_pending(ss.ssl) > 0)
 	    return 1;	/* proceed without blocking */
 
+#ifdef HAVE_POLL_H
+    if (fd >= FD_SETSIZE) {
+	/* select(2) cannot handle this descriptor, e.g. busy pmcd */
+	struct pollfd	pfd;
+	int		msec = -1;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if (timeout != NULL)
+	    msec = timeout->tv_sec * 1000 + timeout->tv_usec / 1000;
+	return poll(&pfd, 1, msec);
+    }
+#endif
+
     FD_ZERO(&onefd);
     FD_SET(fd, &onefd);
     return select(fd+1, &onefd, NULL, NULL, timeout);
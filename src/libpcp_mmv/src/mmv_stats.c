@@ -18,6 +18,9 @@
 #include "pmapi.h"
 #include <ctype.h>
 #include <sys/stat.h>
+#ifdef HAVE_SCHED_H
+#include <sched.h>
+#endif
 #include "mmv_stats.h"
 #include "mmv_dev.h"
 #include "libpcp.h"
@@ -38,6 +41,9 @@ struct mmv_registry {
     void *		addr;
 };
 
+/* upper bound on per-CPU counter shards, CPUs beyond share them */
+#define MMV_MAXSHARDS	1024
+
 static void
 mmv_stats_path(const char *fname, char *fullpath, size_t pathlen)
 {
@@ -128,6 +134,25 @@ mmv_generation(void)
     return (((__uint64_t)gen1 << 32) | (__uint64_t)gen2);
 }
 
+/*
+ * One counter shard per configured CPU, so that concurrent updates
+ * from different CPUs never write to the same cache line.
+ */
+static int
+mmv_shard_count(void)
+{
+    long	ncpus = 1;
+
+#ifdef _SC_NPROCESSORS_CONF
+    ncpus = sysconf(_SC_NPROCESSORS_CONF);
+#endif
+    if (ncpus < 1)
+	ncpus = 1;
+    if (ncpus > MMV_MAXSHARDS)
+	ncpus = MMV_MAXSHARDS;
+    return (int)ncpus;
+}
+
 static void * 
 mmv_init(const char *fname, int version,
 		int cluster, mmv_stats_flags_t fl,
@@ -145,6 +170,7 @@ mmv_init(const char *fname, int version,
     mmv_disk_indom_t *domlist;
     mmv_disk_value_t *vlist;
     mmv_disk_label_t *lblist;
+    mmv_disk_histogram_t *hlist;
     mmv_disk_header_t *hdr;
     mmv_disk_toc_t *toc;
     const mmv_indom_t *mi1;
@@ -155,13 +181,17 @@ mmv_init(const char *fname, int version,
     __uint64_t values_offset;		/* anchor start of values section */
     __uint64_t strings_offset;		/* anchor start of any/all strings */
     __uint64_t labels_offset;		/* anchor start of any/all labels */
+    __uint64_t histograms_offset;	/* anchor start of any histograms */
+    __uint64_t shards_offset;		/* anchor start of per-CPU shards */
     void *addr;
     size_t size;
     __uint64_t offset;
-    int i, j, k, tocidx, stridx;
+    int i, j, k, tocidx, stridx, histidx;
+    int nhistograms = 0;
     int ninstances = 0;
     int nstrings = 0;
     int nvalues = 0;
+    int nshards = 0;
 
     for (i = 0; i < nindom1; i++) {
 	ninstances += in1[i].count;
@@ -172,7 +202,7 @@ mmv_init(const char *fname, int version,
     }
     for (i = 0; i < nindom2; i++) {
 	ninstances += in2[i].count;
-	if (version == MMV_VERSION2 || version == MMV_VERSION3)
+	if (version != MMV_VERSION1)
 	    nstrings += in2[i].count;	/* instance names */
 	if (in2[i].shorttext)
 	    nstrings++;
@@ -198,7 +228,7 @@ mmv_init(const char *fname, int version,
 	}
     }
     for (i = 0; i < nmetric2; i++) {
-	if (version == MMV_VERSION2 || version == MMV_VERSION3)
+	if (version != MMV_VERSION1)
 	    nstrings++;		/* metric name */
 	if (st2[i].helptext)
 	    nstrings++;
@@ -213,6 +243,8 @@ mmv_init(const char *fname, int version,
 	} else {
 	    if (st2[i].type == MMV_TYPE_STRING)
 		nstrings++;
+	    if (st2[i].type == MMV_TYPE_HISTOGRAM)
+		nhistograms++;
 	    nvalues++;
 	}
     }
@@ -227,6 +259,12 @@ mmv_init(const char *fname, int version,
     if (nlabels) {
 	size += sizeof(mmv_disk_toc_t) * 1;
     }
+    if (nhistograms)
+	size += sizeof(mmv_disk_toc_t) * 1;
+    if (version >= MMV_VERSION4 && (fl & MMV_FLAG_SHARDED) && nvalues)
+	nshards = mmv_shard_count();
+    if (nshards)
+	size += sizeof(mmv_disk_toc_t) * 1;
     indoms_offset = sizeof(mmv_disk_header_t) + size;
 
     /* Following the indom definitions are the actual instances */
@@ -271,8 +309,17 @@ mmv_init(const char *fname, int version,
     size = nstrings * sizeof(mmv_disk_string_t);
     labels_offset = strings_offset + size;
 
-    /* End of file follows all of the actual strings */
-    size = labels_offset + nlabels * sizeof(mmv_disk_label_t);
+    /* Following the labels are any histograms */
+    size = nlabels * sizeof(mmv_disk_label_t);
+    histograms_offset = labels_offset + size;
+
+    /* End of file follows all of the strings, labels and histograms */
+    size = histograms_offset + nhistograms * sizeof(mmv_disk_histogram_t);
+
+    /* ... or the per-CPU shards, each starting on a new cache line */
+    shards_offset = (size + MMV_CACHELINE - 1) & ~((__uint64_t)MMV_CACHELINE - 1);
+    if (nshards)
+	size = shards_offset + nshards * MMV_SHARD_STRIDE(nvalues);
 
     if ((addr = mmv_mapping_init(fname, size)) == NULL)
 	return NULL;
@@ -300,6 +347,10 @@ mmv_init(const char *fname, int version,
 	hdr->tocs += 1;
     if (nlabels)
 	hdr->tocs += 1;    
+    if (nhistograms)
+	hdr->tocs += 1;
+    if (nshards)
+	hdr->tocs += 1;
     hdr->flags = fl;
     hdr->cluster = cluster;
     hdr->process = (__int32_t)getpid();
@@ -337,6 +388,18 @@ mmv_init(const char *fname, int version,
 	toc[tocidx].offset = labels_offset;
 	tocidx++;
     }
+    if (nhistograms) {
+	toc[tocidx].type = MMV_TOC_HISTOGRAMS;
+	toc[tocidx].count = nhistograms;
+	toc[tocidx].offset = histograms_offset;
+	tocidx++;
+    }
+    if (nshards) {
+	toc[tocidx].type = MMV_TOC_SHARDS;
+	toc[tocidx].count = nshards;
+	toc[tocidx].offset = shards_offset;
+	tocidx++;
+    }
 
     /* Indom section */
     domlist = (mmv_disk_indom_t *)((char *)addr + indoms_offset);
@@ -493,7 +556,7 @@ mmv_init(const char *fname, int version,
      * 6 phases: v2 instance names, v2 metric names, all string values,
      *	   any metric help, any indom help, v3 metric labels.
      */
-    if (version == MMV_VERSION2 || version == MMV_VERSION3) {
+    if (version != MMV_VERSION1) {
 	inlist2 = (mmv_disk_instance2_t *)((char *)addr + instances_offset);
 	for (i = 0; i < nindom2; i++) {
 	    mmv_instances2_t *insts = in2[i].instances;
@@ -518,6 +581,8 @@ mmv_init(const char *fname, int version,
 	}
     }
 
+    hlist = (mmv_disk_histogram_t *)((char *)addr + histograms_offset);
+    histidx = 0;
     for (i = 0; i < nvalues; i++) {
 	mmv_metric_type_t type = MMV_TYPE_NOSUPPORT;
 
@@ -525,7 +590,7 @@ mmv_init(const char *fname, int version,
 	    mmv_disk_metric_t *m1 = (mmv_disk_metric_t *)
 			((char *)(addr + vlist[i].metric));
 	    type = m1->type;
-	} else if (version == MMV_VERSION2 || version == MMV_VERSION3) {
+	} else {
 	    mmv_disk_metric2_t *m2 = (mmv_disk_metric2_t *)
 			((char *)(addr + vlist[i].metric));
 	    type = m2->type;
@@ -535,6 +600,12 @@ mmv_init(const char *fname, int version,
 				(stridx * sizeof(mmv_disk_string_t));
 	    stridx++;
 	}
+	if (type == MMV_TYPE_HISTOGRAM) {
+	    vlist[i].extra = histograms_offset +
+				(histidx * sizeof(mmv_disk_histogram_t));
+	    hlist[histidx].min = ~(__uint64_t)0;
+	    histidx++;
+	}
     }
     for (i = 0; i < nmetric1; i++) {
 	if (st1[i].shorttext) {
@@ -617,12 +688,28 @@ mmv_init(const char *fname, int version,
 	memcpy(lblist[i].payload, lb[i].payload, MMV_LABELMAX);
     }
 
+    /* Shards section is left zero filled (from ftruncate) */
+
     /* Complete - unlock the header, PMDA can read now */
     hdr->g2 = hdr->g1;
 
     return addr;
 }
 
+/*
+ * Histograms have no instance domain, and the item with the summary
+ * bit set is used for the second PMID exported by pmdammv.
+ */
+static int
+mmv_check_histogram(__uint32_t item, __uint32_t indom)
+{
+    if (!mmv_singular(indom) || (item & MMV_HIST_SUMMARY)) {
+	setoserror(EINVAL);
+	return -1;
+    }
+    return 0;
+}
+
 static int
 mmv_check(const mmv_metric_t *st, int nmetrics,
 	  const mmv_indom_t *in, int nindoms)
@@ -630,7 +717,7 @@ mmv_check(const mmv_metric_t *st, int nmetrics,
     const mmv_metric_t *metric;
     const mmv_indom_t *indom;
     size_t size;
-    int i;
+    int i, version = MMV_VERSION1;
 
     for (i = 0; i < nindoms; i++) {
 	indom = &in[i];
@@ -658,7 +745,7 @@ mmv_check(const mmv_metric_t *st, int nmetrics,
 	metric = &st[i];
 	size = strlen(metric->name);
 	if (metric->type < MMV_TYPE_NOSUPPORT ||
-	    metric->type > MMV_TYPE_ELAPSED || size == 0) {
+	    metric->type > MMV_TYPE_HISTOGRAM || size == 0) {
 	    setoserror(EINVAL);
 	    return -1;
 	}
@@ -671,8 +758,70 @@ mmv_check(const mmv_metric_t *st, int nmetrics,
 	    setoserror(ESRCH);
 	    return -1;
 	}
+	if (metric->type == MMV_TYPE_HISTOGRAM) {
+	    if (mmv_check_histogram(metric->item, metric->indom) < 0)
+		return -1;
+	    version = MMV_VERSION5;
+	}
+    }
+    return version;
+}
+
+/*
+ * Histograms need the v2 (and later) on-disk metric format, so convert
+ * any metrics and indoms from the original interface to that form.
+ */
+static void *
+mmv_init_upgrade(const char *fname,
+		int cluster, mmv_stats_flags_t flags,
+		const mmv_metric_t *st, int nmetrics,
+		const mmv_indom_t *in, int nindoms)
+{
+    mmv_instances2_t *instances = NULL;
+    mmv_metric2_t *st2 = NULL;
+    mmv_indom2_t *in2 = NULL;
+    void *addr = NULL;
+    int i, j, ninstances = 0;
+
+    for (i = 0; i < nindoms; i++)
+	ninstances += in[i].count;
+    if ((st2 = calloc(nmetrics, sizeof(mmv_metric2_t))) == NULL ||
+	(nindoms && (in2 = calloc(nindoms, sizeof(mmv_indom2_t))) == NULL) ||
+	(ninstances &&
+	 (instances = calloc(ninstances, sizeof(mmv_instances2_t))) == NULL)) {
+	setoserror(ENOMEM);
+	goto done;
+    }
+
+    for (i = 0; i < nmetrics; i++) {
+	st2[i].name = (char *)st[i].name;
+	st2[i].item = st[i].item;
+	st2[i].type = st[i].type;
+	st2[i].semantics = st[i].semantics;
+	st2[i].dimension = st[i].dimension;
+	st2[i].indom = st[i].indom;
+	st2[i].shorttext = st[i].shorttext;
+	st2[i].helptext = st[i].helptext;
+    }
+    for (i = ninstances = 0; i < nindoms; i++) {
+	in2[i].serial = in[i].serial;
+	in2[i].count = in[i].count;
+	in2[i].instances = &instances[ninstances];
+	in2[i].shorttext = in[i].shorttext;
+	in2[i].helptext = in[i].helptext;
+	for (j = 0; j < in[i].count; j++, ninstances++) {
+	    instances[ninstances].internal = in[i].instances[j].internal;
+	    instances[ninstances].external = in[i].instances[j].external;
+	}
     }
-    return MMV_VERSION1;
+
+    addr = mmv_init(fname, MMV_VERSION5, cluster, flags,
+		    NULL, 0, NULL, 0, st2, nmetrics, in2, nindoms, NULL, 0);
+done:
+    free(instances);
+    free(in2);
+    free(st2);
+    return addr;
 }
 
 void * 
@@ -685,6 +834,9 @@ mmv_stats_init(const char *fname,
 
     if ((version = mmv_check(st, nmetrics, in, nindoms)) < 0)
 	return NULL;
+    if (version == MMV_VERSION5)
+	return mmv_init_upgrade(fname, cluster, flags,
+				st, nmetrics, in, nindoms);
 
     return mmv_init(fname, version, cluster, flags,
 		    st, nmetrics, in, nindoms, 
@@ -699,7 +851,7 @@ mmv_check2(const mmv_metric2_t *st, int nmetrics,
     const mmv_metric2_t *metric;
     const mmv_indom2_t *indom;
     size_t size;
-    int i, j, version = MMV_VERSION1;
+    int i, j, histograms = 0, version = MMV_VERSION1;
 
     for (i = 0; i < nindoms; i++) {
 	indom = &in[i];
@@ -741,7 +893,7 @@ mmv_check2(const mmv_metric2_t *st, int nmetrics,
 	metric = &st[i];
 	size = strlen(metric->name);
 	if (metric->type < MMV_TYPE_NOSUPPORT ||
-	    metric->type > MMV_TYPE_ELAPSED || size == 0) {
+	    metric->type > MMV_TYPE_HISTOGRAM || size == 0) {
 	    setoserror(EINVAL);
 	    return -1;
 	}
@@ -756,8 +908,13 @@ mmv_check2(const mmv_metric2_t *st, int nmetrics,
 	    setoserror(ESRCH);
 	    return -1;
 	}
+	if (metric->type == MMV_TYPE_HISTOGRAM) {
+	    if (mmv_check_histogram(metric->item, metric->indom) < 0)
+		return -1;
+	    histograms++;
+	}
     }
-    return version;
+    return histograms ? MMV_VERSION5 : version;
 }
 
 void * 
@@ -770,6 +927,8 @@ mmv_stats2_init(const char *fname,
 
     if ((version = mmv_check2(st, nmetrics, in, nindoms)) < 0)
 	return NULL;
+    if ((flags & MMV_FLAG_SHARDED) && version < MMV_VERSION4)
+	version = MMV_VERSION4;
 
     return mmv_init(fname, version, cluster, flags,
 		    NULL, 0, NULL, 0, st, nmetrics, in, nindoms, NULL, 0);
@@ -792,7 +951,9 @@ mmv_stats_registry(const char *file,
     }
     /*
      * Initial version is 1, this increases to 2 if adding
-     * long strings, and to 3 if adding any metric labels.
+     * long strings, to 3 if adding any metric labels, to
+     * 4 if per-CPU counter shards were requested (flags),
+     * and to 5 if adding any histogram metrics.
      */
     mr->version = MMV_VERSION1;
     mr->file = file;
@@ -1198,7 +1359,11 @@ mmv_stats_start(mmv_registry_t *registry)
 				registry->indoms, registry->nindoms)) < 0)
 	return NULL;
 
-    if (registry->version != MMV_VERSION3)
+    if (version == MMV_VERSION5)
+	registry->version = MMV_VERSION5;
+    else if (registry->flags & MMV_FLAG_SHARDED)
+	registry->version = MMV_VERSION4;
+    else if (registry->version != MMV_VERSION3)
 	registry->version = version;
 
     registry->addr = mmv_init(registry->file,
@@ -1345,52 +1510,229 @@ mmv_lookup_value_desc(void *addr, const char *metric, const char *inst)
     return NULL;
 }
 
+static int
+mmv_value_type(void *addr, mmv_disk_value_t *v)
+{
+    mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
+
+    if (hdr->version == MMV_VERSION1) {
+	mmv_disk_metric_t *m = (mmv_disk_metric_t *)
+					((char *)addr + v->metric);
+	return m->type;
+    } else {
+	mmv_disk_metric2_t *m = (mmv_disk_metric2_t *)
+					((char *)addr + v->metric);
+	return m->type;
+    }
+}
+
+static int
+mmv_value_atom(int type, double value, pmAtomValue *atom)
+{
+    switch (type) {
+    case MMV_TYPE_I32:
+	atom->l = (__int32_t)value;
+	break;
+    case MMV_TYPE_U32:
+	atom->ul = (__uint32_t)value;
+	break;
+    case MMV_TYPE_I64:
+	atom->ll = (__int64_t)value;
+	break;
+    case MMV_TYPE_U64:
+	atom->ull = (__uint64_t)value;
+	break;
+    case MMV_TYPE_FLOAT:
+	atom->f = (float)value;
+	break;
+    case MMV_TYPE_DOUBLE:
+	atom->d = value;
+	break;
+    default:
+	return 0;
+    }
+    return 1;
+}
+
+/*
+ * Counter updates are lock-free - a single atomic add for integer
+ * types, a compare-and-swap loop for floating point types - so that
+ * no increments are lost when several threads update one value.
+ */
+static void
+mmv_atomic_add(pmAtomValue *av, int type, const pmAtomValue *inc)
+{
+    pmAtomValue old, new;
+
+    switch (type) {
+    case MMV_TYPE_I32:
+	__sync_fetch_and_add(&av->l, inc->l);
+	break;
+    case MMV_TYPE_U32:
+	__sync_fetch_and_add(&av->ul, inc->ul);
+	break;
+    case MMV_TYPE_I64:
+	__sync_fetch_and_add(&av->ll, inc->ll);
+	break;
+    case MMV_TYPE_U64:
+	__sync_fetch_and_add(&av->ull, inc->ull);
+	break;
+    case MMV_TYPE_FLOAT:
+	do {
+	    old.ul = *(volatile __uint32_t *)&av->ul;
+	    new.f = old.f + inc->f;
+	} while (!__sync_bool_compare_and_swap(&av->ul, old.ul, new.ul));
+	break;
+    case MMV_TYPE_DOUBLE:
+	do {
+	    old.ull = *(volatile __uint64_t *)&av->ull;
+	    new.d = old.d + inc->d;
+	} while (!__sync_bool_compare_and_swap(&av->ull, old.ull, new.ull));
+	break;
+    default:
+	break;
+    }
+}
+
+static int
+mmv_hist_index(__uint64_t value)
+{
+    int shift;
+
+    if (value < (1 << MMV_HIST_SUBBITS))
+	return (int)value;
+    shift = 63 - __builtin_clzll(value) - (MMV_HIST_SUBBITS - 1);
+    return (shift << (MMV_HIST_SUBBITS - 1)) + (int)(value >> shift);
+}
+
+/*
+ * Record a value in a histogram (v5) - lock-free, as for counters,
+ * using atomic adds for the bucket, count and sum, and compare-and-swap
+ * loops for the minimum and maximum.  Negative values are ignored.
+ */
+static void
+mmv_hist_record(void *addr, mmv_disk_value_t *v, double value)
+{
+    mmv_disk_histogram_t *hp;
+    __uint64_t x, old;
+
+    if (!(value >= 0))
+	return;
+    x = (value >= 18446744073709551615.0) ? ~(__uint64_t)0 : (__uint64_t)value;
+    hp = (mmv_disk_histogram_t *)((char *)addr + v->extra);
+
+    __sync_fetch_and_add(&hp->buckets[mmv_hist_index(x)], 1);
+    __sync_fetch_and_add(&hp->count, 1);
+    __sync_fetch_and_add(&hp->sum, x);
+    do {
+	old = *(volatile __uint64_t *)&hp->min;
+    } while (x < old && !__sync_bool_compare_and_swap(&hp->min, old, x));
+    do {
+	old = *(volatile __uint64_t *)&hp->max;
+    } while (x > old && !__sync_bool_compare_and_swap(&hp->max, old, x));
+}
+
+/*
+ * Locate the values and per-CPU shards sections of a v4 file,
+ * returning the number of shards (zero for earlier versions).
+ */
+static int
+mmv_shard_section(void *addr, __uint64_t *values, __uint64_t *stride,
+		__uint64_t *shards)
+{
+    mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
+    mmv_disk_toc_t *toc;
+    int i, nshards = 0;
+
+    if (hdr->version < MMV_VERSION4)
+	return 0;
+    toc = (mmv_disk_toc_t *)((char *)addr + sizeof(mmv_disk_header_t));
+    for (i = 0; i < hdr->tocs; i++) {
+	if (toc[i].type == MMV_TOC_VALUES) {
+	    *values = toc[i].offset;
+	    *stride = MMV_SHARD_STRIDE(toc[i].count);
+	} else if (toc[i].type == MMV_TOC_SHARDS) {
+	    *shards = toc[i].offset;
+	    nshards = toc[i].count;
+	}
+    }
+    return nshards;
+}
+
+/*
+ * Resolve everything needed to update a value once, for the handle
+ * interfaces and the by-address interfaces alike.
+ */
+static void
+mmv_handle_fill(void *addr, mmv_disk_value_t *v, mmv_handle_t *h)
+{
+    __uint64_t values = 0, stride = 0, shards = 0, index;
+
+    h->addr = addr;
+    h->value = &v->value;
+    h->type = mmv_value_type(addr, v);
+    h->shards = NULL;
+    h->stride = 0;
+    if ((h->nshards = mmv_shard_section(addr, &values, &stride, &shards)) > 0) {
+	index = ((char *)v - (char *)addr - values) / sizeof(mmv_disk_value_t);
+	h->shards = (char *)addr + shards + index * sizeof(pmAtomValue);
+	h->stride = stride;
+    } else {
+	h->nshards = 0;
+    }
+}
+
+/*
+ * Counter updates go to the shard for the current CPU where there
+ * are shards, keeping concurrent updates on separate cache lines.
+ */
+static pmAtomValue *
+mmv_handle_target(mmv_handle_t *h)
+{
+    int cpu = 0;
+
+    if (h->nshards <= 0)
+	return h->value;
+#ifdef HAVE_SCHED_GETCPU
+    if ((cpu = sched_getcpu()) < 0)
+	cpu = 0;
+#endif
+    return (pmAtomValue *)(h->shards + (cpu % h->nshards) * h->stride);
+}
+
+/*
+ * Setting a value discards the accumulated shards - increments
+ * from other threads racing with the set may be lost.
+ */
+static void
+mmv_handle_clear(mmv_handle_t *h)
+{
+    int i;
+
+    for (i = 0; i < h->nshards; i++)
+	memset(h->shards + i * h->stride, 0, sizeof(pmAtomValue));
+}
+
 void
 mmv_inc_value(void *addr, pmAtomValue *av, double inc)
 {
     if (av != NULL && addr != NULL) {
-	mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
 	mmv_disk_value_t *v = (mmv_disk_value_t *)av;
-	int type;
+	pmAtomValue value;
+	mmv_handle_t h;
 
-	if (hdr->version == MMV_VERSION1) {
-	    mmv_disk_metric_t *m = (mmv_disk_metric_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	} else {
-	    mmv_disk_metric2_t *m = (mmv_disk_metric2_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	}
-	switch (type) {
-	case MMV_TYPE_I32:
-	    v->value.l += (__int32_t)inc;
-	    break;
-	case MMV_TYPE_U32:
-	    v->value.ul += (__uint32_t)inc;
-	    break;
-	case MMV_TYPE_I64:
-	    v->value.ll += (__int64_t)inc;
-	    break;
-	case MMV_TYPE_U64:
-	    v->value.ull += (__uint64_t)inc;
-	    break;
-	case MMV_TYPE_FLOAT:
-	    v->value.f += (float)inc;
-	    break;
-	case MMV_TYPE_DOUBLE:
-	    v->value.d += inc;
-	    break;
-	case MMV_TYPE_ELAPSED:
+	mmv_handle_fill(addr, v, &h);
+	if (h.type == MMV_TYPE_ELAPSED) {
 	    if (inc < 0)
 		v->extra = (__int64_t)inc;
 	    else {
 		v->value.ll += v->extra + (__int64_t)inc;
 		v->extra = 0;
 	    }
-	    break;
-	default:
-	    break;
+	} else if (h.type == MMV_TYPE_HISTOGRAM) {
+	    mmv_hist_record(addr, v, inc);
+	} else if (mmv_value_atom(h.type, inc, &value)) {
+	    mmv_atomic_add(mmv_handle_target(&h), h.type, &value);
 	}
     }
 }
@@ -1399,48 +1741,21 @@ void
 mmv_inc_atomvalue(void *addr, pmAtomValue *av, pmAtomValue *value)
 {
     if (av != NULL && addr != NULL) {
-	mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
 	mmv_disk_value_t *v = (mmv_disk_value_t *)av;
-	int type;
+	mmv_handle_t h;
 
-	if (hdr->version == MMV_VERSION1) {
-	    mmv_disk_metric_t *m = (mmv_disk_metric_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	} else {
-	    mmv_disk_metric2_t *m = (mmv_disk_metric2_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	}
-	switch (type) {
-	case MMV_TYPE_I32:
-	    v->value.l += value->l;
-	    break;
-	case MMV_TYPE_U32:
-	    v->value.ul += value->ul;
-	    break;
-	case MMV_TYPE_I64:
-	    v->value.ll += value->ll;
-	    break;
-	case MMV_TYPE_U64:
-	    v->value.ull += value->ull;
-	    break;
-	case MMV_TYPE_FLOAT:
-	    v->value.f += value->f;
-	    break;
-	case MMV_TYPE_DOUBLE:
-	    v->value.d += value->d;
-	    break;
-	case MMV_TYPE_ELAPSED:
+	mmv_handle_fill(addr, v, &h);
+	if (h.type == MMV_TYPE_ELAPSED) {
 	    if (value->ll < 0)
 		v->extra = value->ll;
 	    else {
 		v->value.ll += v->extra + value->ll;
 		v->extra = 0;
 	    }
-	    break;
-	default:
-	    break;
+	} else if (h.type == MMV_TYPE_HISTOGRAM) {
+	    mmv_hist_record(addr, v, (double)value->ull);
+	} else if (h.type != MMV_TYPE_STRING) {
+	    mmv_atomic_add(mmv_handle_target(&h), h.type, value);
 	}
     }
 }
@@ -1455,48 +1770,22 @@ void
 mmv_inc(void *addr, pmAtomValue *av)
 {
     if (av != NULL && addr != NULL) {
-	mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
 	mmv_disk_value_t *v = (mmv_disk_value_t *)av;
-	int type;
+	pmAtomValue value;
+	mmv_handle_t h;
 
-	if (hdr->version == MMV_VERSION1) {
-	    mmv_disk_metric_t *m = (mmv_disk_metric_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	} else {
-	    mmv_disk_metric2_t *m = (mmv_disk_metric2_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	}
-	switch (type) {
-	case MMV_TYPE_I32:
-	    v->value.l++;
-	    break;
-	case MMV_TYPE_U32:
-	    v->value.ul++;
-	    break;
-	case MMV_TYPE_I64:
-	    v->value.ll++;
-	    break;
-	case MMV_TYPE_U64:
-	    v->value.ull++;
-	    break;
-	case MMV_TYPE_FLOAT:
-	    v->value.f++;
-	    break;
-	case MMV_TYPE_DOUBLE:
-	    v->value.d++;
-	    break;
-	case MMV_TYPE_ELAPSED:
+	mmv_handle_fill(addr, v, &h);
+	if (h.type == MMV_TYPE_ELAPSED) {
 	    if (v->value.ll < 0)
 		v->extra++;
 	    else {
 		v->value.ll += v->extra + 1;
 		v->extra = 0;
 	    }
-	    break;
-	default:
-	    break;
+	} else if (h.type == MMV_TYPE_HISTOGRAM) {
+	    mmv_hist_record(addr, v, 1);
+	} else if (mmv_value_atom(h.type, 1, &value)) {
+	    mmv_atomic_add(mmv_handle_target(&h), h.type, &value);
 	}
     }
 }
@@ -1505,44 +1794,15 @@ void
 mmv_set_value(void *addr, pmAtomValue *av, double val)
 {
     if (av != NULL && addr != NULL) {
-	mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
 	mmv_disk_value_t *v = (mmv_disk_value_t *)av;
-	int type;
+	mmv_handle_t h;
 
-	if (hdr->version == MMV_VERSION1) {
-	    mmv_disk_metric_t *m = (mmv_disk_metric_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	} else {
-	    mmv_disk_metric2_t *m = (mmv_disk_metric2_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	}
-	switch (type) {
-	case MMV_TYPE_I32:
-	    v->value.l = (__int32_t)val;
-	    break;
-	case MMV_TYPE_U32:
-	    v->value.ul = (__uint32_t)val;
-	    break;
-	case MMV_TYPE_I64:
-	    v->value.ll = (__int64_t)val;
-	    break;
-	case MMV_TYPE_U64:
-	    v->value.ull = (__uint64_t)val;
-	    break;
-	case MMV_TYPE_FLOAT:
-	    v->value.f = (float)val;
-	    break;
-	case MMV_TYPE_DOUBLE:
-	    v->value.d = val;
-	    break;
-	case MMV_TYPE_ELAPSED:
+	mmv_handle_fill(addr, v, &h);
+	if (h.type == MMV_TYPE_ELAPSED) {
 	    v->value.ll = (__int64_t)val;
 	    v->extra = 0;
-	    break;
-	default:
-	    break;
+	} else if (mmv_value_atom(h.type, val, &v->value)) {
+	    mmv_handle_clear(&h);
 	}
     }
 }
@@ -1551,20 +1811,9 @@ void
 mmv_set_string(void *addr, pmAtomValue *av, const char *string, int size)
 {
     if (av != NULL && addr != NULL && string != NULL) {
-	mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
 	mmv_disk_value_t *v = (mmv_disk_value_t *)av;
-	int type;
+	int type = mmv_value_type(addr, v);
 
-	if (hdr->version == MMV_VERSION1) {
-	    mmv_disk_metric_t *m = (mmv_disk_metric_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	} else {
-	    mmv_disk_metric2_t *m = (mmv_disk_metric2_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	}
- 
 	if (type == MMV_TYPE_STRING &&
 	    (size >= 0 && size < MMV_STRINGMAX - 1)) {
 	    __uint64_t soffset = v->extra;
@@ -1585,24 +1834,22 @@ void
 mmv_set_atomvalue(void *addr, pmAtomValue *av, pmAtomValue *value)
 {
     if (av != NULL && addr != NULL) {
-	mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
 	mmv_disk_value_t *v = (mmv_disk_value_t *)av;
-	int type;
+	int type = mmv_value_type(addr, v);
 
-	if (hdr->version == MMV_VERSION1) {
-	    mmv_disk_metric_t *m = (mmv_disk_metric_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	} else {
-	    mmv_disk_metric2_t *m = (mmv_disk_metric2_t *)
-					((char *)addr + v->metric);
-	    type = m->type;
-	}
+	if (type == MMV_TYPE_HISTOGRAM)
+	    return;
 	if (type == MMV_TYPE_ELAPSED)
 	    v->extra = 0;
-	if (type != MMV_TYPE_STRING)
+	if (type != MMV_TYPE_STRING) {
 	    v->value = *value;
-	else
+	    if (type != MMV_TYPE_ELAPSED) {
+		mmv_handle_t h;
+
+		mmv_handle_fill(addr, v, &h);
+		mmv_handle_clear(&h);
+	    }
+	} else
 	    mmv_set_string(addr, av, value->cp, strlen(value->cp));
     }
 }
@@ -1613,6 +1860,65 @@ mmv_set(void *registry, pmAtomValue *metric, void *value)
     mmv_set_atomvalue(registry, metric, (pmAtomValue *)value);
 }
 
+/*
+ * Value handles - the name lookup and the search for the shards are
+ * done once, up front, leaving only the update itself for each call.
+ */
+
+int
+mmv_lookup_handle(void *addr, const char *metric, const char *inst,
+		mmv_handle_t *h)
+{
+    pmAtomValue *av;
+
+    if (h == NULL ||
+	(av = mmv_lookup_value_desc(addr, metric, inst)) == NULL) {
+	setoserror(ESRCH);
+	return -1;
+    }
+    mmv_handle_fill(addr, (mmv_disk_value_t *)av, h);
+    return 0;
+}
+
+void
+mmv_handle_inc(mmv_handle_t *h)
+{
+    pmAtomValue value;
+
+    if (h == NULL || h->value == NULL)
+	return;
+    if (h->type == MMV_TYPE_ELAPSED || h->type == MMV_TYPE_HISTOGRAM)
+	mmv_inc(h->addr, h->value);
+    else if (mmv_value_atom(h->type, 1, &value))
+	mmv_atomic_add(mmv_handle_target(h), h->type, &value);
+}
+
+void
+mmv_handle_add(mmv_handle_t *h, double inc)
+{
+    pmAtomValue value;
+
+    if (h == NULL || h->value == NULL)
+	return;
+    if (h->type == MMV_TYPE_HISTOGRAM)
+	mmv_hist_record(h->addr, (mmv_disk_value_t *)h->value, inc);
+    else if (h->type == MMV_TYPE_ELAPSED)
+	mmv_inc_value(h->addr, h->value, inc);
+    else if (mmv_value_atom(h->type, inc, &value))
+	mmv_atomic_add(mmv_handle_target(h), h->type, &value);
+}
+
+void
+mmv_handle_set(mmv_handle_t *h, double val)
+{
+    if (h == NULL || h->value == NULL)
+	return;
+    if (h->type == MMV_TYPE_ELAPSED)
+	mmv_set_value(h->addr, h->value, val);
+    else if (mmv_value_atom(h->type, val, h->value))
+	mmv_handle_clear(h);
+}
+
 /*
  * Simple wrapper routines, less efficient than earlier methods.
  */
@@ -148,6 +148,307 @@ pmDiscoverFree(pmDiscover *p)
     free(p);
 }
 
+/*
+ * Persistent checkpoints of the position reached in each archive.  These
+ * are saved periodically (if a checkpoints file is configured) so that
+ * after a restart values are processed from where we left off, instead
+ * of skipping ahead to the current end of each archive.  Checkpoints may
+ * lag behind processing by up to checkpoint.interval seconds, so a few
+ * records may be sent again after restarting - these duplicate stream
+ * inserts are harmless.
+ */
+#define CHECKPOINT_HEADER	"# pmproxy discovery checkpoints v1"
+#define CHECKPOINT_INTERVAL	60	/* default seconds between saves */
+
+static void
+checkpoint_free(discoverModuleData *data)
+{
+    dictIterator	*iterator;
+    dictEntry		*entry;
+
+    iterator = dictGetIterator(data->checkpoint);
+    while ((entry = dictNext(iterator)) != NULL)
+	free(dictGetVal(entry));
+    dictReleaseIterator(iterator);
+    dictRelease(data->checkpoint);
+    data->checkpoint = NULL;
+}
+
+static void
+checkpoint_save(pmDiscoverModule *module)
+{
+    discoverModuleData	*data = getDiscoverModuleData(module);
+    discoverCheckpoint	*cp;
+    dictIterator	*iterator;
+    dictEntry		*entry;
+    FILE		*fp;
+    sds			name, path, msg;
+
+    path = sdscatfmt(sdsempty(), "%S.tmp", data->checkpoints);
+    if ((fp = fopen(path, "w")) == NULL) {
+	infofmt(msg, "cannot create checkpoints file %s: %s", path, osstrerror());
+	moduleinfo(module, PMLOG_WARNING, msg, data->data);
+	sdsfree(path);
+	return;
+    }
+    fprintf(fp, "%s\n", CHECKPOINT_HEADER);
+
+    iterator = dictGetSafeIterator(data->checkpoint);
+    while ((entry = dictNext(iterator)) != NULL) {
+	name = (sds)dictGetKey(entry);
+	cp = (discoverCheckpoint *)dictGetVal(entry);
+	if (!cp->active) {
+	    /* not rediscovered since loading, keep while the archive exists */
+	    sds	metaname = sdscatfmt(sdsempty(), "%S.meta", name);
+	    int	exists = (access(metaname, F_OK) == 0);
+
+	    sdsfree(metaname);
+	    if (!exists) {
+		free(cp);
+		dictDelete(data->checkpoint, name);
+		continue;
+	    }
+	}
+	fprintf(fp, "%d %lld %lld %d %lld %s\n", cp->volume,
+		(long long)cp->offset, (long long)cp->timestamp.sec,
+		cp->timestamp.nsec, (long long)cp->metaoffset, name);
+    }
+    dictReleaseIterator(iterator);
+
+    if (fflush(fp) != 0 || fsync(fileno(fp)) < 0 || fclose(fp) != 0 ||
+	rename(path, data->checkpoints) < 0) {
+	infofmt(msg, "cannot save checkpoints file %s: %s",
+		data->checkpoints, osstrerror());
+	moduleinfo(module, PMLOG_WARNING, msg, data->data);
+	unlink(path);
+    } else {
+	data->checkpoint_dirty = 0;
+    }
+    sdsfree(path);
+}
+
+static void
+checkpoint_worker(void *arg)
+{
+    pmDiscoverModule	*module = (pmDiscoverModule *)arg;
+    discoverModuleData	*data = getDiscoverModuleData(module);
+
+    /* called every second, save only at the configured interval */
+    if (data->checkpoint_dirty &&
+	++data->checkpoint_ticks >= data->checkpoint_interval) {
+	data->checkpoint_ticks = 0;
+	checkpoint_save(module);
+    }
+}
+
+static void
+checkpoint_load(pmDiscoverModule *module)
+{
+    discoverModuleData	*data = getDiscoverModuleData(module);
+    discoverCheckpoint	*cp;
+    long long		offset, metaoffset, sec;
+    int			volume, nsec, count = 0, len;
+    char		line[MAXPATHLEN + 128], *name;
+    FILE		*fp;
+    sds			key, msg;
+
+    if ((data->checkpoint = dictCreate(&sdsKeyDictCallBacks, NULL)) == NULL)
+	return;
+    if (data->checkpoint_interval == 0)
+	data->checkpoint_interval = CHECKPOINT_INTERVAL;
+    data->checkpoint_timer = pmWebTimerRegister(checkpoint_worker, module);
+
+    if ((fp = fopen(data->checkpoints, "r")) == NULL) {
+	if (oserror() != ENOENT) {
+	    infofmt(msg, "cannot open checkpoints file %s: %s",
+		    data->checkpoints, osstrerror());
+	    moduleinfo(module, PMLOG_WARNING, msg, data->data);
+	}
+	return;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	if (line[0] == '#')
+	    continue;
+	if (sscanf(line, "%d %lld %lld %d %lld %n", &volume, &offset,
+		    &sec, &nsec, &metaoffset, &len) != 5)
+	    continue;
+	name = line + len;
+	name[strcspn(name, "\n")] = '\0';
+	if (*name == '\0')
+	    continue;
+	if ((cp = (discoverCheckpoint *)calloc(1, sizeof(*cp))) == NULL)
+	    break;
+	cp->volume = volume;
+	cp->offset = offset;
+	cp->timestamp.sec = sec;
+	cp->timestamp.nsec = nsec;
+	cp->metaoffset = metaoffset;
+	key = sdsnew(name);
+	if (dictAdd(data->checkpoint, key, cp) != DICT_OK)
+	    free(cp);
+	else
+	    count++;
+	sdsfree(key);
+    }
+    fclose(fp);
+
+    if (pmDebugOptions.discovery)
+	fprintf(stderr, "%s: loaded %d checkpoints from %s\n",
+			"checkpoint_load", count, data->checkpoints);
+}
+
+static discoverCheckpoint *
+checkpoint_lookup(pmDiscover *p)
+{
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
+
+    if (data == NULL || data->checkpoints == NULL)
+	return NULL;
+    if (data->checkpoint == NULL)
+	checkpoint_load(p->module);
+    if (data->checkpoint == NULL)
+	return NULL;
+    return (discoverCheckpoint *)dictFetchValue(data->checkpoint, p->context.name);
+}
+
+static void
+checkpoint_update(pmDiscover *p, __pmTimestamp *stamp)
+{
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
+    discoverCheckpoint	*cp;
+    __pmContext		*ctxp;
+
+    if (data == NULL || data->checkpoints == NULL)
+	return;
+    if ((cp = checkpoint_lookup(p)) == NULL) {
+	if (data->checkpoint == NULL ||
+	    (cp = (discoverCheckpoint *)calloc(1, sizeof(*cp))) == NULL)
+	    return;
+	if (dictAdd(data->checkpoint, p->context.name, cp) != DICT_OK) {
+	    free(cp);
+	    return;
+	}
+    }
+    if ((ctxp = __pmHandleToPtr(p->ctx)) == NULL)
+	return;
+    cp->volume = ctxp->c_archctl->ac_vol;
+    cp->offset = ctxp->c_archctl->ac_offset;
+    PM_UNLOCK(ctxp->c_lock);
+    cp->timestamp = *stamp;
+    cp->metaoffset = lseek(p->fd, 0, SEEK_CUR);
+    cp->active = 1;
+    data->checkpoint_dirty = 1;
+}
+
+static void
+checkpoint_drop(pmDiscover *p)
+{
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
+    discoverCheckpoint	*cp;
+
+    if ((cp = checkpoint_lookup(p)) != NULL) {
+	free(cp);
+	dictDelete(data->checkpoint, p->context.name);
+	data->checkpoint_dirty = 1;
+    }
+}
+
+/*
+ * Position a new archive context for values processing - just after
+ * the last record processed before a restart if there is a (plausible)
+ * checkpoint, else at the current end of the archive.  Metadata is
+ * always processed from the start, as the callbacks need it to decode
+ * values.
+ */
+static void
+checkpoint_resume(pmDiscover *p, struct timespec *end)
+{
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
+    discoverCheckpoint	*cp;
+    struct timespec	after = {0, 1};
+    struct timespec	resume;
+    struct stat		sbuf;
+    __pmContext		*ctxp;
+    __pmArchCtl		*acp;
+    __pmLogCtl		*lcp;
+    char		path[MAXPATHLEN];
+    sds			metaname;
+
+    if ((cp = checkpoint_lookup(p)) == NULL)
+	goto end;
+    cp->active = 1;
+
+    /* an archive recreated under the same name is not resumed */
+    metaname = sdscatfmt(sdsempty(), "%S.meta", p->context.name);
+    if (stat(metaname, &sbuf) < 0 || sbuf.st_size < cp->metaoffset ||
+	cp->timestamp.sec > end->tv_sec ||
+	(cp->timestamp.sec == end->tv_sec && cp->timestamp.nsec > end->tv_nsec)) {
+	if (pmDebugOptions.discovery)
+	    fprintf(stderr, "%s: %s stale checkpoint ignored\n",
+			    "checkpoint_resume", p->context.name);
+	sdsfree(metaname);
+	goto end;
+    }
+    sdsfree(metaname);
+
+    resume.tv_sec = cp->timestamp.sec;
+    resume.tv_nsec = cp->timestamp.nsec;
+    pmtimespecInc(&resume, &after);
+    if (pmSetModeHighRes(PM_MODE_FORW, &resume, &after) < 0)
+	goto end;
+
+    /*
+     * The temporal index has positioned us approximately; if the
+     * checkpoint volume is still uncompressed and has not shrunk,
+     * go directly to the next unprocessed record instead.
+     */
+    if ((ctxp = __pmHandleToPtr(p->ctx)) == NULL)
+	return;
+    acp = ctxp->c_archctl;
+    lcp = acp->ac_log;
+    pmsprintf(path, sizeof(path), "%s.%d", lcp->name, cp->volume);
+    if (cp->volume >= lcp->minvol && cp->volume <= lcp->maxvol &&
+	cp->offset >= (off_t)__pmLogLabelSize(lcp) && stat(path, &sbuf) == 0 &&
+	sbuf.st_size >= cp->offset &&
+	__pmLogChangeVol(acp, cp->volume) >= 0) {
+	acp->ac_vol = cp->volume;
+	acp->ac_offset = cp->offset;
+	acp->ac_serial = 1;
+    }
+    PM_UNLOCK(ctxp->c_lock);
+
+    if (pmDebugOptions.discovery) {
+	char	tbuf[64];
+
+	fprintf(stderr, "%s: %s resuming after %s (vol %d offset %lld)\n",
+		"checkpoint_resume", p->context.name,
+		timestamp_str(&cp->timestamp, tbuf, sizeof(tbuf)),
+		cp->volume, (long long)cp->offset);
+    }
+    mmv_inc(data->map, data->metrics[DISCOVER_CHECKPOINT_RESUMED]);
+    return;
+
+end:
+    pmSetModeHighRes(PM_MODE_FORW, end, &after);
+}
+
+void
+pmDiscoverCheckpointsClose(pmDiscoverModule *module)
+{
+    discoverModuleData	*data = getDiscoverModuleData(module);
+
+    if (data == NULL)
+	return;
+    if (data->checkpoint) {
+	if (data->checkpoint_dirty)
+	    checkpoint_save(module);
+	pmWebTimerRelease(data->checkpoint_timer);
+	checkpoint_free(data);
+    }
+    sdsfree(data->checkpoints);
+    data->checkpoints = NULL;
+}
+
 /*
  * Traverse and invoke callback for all paths matching any bit
  * in the flags bitmap. Callback can be NULL to just get a count.
@@ -207,7 +508,9 @@ pmDiscoverPurgeDeleted(void)
     	while (p) {
 	    next = p->next;
 
-	    if (!(p->flags & PM_DISCOVER_FLAGS_DELETED)) {
+	    if (!(p->flags & PM_DISCOVER_FLAGS_DELETED) ||
+		(p->flags & PM_DISCOVER_FLAGS_LOGVOL_BUSY)) {
+		/* purge busy entries once their logvol work completes */
 		prev = p;
 	    } else {
 		if (prev)
@@ -215,6 +518,8 @@ pmDiscoverPurgeDeleted(void)
 		else
 		    discover_hashtable[i] = next;
 		pmDiscoverInvokeClosedCallBacks(p);
+		if (p->flags & PM_DISCOVER_FLAGS_META)
+		    checkpoint_drop(p);
 		pmDiscoverFree(p);
 		count++;
 	    }
@@ -552,6 +857,7 @@ static struct {
     { PM_DISCOVER_FLAGS_COMPRESSED, "compressed|" },
     { PM_DISCOVER_FLAGS_MONITORED, "monitored|" },
     { PM_DISCOVER_FLAGS_DATAVOL_READY, "datavol-ready|" },
+    { PM_DISCOVER_FLAGS_LOGVOL_BUSY, "logvol-busy|" },
     { PM_DISCOVER_FLAGS_META_IN_PROGRESS, "metavol-in-progress|" },
     { 0, NULL }
 };
@@ -1442,100 +1748,118 @@ bump_logvol_decode_stats(discoverModuleData *data, pmHighResResult *r)
 }
 
 /*
- * Fetch metric values to EOF and call all registered callbacks.
- * Always process metadata thru to EOF before any logvol data.
+ * Fetch the next result from an archive being tailed, with volume switch
+ * handling.  Only the PMAPI context is used (locked within libpcp), so this
+ * is safe to call from a worker thread.  Returns 1 with a result in *rp,
+ * else 0 at the current end of the archive (or the archive is locked, or
+ * on error) - try again on the next callback.
  */
-static void
-process_logvol(pmDiscover *p)
+static int
+logvol_fetch(pmDiscover *p, const char *lock_path, pmHighResResult **rp,
+		unsigned int *changed_vol)
 {
-    discoverModuleData	*data = getDiscoverModuleData(p->module);
     pmHighResResult	*r = NULL;
-    __pmTimestamp	stamp;
     __pmContext		*ctxp;
     __pmArchCtl		*acp;
-    char		*lock_path;
     int			oldcurvol;
     int			sts;
 
-    mmv_inc(data->map, data->metrics[DISCOVER_LOGVOL_CALLBACKS]);
-    lock_path = archive_dir_lock_path(p);
-    for (;;) {
-	if (lock_path && access(lock_path, F_OK) == 0)
-	    break;
-	mmv_inc(data->map, data->metrics[DISCOVER_LOGVOL_LOOPS]);
-	pmUseContext(p->ctx);
+    if (lock_path && access(lock_path, F_OK) == 0)
+	return 0;
+    pmUseContext(p->ctx);
+    ctxp = __pmHandleToPtr(p->ctx);
+    acp = ctxp->c_archctl;
+    oldcurvol = acp->ac_curvol;
+    PM_UNLOCK(ctxp->c_lock);
+
+    if ((sts = pmFetchHighResArchive(&r)) < 0) {
+	/* err handling to skip to the next vol */
 	ctxp = __pmHandleToPtr(p->ctx);
 	acp = ctxp->c_archctl;
-	oldcurvol = acp->ac_curvol;
+	if (oldcurvol < acp->ac_curvol) {
+	    __pmLogChangeVol(acp, acp->ac_curvol);
+	    acp->ac_offset = 0; /* __pmLogFetch will fix it up */
+	    (*changed_vol)++;
+	}
 	PM_UNLOCK(ctxp->c_lock);
 
-	r = NULL; /* so we know if pmFetchArchive() assigned it */
-	if ((sts = pmFetchHighResArchive(&r)) < 0) {
-	    /* err handling to skip to the next vol */
-	    ctxp = __pmHandleToPtr(p->ctx);
-	    acp = ctxp->c_archctl;
-	    if (oldcurvol < acp->ac_curvol) {
-	    	__pmLogChangeVol(acp, acp->ac_curvol);
-		acp->ac_offset = 0; /* __pmLogFetch will fix it up */
-		mmv_inc(data->map, data->metrics[DISCOVER_LOGVOL_CHANGE_VOL]);
-	    }
-	    PM_UNLOCK(ctxp->c_lock);
+	if (sts == PM_ERR_EOL) {
+	    if (pmDebugOptions.discovery)
+		fprintf(stderr, "%s: %s end of archive reached\n",
+			"process_logvol", p->context.name);
+	    /* succesfully processed to current end of log */
+	} else {
+	    /* 
+	     * This log vol was probably deleted (likely compressed)
+	     * under our feet. Try and skip to the next volume.
+	     */
+	    if (pmDebugOptions.discovery)
+		fprintf(stderr, "process_logvol: %s fetch failed:%s\n",
+			p->context.name, pmErrStr(sts));
+	}
+	/* we are done - return and wait for another callback */
+	return 0;
+    }
 
-	    if (sts == PM_ERR_EOL) {
-		if (pmDebugOptions.discovery)
-		    fprintf(stderr, "%s: %s end of archive reached\n",
-			    "process_logvol", p->context.name);
+    if (pmDebugOptions.discovery) {
+	char		tbuf[64], bufs[64];
 
-		/* succesfully processed to current end of log */
-		break;
-	    } else {
-		/* 
-		 * This log vol was probably deleted (likely compressed)
-		 * under our feet. Try and skip to the next volume.
-		 * We hold the context lock during error recovery here.
-		 */
-		if (pmDebugOptions.discovery)
-		    fprintf(stderr, "process_logvol: %s fetch failed:%s\n",
-			p->context.name, pmErrStr(sts));
-	    }
+	fprintf(stderr, "process_logvol: %s FETCHED @%s [%s] %d metrics\n",
+		p->context.name,
+		timespec_str(&r->timestamp, tbuf, sizeof(tbuf)),
+		timespec_stream_str(&r->timestamp, bufs, sizeof(bufs)),
+		r->numpmid);
+    }
+    *rp = r;
+    return 1;
+}
 
-	    /* we are done - return and wait for another callback */
-	    r = NULL;
-	    break;
-	}
+/*
+ * Call the values callbacks for a fetched result, then free it.
+ */
+static void
+logvol_values(pmDiscover *p, pmHighResResult *r, __pmTimestamp *stamp)
+{
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
 
-	/*
-	 * Fetch succeeded - call the values callback and continue
-	 */
-	if (pmDebugOptions.discovery) {
-	    char		tbuf[64], bufs[64];
+    stamp->sec = r->timestamp.tv_sec;
+    stamp->nsec = r->timestamp.tv_nsec;
+    bump_logvol_decode_stats(data, r);
+    pmDiscoverInvokeValuesCallBack(p, stamp, r);
+    pmFreeHighResResult(r);
+}
 
-	    fprintf(stderr, "process_logvol: %s FETCHED @%s [%s] %d metrics\n",
-		    p->context.name,
-		    timespec_str(&r->timestamp, tbuf, sizeof(tbuf)),
-		    timespec_stream_str(&r->timestamp, bufs, sizeof(bufs)),
-		    r->numpmid);
-	}
+/*
+ * Fetch metric values to EOF and call all registered callbacks.
+ * Always process metadata thru to EOF before any logvol data.
+ */
+static void
+logvol_process(pmDiscover *p)
+{
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
+    pmHighResResult	*r;
+    __pmTimestamp	stamp;
+    unsigned int	changed_vol = 0;
+    uint64_t		count;
+    char		*lock_path;
+    int			processed = 0;
 
-	/*
-	 * Consider persistently saving current timestamp so that after a
-	 * restart pmproxy can resume where it left off for each archive.
-	 */
-	stamp.sec = r->timestamp.tv_sec;
-	stamp.nsec = r->timestamp.tv_nsec;
-	bump_logvol_decode_stats(data, r);
-	pmDiscoverInvokeValuesCallBack(p, &stamp, r);
-	pmFreeHighResResult(r);
-	r = NULL;
+    mmv_inc(data->map, data->metrics[DISCOVER_LOGVOL_CALLBACKS]);
+    lock_path = archive_dir_lock_path(p);
+    for (;;) {
+	mmv_inc(data->map, data->metrics[DISCOVER_LOGVOL_LOOPS]);
+	if (logvol_fetch(p, lock_path, &r, &changed_vol) <= 0)
+	    break;
+	/* fetch succeeded - call the values callback and continue */
+	logvol_values(p, r, &stamp);
+	processed++;
     }
+    if ((count = changed_vol) > 0)
+	mmv_add(data->map, data->metrics[DISCOVER_LOGVOL_CHANGE_VOL], &count);
 
-    if (r) {
-	stamp.sec = r->timestamp.tv_sec;
-	stamp.nsec = r->timestamp.tv_nsec;
-	bump_logvol_decode_stats(data, r);
-	pmDiscoverInvokeValuesCallBack(p, &stamp, r);
-	pmFreeHighResResult(r);
-    }
+    /* note position reached, so that a restart can resume from here */
+    if (processed)
+	checkpoint_update(p, &stamp);
 
     /* datavol is now up-to-date and at EOF */
     p->flags &= ~PM_DISCOVER_FLAGS_DATAVOL_READY;
@@ -1544,6 +1868,137 @@ process_logvol(pmDiscover *p)
     	free(lock_path);
 }
 
+/*
+ * Optionally, logvol data is fetched and decoded on libuv worker threads
+ * (up to the [discover] workers setting concurrently) so that one busy
+ * archive does not hold up all others.  Each archive is handled by at
+ * most one worker at a time, and values callbacks (which write to the
+ * key server) are always made back on the event loop thread in order.
+ */
+#define LOGVOL_BATCH	256	/* maximum results decoded per work item */
+
+typedef struct discoverLogvol {
+    uv_work_t		work;
+    pmDiscover		*p;
+    char		*lock_path;
+    unsigned int	count;		/* results decoded */
+    unsigned int	loops;		/* fetch attempts */
+    unsigned int	changed_vol;	/* volume switches */
+    unsigned int	more;		/* batch filled, may be more to do */
+    pmHighResResult	*results[LOGVOL_BATCH];
+} discoverLogvol;
+
+static void logvol_done(uv_work_t *, int);
+
+/* worker thread function - fetch results, no callbacks from here */
+static void
+logvol_work(uv_work_t *work)
+{
+    discoverLogvol	*logvol = (discoverLogvol *)work->data;
+    pmHighResResult	*r;
+
+    while (logvol->count < LOGVOL_BATCH) {
+	logvol->loops++;
+	if (logvol_fetch(logvol->p, logvol->lock_path, &r,
+			&logvol->changed_vol) <= 0)
+	    return;
+	logvol->results[logvol->count++] = r;
+    }
+    logvol->more = 1;
+}
+
+/* start work for queued archives, while workers are available */
+static void
+logvol_dispatch(discoverModuleData *data)
+{
+    discoverLogvol	*logvol;
+    pmDiscover		*p;
+
+    while (data->working < data->workers && (p = data->pending) != NULL) {
+	if ((data->pending = p->pending) == NULL)
+	    data->pendtail = NULL;
+	p->pending = NULL;
+	p->flags &= ~PM_DISCOVER_FLAGS_DATAVOL_READY;
+
+	if ((logvol = calloc(1, sizeof(*logvol))) == NULL) {
+	    p->flags &= ~PM_DISCOVER_FLAGS_LOGVOL_BUSY;
+	    logvol_process(p);
+	    continue;
+	}
+	logvol->p = p;
+	logvol->lock_path = archive_dir_lock_path(p);
+	logvol->work.data = logvol;
+	data->working++;
+	mmv_inc(data->map, data->metrics[DISCOVER_LOGVOL_CALLBACKS]);
+	uv_queue_work(data->events, &logvol->work, logvol_work, logvol_done);
+    }
+}
+
+static void
+process_logvol(pmDiscover *p)
+{
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
+
+    if (data->workers == 0) {
+	logvol_process(p);
+	return;
+    }
+
+    /* if already queued or running, go again when that completes */
+    p->flags |= PM_DISCOVER_FLAGS_DATAVOL_READY;
+    if (p->flags & PM_DISCOVER_FLAGS_LOGVOL_BUSY)
+	return;
+    p->flags |= PM_DISCOVER_FLAGS_LOGVOL_BUSY;
+    if (data->pendtail)
+	data->pendtail->pending = p;
+    else
+	data->pending = p;
+    data->pendtail = p;
+    logvol_dispatch(data);
+}
+
+/* event loop thread - pass the decoded results to values callbacks */
+static void
+logvol_done(uv_work_t *work, int status)
+{
+    discoverLogvol	*logvol = (discoverLogvol *)work->data;
+    pmDiscover		*p = logvol->p;
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
+    __pmTimestamp	stamp;
+    unsigned int	i;
+    uint64_t		count;
+
+    (void)status;
+    if ((count = logvol->loops) > 0)
+	mmv_add(data->map, data->metrics[DISCOVER_LOGVOL_LOOPS], &count);
+    if ((count = logvol->changed_vol) > 0)
+	mmv_add(data->map, data->metrics[DISCOVER_LOGVOL_CHANGE_VOL], &count);
+
+    /*
+     * Values may have been written after the metadata was last read;
+     * pmlogger writes metadata first, so catch up before the callbacks.
+     */
+    if (logvol->count > 0 && p->fd >= 0)
+	process_metadata(p);
+    for (i = 0; i < logvol->count; i++)
+	logvol_values(p, logvol->results[i], &stamp);
+    if (logvol->count > 0)
+	checkpoint_update(p, &stamp);
+
+    data->working--;
+    p->flags &= ~PM_DISCOVER_FLAGS_LOGVOL_BUSY;
+    if (logvol->more)
+	p->flags |= PM_DISCOVER_FLAGS_DATAVOL_READY;
+    if (logvol->lock_path)
+	free(logvol->lock_path);
+    free(logvol);
+
+    if ((p->flags & PM_DISCOVER_FLAGS_DATAVOL_READY) &&
+	!(p->flags & (PM_DISCOVER_FLAGS_DELETED|PM_DISCOVER_FLAGS_META_IN_PROGRESS)))
+	process_logvol(p);
+    logvol_dispatch(data);
+}
+
 static void
 pmDiscoverInvokeCallBacks(pmDiscover *p)
 {
@@ -1561,7 +2016,6 @@ pmDiscoverInvokeCallBacks(pmDiscover *p)
 	 * once off initialization on the first event
 	 */
 	if (p->flags & (PM_DISCOVER_FLAGS_DATAVOL | PM_DISCOVER_FLAGS_META)) {
-	    struct timespec	after = {0, 1};
 	    struct timespec	tp;
 
 	    /*
@@ -1614,15 +2068,16 @@ pmDiscoverInvokeCallBacks(pmDiscover *p)
 	    pmDiscoverNewSource(p, p->ctx);
 
 	    /*
-	     * Seek to end of archive for logvol data (see notes in
-	     * process_logvol routine also).
+	     * Seek to end of archive for logvol data, or to where we got
+	     * up to before a restart (see notes in process_logvol also).
 	     */
-	    pmSetModeHighRes(PM_MODE_FORW, &tp, &after);
+	    checkpoint_resume(p, &tp);
 
 	    /*
 	     * For archive meta files, p->fd is the direct file descriptor
 	     * and we pre-scan all existing metadata. Note: we do NOT scan
-	     * pre-existing logvol data (see pmSetModeHighRes above)
+	     * pre-existing logvol data (see checkpoint_resume above), other
+	     * than any written since a checkpoint before a restart.
 	     */
 	    metaname = sdsnew(p->context.name);
 	    metaname = sdscat(metaname, ".meta");
@@ -44,6 +44,11 @@ typedef void uv_loop_t;
  * PM_DISCOVER_FLAGS_META_IN_PROGRESS is set, set PM_DISCOVER_FLAGS_DATAVOL_READY
  * so we know to process the log volume callback once the metadata read has
  * completed.
+ *
+ * When logvol workers are configured, PM_DISCOVER_FLAGS_LOGVOL_BUSY indicates
+ * the archive is queued for or being decoded by a worker thread. Callbacks
+ * received meanwhile set PM_DISCOVER_FLAGS_DATAVOL_READY and the archive is
+ * queued again when the current work completes.
  */
 
 /*
@@ -62,6 +67,7 @@ typedef enum pmDiscoverFlags {
     PM_DISCOVER_FLAGS_META			= (1 << 7), /* archive metadata */
     PM_DISCOVER_FLAGS_DATAVOL_READY		= (1 << 8), /* flag: datavol data available */
     PM_DISCOVER_FLAGS_META_IN_PROGRESS		= (1 << 9), /* flag: metadata read in progress */
+    PM_DISCOVER_FLAGS_LOGVOL_BUSY		= (1 << 10), /* flag: logvol worker queued/active */
 
     PM_DISCOVER_FLAGS_ALL			= ((unsigned int)~PM_DISCOVER_FLAGS_NONE)
 } pmDiscoverFlags;
@@ -88,6 +94,7 @@ typedef struct pmDiscover {
     struct stat			statbuf;	/* stat buffer */
     void			*baton;		/* private internal lib data */
     void			*data;		/* opaque user data pointer */
+    struct pmDiscover		*pending;	/* queue waiting for a worker */
 } pmDiscover;
 
 extern void pmSeriesDiscoverSource(pmDiscoverEvent *, void *);
@@ -133,9 +140,22 @@ enum {
     DISCOVER_THROTTLE,
     DISCOVER_META_PARTIAL_READS,
     DISCOVER_DECODE_RESULT_ERRORS,
+    DISCOVER_CHECKPOINT_RESUMED,
     NUM_DISCOVER_METRIC
 };
 
+/*
+ * Position reached in one archive, persisted across restarts so that
+ * discovery can resume from there instead of the end of the archive.
+ */
+typedef struct discoverCheckpoint {
+    int				volume;		/* data volume of next record */
+    off_t			offset;		/* offset of next record */
+    __pmTimestamp		timestamp;	/* last record processed */
+    off_t			metaoffset;	/* metadata processed */
+    unsigned int		active;		/* archive seen since loading */
+} discoverCheckpoint;
+
 /*
  * Module internals data structure
  */
@@ -157,6 +177,18 @@ typedef struct discoverModuleData {
     unsigned int		exclude_indoms;	/* exclude instance domains */
     struct dict			*indoms;	/* dict of excluded InDoms */
 
+    sds				checkpoints;	/* checkpoint file path */
+    struct dict			*checkpoint;	/* archive: discoverCheckpoint */
+    unsigned int		checkpoint_dirty;
+    unsigned int		checkpoint_interval; /* seconds between saves */
+    unsigned int		checkpoint_ticks;
+    int				checkpoint_timer;
+
+    unsigned int		workers;	/* max concurrent logvol workers */
+    unsigned int		working;	/* logvol workers in progress */
+    struct pmDiscover		*pending;	/* archives waiting for a worker */
+    struct pmDiscover		*pendtail;
+
     void			*data;		/* user-supplied pointer */
 } discoverModuleData;
 
@@ -165,5 +197,6 @@ extern discoverModuleData *getDiscoverModuleData(pmDiscoverModule *);
 extern int pmDiscoverRegister(const char *,
 		pmDiscoverModule *, pmDiscoverCallBacks *, void *);
 extern void pmDiscoverUnregister(int);
+extern void pmDiscoverCheckpointsClose(pmDiscoverModule *);
 
 #endif /* SERIES_DISCOVER_H */
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#include <math.h>
+#include "pmapi.h"
+#include "kernels.h"
+
+/*
+ * No intrinsics here - plain loops the compiler vectorizes for the
+ * target (SSE2/AVX2 on x86_64, Advanced SIMD on aarch64, and so on),
+ * see the per-object CFLAGS in the GNUmakefile.  With function
+ * multi-versioning the loader picks the AVX2 clone on capable CPUs.
+ */
+#ifdef HAVE_ATTRIBUTE_TARGET_CLONES
+#define VECTOR	__attribute__((target_clones("avx2","default")))
+#else
+#define VECTOR
+#endif
+
+/*
+ * Reductions keep LANES independent partial results, so that they
+ * map onto vector registers without reassociating floating point
+ * operations (which the compiler will not do by itself).
+ */
+#define LANES	4
+
+/*
+ * Index of the (first) largest value, as for a scalar scan using
+ * "if (max < v[i])" - NaN values are skipped unless v[0] is NaN.
+ */
+VECTOR int
+series_vector_max(const double *v, int n)
+{
+    double	m[LANES], max;
+    int		i, l;
+
+    if (n <= 0)
+	return 0;
+    for (l = 0; l < LANES; l++)
+	m[l] = v[0];
+    for (i = 0; i + LANES <= n; i += LANES)
+	for (l = 0; l < LANES; l++)
+	    m[l] = v[i+l] > m[l] ? v[i+l] : m[l];
+    for (; i < n; i++)
+	m[0] = v[i] > m[0] ? v[i] : m[0];
+    for (max = m[0], l = 1; l < LANES; l++)
+	max = m[l] > max ? m[l] : max;
+    for (i = 0; i < n; i++)
+	if (v[i] == max)
+	    return i;
+    return 0;
+}
+
+VECTOR int
+series_vector_min(const double *v, int n)
+{
+    double	m[LANES], min;
+    int		i, l;
+
+    if (n <= 0)
+	return 0;
+    for (l = 0; l < LANES; l++)
+	m[l] = v[0];
+    for (i = 0; i + LANES <= n; i += LANES)
+	for (l = 0; l < LANES; l++)
+	    m[l] = v[i+l] < m[l] ? v[i+l] : m[l];
+    for (; i < n; i++)
+	m[0] = v[i] < m[0] ? v[i] : m[0];
+    for (min = m[0], l = 1; l < LANES; l++)
+	min = m[l] < min ? m[l] : min;
+    for (i = 0; i < n; i++)
+	if (v[i] == min)
+	    return i;
+    return 0;
+}
+
+VECTOR double
+series_vector_sum(const double *v, int n)
+{
+    double	s[LANES] = {0};
+    int		i, l;
+
+    for (i = 0; i + LANES <= n; i += LANES)
+	for (l = 0; l < LANES; l++)
+	    s[l] += v[i+l];
+    for (; i < n; i++)
+	s[0] += v[i];
+    return (s[0] + s[1]) + (s[2] + s[3]);
+}
+
+/*
+ * Sum of squared deviations from the mean, for standard deviation
+ */
+VECTOR double
+series_vector_sumsq(const double *v, int n, double mean)
+{
+    double	s[LANES] = {0}, d;
+    int		i, l;
+
+    for (i = 0; i + LANES <= n; i += LANES) {
+	for (l = 0; l < LANES; l++) {
+	    d = v[i+l] - mean;
+	    s[l] += d * d;
+	}
+    }
+    for (; i < n; i++) {
+	d = v[i] - mean;
+	s[0] += d * d;
+    }
+    return (s[0] + s[1]) + (s[2] + s[3]);
+}
+
+VECTOR void
+series_vector_scale(double *v, int n, double mult)
+{
+    int		i;
+
+    for (i = 0; i < n; i++)
+	v[i] *= mult;
+}
+
+VECTOR void
+series_vector_abs(double *v, int n)
+{
+    int		i;
+
+    for (i = 0; i < n; i++)
+	v[i] = fabs(v[i]);
+}
+
+VECTOR void
+series_vector_floor(double *v, int n)
+{
+    int		i;
+
+    for (i = 0; i < n; i++)
+	v[i] = floor(v[i]);
+}
+
+VECTOR void
+series_vector_round(double *v, int n)
+{
+    int		i;
+
+    for (i = 0; i < n; i++)
+	v[i] = round(v[i]);
+}
+
+VECTOR void
+series_vector_sqrt(double *v, int n)
+{
+    int		i;
+
+    for (i = 0; i < n; i++)
+	v[i] = sqrt(v[i]);
+}
+
+/*
+ * Logarithm to the base whose natural logarithm is divisor (1.0 for
+ * natural logarithms), dividing as the scalar code does rather than
+ * multiplying by a reciprocal, so that results are identical.
+ */
+VECTOR void
+series_vector_log(double *v, int n, double divisor)
+{
+    int		i;
+
+    for (i = 0; i < n; i++)
+	v[i] = log(v[i]) / divisor;
+}
+
+VECTOR void
+series_vector_add(double *l, double lmult, const double *r, double rmult, int n)
+{
+    int		i;
+
+    for (i = 0; i < n; i++)
+	l[i] = l[i] * lmult + r[i] * rmult;
+}
+
+VECTOR void
+series_vector_sub(double *l, double lmult, const double *r, double rmult, int n)
+{
+    int		i;
+
+    for (i = 0; i < n; i++)
+	l[i] = l[i] * lmult - r[i] * rmult;
+}
+
+VECTOR void
+series_vector_mul(double *l, double lmult, const double *r, double rmult, int n)
+{
+    int		i;
+
+    for (i = 0; i < n; i++)
+	l[i] = (l[i] * lmult) * (r[i] * rmult);
+}
+
+VECTOR void
+series_vector_div(double *l, double lmult, const double *r, double rmult, int n)
+{
+    int		i;
+
+    for (i = 0; i < n; i++)
+	l[i] = (l[i] * lmult) / (r[i] * rmult);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#ifndef SERIES_KERNELS_H
+#define SERIES_KERNELS_H
+
+/*
+ * Kernels operating on whole arrays of (binary) sample values, used by
+ * the series query functions.  These are written so that the compiler
+ * vectorizes them, and where supported (x86_64) an AVX2 variant of each
+ * is selected at runtime, with the baseline variant as fallback.
+ */
+
+/* reductions - index of the first maximum/minimum, sums */
+extern int series_vector_max(const double *, int);
+extern int series_vector_min(const double *, int);
+extern double series_vector_sum(const double *, int);
+extern double series_vector_sumsq(const double *, int, double);
+
+/* in-place element-wise operations */
+extern void series_vector_scale(double *, int, double);
+extern void series_vector_abs(double *, int);
+extern void series_vector_floor(double *, int);
+extern void series_vector_round(double *, int);
+extern void series_vector_sqrt(double *, int);
+extern void series_vector_log(double *, int, double);
+
+/* l[i] = (l[i] * lmult) op (r[i] * rmult) */
+extern void series_vector_add(double *, double, const double *, double, int);
+extern void series_vector_sub(double *, double, const double *, double, int);
+extern void series_vector_mul(double *, double, const double *, double, int);
+extern void series_vector_div(double *, double, const double *, double, int);
+
+#endif	/* SERIES_KERNELS_H */
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+/*
+ * Micro-benchmark for the series query kernels, comparing each with
+ * the equivalent one-value-at-a-time scalar loop.
+ *
+ * Usage: kernels_bench [values [iterations]]
+ */
+#include <math.h>
+#include <time.h>
+#include "pmapi.h"
+#include "kernels.h"
+
+static double
+now(void)
+{
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report(const char *name, double scalar, double vector, long values)
+{
+    printf("%-8s scalar %7.3f ns/value  vector %7.3f ns/value  speedup %.2fx\n",
+	    name, scalar * 1e9 / values, vector * 1e9 / values,
+	    vector > 0 ? scalar / vector : 0.0);
+}
+
+int
+main(int argc, char **argv)
+{
+    double	*v, *w, *r, t0, t1, t2, sum = 0, check = 0;
+    int		n = 1000000, iter = 50, i, j, k;
+
+    if (argc > 1)
+	n = atoi(argv[1]);
+    if (argc > 2)
+	iter = atoi(argv[2]);
+    if (n <= 0 || iter <= 0) {
+	fprintf(stderr, "Usage: %s [values [iterations]]\n", argv[0]);
+	exit(1);
+    }
+    v = malloc(n * sizeof(double));
+    w = malloc(n * sizeof(double));
+    r = malloc(n * sizeof(double));
+    if (v == NULL || w == NULL || r == NULL) {
+	fprintf(stderr, "%s: out of memory\n", argv[0]);
+	exit(1);
+    }
+    srandom(42);
+    for (i = 0; i < n; i++) {
+	v[i] = (random() % 2000000) / 7.0 - 100000.0;
+	r[i] = (random() % 1000) + 1.0;
+    }
+
+    /* reductions, as in the time-domain max/min/sum/stdev functions */
+    t0 = now();
+    for (j = 0; j < iter; j++) {
+	for (k = 0, i = 1; i < n; i++)
+	    if (v[k] < v[i])
+		k = i;
+	check += k;
+    }
+    t1 = now();
+    for (j = 0; j < iter; j++)
+	check -= series_vector_max(v, n);
+    t2 = now();
+    report("max", t1 - t0, t2 - t1, (long)n * iter);
+
+    t0 = now();
+    for (j = 0; j < iter; j++)
+	for (i = 0; i < n; i++)
+	    sum += v[i];
+    t1 = now();
+    for (j = 0; j < iter; j++)
+	sum -= series_vector_sum(v, n);
+    t2 = now();
+    report("sum", t1 - t0, t2 - t1, (long)n * iter);
+
+    t0 = now();
+    for (j = 0; j < iter; j++)
+	for (i = 0; i < n; i++)
+	    sum += pow(v[i] - 1.0, 2);
+    t1 = now();
+    for (j = 0; j < iter; j++)
+	sum -= series_vector_sumsq(v, n, 1.0);
+    t2 = now();
+    report("stdev", t1 - t0, t2 - t1, (long)n * iter);
+
+    /* element-wise, as in rescale/abs/floor/sqrt and binary operators */
+    t0 = now();
+    for (j = 0; j < iter; j++) {
+	memcpy(w, v, n * sizeof(double));
+	for (i = 0; i < n; i++)
+	    w[i] = fabs(w[i]);
+    }
+    t1 = now();
+    for (j = 0; j < iter; j++) {
+	memcpy(w, v, n * sizeof(double));
+	series_vector_abs(w, n);
+    }
+    t2 = now();
+    report("abs", t1 - t0, t2 - t1, (long)n * iter);
+
+    t0 = now();
+    for (j = 0; j < iter; j++) {
+	memcpy(w, r, n * sizeof(double));
+	for (i = 0; i < n; i++)
+	    w[i] = sqrt(w[i]);
+    }
+    t1 = now();
+    for (j = 0; j < iter; j++) {
+	memcpy(w, r, n * sizeof(double));
+	series_vector_sqrt(w, n);
+    }
+    t2 = now();
+    report("sqrt", t1 - t0, t2 - t1, (long)n * iter);
+
+    t0 = now();
+    for (j = 0; j < iter; j++) {
+	memcpy(w, v, n * sizeof(double));
+	for (i = 0; i < n; i++)
+	    w[i] = (w[i] * 1024.0) / (r[i] * 1.0);
+    }
+    t1 = now();
+    for (j = 0; j < iter; j++) {
+	memcpy(w, v, n * sizeof(double));
+	series_vector_div(w, 1024.0, r, 1.0, n);
+    }
+    t2 = now();
+    report("divide", t1 - t0, t2 - t1, (long)n * iter);
+
+    /* keep the compiler from discarding the scalar loops */
+    if (check != 0 || fabs(sum) > n * iter * 1e-6 * 1e10)
+	printf("results differ: index %g, sum %g\n", check, sum);
+
+    free(v);
+    free(w);
+    free(r);
+    exit(0);
+}
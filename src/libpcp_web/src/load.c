@@ -267,29 +267,30 @@ static sds
 pmwebapi_extract_events(pmValueSet *vsp, int inst)
 {
     sds			s;
-    int			record, param, nrecords, flags, sts;
-    pmResult		**results, *result;
+    int			record, param, flags, sts;
+    pmEventIter		iter;
+    pmEventParam	ep;
+    struct timeval	stamp;
 
-    if ((sts = nrecords = pmUnpackEventRecords(vsp, inst, &results)) < 0) {
+    if ((sts = pmEventIterInit(&iter, vsp, inst)) < 0) {
 	if (pmDebugOptions.series)
-	    fprintf(stderr, "pmUnpackEventRecords: %s\n", pmErrStr(sts));
+	    fprintf(stderr, "pmEventIterInit: %s\n", pmErrStr(sts));
 	return NULL;
     }
-    nrecords = sts;
     pmwebapi_event_flags();
     pmwebapi_event_missed();
     s = sdsnewlen("{", 1);
-    for (record = 0; record < nrecords; record++) {
+    for (record = 0; pmEventIterNextRecord(&iter); record++) {
 	if (record > 0)
 	    s = sdscatlen(s, ",", 1);
-	result = results[record];
+	stamp.tv_sec = iter.timestamp.tv_sec;
+	stamp.tv_usec = iter.timestamp.tv_nsec / 1000;
 	s = sdscatfmt(s, "\"timestamp\":");
-	s = pmwebapi_usectimestamp(s, &result->timestamp);
-	for (param = flags = 0; param < result->numpmid; param++)
-	    s = pmwebapi_event_parameter(s, result->vset[param], param, &flags);
+	s = pmwebapi_usectimestamp(s, &stamp);
+	for (param = flags = 0; pmEventIterNextParam(&iter, &ep); param++)
+	    s = pmwebapi_event_parameter(s, &ep, param, &flags);
     }
     s = sdscatlen(s, "}", 1);
-    pmFreeEventResult(results);
     return s;
 }
 
@@ -297,29 +298,27 @@ static sds
 pmwebapi_extract_highres_events(pmValueSet *vsp, int inst)
 {
     sds			s;
-    int			record, param, nrecords, flags, sts;
-    pmHighResResult	**results, *result;
+    int			record, param, flags, sts;
+    pmEventIter		iter;
+    pmEventParam	ep;
 
-    if ((sts = pmUnpackHighResEventRecords(vsp, inst, &results)) < 0) {
+    if ((sts = pmEventIterInit(&iter, vsp, inst)) < 0) {
 	if (pmDebugOptions.series)
-	    fprintf(stderr, "pmUnpackHighResEventRecords: %s\n", pmErrStr(sts));
+	    fprintf(stderr, "pmEventIterInit: %s\n", pmErrStr(sts));
 	return NULL;
     }
-    nrecords = sts;
     pmwebapi_event_flags();
     pmwebapi_event_missed();
     s = sdsempty();
-    for (record = 0; record < nrecords; record++) {
+    for (record = 0; pmEventIterNextRecord(&iter); record++) {
 	if (record > 0)
 	    s = sdscatlen(s, ",", 1);
-	result = results[record];
 	s = sdscatfmt(s, "\"timestamp\":");
-	s = pmwebapi_nsectimestamp(s, &result->timestamp);
-	for (param = flags = 0; param < result->numpmid; param++)
-	    s = pmwebapi_event_parameter(s, result->vset[param], param, &flags);
+	s = pmwebapi_nsectimestamp(s, &iter.timestamp);
+	for (param = flags = 0; pmEventIterNextParam(&iter, &ep); param++)
+	    s = pmwebapi_event_parameter(s, &ep, param, &flags);
     }
     s = sdscatlen(s, "}", 1);
-    pmFreeHighResEventResult(results);
     return s;
 }
 
@@ -55,6 +55,7 @@ typedef struct context {
     struct dict		*indoms;	/* indom number to indom struct */
     struct dict		*domains;	/* domain number to domain struct */
     struct dict		*clusters;	/* domain+cluster to cluster struct */
+    struct dict		*scrapes;	/* metric names to scrape plans */
     sds			labels;		/* context labelset as string */
     pmLabelSet		*labelset;	/* labelset at context level */
     void		*privdata;
@@ -83,7 +84,9 @@ typedef struct instance {
     unsigned int	inst;		/* internal instance identifier */
     unsigned int	cached : 1;	/* metadata is already cached */
     unsigned int	updated : 1;	/* instance labels are updated */
-    unsigned int	padding : 30;
+    unsigned int	labelled : 1;	/* instance labels were requested */
+    unsigned int	padding : 29;
+    unsigned int	generation;	/* changes with name or hash */
     sds			labels;		/* fully merged inst labelset */
     pmLabelSet		*labelset;	/* labels at inst level or NULL */
     labellist_t		*labellist;	/* label name/value mapping set */
@@ -112,6 +115,7 @@ typedef struct cluster {
 typedef struct value {
     int			inst;		/* internal instance identifier */
     unsigned int	updated;	/* last sample modified value */
+    unsigned int	mapped;		/* instance generation sent */
     pmAtomValue		atom;		/* most recent sampled value */
 } value_t;
 
@@ -142,6 +146,29 @@ typedef struct metric {
     } u;
 } metric_t;
 
+/*
+ * Cached scrape plan - the metrics found by traversing the PMNS
+ * for a set of scrape names, with their metadata and labels in the
+ * final (rendered) form, kept until the namespace or labels change.
+ */
+typedef struct scrapemetric {
+    metric_t		*metric;
+    sds			sem;		/* metric semantics as a string */
+    sds			type;		/* metric type as a string */
+    sds			units;		/* metric units as a string */
+    sds			labels;		/* rendered labels, PM_IN_NULL */
+    struct dict		*instlabels;	/* rendered labels by instance */
+} scrapemetric_t;
+
+typedef struct scrapeplan {
+    unsigned int	numpmid;	/* count of metrics to scrape */
+    unsigned int	invalid : 1;	/* plan must be rebuilt on use */
+    unsigned int	relabel : 1;	/* labels changed since scraped */
+    unsigned int	padding : 30;	/* zero-fill structure padding */
+    scrapemetric_t	*metrics;	/* metrics and rendered metadata */
+    pmID		*pmidlist;	/* identifiers for pmFetch */
+} scrapeplan_t;
+
 struct seriesGetContext;
 extern void doneSeriesGetContext(struct seriesGetContext *, const char *);
 
@@ -99,6 +99,14 @@ sdsFreeCallBack(void *privdata, void *val)
     sdsfree(val);
 }
 
+dictType intSdsDictCallBacks = {
+    .hashFunction	= intHashCallBack,
+    .keyCompare		= intCmpCallBack,
+    .keyDup		= intDupCallBack,
+    .keyDestructor	= intFreeCallBack,
+    .valDestructor	= sdsFreeCallBack,
+};
+
 dictType sdsKeyDictCallBacks = {
     .hashFunction	= sdsHashCallBack,
     .keyCompare		= sdsCompareCallBack,
@@ -28,3 +28,9 @@ pmDiscoverUnregister(int handle)
 {
     (void)handle;
 }
+
+void
+pmDiscoverCheckpointsClose(pmDiscoverModule *module)
+{
+    (void)module;
+}
@@ -24,6 +24,8 @@
 #include "schema.h"
 #include "slots.h"
 #include "maps.h"
+#include "kernels.h"
+#include "sketch.h"
 #include <math.h>
 #include <fnmatch.h>
 
@@ -91,6 +93,98 @@ initSeriesGetQuery(seriesQueryBaton *baton, node_t *root, timing_t *timing)
     baton->query.timing = *timing;
 }
 
+/*
+ * Allocate the (columnar) value storage for n instances of a sample
+ */
+static int
+series_instance_alloc(series_instance_set_t *set, int n)
+{
+    set->num_instances = n;
+    set->value_format = NULL;
+    set->series_instance = (pmSeriesValue *)calloc(n, sizeof(pmSeriesValue));
+    set->value = (double *)calloc(n, sizeof(double));
+    if (n > 0 && (set->series_instance == NULL || set->value == NULL)) {
+	free(set->series_instance);
+	free(set->value);
+	set->series_instance = NULL;
+	set->value = NULL;
+	set->num_instances = 0;
+	return -ENOMEM;
+    }
+    return 0;
+}
+
+/*
+ * Value string of instance k - computed values are formatted on demand
+ */
+static sds
+series_instance_data(series_instance_set_t *set, int k)
+{
+    pmSeriesValue	*vp = &set->series_instance[k];
+
+    if (vp->data == NULL)
+	vp->data = sdscatprintf(sdsempty(), set->value_format, set->value[k]);
+    return vp->data;
+}
+
+/*
+ * Store a computed value for instance k, deferring its string form
+ */
+static void
+series_instance_set_value(series_instance_set_t *set, int k,
+		double value, const char *format)
+{
+    sdsfree(set->series_instance[k].data);
+    set->series_instance[k].data = NULL;
+    set->value[k] = value;
+    set->value_format = format;
+}
+
+/*
+ * Store a value string (e.g. as formatted for a specific metric type)
+ */
+static void
+series_instance_set_data(series_instance_set_t *set, int k, sds data)
+{
+    sdsfree(set->series_instance[k].data);
+    set->series_instance[k].data = data;
+    set->value[k] = strtod(data, NULL);
+}
+
+/*
+ * Values of all instances were updated in place, discard stale strings
+ */
+static void
+series_instance_values_updated(series_instance_set_t *set, const char *format)
+{
+    int			k;
+
+    for (k = 0; k < set->num_instances; k++) {
+	sdsfree(set->series_instance[k].data);
+	set->series_instance[k].data = NULL;
+    }
+    set->value_format = format;
+}
+
+/*
+ * Copy instance sk from one sample to instance dk of another
+ */
+static void
+series_instance_copy(series_instance_set_t *dst, int dk,
+		series_instance_set_t *src, int sk)
+{
+    pmSeriesValue	*sp = &src->series_instance[sk];
+    pmSeriesValue	*dp = &dst->series_instance[dk];
+
+    dp->timestamp = sdsnew(sp->timestamp);
+    dp->series = sdsnew(sp->series);
+    dp->data = sp->data ? sdsnew(sp->data) : NULL;
+    dp->ts = sp->ts;
+    dst->value[dk] = src->value[sk];
+    if (sp->data == NULL)
+	dst->value_format = src->value_format;
+}
+
 static int
 skip_free_value_set(node_t *np)
 {
@@ -124,9 +218,13 @@ freeSeriesQueryNode(node_t *np)
 		    sdsfree(np->value_set.series_values[i].series_sample[j].series_instance[k].data);
 		}
 		free(np->value_set.series_values[i].series_sample[j].series_instance);
+		free(np->value_set.series_values[i].series_sample[j].value);
+	    }
+	    if (np->value_set.series_values[i].sid != NULL) {
+		/* not set if a reducer failed part way */
+		sdsfree(np->value_set.series_values[i].sid->name);
+		free(np->value_set.series_values[i].sid);
 	    }
-	    sdsfree(np->value_set.series_values[i].sid->name);
-	    free(np->value_set.series_values[i].sid);
 	    free(np->value_set.series_values[i].series_sample);
 	    sdsfree(np->value_set.series_values[i].series_desc.indom);
 	    sdsfree(np->value_set.series_values[i].series_desc.pmid);
@@ -1744,10 +1842,11 @@ series_query_report_matches(void *arg)
      * Store the canonical query to Redis if this query statement has
      * function operation.
      */
-    if (has_function != 0)
+    if (has_function > 0)
 	series_key_hash_expression(baton, hashbuf, sizeof(hashbuf));
 
-    series_report_set(baton, baton->query.root);
+    if (has_function >= 0)
+	series_report_set(baton, baton->query.root);
     series_query_end_phase(baton);
 }
 
@@ -1820,13 +1919,15 @@ series_instance_store_to_node(seriesQueryBaton *baton, sds series,
 	if (extract_string(baton, series, elements[i+1], &value->data, "value") < 0)
 	    sts = -EPROTO;
 	else {
-	    /* update value instance */
-	    pmSeriesValue *valinst = &np->value_set.series_values[idx_series].series_sample[idx_sample].series_instance[idx_instance];
+	    /* update value instance, parsing the value just this once */
+	    series_instance_set_t *set = &np->value_set.series_values[idx_series].series_sample[idx_sample];
+	    pmSeriesValue *valinst = &set->series_instance[idx_instance];
 
 	    valinst->ts = value->ts; /* struct pmTimespec assign */
 	    valinst->timestamp = sdsnew(value->timestamp);
 	    valinst->series = sdsnew(value->series);
 	    valinst->data = sdsnew(value->data);
+	    set->value[idx_instance] = strtod(value->data, NULL);
 	    ++idx_instance;
 	}
     }
@@ -1932,11 +2033,10 @@ series_values_store_to_node(seriesQueryBaton *baton, sds series,
 	    break;
 	
 	idx_sample = i;
-	np->value_set.series_values[idx_series].series_sample[idx_sample].num_instances = reply->elements/2;
-	if ((np->value_set.series_values[idx_series].series_sample[idx_sample].series_instance =
-		(pmSeriesValue *)calloc(reply->elements/2, sizeof(pmSeriesValue))) == NULL) {
-	    /* TODO: error report here */
-	    baton->error = -ENOMEM;
+	if ((sts = series_instance_alloc(&np->value_set.series_values[idx_series].series_sample[idx_sample],
+		reply->elements/2)) < 0) {
+	    baton->error = sts;
+	    goto last_sample;
 	}
 	if ((sts = series_instance_store_to_node(baton, series, &sampling.value,
 				reply->elements, reply->element, np, idx_sample)) < 0) {
@@ -2372,6 +2472,8 @@ series_expr_canonical(node_t *np, int idx)
     case N_TOPK_SAMPLE:
     case N_NTH_PERCENTILE_INST:
     case N_NTH_PERCENTILE_SAMPLE:
+    case N_APPROX_PERCENTILE_INST:
+    case N_APPROX_PERCENTILE_SAMPLE:
 	left = series_expr_canonical(np->left, idx);
 	right = series_expr_canonical(np->right, idx);
 	break;
@@ -2472,6 +2574,12 @@ series_expr_canonical(node_t *np, int idx)
     case N_NTH_PERCENTILE_SAMPLE:
 	statement = sdscatfmt(sdsempty(), "nth_percentile_inst(%S, %S)", left, right);
 	break;
+    case N_APPROX_PERCENTILE_INST:
+	statement = sdscatfmt(sdsempty(), "approx_percentile_inst(%S, %S)", left, right);
+	break;
+    case N_APPROX_PERCENTILE_SAMPLE:
+	statement = sdscatfmt(sdsempty(), "approx_percentile_sample(%S, %S)", left, right);
+	break;
     case N_ANON:
 	break;
     case N_RATE:
@@ -2584,14 +2692,19 @@ series_function_hash(unsigned char *hash, node_t *np, int idx)
 static void
 series_node_values_report(seriesQueryBaton *baton, node_t *np)
 {
+    series_instance_set_t	*set;
     sds		series;
     int		i, j, k;
 
     for (i = 0; i < np->value_set.num_series; i++) {
 	series = np->value_set.series_values[i].sid->name;
 	for (j = 0; j < np->value_set.series_values[i].num_samples; j++) {
-	    for (k = 0; k < np->value_set.series_values[i].series_sample[j].num_instances; k++) {
-		pmSeriesValue value = np->value_set.series_values[i].series_sample[j].series_instance[k];
+	    set = &np->value_set.series_values[i].series_sample[j];
+	    for (k = 0; k < set->num_instances; k++) {
+		pmSeriesValue value = set->series_instance[k];
+
+		/* binary values are converted to strings only here */
+		value.data = series_instance_data(set, k);
 		baton->callbacks->on_value(series, &value, baton->userdata);
 	    }
 	}
@@ -2615,10 +2728,10 @@ static void
 series_calculate_rate(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
-    pmSeriesValue	s_pmval, t_pmval;
+    series_instance_set_t *s_set, *t_set;
+    pmSeriesValue	*s_pmval, *t_pmval;
     unsigned int	n_instances, n_samples, i, j, k;
-    double		s_data, t_data, mult;
-    char		str[256];
+    double		mult;
     sds			msg, expr;
     int			sts;
     pmUnits		units = {0};
@@ -2636,36 +2749,34 @@ series_calculate_rate(node_t *np, void *arg)
 				np->value_set.series_values[i].series_sample[j].num_instances, n_instances);
 		    continue;
 		}
+		s_set = &np->value_set.series_values[i].series_sample[j-1];
+		t_set = &np->value_set.series_values[i].series_sample[j];
 		for (k = 0; k < n_instances; k++) {
-		    t_pmval = np->value_set.series_values[i].series_sample[j-1].series_instance[k];
-		    s_pmval = np->value_set.series_values[i].series_sample[j].series_instance[k];
-		    if (strcmp(s_pmval.series, t_pmval.series) != 0) {
+		    s_pmval = &s_set->series_instance[k];
+		    t_pmval = &t_set->series_instance[k];
+		    if (strcmp(s_pmval->series, t_pmval->series) != 0) {
 			/* TODO: two SIDs of the instances' names between samples are different, report error. */
 			if (pmDebugOptions.query) {
 			    fprintf(stderr, "TODO: two SIDs of the instances' names between samples are different, report error.");
-			    fprintf(stderr, "%s %s\n", s_pmval.series, t_pmval.series);
+			    fprintf(stderr, "%s %s\n", s_pmval->series, t_pmval->series);
 			}
 		    }
 
 		    /* compute rate/sec from delta value and delta timestamp */
-		    s_data = strtod(s_pmval.data, NULL);
-		    t_data = strtod(t_pmval.data, NULL);
-		    pmsprintf(str, sizeof(str), "%.6lf", (t_data - s_data) / pmTimespec_delta(&t_pmval.ts, &s_pmval.ts));
-
-		    sdsfree(np->value_set.series_values[i].series_sample[j-1].series_instance[k].data);
-		    sdsfree(np->value_set.series_values[i].series_sample[j-1].series_instance[k].timestamp);
-		    np->value_set.series_values[i].series_sample[j-1].series_instance[k].data = sdsnew(str);
-		    np->value_set.series_values[i].series_sample[j-1].series_instance[k].timestamp =
-		    	sdsnew(np->value_set.series_values[i].series_sample[j].series_instance[k].timestamp);
-		    np->value_set.series_values[i].series_sample[j-1].series_instance[k].ts =
-		    	np->value_set.series_values[i].series_sample[j].series_instance[k].ts;
+		    series_instance_set_value(s_set, k,
+			(t_set->value[k] - s_set->value[k]) /
+			pmTimespec_delta(&t_pmval->ts, &s_pmval->ts), "%.6lf");
+
+		    sdsfree(s_pmval->timestamp);
+		    s_pmval->timestamp = sdsnew(t_pmval->timestamp);
+		    s_pmval->ts = t_pmval->ts;
 		}
 		if (j == n_samples-1) {
 		    /* Free the last sample */
 		    for (k = 0; k < n_instances; k++) {
-			sdsfree(np->value_set.series_values[i].series_sample[j].series_instance[k].timestamp);
-			sdsfree(np->value_set.series_values[i].series_sample[j].series_instance[k].series);
-			sdsfree(np->value_set.series_values[i].series_sample[j].series_instance[k].data);
+			sdsfree(t_set->series_instance[k].timestamp);
+			sdsfree(t_set->series_instance[k].series);
+			sdsfree(t_set->series_instance[k].data);
 		    }
 		    np->value_set.series_values[i].num_samples -= 1;
 		}
@@ -2701,11 +2812,11 @@ static void
 series_calculate_time_domain_max(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
-    unsigned int	n_series, n_samples, n_instances, i, j, k;
-    double		max_data, data;
+    series_instance_set_t *set;
+    unsigned int	n_series, n_samples, n_instances, i, j;
     int			max_pointer;
+    int			sts;
     sds			msg;
-    pmSeriesValue	inst;
 
     n_series = np->left->value_set.num_series;
     np->value_set.num_series = n_series;
@@ -2718,31 +2829,23 @@ series_calculate_time_domain_max(node_t *np, void *arg)
 	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
 
 	    for (j = 0; j < n_samples; j++) {
-		np->value_set.series_values[i].series_sample[j].num_instances = 1;
-		np->value_set.series_values[i].series_sample[j].series_instance = (pmSeriesValue *)calloc(1, sizeof(pmSeriesValue));
+		if ((sts = series_instance_alloc(&np->value_set.series_values[i].series_sample[j], 1)) < 0) {
+		    baton->error = sts;
+		    return;
+		}
 
-		max_pointer = 0;
-		max_data = atof(np->left->value_set.series_values[i].series_sample[j].series_instance[0].data);
-		for (k = 1; k < n_instances; k++) {
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
+		set = &np->left->value_set.series_values[i].series_sample[j];
+		if (set->num_instances != n_instances) {
 			if (pmDebugOptions.query && pmDebugOptions.desperate) {
 			    infofmt(msg, "number of instances in each sample are not equal\n");
 			    batoninfo(baton, PMLOG_ERROR, msg);
 			}
-			continue;
-		    }                
-		    data = atof(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		    if (max_data < data) {
-			max_data = data;
-			max_pointer = k;
-		    }
+		    max_pointer = 0;
+		} else {
+		    max_pointer = series_vector_max(set->value, n_instances);
 		}
-		inst = np->left->value_set.series_values[i].series_sample[j].series_instance[max_pointer];
-
-		np->value_set.series_values[i].series_sample[j].series_instance[0].timestamp = sdsnew(inst.timestamp);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].series = sdsnew(inst.series);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].data = sdsnew(inst.data);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].ts = inst.ts;
+		series_instance_copy(&np->value_set.series_values[i].series_sample[j], 0,
+			&np->left->value_set.series_values[i].series_sample[j], max_pointer);
 	    }
         } else {
 	    np->value_set.series_values[i].num_samples = 0;
@@ -2769,6 +2872,7 @@ series_calculate_max(node_t *np, void *arg)
     unsigned int	n_series, n_samples, n_instances, i, j, k;
     double		max_data, data;
     int			max_pointer;
+    int			sts;
     sds			msg;
 
     n_series = np->left->value_set.num_series;
@@ -2780,11 +2884,13 @@ series_calculate_max(node_t *np, void *arg)
 	    np->value_set.series_values[i].num_samples = 1;
 	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(1, sizeof(series_instance_set_t));
 	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
-	    np->value_set.series_values[i].series_sample[0].num_instances = n_instances;
-	    np->value_set.series_values[i].series_sample[0].series_instance = (pmSeriesValue *)calloc(n_instances, sizeof(pmSeriesValue));
+	    if ((sts = series_instance_alloc(&np->value_set.series_values[i].series_sample[0], n_instances)) < 0) {
+		baton->error = sts;
+		return;
+	    }
 	    for (k = 0; k < n_instances; k++) {
 		max_pointer = 0;
-		max_data = atof(np->left->value_set.series_values[i].series_sample[0].series_instance[k].data);
+		max_data = np->left->value_set.series_values[i].series_sample[0].value[k];
 		for (j = 1; j < n_samples; j++) {
 		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
 			if (pmDebugOptions.query && pmDebugOptions.desperate) {
@@ -2793,20 +2899,14 @@ series_calculate_max(node_t *np, void *arg)
 			}
 			continue;
 		    }
-		    data = atof(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data);
+		    data = np->left->value_set.series_values[i].series_sample[j].value[k];
 		    if (max_data < data) {
 			max_data = data;
 			max_pointer = j;
 		    }
 		}
-		np->value_set.series_values[i].series_sample[0].series_instance[k].timestamp = 
-			sdsnew(np->left->value_set.series_values[i].series_sample[max_pointer].series_instance[k].timestamp);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].series = 
-			sdsnew(np->left->value_set.series_values[i].series_sample[max_pointer].series_instance[k].series);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].data = 
-			sdsnew(np->left->value_set.series_values[i].series_sample[max_pointer].series_instance[k].data);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].ts = 
-			np->left->value_set.series_values[i].series_sample[max_pointer].series_instance[k].ts;
+		series_instance_copy(&np->value_set.series_values[i].series_sample[0], k,
+			&np->left->value_set.series_values[i].series_sample[max_pointer], k);
 	    }
 	} else {
 	    np->value_set.series_values[i].num_samples = 0;
@@ -2830,11 +2930,11 @@ static void
 series_calculate_time_domain_min(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
-    unsigned int	n_series, n_samples, n_instances, i, j, k;
-    double		min_data, data;
+    series_instance_set_t *set;
+    unsigned int	n_series, n_samples, n_instances, i, j;
     int			min_pointer;
+    int			sts;
     sds			msg;
-    pmSeriesValue	inst;
 
     n_series = np->left->value_set.num_series;
     np->value_set.num_series = n_series;
@@ -2847,31 +2947,23 @@ series_calculate_time_domain_min(node_t *np, void *arg)
 	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
 
 	    for (j = 0; j < n_samples; j++) {
-		np->value_set.series_values[i].series_sample[j].num_instances = 1;
-		np->value_set.series_values[i].series_sample[j].series_instance = (pmSeriesValue *)calloc(1, sizeof(pmSeriesValue));
+		if ((sts = series_instance_alloc(&np->value_set.series_values[i].series_sample[j], 1)) < 0) {
+		    baton->error = sts;
+		    return;
+		}
 
-		min_pointer = 0;
-		min_data = atof(np->left->value_set.series_values[i].series_sample[j].series_instance[0].data);
-		for (k = 1; k < n_instances; k++) {
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
+		set = &np->left->value_set.series_values[i].series_sample[j];
+		if (set->num_instances != n_instances) {
 			if (pmDebugOptions.query && pmDebugOptions.desperate) {
 			    infofmt(msg, "number of instances in each sample are not equal\n");
 			    batoninfo(baton, PMLOG_ERROR, msg);
 			}
-			continue;
-		    }                
-		    data = atof(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		    if (min_data > data) {
-			min_data = data;
-			min_pointer = k;
-		    }
+		    min_pointer = 0;
+		} else {
+		    min_pointer = series_vector_min(set->value, n_instances);
 		}
-		inst = np->left->value_set.series_values[i].series_sample[j].series_instance[min_pointer];
-
-		np->value_set.series_values[i].series_sample[j].series_instance[0].timestamp = sdsnew(inst.timestamp);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].series = sdsnew(inst.series);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].data = sdsnew(inst.data);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].ts = inst.ts;
+		series_instance_copy(&np->value_set.series_values[i].series_sample[j], 0,
+			&np->left->value_set.series_values[i].series_sample[j], min_pointer);
 	    }
         } else {
 	    np->value_set.series_values[i].num_samples = 0;
@@ -2898,6 +2990,7 @@ series_calculate_min(node_t *np, void *arg)
     unsigned int	n_series, n_samples, n_instances, i, j, k;
     double		min_data, data;
     int			min_pointer;
+    int			sts;
     sds			msg;
 
     n_series = np->left->value_set.num_series;
@@ -2909,11 +3002,13 @@ series_calculate_min(node_t *np, void *arg)
 	    np->value_set.series_values[i].num_samples = 1;
 	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(1, sizeof(series_instance_set_t));
 	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
-	    np->value_set.series_values[i].series_sample[0].num_instances = n_instances;
-	    np->value_set.series_values[i].series_sample[0].series_instance = (pmSeriesValue *)calloc(n_instances, sizeof(pmSeriesValue));
+	    if ((sts = series_instance_alloc(&np->value_set.series_values[i].series_sample[0], n_instances)) < 0) {
+		baton->error = sts;
+		return;
+	    }
 	    for (k = 0; k < n_instances; k++) {
 		min_pointer = 0;
-		min_data = atof(np->left->value_set.series_values[i].series_sample[0].series_instance[k].data);
+		min_data = np->left->value_set.series_values[i].series_sample[0].value[k];
 		for (j = 1; j < n_samples; j++) {
 		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
 			if (pmDebugOptions.query && pmDebugOptions.desperate) {
@@ -2922,20 +3017,14 @@ series_calculate_min(node_t *np, void *arg)
 			}
 			continue;
 		    }
-		    data = atof(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data);
+		    data = np->left->value_set.series_values[i].series_sample[j].value[k];
 		    if (min_data > data) {
 			min_data = data;
 			min_pointer = j;
 		    }
 		}
-		np->value_set.series_values[i].series_sample[0].series_instance[k].timestamp = 
-			sdsnew(np->left->value_set.series_values[i].series_sample[min_pointer].series_instance[k].timestamp);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].series = 
-			sdsnew(np->left->value_set.series_values[i].series_sample[min_pointer].series_instance[k].series);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].data = 
-			sdsnew(np->left->value_set.series_values[i].series_sample[min_pointer].series_instance[k].data);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].ts = 
-			np->left->value_set.series_values[i].series_sample[min_pointer].series_instance[k].ts;
+		series_instance_copy(&np->value_set.series_values[i].series_sample[0], k,
+			&np->left->value_set.series_values[i].series_sample[min_pointer], k);
 	    }
 	} else {
 	    np->value_set.series_values[i].num_samples = 0;
@@ -3052,11 +3141,12 @@ static void
 series_calculate_rescale(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
+    series_instance_set_t *set;
     double		mult;
     pmUnits		iunit;
-    char		*errmsg, str_val[256];
+    char		*errmsg;
     pmAtomValue		ival, oval;
-    int			type, sts, str_len, i, j, k;
+    int			i, j;
     sds			msg;
 
     np->value_set = np->left->value_set;
@@ -3077,32 +3167,24 @@ series_calculate_rescale(node_t *np, void *arg)
 	    np->value_set.series_values[i].num_samples = -np->value_set.series_values[i].num_samples;
 	    return;
 	}
-	if ((type = series_extract_type(np->value_set.series_values[i].series_desc.type)) == PM_TYPE_UNKNOWN) {
+	if (series_extract_type(np->value_set.series_values[i].series_desc.type) == PM_TYPE_UNKNOWN) {
 	    infofmt(msg, "Series values' Type extract fail, unsupported type\n");
 	    batoninfo(baton, PMLOG_ERROR, msg);
 	    baton->error = -EPROTO;
 	    np->value_set.series_values[i].num_samples = -np->value_set.series_values[i].num_samples;
 	    return;
 	}
-	type = PM_TYPE_DOUBLE;
-	for (j = 0; j < np->value_set.series_values[i].num_samples; j++) {
-	    for (k = 0; k < np->value_set.series_values[i].series_sample[j].num_instances; k++) {
-		if (series_extract_value(type, 
-			np->value_set.series_values[i].series_sample[j].series_instance[k].data, &ival) != 0 ) {
-		    /* TODO: error report for extracting values from string fail */
-		    fprintf(stderr, "Extract values from string fail\n");
-		    return;
-		}
-		if ((sts = pmConvScale(type, &ival, &iunit, &oval, &np->right->meta.units)) != 0) {
+	/* conversion of doubles is linear, so scale all values at once */
+	ival.d = 1.0;
+	if (pmConvScale(PM_TYPE_DOUBLE, &ival, &iunit, &oval, &np->right->meta.units) != 0) {
 		    /* TODO: rescale error report */
 		    fprintf(stderr, "rescale error\n");
 		    return;
 		}
-		if ((str_len = series_pmAtomValue_conv_str(type, str_val, &oval, sizeof(str_val))) == 0)
-		    return;
-		sdsfree(np->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		np->value_set.series_values[i].series_sample[j].series_instance[k].data = sdsnewlen(str_val, str_len);
-	    }
+	for (j = 0; j < np->value_set.series_values[i].num_samples; j++) {
+	    set = &np->value_set.series_values[i].series_sample[j];
+	    series_vector_scale(set->value, set->num_instances, oval.d);
+	    series_instance_values_updated(set, "%e");
 	}
 	sdsfree(np->value_set.series_values[i].series_desc.units);
 	np->value_set.series_values[i].series_desc.units = sdsnew(pmUnitsStr(&np->right->meta.units));
@@ -3147,6 +3229,7 @@ static void
 series_calculate_abs(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
+    series_instance_set_t *set;
     pmAtomValue		val;
     int			type, sts, str_len, i, j, k;
     char		str_val[256];
@@ -3162,9 +3245,14 @@ series_calculate_abs(node_t *np, void *arg)
 	    return;
 	}	
 	for (j = 0; j < np->value_set.series_values[i].num_samples; j++) {
+	    set = &np->value_set.series_values[i].series_sample[j];
+	    if (type == PM_TYPE_DOUBLE) {
+		series_vector_abs(set->value, set->num_instances);
+		series_instance_values_updated(set, "%e");
+		continue;
+	    }
 	    for (k = 0; k < np->value_set.series_values[i].series_sample[j].num_instances; k++) {
-		if (series_extract_value(type, 
-			np->value_set.series_values[i].series_sample[j].series_instance[k].data, &val) != 0 ) {
+		if (series_extract_value(type,  series_instance_data(&np->value_set.series_values[i].series_sample[j], k), &val) != 0 ) {
 		    /* TODO: error report for extracting values from string fail */
 		    fprintf(stderr, "Extract values from string fail\n");
 		    return;
@@ -3176,8 +3264,7 @@ series_calculate_abs(node_t *np, void *arg)
 		}
 		if ((str_len = series_pmAtomValue_conv_str(type, str_val, &val, sizeof(str_val))) == 0)
 		    return;
-		sdsfree(np->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		np->value_set.series_values[i].series_sample[j].series_instance[k].data = sdsnewlen(str_val, str_len);
+		series_instance_set_data(&np->value_set.series_values[i].series_sample[j], k, sdsnewlen(str_val, str_len));
 	    }
 	}
     }
@@ -3190,13 +3277,11 @@ static void
 series_calculate_time_domain_topk(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
+    series_instance_set_t *set;
+    series_topk_t	topk;
     unsigned int	n_series, n_samples, n_instances, i, j, k, l;
     sds			msg;
-    pmSeriesValue	inst;
-    int			n, ind;
-    double		data;
-    double		*topk_data;
-    int			*topk_pointer;
+    int			n, sts;
 
     n_series = np->left->value_set.num_series;
     np->value_set.num_series = n_series;
@@ -3208,51 +3293,40 @@ series_calculate_time_domain_topk(node_t *np, void *arg)
 	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(n_samples, sizeof(series_instance_set_t));
 	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
 
+	    sscanf(np->right->value, "%d", &n);
+	    if (n > n_instances){
+		n = n_instances;
+	    }
+	    if ((sts = series_topk_init(&topk, n)) < 0) {
+		baton->error = sts;
+		return;
+	    }
 	    for (j = 0; j < n_samples; j++){
-		sscanf(np->right->value, "%d", &n);
-		if (n > n_instances){
-		    n = n_instances;
+		if ((sts = series_instance_alloc(&np->value_set.series_values[i].series_sample[j], n)) < 0) {
+		    baton->error = sts;
+		    series_topk_free(&topk);
+		    return;
 		}
-		topk_data = (double*) calloc(n, sizeof(double));
-		topk_pointer = (int*) calloc(n, sizeof(int));
-		np->value_set.series_values[i].series_sample[j].num_instances = n;
-		np->value_set.series_values[i].series_sample[j].series_instance = (pmSeriesValue *)calloc(n, sizeof(pmSeriesValue));
+		series_topk_reset(&topk);
 
-		for (k = 0; k < n_instances; k++){
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
-			if (pmDebugOptions.query && pmDebugOptions.desperate) {
-			    infofmt(msg, "number of instances in each sample are not equal\n");
-			    batoninfo(baton, PMLOG_ERROR, msg);
-			}
-		    continue;
-		    }                
-		    data = strtod(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data, NULL);
-		    if (data > topk_data[n-1]){
-			for (l = 0; l < n; ++l){
-			    if (data > topk_data[l]){
-				// insert in to position l
-				for (ind = n - 1; ind > l; --ind){
-				    topk_data[ind] = topk_data[ind-1];
-				    topk_pointer[ind] = topk_pointer[ind-1];
-				}
-				topk_data[l] = data;
-				topk_pointer[l] = k;
-			    	break;
-			    }
-			}
+		set = &np->left->value_set.series_values[i].series_sample[j];
+		if (set->num_instances != n_instances) {
+		    if (pmDebugOptions.query && pmDebugOptions.desperate) {
+			infofmt(msg, "number of instances in each sample are not equal\n");
+			batoninfo(baton, PMLOG_ERROR, msg);
 		    }
+		} else {
+		    for (k = 0; k < n_instances; k++)
+			series_topk_add(&topk, set->value[k], k);
 		}
 
+		series_topk_sort(&topk);
 		for (l = 0; l < n; ++l){
-		    inst = np->left->value_set.series_values[i].series_sample[j].series_instance[topk_pointer[l]];
-		    np->value_set.series_values[i].series_sample[j].series_instance[l].timestamp = sdsnew(inst.timestamp);
-		    np->value_set.series_values[i].series_sample[j].series_instance[l].series = sdsnew(inst.series);
-		    np->value_set.series_values[i].series_sample[j].series_instance[l].data = sdsnew(inst.data);
-		    np->value_set.series_values[i].series_sample[j].series_instance[l].ts = inst.ts;       
+		    series_instance_copy(&np->value_set.series_values[i].series_sample[j], l,
+			    set, topk.heap[l].index);
 		}
-		free(topk_data);
-		free(topk_pointer);
 	    }
+	    series_topk_free(&topk);
 	}
 	else{
 	    np->value_set.series_values[i].num_samples = 0;
@@ -3276,13 +3350,11 @@ static void
 series_calculate_topk(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
+    series_instance_set_t *set;
+    series_topk_t	topk;
     unsigned int	n_series, n_samples, n_instances, i, j, k, l;
-    double		data;
-    int 		n, ind;
-    double		*topk_data;
-    int			*topk_pointer;
+    int 		n, sts;
     sds			msg;
-    pmSeriesValue	inst;
 
     n_series = np->left->value_set.num_series;
     np->value_set.num_series = n_series;
@@ -3297,48 +3369,37 @@ series_calculate_topk(node_t *np, void *arg)
 	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
 	    np->value_set.series_values[i].num_samples = n_instances;
 	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(n_instances, sizeof(series_instance_set_t));
-	    topk_data = (double*) calloc(n, sizeof(double));
-	    topk_pointer = (int*) calloc(n, sizeof(int));
+	    if ((sts = series_topk_init(&topk, n)) < 0) {
+		baton->error = sts;
+		return;
+	    }
 	    for (j = 0; j < n_instances; j++){
-		np->value_set.series_values[i].series_sample[j].num_instances = n;
-		np->value_set.series_values[i].series_sample[j].series_instance = (pmSeriesValue *)calloc(n, sizeof(pmSeriesValue));
+		if ((sts = series_instance_alloc(&np->value_set.series_values[i].series_sample[j], n)) < 0) {
+		    baton->error = sts;
+		    series_topk_free(&topk);
+		    return;
+		}
 	    }
 	    for (k = 0; k < n_instances; k++) {
-		memset(topk_data, 0, sizeof(*topk_data));
+		series_topk_reset(&topk);
 		for (j = 0; j < n_samples; j++) {
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
+		    set = &np->left->value_set.series_values[i].series_sample[j];
+		    if (set->num_instances != n_instances) {
 			if (pmDebugOptions.query && pmDebugOptions.desperate) {
 			    infofmt(msg, "number of instances in each sample are not equal\n");
 			    batoninfo(baton, PMLOG_ERROR, msg);
 			}
 			continue;
 		    }
-		    data = atof(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		    if (data > topk_data[n-1]){
-			for (l = 0; l < n; ++l){
-			    if (data > topk_data[l]){
-				// insert in to position l
-				for (ind = n - 1; ind > l; --ind){
-				    topk_data[ind] = topk_data[ind-1];
-				    topk_pointer[ind] = topk_pointer[ind-1];
-				}
-				topk_data[l] = data;
-				topk_pointer[l] = j;
-			    	break;
-			    }
-			}
-		    }
-		}		
+		    series_topk_add(&topk, set->value[k], j);
+		}
+		series_topk_sort(&topk);
 		for (l = 0; l < n; ++l){
-		    inst = np->left->value_set.series_values[i].series_sample[topk_pointer[l]].series_instance[k];
-		    np->value_set.series_values[i].series_sample[k].series_instance[l].timestamp = sdsnew(inst.timestamp);
-		    np->value_set.series_values[i].series_sample[k].series_instance[l].series = sdsnew(inst.series);
-		    np->value_set.series_values[i].series_sample[k].series_instance[l].data = sdsnew(inst.data);
-		    np->value_set.series_values[i].series_sample[k].series_instance[l].ts = inst.ts;
+		    series_instance_copy(&np->value_set.series_values[i].series_sample[k], l,
+			    &np->left->value_set.series_values[i].series_sample[topk.heap[l].index], k);
 		}
 	    }
-	    free(topk_data);
-	    free(topk_pointer);
+	    series_topk_free(&topk);
 	} else {
 	    np->value_set.series_values[i].num_samples = 0;
 	}
@@ -3361,11 +3422,12 @@ static void
 series_calculate_time_domain_standard_deviation(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
-    unsigned int	n_series, n_samples, n_instances, i, j, k;
-    double		sum_data, mean, sd, data;
+    series_instance_set_t *set;
+    unsigned int	n_series, n_samples, n_instances, count, i, j;
+    double		mean, sd;
+    int			sts;
     sds			msg;
     pmSeriesValue	inst;
-    char		stdev[64];
 
     n_series = np->left->value_set.num_series;
     np->value_set.num_series = n_series;
@@ -3378,34 +3440,31 @@ series_calculate_time_domain_standard_deviation(node_t *np, void *arg)
 	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
 
 	    for (j = 0; j < n_samples; j++) {
-		np->value_set.series_values[i].series_sample[j].num_instances = 1;
-		np->value_set.series_values[i].series_sample[j].series_instance = (pmSeriesValue *)calloc(1, sizeof(pmSeriesValue));
-		sum_data = 0.0;
-		for (k = 0; k < n_instances; k++) {
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
+		if ((sts = series_instance_alloc(&np->value_set.series_values[i].series_sample[j], 1)) < 0) {
+		    baton->error = sts;
+		    return;
+		}
+		set = &np->left->value_set.series_values[i].series_sample[j];
+		if (set->num_instances != n_instances) {
 			if (pmDebugOptions.query && pmDebugOptions.desperate) {
 			    infofmt(msg, "number of instances in each sample are not equal\n");
 			    batoninfo(baton, PMLOG_ERROR, msg);
 			}
-		    continue;
-		    }
-		    data = strtod(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data, NULL);
-		    sum_data += data;
-		}
-
-		mean = sum_data/n_instances;
-		sd = 0.0;
-		for (k = 0; k < n_instances; k++) {
-		    data = strtod(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data, NULL);
-		    sd += pow(data - mean, 2);
+		    mean = 0.0;
+		    count = set->num_instances < n_instances ?
+			    set->num_instances : n_instances;
+		} else {
+		    mean = series_vector_sum(set->value, n_instances) / n_instances;
+		    count = n_instances;
 		}
+		sd = series_vector_sumsq(set->value, count, mean);
 
-		pmsprintf(stdev, sizeof(stdev), "%le", sqrt(sd / n_instances));
 		inst = np->left->value_set.series_values[i].series_sample[j].series_instance[0];
 		np->value_set.series_values[i].series_sample[j].series_instance[0].timestamp = sdsnew(inst.timestamp);
 		np->value_set.series_values[i].series_sample[j].series_instance[0].series = sdsnew(0);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].data = sdsnew(stdev);
 		np->value_set.series_values[i].series_sample[j].series_instance[0].ts = inst.ts;
+		series_instance_set_value(&np->value_set.series_values[i].series_sample[j], 0,
+			sqrt(sd / n_instances), "%le");
 	    }
 	} else {
 	    np->value_set.series_values[i].num_samples = 0;
@@ -3431,7 +3490,7 @@ series_calculate_standard_deviation(node_t *np, void *arg)
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
     unsigned int	n_series, n_samples, n_instances, i, j, k;
     double		sum_data, data, sd, mean;
-    char		stdev[64];
+    int			sts;
     sds			msg;
     pmSeriesValue       inst;
 
@@ -3444,8 +3503,10 @@ series_calculate_standard_deviation(node_t *np, void *arg)
 	    np->value_set.series_values[i].num_samples = 1;
 	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(1, sizeof(series_instance_set_t));
 	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
-	    np->value_set.series_values[i].series_sample[0].num_instances = n_instances;
-	    np->value_set.series_values[i].series_sample[0].series_instance = (pmSeriesValue *)calloc(n_instances, sizeof(pmSeriesValue));
+	    if ((sts = series_instance_alloc(&np->value_set.series_values[i].series_sample[0], n_instances)) < 0) {
+		baton->error = sts;
+		return;
+	    }
 	    for (k = 0; k < n_instances; k++) {
 		sum_data = 0.0;
 		for (j = 0; j < n_samples; j++) {
@@ -3456,21 +3517,21 @@ series_calculate_standard_deviation(node_t *np, void *arg)
 			}
 			continue;
 		    }
-		    data = strtod(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data, NULL);
+		    data = np->left->value_set.series_values[i].series_sample[j].value[k];
 		    sum_data += data;
 		}
 		mean = sum_data/n_samples;
 		sd = 0.0;
 		for (j = 0; j < n_samples; j++) {
-		    data = strtod(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data, NULL);
+		    data = np->left->value_set.series_values[i].series_sample[j].value[k];
 		    sd += pow(data - mean, 2);
 		}
-		pmsprintf(stdev, sizeof(stdev), "%le", sqrt(sd / n_samples));
 		inst = np->left->value_set.series_values[i].series_sample[0].series_instance[k];
 		np->value_set.series_values[i].series_sample[0].series_instance[k].timestamp = sdsnew(inst.timestamp);
 		np->value_set.series_values[i].series_sample[0].series_instance[k].series = sdsnew(inst.series);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].data = sdsnew(stdev);
 		np->value_set.series_values[i].series_sample[0].series_instance[k].ts = inst.ts;
+		series_instance_set_value(&np->value_set.series_values[i].series_sample[0], k,
+			sqrt(sd / n_samples), "%le");
 	    }
 	} else {
 	    np->value_set.series_values[i].num_samples = 0;
@@ -3497,8 +3558,8 @@ series_calculate_time_domain_nth_percentile(node_t *np, void *arg)
     unsigned int	n_series, n_samples, n_instances, i, j, k, l, m;
     int			n, instance_idx, rank, *n_pointer;
     double              *n_data, data, rank_d;
+    int			sts;
     sds			msg;
-    pmSeriesValue       inst;
 
     sscanf(np->right->value, "%d", &n);
     n_series = np->left->value_set.num_series;
@@ -3513,8 +3574,10 @@ series_calculate_time_domain_nth_percentile(node_t *np, void *arg)
 	    rank_d = ((double)n/100 * n_instances);
 	    rank = (int) rank_d;
 	    for (j = 0; j < n_samples; j++) {
-		np->value_set.series_values[i].series_sample[j].num_instances = 1;
-		np->value_set.series_values[i].series_sample[j].series_instance = (pmSeriesValue *)calloc(1, sizeof(pmSeriesValue));
+		if ((sts = series_instance_alloc(&np->value_set.series_values[i].series_sample[j], 1)) < 0) {
+		    baton->error = sts;
+		    return;
+		}
 		n_data = (double*) calloc(n_instances, sizeof(double));
 		n_pointer = (int*) calloc(n_instances, sizeof(int)); 
 
@@ -3526,7 +3589,7 @@ series_calculate_time_domain_nth_percentile(node_t *np, void *arg)
 			}
 			continue;
 		    }
-		    data = strtod(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data, NULL);
+		    data = np->left->value_set.series_values[i].series_sample[j].value[k];
 		    for (l = 0; l < n_instances; ++l){
 			if (data > n_data[l]){
 			    for (m = n_instances - 1; m > l; --m){
@@ -3545,11 +3608,8 @@ series_calculate_time_domain_nth_percentile(node_t *np, void *arg)
 		} else {
 		    instance_idx = n_pointer[n_instances-1-rank];
 		}
-		inst = np->left->value_set.series_values[i].series_sample[j].series_instance[instance_idx];
-		np->value_set.series_values[i].series_sample[j].series_instance[0].timestamp = sdsnew(inst.timestamp);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].series = sdsnew(inst.series);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].data = sdsnew(inst.data);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].ts = inst.ts;
+		series_instance_copy(&np->value_set.series_values[i].series_sample[j], 0,
+			&np->left->value_set.series_values[i].series_sample[j], instance_idx);
 		free(n_data);
 		free(n_pointer);
 	    }
@@ -3578,8 +3638,8 @@ series_calculate_nth_percentile(node_t *np, void *arg)
     unsigned int	n_series, n_samples, n_instances, i, j, k, l, m;
     int			n, instance_idx, rank, *n_pointer;
     double              *n_data, data, rank_d;
+    int			sts;
     sds			msg;
-    pmSeriesValue       inst;
 
     sscanf(np->right->value, "%d", &n);
 
@@ -3592,8 +3652,10 @@ series_calculate_nth_percentile(node_t *np, void *arg)
 	    np->value_set.series_values[i].num_samples = 1;
 	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(1, sizeof(series_instance_set_t));
 	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
-	    np->value_set.series_values[i].series_sample[0].num_instances = n_instances;
-	    np->value_set.series_values[i].series_sample[0].series_instance = (pmSeriesValue *)calloc(n_instances, sizeof(pmSeriesValue));
+	    if ((sts = series_instance_alloc(&np->value_set.series_values[i].series_sample[0], n_instances)) < 0) {
+		baton->error = sts;
+		return;
+	    }
 	    rank_d = ((double)n/100 * n_samples);
 	    rank = (int) rank_d;
 	    for (k = 0; k < n_instances; k++) {
@@ -3608,7 +3670,7 @@ series_calculate_nth_percentile(node_t *np, void *arg)
 			}
 			continue;
 		    }
-		    data = atof(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data);
+		    data = np->left->value_set.series_values[i].series_sample[j].value[k];
 		    for (l = 0; l < n_samples; ++l){
 			if (data > n_data[l]) {
 			    for (m = n_samples - 1; m > l; --m){
@@ -3626,11 +3688,8 @@ series_calculate_nth_percentile(node_t *np, void *arg)
 		} else {
 		    instance_idx = n_pointer[n_samples-1-rank];
 		}
-		inst = np->left->value_set.series_values[i].series_sample[instance_idx].series_instance[k];
-		np->value_set.series_values[i].series_sample[0].series_instance[k].timestamp = sdsnew(inst.timestamp);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].series = sdsnew(inst.series);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].data = sdsnew(inst.data);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].ts = inst.ts;
+		series_instance_copy(&np->value_set.series_values[i].series_sample[0], k,
+			&np->left->value_set.series_values[i].series_sample[instance_idx], k);
 		free(n_data);
 		free(n_pointer);
 	    }
@@ -3649,6 +3708,152 @@ series_calculate_nth_percentile(node_t *np, void *arg)
     }
 }
 
+/*
+ * Estimate the nth percentile of the values in the time series for each
+ * sample across time, from a fixed-size quantile sketch of the values
+ * rather than by sorting them.
+ */
+static void
+series_calculate_time_domain_approx_percentile(node_t *np, void *arg)
+{
+    seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
+    series_instance_set_t *set;
+    series_sketch_t	sketch;
+    unsigned int	n_series, n_samples, n_instances, i, j, k;
+    int			n, sts;
+    sds			msg;
+
+    sscanf(np->right->value, "%d", &n);
+    series_sketch_init(&sketch);
+
+    n_series = np->left->value_set.num_series;
+    np->value_set.num_series = n_series;
+    np->value_set.series_values = (series_sample_set_t *)calloc(n_series, sizeof(series_sample_set_t));
+    for (i = 0; i < n_series; i++) {
+	n_samples = np->left->value_set.series_values[i].num_samples;
+	if (n_samples > 0) {
+	    np->value_set.series_values[i].num_samples = n_samples;
+	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(n_samples, sizeof(series_instance_set_t));
+	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
+	    for (j = 0; j < n_samples; j++) {
+		if ((sts = series_instance_alloc(&np->value_set.series_values[i].series_sample[j], 1)) < 0) {
+		    baton->error = sts;
+		    series_sketch_free(&sketch);
+		    return;
+		}
+		series_sketch_reset(&sketch);
+
+		set = &np->left->value_set.series_values[i].series_sample[j];
+		if (set->num_instances != n_instances) {
+		    if (pmDebugOptions.query && pmDebugOptions.desperate) {
+			infofmt(msg, "number of instances in each sample are not equal\n");
+			batoninfo(baton, PMLOG_ERROR, msg);
+		    }
+		} else {
+		    for (k = 0; k < n_instances; k++) {
+			if ((sts = series_sketch_add(&sketch, set->value[k])) < 0) {
+			    baton->error = sts;
+			    series_sketch_free(&sketch);
+			    return;
+			}
+		    }
+		}
+		np->value_set.series_values[i].series_sample[j].series_instance[0].timestamp =
+			sdsnew(set->series_instance[0].timestamp);
+		np->value_set.series_values[i].series_sample[j].series_instance[0].series =
+			sdsnew(0);
+		np->value_set.series_values[i].series_sample[j].series_instance[0].ts =
+			set->series_instance[0].ts;
+		series_instance_set_value(&np->value_set.series_values[i].series_sample[j], 0,
+			series_sketch_quantile(&sketch, (double)n / 100), "%e");
+	    }
+	} else {
+	    np->value_set.series_values[i].num_samples = 0;
+	}
+	np->value_set.series_values[i].sid = (seriesGetSID *)calloc(1, sizeof(seriesGetSID));
+	np->value_set.series_values[i].sid->name = sdsnew(np->left->value_set.series_values[i].sid->name);
+	np->value_set.series_values[i].baton = np->left->value_set.series_values[i].baton;
+	np->value_set.series_values[i].series_desc.indom = sdsnew(np->left->value_set.series_values[i].series_desc.indom);
+	np->value_set.series_values[i].series_desc.pmid = sdsnew(np->left->value_set.series_values[i].series_desc.pmid);
+	np->value_set.series_values[i].series_desc.semantics = sdsnew(np->left->value_set.series_values[i].series_desc.semantics);
+	np->value_set.series_values[i].series_desc.source = sdsnew(np->left->value_set.series_values[i].series_desc.source);
+	np->value_set.series_values[i].series_desc.type = sdsnew("double");
+	np->value_set.series_values[i].series_desc.units = sdsnew(np->left->value_set.series_values[i].series_desc.units);
+    }
+    series_sketch_free(&sketch);
+}
+
+/*
+ * Estimate the nth percentile series per-instance over time samples,
+ * as above the sketch size does not depend on the number of samples.
+ */
+static void
+series_calculate_approx_percentile(node_t *np, void *arg)
+{
+    seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
+    series_instance_set_t *set;
+    series_sketch_t	sketch;
+    unsigned int	n_series, n_samples, n_instances, i, j, k, last;
+    int			n, sts;
+    sds			msg;
+
+    sscanf(np->right->value, "%d", &n);
+    series_sketch_init(&sketch);
+
+    n_series = np->left->value_set.num_series;
+    np->value_set.num_series = n_series;
+    np->value_set.series_values = (series_sample_set_t *)calloc(n_series, sizeof(series_sample_set_t));
+    for (i = 0; i < n_series; i++) {
+	n_samples = np->left->value_set.series_values[i].num_samples;
+	if (n_samples > 0) {
+	    np->value_set.series_values[i].num_samples = 1;
+	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(1, sizeof(series_instance_set_t));
+	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
+	    if ((sts = series_instance_alloc(&np->value_set.series_values[i].series_sample[0], n_instances)) < 0) {
+		baton->error = sts;
+		series_sketch_free(&sketch);
+		return;
+	    }
+	    for (k = 0; k < n_instances; k++) {
+		series_sketch_reset(&sketch);
+		for (j = last = 0; j < n_samples; j++) {
+		    set = &np->left->value_set.series_values[i].series_sample[j];
+		    if (set->num_instances != n_instances) {
+			if (pmDebugOptions.query && pmDebugOptions.desperate) {
+			    infofmt(msg, "number of instances in each sample are not equal\n");
+			    batoninfo(baton, PMLOG_ERROR, msg);
+			}
+			continue;
+		    }
+		    if ((sts = series_sketch_add(&sketch, set->value[k])) < 0) {
+			baton->error = sts;
+			series_sketch_free(&sketch);
+			return;
+		    }
+		    last = j;
+		}
+		/* report with the timestamp of the most recent sample used */
+		series_instance_copy(&np->value_set.series_values[i].series_sample[0], k,
+			&np->left->value_set.series_values[i].series_sample[last], k);
+		series_instance_set_value(&np->value_set.series_values[i].series_sample[0], k,
+			series_sketch_quantile(&sketch, (double)n / 100), "%e");
+	    }
+	} else {
+	    np->value_set.series_values[i].num_samples = 0;
+	}
+	np->value_set.series_values[i].sid = (seriesGetSID *)calloc(1, sizeof(seriesGetSID));
+	np->value_set.series_values[i].sid->name = sdsnew(np->left->value_set.series_values[i].sid->name);
+	np->value_set.series_values[i].baton = np->left->value_set.series_values[i].baton;
+	np->value_set.series_values[i].series_desc.indom = sdsnew(np->left->value_set.series_values[i].series_desc.indom);
+	np->value_set.series_values[i].series_desc.pmid = sdsnew(np->left->value_set.series_values[i].series_desc.pmid);
+	np->value_set.series_values[i].series_desc.semantics = sdsnew(np->left->value_set.series_values[i].series_desc.semantics);
+	np->value_set.series_values[i].series_desc.source = sdsnew(np->left->value_set.series_values[i].series_desc.source);
+	np->value_set.series_values[i].series_desc.type = sdsnew("double");
+	np->value_set.series_values[i].series_desc.units = sdsnew(np->left->value_set.series_values[i].series_desc.units);
+    }
+    series_sketch_free(&sketch);
+}
+
 /*
  * calculate sum or avg in the time series for each sample across time
  */
@@ -3657,9 +3862,10 @@ series_calculate_time_domain_statistical(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
     nodetype_t		func = np->type;
-    unsigned int	n_series, n_samples, n_instances, i, j, k;
-    double		sum_data, data;
-    char		sum_data_str[64];
+    series_instance_set_t *set;
+    unsigned int	n_series, n_samples, n_instances, i, j;
+    double		sum_data, result;
+    int			sts;
     sds			msg;
 
     assert(func == N_SUM_SAMPLE || func == N_AVG_SAMPLE);
@@ -3674,20 +3880,20 @@ series_calculate_time_domain_statistical(node_t *np, void *arg)
 	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(n_samples, sizeof(series_instance_set_t));
 	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
 	    for (j = 0; j < n_samples; j++) {
-		np->value_set.series_values[i].series_sample[j].num_instances = 1;
-		np->value_set.series_values[i].series_sample[j].series_instance = (pmSeriesValue *)calloc(1, sizeof(pmSeriesValue));
+		if ((sts = series_instance_alloc(&np->value_set.series_values[i].series_sample[j], 1)) < 0) {
+		    baton->error = sts;
+		    return;
+		}
 		
-		sum_data = 0.0;
-		for (k = 0; k < n_instances; k++) {
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
+		set = &np->left->value_set.series_values[i].series_sample[j];
+		if (set->num_instances != n_instances) {
 			if (pmDebugOptions.query && pmDebugOptions.desperate) {
 			    infofmt(msg, "number of instances in each sample are not equal\n");
 			    batoninfo(baton, PMLOG_ERROR, msg);
 			}
-			continue;
-		    }
-		    data = strtod(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data, NULL);
-		    sum_data += data;
+		    sum_data = 0.0;
+		} else {
+		    sum_data = series_vector_sum(set->value, n_instances);
 		}
 		np->value_set.series_values[i].series_sample[j].series_instance[0].timestamp = 
 			sdsnew(np->left->value_set.series_values[i].series_sample[j].series_instance[0].timestamp);
@@ -3695,19 +3901,20 @@ series_calculate_time_domain_statistical(node_t *np, void *arg)
 			sdsnew(0);
 		switch (func) {
 		case N_SUM_SAMPLE:
-		    pmsprintf(sum_data_str, sizeof(sum_data_str), "%le", sum_data);
+		    result = sum_data;
 		    break;
 		case N_AVG_SAMPLE:
-		    pmsprintf(sum_data_str, sizeof(sum_data_str), "%le", sum_data / n_instances);
+		    result = sum_data / n_instances;
 		    break;
 		default:
 		    /* .. TODO: standard deviation, variance, mode, median, etc */
-		    sum_data_str[0] = '\0';	/* for coverity */
+		    result = 0.0;	/* for coverity */
 		    assert(0);
 		    break;
 		}
 
-		np->value_set.series_values[i].series_sample[j].series_instance[0].data = sdsnew(sum_data_str);
+		series_instance_set_value(&np->value_set.series_values[i].series_sample[j], 0,
+			result, "%le");
 		np->value_set.series_values[i].series_sample[j].series_instance[0].ts = 
 		np->left->value_set.series_values[i].series_sample[j].series_instance[0].ts;
 	    }
@@ -3740,8 +3947,8 @@ series_calculate_statistical(node_t *np, void *arg)
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
     nodetype_t		func = np->type;
     unsigned int	n_series, n_samples, n_instances, i, j, k;
-    double		sum_data, data;
-    char		sum_data_str[64];
+    double		sum_data, data, result;
+    int			sts;
     sds			msg;
 
     assert(func == N_SUM || func == N_AVG || func == N_SUM_INST || func == N_AVG_INST);
@@ -3755,8 +3962,10 @@ series_calculate_statistical(node_t *np, void *arg)
 	    np->value_set.series_values[i].num_samples = 1;
 	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(1, sizeof(series_instance_set_t));
 	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
-	    np->value_set.series_values[i].series_sample[0].num_instances = n_instances;
-	    np->value_set.series_values[i].series_sample[0].series_instance = (pmSeriesValue *)calloc(n_instances, sizeof(pmSeriesValue));
+	    if ((sts = series_instance_alloc(&np->value_set.series_values[i].series_sample[0], n_instances)) < 0) {
+		baton->error = sts;
+		return;
+	    }
 	    for (k = 0; k < n_instances; k++) {
 		sum_data = 0.0;
 		for (j = 0; j < n_samples; j++) {
@@ -3767,7 +3976,7 @@ series_calculate_statistical(node_t *np, void *arg)
 			}
 			continue;
 		    }
-		    data = strtod(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data, NULL);
+		    data = np->left->value_set.series_values[i].series_sample[j].value[k];
 		    sum_data += data;
 		}
 		np->value_set.series_values[i].series_sample[0].series_instance[k].timestamp = 
@@ -3777,20 +3986,21 @@ series_calculate_statistical(node_t *np, void *arg)
 		switch (func) {
 		case N_SUM:
 		case N_SUM_INST:
-		    pmsprintf(sum_data_str, sizeof(sum_data_str), "%le", sum_data);
+		    result = sum_data;
 		    break;
 		case N_AVG:
 		case N_AVG_INST:
-		    pmsprintf(sum_data_str, sizeof(sum_data_str), "%le", sum_data / n_samples);
+		    result = sum_data / n_samples;
 		    break;
 		default:
 		    /* .. TODO: standard deviation, variance, mode, median, etc */
-		    sum_data_str[0] = '\0';	/* for coverity */
+		    result = 0.0;	/* for coverity */
 		    assert(0);
 		    break;
 		}
 
-		np->value_set.series_values[i].series_sample[0].series_instance[k].data = sdsnew(sum_data_str);
+		series_instance_set_value(&np->value_set.series_values[i].series_sample[0], k,
+			result, "%le");
 		np->value_set.series_values[i].series_sample[0].series_instance[k].ts = 
 			np->left->value_set.series_values[i].series_sample[0].series_instance[k].ts;
 	    }
@@ -3846,6 +4056,7 @@ static void
 series_calculate_floor(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
+    series_instance_set_t *set;
     pmAtomValue		val;
     int			type, sts, str_len, i, j, k;
     char		str_val[256];
@@ -3861,9 +4072,14 @@ series_calculate_floor(node_t *np, void *arg)
 	    return;
 	}	
 	for (j = 0; j < np->value_set.series_values[i].num_samples; j++) {
+	    set = &np->value_set.series_values[i].series_sample[j];
+	    if (type == PM_TYPE_DOUBLE) {
+		series_vector_floor(set->value, set->num_instances);
+		series_instance_values_updated(set, "%e");
+		continue;
+	    }
 	    for (k = 0; k < np->value_set.series_values[i].series_sample[j].num_instances; k++) {
-		if (series_extract_value(type, 
-			np->value_set.series_values[i].series_sample[j].series_instance[k].data, &val) != 0 ) {
+		if (series_extract_value(type,  series_instance_data(&np->value_set.series_values[i].series_sample[j], k), &val) != 0 ) {
 		    /* TODO: error report for extracting values from string fail */
 		    fprintf(stderr, "Extract values from string fail\n");
 		    return;
@@ -3875,8 +4091,7 @@ series_calculate_floor(node_t *np, void *arg)
 		}
 		if ((str_len = series_pmAtomValue_conv_str(type, str_val, &val, sizeof(str_val))) == 0)
 		    return;
-		sdsfree(np->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		np->value_set.series_values[i].series_sample[j].series_instance[k].data = sdsnewlen(str_val, str_len);
+		series_instance_set_data(&np->value_set.series_values[i].series_sample[j], k, sdsnewlen(str_val, str_len));
 	    }
 	}
     }
@@ -3931,7 +4146,8 @@ static void
 series_calculate_log(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
-    double		base;
+    series_instance_set_t *set;
+    double		base, divisor;
     pmAtomValue		val;
     int			i, j, k, itype, otype=PM_TYPE_UNKNOWN;
     int			sts, str_len, is_natural_log;
@@ -3942,8 +4158,10 @@ series_calculate_log(node_t *np, void *arg)
     if (np->right != NULL) {
 	sscanf(np->right->value, "%lf", &base);
 	is_natural_log = 0;
+	divisor = log(base);
     } else {
 	is_natural_log = 1;
+	divisor = 1.0;
     }
     np->value_set = np->left->value_set;
     for (i = 0; i < np->value_set.num_series; i++) {
@@ -3955,9 +4173,16 @@ series_calculate_log(node_t *np, void *arg)
 	    return;
 	}
 	for (j = 0; j < np->value_set.series_values[i].num_samples; j++) {
+	    set = &np->value_set.series_values[i].series_sample[j];
+	    if (itype != PM_TYPE_FLOAT) {
+		/* as for sqrt, only float values are not exact in the column */
+		otype = PM_TYPE_DOUBLE;
+		series_vector_log(set->value, set->num_instances, divisor);
+		series_instance_values_updated(set, "%e");
+		continue;
+	    }
 	    for (k = 0; k < np->value_set.series_values[i].series_sample[j].num_instances; k++) {
-		if (series_extract_value(itype, 
-			np->value_set.series_values[i].series_sample[j].series_instance[k].data, &val) != 0 ) {
+		if (series_extract_value(itype,  series_instance_data(&np->value_set.series_values[i].series_sample[j], k), &val) != 0 ) {
 		    /* TODO: error report for extracting values from string fail */
 		    fprintf(stderr, "Extract values from string fail\n");
 		    return;
@@ -3969,8 +4194,7 @@ series_calculate_log(node_t *np, void *arg)
 		}
 		if ((str_len = series_pmAtomValue_conv_str(otype, str_val, &val, sizeof(str_val))) == 0)
 		    return;
-		sdsfree(np->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		np->value_set.series_values[i].series_sample[j].series_instance[k].data = sdsnewlen(str_val, str_len);
+		series_instance_set_data(&np->value_set.series_values[i].series_sample[j], k, sdsnewlen(str_val, str_len));
 	    }
 	}
 	sdsfree(np->value_set.series_values[i].series_desc.type);
@@ -4025,6 +4249,7 @@ static void
 series_calculate_sqrt(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
+    series_instance_set_t *set;
     pmAtomValue		val;
     int			i, j, k, itype, otype=PM_TYPE_UNKNOWN;
     int			sts, str_len;
@@ -4041,9 +4266,16 @@ series_calculate_sqrt(node_t *np, void *arg)
 	    return;
 	}	
 	for (j = 0; j < np->value_set.series_values[i].num_samples; j++) {
+	    set = &np->value_set.series_values[i].series_sample[j];
+	    if (itype != PM_TYPE_FLOAT) {
+		/* integer and double values are exact in the value column */
+		otype = PM_TYPE_DOUBLE;
+		series_vector_sqrt(set->value, set->num_instances);
+		series_instance_values_updated(set, "%e");
+		continue;
+	    }
 	    for (k = 0; k < np->value_set.series_values[i].series_sample[j].num_instances; k++) {
-		if (series_extract_value(itype, 
-			np->value_set.series_values[i].series_sample[j].series_instance[k].data, &val) != 0 ) {
+		if (series_extract_value(itype,  series_instance_data(&np->value_set.series_values[i].series_sample[j], k), &val) != 0 ) {
 		    /* TODO: error report for extracting values from string fail */
 		    fprintf(stderr, "Extract values from string fail\n");
 		    return;
@@ -4055,8 +4287,7 @@ series_calculate_sqrt(node_t *np, void *arg)
 		}
 		if ((str_len = series_pmAtomValue_conv_str(otype, str_val, &val, sizeof(str_val))) == 0)
 		    return;
-		sdsfree(np->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		np->value_set.series_values[i].series_sample[j].series_instance[k].data = sdsnewlen(str_val, str_len);
+		series_instance_set_data(&np->value_set.series_values[i].series_sample[j], k, sdsnewlen(str_val, str_len));
 	    }
 	}
 	sdsfree(np->value_set.series_values[i].series_desc.type);
@@ -4080,7 +4311,7 @@ series_round_pmAtomValue(int type, pmAtomValue *val)
 	val->f = roundf(val->f);
 	break;
     case PM_TYPE_DOUBLE:
-	val->d = round(val->f);
+	val->d = round(val->d);
 	break;
     default:
 	/* Unsupported type */
@@ -4094,6 +4325,7 @@ static void
 series_calculate_round(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
+    series_instance_set_t *set;
     pmAtomValue		val;
     int			i, j, k, type, sts, str_len;
     char		str_val[256];
@@ -4109,9 +4341,14 @@ series_calculate_round(node_t *np, void *arg)
 	    return;
 	}
 	for (j = 0; j < np->value_set.series_values[i].num_samples; j++) {
+	    set = &np->value_set.series_values[i].series_sample[j];
+	    if (type == PM_TYPE_DOUBLE) {
+		series_vector_round(set->value, set->num_instances);
+		series_instance_values_updated(set, "%e");
+		continue;
+	    }
 	    for (k = 0; k < np->value_set.series_values[i].series_sample[j].num_instances; k++) {
-		if (series_extract_value(type, 
-			np->value_set.series_values[i].series_sample[j].series_instance[k].data, &val) != 0 ) {
+		if (series_extract_value(type,  series_instance_data(&np->value_set.series_values[i].series_sample[j], k), &val) != 0 ) {
 		    /* TODO: error report for extracting values from string fail */
 		    fprintf(stderr, "Extract values from string fail\n");
 		    return;
@@ -4123,8 +4360,7 @@ series_calculate_round(node_t *np, void *arg)
 		}
 		if ((str_len = series_pmAtomValue_conv_str(type, str_val, &val, sizeof(str_val))) == 0)
 		    return;
-		sdsfree(np->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		np->value_set.series_values[i].series_sample[j].series_instance[k].data = sdsnewlen(str_val, str_len);
+		series_instance_set_data(&np->value_set.series_values[i].series_sample[j], k, sdsnewlen(str_val, str_len));
 	    }
 	}
 	
@@ -4415,7 +4651,7 @@ calculate_slash(int *type, pmAtomValue *l_val, pmAtomValue *r_val, pmAtomValue *
 static void
 series_calculate_order_binary(int ope_type, int l_type, int r_type, int *otype,
 	pmAtomValue *l_val, pmAtomValue *r_val,
-	pmSeriesValue *l_data, pmSeriesValue *r_data,
+	series_instance_set_t *l_set, series_instance_set_t *r_set, int k,
 	pmUnits *l_units, pmUnits *r_units, pmUnits *large_units,
 	int (*operator)(int*, pmAtomValue*, pmAtomValue*, pmAtomValue*))
 {
@@ -4440,8 +4676,8 @@ series_calculate_order_binary(int ope_type, int l_type, int r_type, int *otype,
     }
 
     /* Extract series values */
-    series_extract_value(*otype, r_data->data, r_val);
-    series_extract_value(*otype, l_data->data, l_val);
+    series_extract_value(*otype, series_instance_data(r_set, k), r_val);
+    series_extract_value(*otype, series_instance_data(l_set, k), l_val);
 
     /* Convert scale to larger one */
     if (pmConvScale(*otype, l_val, l_units, l_val, large_units) < 0)
@@ -4450,15 +4686,68 @@ series_calculate_order_binary(int ope_type, int l_type, int r_type, int *otype,
     	memset(large_units, 0, sizeof(*large_units));
 
     if ((*operator)(otype, l_val, r_val, &res) != 0) {
-	sdsfree(l_data->data);
-	l_data->data = sdsnew("no value"); /* TODO - error handling */
+	/* TODO - error handling */
+	series_instance_set_data(l_set, k, sdsnew("no value"));
     } else {
-	sdsfree(l_data->data);
 	str_len = series_pmAtomValue_conv_str(*otype, str_val, &res, sizeof(str_val));
-	l_data->data = sdsnewlen(str_val, str_len);
+	series_instance_set_data(l_set, k, sdsnewlen(str_val, str_len));
     }
 }
 
+/*
+ * Binary operations with a double result are calculated a whole sample
+ * at a time.  Units conversion of doubles is a multiplication, so find
+ * the scale factors of each operand up front - returns zero if the
+ * per-value series_calculate_order_binary path must be used instead.
+ */
+static int
+series_calculate_vector_scale(int ope_type, int l_type, int r_type,
+	pmUnits *l_units, pmUnits *r_units, pmUnits *large_units,
+	double *l_mult, double *r_mult)
+{
+    pmAtomValue		one, mult;
+
+    if (l_type != PM_TYPE_DOUBLE && r_type != PM_TYPE_DOUBLE &&
+	ope_type != N_SLASH)
+	return 0;
+
+    one.d = 1.0;
+    if (pmConvScale(PM_TYPE_DOUBLE, &one, l_units, &mult, large_units) < 0)
+	return 0;
+    *l_mult = mult.d;
+    if (pmConvScale(PM_TYPE_DOUBLE, &one, r_units, &mult, large_units) < 0)
+	return 0;
+    *r_mult = mult.d;
+    return 1;
+}
+
+static void
+series_calculate_vector_binary(int ope_type,
+	series_instance_set_t *l_set, series_instance_set_t *r_set,
+	double l_mult, double r_mult)
+{
+    int			n = l_set->num_instances;
+
+    switch (ope_type) {
+    case N_PLUS:
+	series_vector_add(l_set->value, l_mult, r_set->value, r_mult, n);
+	break;
+    case N_MINUS:
+	series_vector_sub(l_set->value, l_mult, r_set->value, r_mult, n);
+	break;
+    case N_STAR:
+	series_vector_mul(l_set->value, l_mult, r_set->value, r_mult, n);
+	break;
+    case N_SLASH:
+	series_vector_div(l_set->value, l_mult, r_set->value, r_mult, n);
+	break;
+    default:
+	assert(0);
+	break;
+    }
+    series_instance_values_updated(l_set, "%e");
+}
+
 static void
 series_binary_meta_update(node_t *left, pmUnits *large_units, int *l_sem, int *r_sem, int *otype)
 {
@@ -4500,9 +4789,10 @@ series_calculate_plus(node_t *np, void *arg)
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
     node_t		*left = np->left, *right = np->right;
     int			l_type, r_type, otype=PM_TYPE_UNKNOWN;
-    int			l_sem, r_sem, j, k;
+    int			l_sem, r_sem, vector, j, k;
     unsigned int	num_samples, num_instances;
     pmAtomValue		l_val, r_val;
+    double		l_mult, r_mult;
     pmUnits		l_units = {0}, r_units = {0}, large_units = {0};
     sds			msg;
 
@@ -4516,6 +4806,10 @@ series_calculate_plus(node_t *np, void *arg)
 		right->value_set.series_values[0].series_desc.indom) != 0)
 	return;
 
+    vector = series_calculate_vector_scale(N_PLUS, l_type, r_type,
+		&l_units, &r_units, &large_units, &l_mult, &r_mult);
+    if (vector)
+	otype = PM_TYPE_DOUBLE;
     num_samples = left->value_set.series_values[0].num_samples;
 
     for (j = 0; j < num_samples; j++) {
@@ -4526,11 +4820,18 @@ series_calculate_plus(node_t *np, void *arg)
 	    baton->error = -EPROTO;
 	    return;
 	}
+	if (vector) {
+	    series_calculate_vector_binary(N_PLUS,
+		&left->value_set.series_values[0].series_sample[j],
+		&right->value_set.series_values[0].series_sample[j],
+		l_mult, r_mult);
+	    continue;
+	}
 	for (k = 0; k < num_instances; k++) {
 	    series_calculate_order_binary(N_PLUS, l_type, r_type, &otype, 
 		&l_val, &r_val, 
-		left->value_set.series_values[0].series_sample[j].series_instance + k,
-		right->value_set.series_values[0].series_sample[j].series_instance + k,
+		&left->value_set.series_values[0].series_sample[j],
+		&right->value_set.series_values[0].series_sample[j], k,
 		&l_units, &r_units, &large_units, calculate_plus);
 	}
     }
@@ -4553,9 +4854,10 @@ series_calculate_minus(node_t *np, void *arg)
     node_t		*left = np->left, *right = np->right;
     unsigned int	num_samples, num_instances, j, k;
     pmAtomValue		l_val, r_val;
+    double		l_mult, r_mult;
     pmUnits		l_units = {0}, r_units = {0}, large_units = {0};
     int			l_type, r_type, otype=PM_TYPE_UNKNOWN;
-    int			l_sem, r_sem;
+    int			l_sem, r_sem, vector;
     sds			msg;
 
     if (left->value_set.num_series == 0 || right->value_set.num_series == 0)
@@ -4568,6 +4870,10 @@ series_calculate_minus(node_t *np, void *arg)
 		right->value_set.series_values[0].series_desc.indom) != 0)
 	return;
 
+    vector = series_calculate_vector_scale(N_MINUS, l_type, r_type,
+		&l_units, &r_units, &large_units, &l_mult, &r_mult);
+    if (vector)
+	otype = PM_TYPE_DOUBLE;
     num_samples = left->value_set.series_values[0].num_samples;
 
     for (j = 0; j < num_samples; j++) {
@@ -4578,11 +4884,18 @@ series_calculate_minus(node_t *np, void *arg)
 	    baton->error = -EPROTO;
 	    return;
 	}
+	if (vector) {
+	    series_calculate_vector_binary(N_MINUS,
+		&left->value_set.series_values[0].series_sample[j],
+		&right->value_set.series_values[0].series_sample[j],
+		l_mult, r_mult);
+	    continue;
+	}
 	for (k = 0; k < num_instances; k++) {
 	    series_calculate_order_binary(N_MINUS, l_type, r_type, &otype, 
 		&l_val, &r_val, 
-		left->value_set.series_values[0].series_sample[j].series_instance + k,
-		right->value_set.series_values[0].series_sample[j].series_instance + k,
+		&left->value_set.series_values[0].series_sample[j],
+		&right->value_set.series_values[0].series_sample[j], k,
 		&l_units, &r_units, &large_units, calculate_minus);
 	}
     }
@@ -4603,13 +4916,15 @@ series_calculate_star(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)np->baton;
     node_t		*left = np->left, *right = np->right, *node;
+    series_instance_set_t *set;
     unsigned int	n_series, num_samples, num_instances, i, j, k;
     pmAtomValue		l_val, r_val;
+    double		l_mult, r_mult;
     pmUnits		l_units = {0}, r_units = {0}, large_units = {0};
     int			l_type, r_type, otype=PM_TYPE_UNKNOWN;
-    int			l_sem, r_sem, int_operand, is_int;
+    int			l_sem, r_sem, vector, int_operand, is_int;
     sds			msg;
-    double		data, double_operand;
+    double		double_operand;
     char		new_data[64];
 
     if (left->value_set.num_series == 0 || right->value_set.num_series == 0){
@@ -4638,17 +4953,16 @@ series_calculate_star(node_t *np, void *arg)
 	    num_samples = node->value_set.series_values[i].num_samples;
 	    for (j = 0; j < num_samples; j++) {
 	    	num_instances = node->value_set.series_values[i].series_sample[j].num_instances;
+		set = &node->value_set.series_values[i].series_sample[j];
+		if (node->type != N_INTEGER || !is_int) {
+		    series_vector_scale(set->value, num_instances,
+				is_int ? int_operand : double_operand);
+		    series_instance_values_updated(set, "%le");
+		    continue;
+		}
 	    	for (k = 0; k < num_instances; k++) {
-		    data = atof(node->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		    if (node->type == N_INTEGER && is_int) {
-			pmsprintf(new_data, sizeof(new_data), "%d", atoi(node->value_set.series_values[i].series_sample[j].series_instance[k].data) * int_operand);
-		    } else if (is_int) {
-			pmsprintf(new_data, sizeof(new_data), "%le", data * int_operand);
-		    } else {
-			pmsprintf(new_data, sizeof(new_data), "%le", data * double_operand);
-		    }
-		    sdsfree(node->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		    node->value_set.series_values[i].series_sample[j].series_instance[k].data = sdsnew(new_data);
+		    pmsprintf(new_data, sizeof(new_data), "%d", atoi(series_instance_data(set, k)) * int_operand);
+		    series_instance_set_data(set, k, sdsnew(new_data));
 	    	}
 	    }
 	    if (!is_int) {
@@ -4670,6 +4984,10 @@ series_calculate_star(node_t *np, void *arg)
 		right->value_set.series_values[i].series_desc.indom) != 0)
 	        return;
 
+	    vector = series_calculate_vector_scale(N_STAR, l_type, r_type,
+			&l_units, &r_units, &large_units, &l_mult, &r_mult);
+	    if (vector)
+		otype = PM_TYPE_DOUBLE;
 	    num_samples = left->value_set.series_values[i].num_samples;
 
 	    for (j = 0; j < num_samples; j++) {
@@ -4680,11 +4998,18 @@ series_calculate_star(node_t *np, void *arg)
 		    baton->error = -EPROTO;
 		    return;
 		}
+		if (vector) {
+		    series_calculate_vector_binary(N_STAR,
+			&left->value_set.series_values[i].series_sample[j],
+			&right->value_set.series_values[i].series_sample[j],
+			l_mult, r_mult);
+		    continue;
+		}
 		for (k = 0; k < num_instances; k++) {
 		    series_calculate_order_binary(N_STAR, l_type, r_type, &otype, 
 			&l_val, &r_val, 
-			left->value_set.series_values[i].series_sample[j].series_instance + k,
-			right->value_set.series_values[i].series_sample[j].series_instance + k,
+			&left->value_set.series_values[i].series_sample[j],
+			&right->value_set.series_values[i].series_sample[j], k,
 			&l_units, &r_units, &large_units, calculate_star);
 		}
 	    }
@@ -4710,9 +5035,10 @@ series_calculate_slash(node_t *np, void *arg)
     node_t		*left = np->left, *right = np->right;
     unsigned int	num_samples, num_instances, j, k;
     pmAtomValue		l_val, r_val;
+    double		l_mult, r_mult;
     pmUnits		l_units = {0}, r_units = {0}, large_units = {0};
     int			l_type, r_type, otype=PM_TYPE_UNKNOWN;
-    int			l_sem, r_sem;
+    int			l_sem, r_sem, vector;
     sds			msg;
 
     if (left->value_set.num_series == 0 || right->value_set.num_series == 0)
@@ -4725,6 +5051,10 @@ series_calculate_slash(node_t *np, void *arg)
 		right->value_set.series_values[0].series_desc.indom) != 0)
 	return;
 
+    vector = series_calculate_vector_scale(N_SLASH, l_type, r_type,
+		&l_units, &r_units, &large_units, &l_mult, &r_mult);
+    if (vector)
+	otype = PM_TYPE_DOUBLE;
     num_samples = left->value_set.series_values[0].num_samples;
 
     for (j = 0; j < num_samples; j++) {
@@ -4735,11 +5065,18 @@ series_calculate_slash(node_t *np, void *arg)
 	    baton->error = -EPROTO;
 	    return;
 	}
+	if (vector) {
+	    series_calculate_vector_binary(N_SLASH,
+		&left->value_set.series_values[0].series_sample[j],
+		&right->value_set.series_values[0].series_sample[j],
+		l_mult, r_mult);
+	    continue;
+	}
 	for (k = 0; k < num_instances; k++) {
 	    series_calculate_order_binary(N_SLASH, l_type, r_type, &otype, 
 		&l_val, &r_val, 
-		left->value_set.series_values[0].series_sample[j].series_instance + k,
-		right->value_set.series_values[0].series_sample[j].series_instance + k,
+		&left->value_set.series_values[0].series_sample[j],
+		&right->value_set.series_values[0].series_sample[j], k,
 		&l_units, &r_units, &large_units, calculate_slash);
 	}
     }
@@ -4766,6 +5103,7 @@ series_calculate_slash(node_t *np, void *arg)
 static int
 series_calculate(node_t *np, int level, void *arg)
 {
+    seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
     int		sts;
 
     if (np == NULL)
@@ -4851,10 +5189,19 @@ series_calculate(node_t *np, int level, void *arg)
     case N_NTH_PERCENTILE_SAMPLE:
 	series_calculate_time_domain_nth_percentile(np, arg);
 	break;
+    case N_APPROX_PERCENTILE_INST:
+	series_calculate_approx_percentile(np, arg);
+	break;
+    case N_APPROX_PERCENTILE_SAMPLE:
+	series_calculate_time_domain_approx_percentile(np, arg);
+	break;
     default:
 	sts = 0;	/* no function */
 	break;
     }
+    /* a failed function leaves its results incomplete, go no further */
+    if (baton->error < 0)
+	return baton->error;
     return sts;
 }
 
@@ -4887,12 +5234,11 @@ series_compatibility_convert(
 	type0 = PM_TYPE_DOUBLE;
 	for (j = 0; j < set0->num_samples; j++) {
 	    for (k = 0; k < set0->series_sample[j].num_instances; k++) {
-		series_extract_value(type0, set0->series_sample[j].series_instance[k].data, &val0);
+		series_extract_value(type0, series_instance_data(&set0->series_sample[j], k), &val0);
 		if (pmConvScale(type0, &val0, units0, &val0, large_units) < 0)
 		    memset(large_units, 0, sizeof(*large_units));
-		sdsfree(set0->series_sample[j].series_instance[k].data);
 		str_len = series_pmAtomValue_conv_str(type0, str_val, &val0, sizeof(str_val));
-		set0->series_sample[j].series_instance[k].data = sdsnewlen(str_val, str_len);
+		series_instance_set_data(&set0->series_sample[j], k, sdsnewlen(str_val, str_len));
 	    }
 	}
 	sdsfree(set0->series_desc.type);
@@ -4906,12 +5252,11 @@ series_compatibility_convert(
 	type1 = PM_TYPE_DOUBLE;
 	for (j = 0; j < set1->num_samples; j++) {
 	    for (k = 0; k < set1->series_sample[j].num_instances; k++) {
-		series_extract_value(type1, set1->series_sample[j].series_instance[k].data, &val1);
+		series_extract_value(type1, series_instance_data(&set1->series_sample[j], k), &val1);
 		if (pmConvScale(type1, &val1, units1, &val1, large_units) < 0)
 		    memset(large_units, 0, sizeof(*large_units));
-		sdsfree(set1->series_sample[j].series_instance[k].data);
 		str_len = series_pmAtomValue_conv_str(type1, str_val, &val1, sizeof(str_val));
-		set1->series_sample[j].series_instance[k].data = sdsnewlen(str_val, str_len);
+		series_instance_set_data(&set1->series_sample[j], k, sdsnewlen(str_val, str_len));
 	    }
 	}
 	sdsfree(set1->series_desc.type);
@@ -5053,17 +5398,18 @@ series_query_funcs_report_values(void *arg)
     seriesBatonReference(baton, "series_query_funcs_report_values");
 
     /* For function-type nodes, calculate actual values */
-    has_function = series_calculate(baton->query.root, 0, baton->userdata);
+    has_function = series_calculate(baton->query.root, 0, arg);
 
     /*
      * Store the canonical query to Redis if this query statement has
      * function operation.
      */
-    if (has_function)
+    if (has_function > 0)
 	series_key_hash_expression(baton, hashbuf, sizeof(hashbuf));
 
     /* time series values saved in root node so report them directly. */
-    series_node_values_report(baton, baton->query.root);
+    if (has_function >= 0)
+	series_node_values_report(baton, baton->query.root);
     
     series_query_end_phase(baton);
 }
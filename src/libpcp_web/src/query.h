@@ -80,6 +80,8 @@ typedef enum nodetype {
     N_LOG,
     N_SQRT,
     N_ROUND,
+    N_APPROX_PERCENTILE_INST,
+    N_APPROX_PERCENTILE_SAMPLE,
 
 /* node_t time-related sub-types */
     N_RANGE = 100,
@@ -125,6 +127,14 @@ typedef struct series_instance_set {
     /* Number of series instances */
     int			num_instances;
     pmSeriesValue	*series_instance;
+    /*
+     * Instance values in binary form, parsed once when the samples
+     * are loaded.  Functions store their results here and leave the
+     * series_instance data string NULL until the value is reported,
+     * when it is formatted using value_format.
+     */
+    double		*value;
+    const char		*value_format;
 } series_instance_set_t;
 
 typedef struct series_sample_set {
@@ -25,6 +25,9 @@
 #define SERIES_VERSION	2
 #define OLDEST_VERSION	5
 
+/* maximum instances per coalesced series to instances SADD command */
+#define SERIES_INSTANCES_BATCH	1024
+
 extern sds		cursorcount;
 static sds		maxstreamlen;
 static sds		streamexpire;
@@ -352,7 +355,7 @@ keys_series_instance(keySlots *slots, metric_t *metric, instance_t *instance, vo
     int				i;
 
     seriesBatonCheckMagic(baton, MAGIC_LOAD, "keys_series_instance");
-    seriesBatonReferences(baton, 1 + metric->numnames, "keys_series_instance");
+    seriesBatonReference(baton, "keys_series_instance");
 
     assert(instance->name.sds);
     pmwebapi_hash_str(instance->name.id, hashbuf, sizeof(hashbuf));
@@ -374,18 +377,6 @@ keys_series_instance(keySlots *slots, metric_t *metric, instance_t *instance, vo
     keySlotsRequest(slots, cmd, keys_series_inst_name_callback, arg);
     sdsfree(cmd);
 
-    for (i = 0; i < metric->numnames; i++) {
-	pmwebapi_hash_str(metric->names[i].hash, hashbuf, sizeof(hashbuf));
-	key = sdscatfmt(sdsempty(), "pcp:instances:series:%s", hashbuf);
-	cmd = resp_command(3);
-	cmd = resp_param_str(cmd, SADD, SADD_LEN);
-	cmd = resp_param_sds(cmd, key);
-	cmd = resp_param_sha(cmd, instance->name.hash);
-	sdsfree(key);
-	keySlotsRequest(slots, cmd, keys_instances_series_callback, arg);
-	sdsfree(cmd);
-    }
-
     if (instance->cached == 0) {
 	seriesBatonReference(baton, "keys_series_instance");
 	pmwebapi_hash_str(instance->name.hash, hashbuf, sizeof(hashbuf));
@@ -407,6 +398,35 @@ keys_series_instance(keySlots *slots, metric_t *metric, instance_t *instance, vo
     }
 }
 
+/*
+ * Map each series of a metric to a set of its instances, given as
+ * pre-encoded RESP parameters - one SADD per series for many instances
+ * rather than one per instance.
+ */
+static void
+keys_series_instances(keySlots *slots, metric_t *metric,
+		sds members, unsigned int count, void *arg)
+{
+    seriesLoadBaton		*baton = (seriesLoadBaton *)arg;
+    char			hashbuf[42];
+    sds				cmd, key;
+    int				i;
+
+    seriesBatonReferences(baton, metric->numnames, "keys_series_instances");
+
+    for (i = 0; i < metric->numnames; i++) {
+	pmwebapi_hash_str(metric->names[i].hash, hashbuf, sizeof(hashbuf));
+	key = sdscatfmt(sdsempty(), "pcp:instances:series:%s", hashbuf);
+	cmd = resp_command(2 + count);
+	cmd = resp_param_str(cmd, SADD, SADD_LEN);
+	cmd = resp_param_sds(cmd, key);
+	cmd = sdscatsds(cmd, members);
+	sdsfree(key);
+	keySlotsRequest(slots, cmd, keys_instances_series_callback, arg);
+	sdsfree(cmd);
+    }
+}
+
 static void
 label_value_mapping_callback(void *arg)
 {
@@ -814,7 +834,8 @@ keys_series_metadata(context_t *context, metric_t *metric, void *arg)
     const char			*units, *indom = NULL, *pmid, *sem, *type;
     char			ibuf[32], pbuf[32], sbuf[20], tbuf[20], ubuf[60];
     char			hashbuf[42];
-    sds				cmd, key;
+    unsigned int		count = 0;
+    sds				cmd, key, members;
     int				i;
 
     if (metric->cached)
@@ -907,11 +928,22 @@ check_instances:
 	    metric->cached = 1;
 	}
     } else {
+	members = sdsempty();
 	for (i = 0; i < metric->u.vlist->listcount; i++) {
 	    value = &metric->u.vlist->value[i];
 	    if ((instance = dictFetchValue(metric->indom->insts, &value->inst)) == NULL)
 		continue;
+	    /* skip if series and instance mappings are unchanged since sent */
+	    if (metric->cached && value->mapped == instance->generation)
+		continue;
 	    keys_series_instance(slots, metric, instance, baton);
+	    members = resp_param_sha(members, instance->name.hash);
+	    if (++count == SERIES_INSTANCES_BATCH) {
+		keys_series_instances(slots, metric, members, count, baton);
+		sdsclear(members);
+		count = 0;
+	    }
+	    value->mapped = instance->generation;
 	    if (metric->cached == 0 || instance->cached == 0)
 		keys_series_labelset(slots, metric, instance, baton);
 	    if (metric->cached == 0 &&
@@ -922,6 +954,9 @@ check_instances:
 			    instance->name.sds, indom, NULL, NULL, baton);
 	    }
 	}
+	if (count > 0)
+	    keys_series_instances(slots, metric, members, count, baton);
+	sdsfree(members);
 	for (i = 0; i < metric->u.vlist->listcount; i++) {
 	    value = &metric->u.vlist->value[i];
 	    if ((instance = dictFetchValue(metric->indom->insts, &value->inst)) == NULL)
@@ -1904,6 +1939,12 @@ pmDiscoverSetupMetrics(pmDiscoverModule *module)
 	"error result records decoded for monitored archives",
 	"Total errors in result records decoded for monitored archives");
 
+    mmv_stats_add_metric(data->registry, "logvol.checkpoint_resumed", 22,
+	MMV_TYPE_U64, MMV_SEM_COUNTER, countunits, MMV_INDOM_NULL,
+	"archives resumed from a saved checkpoint",
+	"Number of archives where values processing resumed from a checkpoint\n"
+	"saved before pmproxy restarted, rather than from the end of archive");
+
     data->map = map = mmv_stats_start(data->registry);
     metrics = data->metrics;
 
@@ -1949,6 +1990,8 @@ pmDiscoverSetupMetrics(pmDiscoverModule *module)
 				    map, "metadata.partial_reads", NULL);
     metrics[DISCOVER_DECODE_RESULT_ERRORS] = mmv_lookup_value_desc(
 				    map, "logvol.decode.result_errors", NULL);
+    metrics[DISCOVER_CHECKPOINT_RESUMED] = mmv_lookup_value_desc(
+				    map, "logvol.checkpoint_resumed", NULL);
 }
 
 int
@@ -2018,6 +2061,18 @@ pmDiscoverSetup(pmDiscoverModule *module, pmDiscoverCallBacks *cbs, void *arg)
 	}
     }
 
+    /* optional persistent checkpoints, to resume archives after restart */
+    if ((option = pmIniFileLookup(config, "discover", "checkpoints")) &&
+	sdslen(option) > 0)
+	data->checkpoints = sdsdup(option);
+    if ((option = pmIniFileLookup(config, "discover", "checkpoint.interval")))
+	data->checkpoint_interval = strtoul(option, NULL, 10);
+    data->data = arg;
+
+    /* optional worker threads for decoding archive values */
+    if ((option = pmIniFileLookup(config, "discover", "workers")))
+	data->workers = strtoul(option, NULL, 10);
+
     /* create global string map caches */
     keysGlobalsInit(data->config);
 
@@ -2044,6 +2099,7 @@ pmDiscoverClose(pmDiscoverModule *module)
 
     if (discover) {
 	pmDiscoverUnregister(discover->handle);
+	pmDiscoverCheckpointsClose(module);
 	if (discover->slots && !discover->shareslots)
 	    keySlotsFree(discover->slots);
 	for (i = 0; i < discover->exclude_names; i++)
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#include <math.h>
+#include "pmapi.h"
+#include "sketch.h"
+
+/*
+ * Bucket i holds values in (gamma^(i-1), gamma^i], where
+ * gamma = (1 + accuracy) / (1 - accuracy).
+ */
+#define SKETCH_GAMMA	((1.0 + SERIES_SKETCH_ACCURACY) / (1.0 - SERIES_SKETCH_ACCURACY))
+#define SKETCH_MINVALUE	1e-300	/* smaller magnitudes are counted as zero */
+#define SKETCH_GROW	64	/* minimum bucket allocation */
+
+static int
+sketch_index(double value)
+{
+    return (int)ceil(log(value) / log(SKETCH_GAMMA));
+}
+
+static double
+sketch_value(int index)
+{
+    /* midpoint (in relative error terms) of the bucket */
+    return 2.0 * pow(SKETCH_GAMMA, index) / (SKETCH_GAMMA + 1.0);
+}
+
+/*
+ * Make the allocated buckets cover indices lo to hi (inclusive),
+ * keeping the counts of the buckets in use.
+ */
+static int
+store_extend(series_sketch_store_t *store, int lo, int hi)
+{
+    double		*counts;
+    int			size, offset;
+
+    if (store->size > 0 && lo >= store->offset &&
+	hi < store->offset + store->size)
+	return 0;
+
+    size = hi - lo + 1;
+    if (size < store->size * 2)
+	size = store->size * 2;
+    if (size < SKETCH_GROW)
+	size = SKETCH_GROW;
+    if (size > SERIES_SKETCH_MAXBINS)
+	size = SERIES_SKETCH_MAXBINS;
+    /* leave room to grow in the direction of the new index */
+    offset = (store->size > 0 && lo < store->offset) ? hi - size + 1 : lo;
+
+    if ((counts = (double *)calloc(size, sizeof(double))) == NULL)
+	return -ENOMEM;
+    if (store->size > 0) {
+	if (store->lo <= store->hi)
+	    memcpy(&counts[store->lo - offset], &store->counts[store->lo - store->offset],
+		    (store->hi - store->lo + 1) * sizeof(double));
+	free(store->counts);
+    }
+    store->counts = counts;
+    store->offset = offset;
+    store->size = size;
+    return 0;
+}
+
+static int
+store_add(series_sketch_store_t *store, int index, double count)
+{
+    double		collapsed = 0;
+    int			lo, hi, cut = 0, i, sts;
+
+    if (store->lo > store->hi) {	/* empty */
+	lo = hi = index;
+    } else {
+	lo = index < store->lo ? index : store->lo;
+	hi = index > store->hi ? index : store->hi;
+	if (hi - lo + 1 > SERIES_SKETCH_MAXBINS) {
+	    /* collapse the buckets nearest zero into the lowest one kept */
+	    cut = hi - SERIES_SKETCH_MAXBINS + 1;
+	    if (index < cut) {
+		index = cut;
+	    } else {
+		for (i = store->lo; i < cut && i <= store->hi; i++) {
+		    collapsed += store->counts[i - store->offset];
+		    store->counts[i - store->offset] = 0;
+		}
+		store->lo = cut;
+	    }
+	    lo = cut;
+	}
+    }
+    if ((sts = store_extend(store, lo, hi)) < 0)
+	return sts;
+    if (collapsed != 0)
+	store->counts[cut - store->offset] += collapsed;
+    store->counts[index - store->offset] += count;
+    store->lo = lo;
+    store->hi = hi;
+    return 0;
+}
+
+static void
+store_reset(series_sketch_store_t *store)
+{
+    if (store->lo <= store->hi)
+	memset(&store->counts[store->lo - store->offset], 0,
+		(store->hi - store->lo + 1) * sizeof(double));
+    store->lo = 1;
+    store->hi = 0;
+}
+
+void
+series_sketch_init(series_sketch_t *sketch)
+{
+    memset(sketch, 0, sizeof(*sketch));
+    sketch->positive.lo = sketch->negative.lo = 1;
+    sketch->min = HUGE_VAL;
+    sketch->max = -HUGE_VAL;
+}
+
+/*
+ * Empty the sketch, keeping its buckets allocated for reuse
+ */
+void
+series_sketch_reset(series_sketch_t *sketch)
+{
+    store_reset(&sketch->positive);
+    store_reset(&sketch->negative);
+    sketch->count = sketch->zeros = 0;
+    sketch->min = HUGE_VAL;
+    sketch->max = -HUGE_VAL;
+}
+
+void
+series_sketch_free(series_sketch_t *sketch)
+{
+    free(sketch->positive.counts);
+    free(sketch->negative.counts);
+    series_sketch_init(sketch);
+}
+
+/*
+ * Add a value to the sketch - values that are not finite are skipped
+ */
+int
+series_sketch_add(series_sketch_t *sketch, double value)
+{
+    int			sts = 0;
+
+    if (!isfinite(value))
+	return 0;
+    if (value > SKETCH_MINVALUE)
+	sts = store_add(&sketch->positive, sketch_index(value), 1);
+    else if (value < -SKETCH_MINVALUE)
+	sts = store_add(&sketch->negative, sketch_index(-value), 1);
+    else
+	sketch->zeros++;
+    if (sts < 0)
+	return sts;
+    sketch->count++;
+    if (value < sketch->min)
+	sketch->min = value;
+    if (value > sketch->max)
+	sketch->max = value;
+    return 0;
+}
+
+/*
+ * Estimate the q quantile (0 <= q <= 1) of the values in the sketch,
+ * returns NaN for an empty sketch.
+ */
+double
+series_sketch_quantile(const series_sketch_t *sketch, double q)
+{
+    const series_sketch_store_t *store;
+    double		rank, total = 0, value;
+    int			i;
+
+    if (sketch->count == 0)
+	return NAN;
+    if (q <= 0)
+	return sketch->min;
+    if (q >= 1)
+	return sketch->max;
+
+    rank = q * (sketch->count - 1);
+    value = sketch->max;
+
+    /* most negative values first, i.e. the highest negative buckets */
+    store = &sketch->negative;
+    for (i = store->hi; i >= store->lo; i--) {
+	total += store->counts[i - store->offset];
+	if (total > rank) {
+	    value = -sketch_value(i);
+	    goto found;
+	}
+    }
+    total += sketch->zeros;
+    if (total > rank) {
+	value = 0;
+	goto found;
+    }
+    store = &sketch->positive;
+    for (i = store->lo; i <= store->hi; i++) {
+	total += store->counts[i - store->offset];
+	if (total > rank) {
+	    value = sketch_value(i);
+	    goto found;
+	}
+    }
+
+found:
+    if (value < sketch->min)
+	value = sketch->min;
+    if (value > sketch->max)
+	value = sketch->max;
+    return value;
+}
+
+/*
+ * Heap order - the entry that would be evicted first is at the root,
+ * i.e. the smallest value, and of equal values the latest (highest
+ * index), so that ties keep the first values seen as before.
+ */
+static int
+topk_before(const series_topk_entry_t *a, const series_topk_entry_t *b)
+{
+    if (a->value != b->value)
+	return a->value < b->value;
+    return a->index > b->index;
+}
+
+static void
+topk_sift_down(series_topk_entry_t *heap, unsigned int n, unsigned int i)
+{
+    series_topk_entry_t	entry = heap[i];
+    unsigned int	child;
+
+    while ((child = 2 * i + 1) < n) {
+	if (child + 1 < n && topk_before(&heap[child + 1], &heap[child]))
+	    child++;
+	if (!topk_before(&heap[child], &entry))
+	    break;
+	heap[i] = heap[child];
+	i = child;
+    }
+    heap[i] = entry;
+}
+
+int
+series_topk_init(series_topk_t *topk, unsigned int k)
+{
+    topk->k = k;
+    if ((topk->heap = calloc(k ? k : 1, sizeof(series_topk_entry_t))) == NULL)
+	return -ENOMEM;
+    return 0;
+}
+
+void
+series_topk_reset(series_topk_t *topk)
+{
+    memset(topk->heap, 0, topk->k * sizeof(series_topk_entry_t));
+}
+
+void
+series_topk_free(series_topk_t *topk)
+{
+    free(topk->heap);
+    topk->heap = NULL;
+    topk->k = 0;
+}
+
+void
+series_topk_add(series_topk_t *topk, double value, int index)
+{
+    if (topk->k == 0 || !(value > topk->heap[0].value))
+	return;
+    topk->heap[0].value = value;
+    topk->heap[0].index = index;
+    topk_sift_down(topk->heap, topk->k, 0);
+}
+
+/*
+ * Order the entries largest value first (ties by index), after which
+ * the heap must be reset before further use.
+ */
+void
+series_topk_sort(series_topk_t *topk)
+{
+    series_topk_entry_t	entry;
+    unsigned int	n;
+
+    for (n = topk->k; n > 1; n--) {
+	entry = topk->heap[0];
+	topk->heap[0] = topk->heap[n - 1];
+	topk->heap[n - 1] = entry;
+	topk_sift_down(topk->heap, n - 1, 0);
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#ifndef SERIES_SKETCH_H
+#define SERIES_SKETCH_H
+
+/*
+ * Fixed-size summaries of streams of series values, used by the query
+ * functions instead of gathering and sorting all values of a series.
+ * Each summary is built in one pass over the values of one series -
+ * there is no merging of summaries across series or time windows.
+ */
+
+/*
+ * Quantile sketch (DDSketch) - values are counted in logarithmically
+ * sized buckets, so that any quantile is estimated with a relative error
+ * of at most SERIES_SKETCH_ACCURACY.  The number of buckets is bounded,
+ * when exceeded the buckets nearest zero are collapsed together.
+ */
+#define SERIES_SKETCH_ACCURACY	0.01
+#define SERIES_SKETCH_MAXBINS	2048
+
+typedef struct series_sketch_store {
+    double		*counts;	/* bucket counts, from offset */
+    int			offset;		/* bucket index of counts[0] */
+    int			size;		/* allocated buckets */
+    int			lo;		/* lowest bucket index in use */
+    int			hi;		/* highest bucket index in use */
+} series_sketch_store_t;
+
+typedef struct series_sketch {
+    double		count;		/* number of values added */
+    double		zeros;		/* number of (near) zero values */
+    double		min;
+    double		max;
+    series_sketch_store_t positive;
+    series_sketch_store_t negative;	/* by magnitude */
+} series_sketch_t;
+
+extern void series_sketch_init(series_sketch_t *);
+extern void series_sketch_reset(series_sketch_t *);
+extern void series_sketch_free(series_sketch_t *);
+extern int series_sketch_add(series_sketch_t *, double);
+extern double series_sketch_quantile(const series_sketch_t *, double);
+
+/*
+ * Bounded heap of the k largest values seen and where they came from.
+ * As for the original topk functions, the heap starts out holding k
+ * zero values (at index zero), so only positive values are ranked.
+ */
+typedef struct series_topk_entry {
+    double		value;
+    int			index;
+} series_topk_entry_t;
+
+typedef struct series_topk {
+    unsigned int	k;
+    series_topk_entry_t	*heap;		/* smallest value at heap[0] */
+} series_topk_t;
+
+extern int series_topk_init(series_topk_t *, unsigned int);
+extern void series_topk_reset(series_topk_t *);
+extern void series_topk_free(series_topk_t *);
+extern void series_topk_add(series_topk_t *, double, int);
+extern void series_topk_sort(series_topk_t *);
+
+#endif	/* SERIES_SKETCH_H */
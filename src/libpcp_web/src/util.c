@@ -541,6 +541,7 @@ pmwebapi_instance_hash(indom_t *ip, instance_t *instance)
     sdsfree(identifier);
 
     instance->cached = 0;
+    instance->generation++;
 }
 
 sds
@@ -668,6 +669,14 @@ pmwebapi_release_context(context_t *cp)
     if (cp->labelset)
 	pmFreeLabelSets(cp->labelset, 1);
 
+    if (cp->scrapes) {
+	iterator = dictGetIterator(cp->scrapes);
+	while ((entry = dictNext(iterator)) != NULL)
+	    pmwebapi_free_scrapeplan((scrapeplan_t *)dictGetVal(entry));
+	dictReleaseIterator(iterator);
+	dictRelease(cp->scrapes);
+    }
+
     if (cp->metrics)	/* use the same value pointers as cp->pmids */
 	dictRelease(cp->metrics);	/* but, one entry per name */
 
@@ -893,14 +902,22 @@ pmwebapi_labelsetdup(pmLabelSet *lp)
     return dup;
 }
 
+/*
+ * Instance labels are requested only for instances not seen before,
+ * so the cost of refreshing an instance domain is proportional to the
+ * number of new instances rather than the size of the instance domain.
+ */
 void
 pmwebapi_add_instances_labels(struct context *context, struct indom *indom)
 {
     struct instance	*instance;
     pmLabelSet		*labels, *labelsets = NULL;
+    dictIterator	*iterator;
+    dictEntry		*entry;
     size_t		length;
     char		errmsg[PM_MAXERRMSGLEN], buffer[64];
-    int			i, inst, sts = 0, nsets = 0;
+    int			i, inst, sts = 0, nsets = 0, numinst = 0;
+    int			*instlist = NULL;
 
     if (indom->labelset == NULL) {
 	sts = pmGetInDomLabels(indom->indom, &indom->labelset);
@@ -916,8 +933,20 @@ pmwebapi_add_instances_labels(struct context *context, struct indom *indom)
 	}
     }
 
+    if (indom->updated == 0 &&
+	(instlist = calloc(dictSize(indom->insts), sizeof(int))) != NULL) {
+	iterator = dictGetIterator(indom->insts);
+	while ((entry = dictNext(iterator)) != NULL) {
+	    instance = dictGetVal(entry);
+	    if (instance->labelled == 0)
+		instlist[numinst++] = instance->inst;
+	}
+	dictReleaseIterator(iterator);
+    }
+
     if (indom->updated == 0) {
-	sts = nsets = pmGetInstancesLabels(indom->indom, &labelsets);
+	sts = nsets = pmGetInstancesLabelsList(indom->indom, numinst, instlist,
+					&labelsets);
 	if (sts == PM_ERR_IPC)
 	    context->setup = 0;
 	for (i = 0; i < nsets; i++) {
@@ -946,8 +975,14 @@ pmwebapi_add_instances_labels(struct context *context, struct indom *indom)
 		fprintf(stderr, "\nSHA1=%s\n", buffer);
 	    }
 	}
-	if (sts >= 0)
+	if (sts >= 0) {
+	    for (i = 0; i < numinst; i++) {
+		inst = instlist[i];
+		if ((instance = dictFetchValue(indom->insts, &inst)) != NULL)
+		    instance->labelled = 1;
+	    }
 	    indom->updated = 1;
+	}
 	else if (pmDebugOptions.series)
 	    fprintf(stderr, "failed to get indom (%s) instance labels: %s\n",
 		    pmInDomStr_r(indom->indom, buffer, sizeof(buffer)),
@@ -959,6 +994,8 @@ pmwebapi_add_instances_labels(struct context *context, struct indom *indom)
 
     if (labelsets)
 	pmFreeLabelSets(labelsets, nsets);
+    if (instlist)
+	free(instlist);
 }
 
 void
@@ -1267,6 +1304,27 @@ pmwebapi_add_item_labels(struct context *context, struct metric *metric)
     }
 }
 
+void
+pmwebapi_free_scrapeplan(scrapeplan_t *plan)
+{
+    scrapemetric_t	*entry;
+    unsigned int	i;
+
+    for (i = 0; i < plan->numpmid; i++) {
+	entry = &plan->metrics[i];
+	sdsfree(entry->sem);
+	sdsfree(entry->type);
+	sdsfree(entry->units);
+	sdsfree(entry->labels);
+	if (entry->instlabels)
+	    dictRelease(entry->instlabels);
+    }
+    free(plan->metrics);
+    free(plan->pmidlist);
+    memset(plan, 0, sizeof(*plan));
+    free(plan);
+}
+
 void
 pmwebapi_metric_help(struct context *context, struct metric *metric)
 {
@@ -1334,9 +1392,9 @@ pmwebapi_event_missed(void)
 }
 
 sds
-pmwebapi_event_parameter(sds s, pmValueSet *vsp, int inst, int *flags)
+pmwebapi_event_parameter(sds s, pmEventParam *param, int inst, int *flags)
 {
-    (void)vsp;
+    (void)param;
     (void)inst;
     (void)flags;
 
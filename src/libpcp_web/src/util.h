@@ -22,6 +22,7 @@ extern dictType intKeyDictCallBacks;	/* integer key -> (void *) value */
 extern dictType sdsKeyDictCallBacks;	/* sds string -> (void *) value */
 extern dictType sdsDictCallBacks;	/* sds key -> sds string value */
 extern dictType sdsOwnDictCallBacks;	/* owned sds key -> sds string value */
+extern dictType intSdsDictCallBacks;	/* integer key -> sds string value */
 
 extern const char *timespec_str(struct timespec *, char *, int);
 extern const char *timespec_stream_str(struct timespec *, char *, int);
@@ -102,11 +103,13 @@ extern int pmwebapi_add_valueset(struct metric *, pmValueSet *);
 extern void pmwebapi_free_metric(struct metric *);
 extern void pmwebapi_metric_help(struct context *, struct metric *);
 
+extern void pmwebapi_free_scrapeplan(struct scrapeplan *);
+
 extern void pmwebapi_event_flags(void);
 extern void pmwebapi_event_missed(void);
 extern sds pmwebapi_usectimestamp(sds, struct timeval *);
 extern sds pmwebapi_nsectimestamp(sds, struct timespec *);
-extern sds pmwebapi_event_parameter(sds, pmValueSet *, int, int *);
+extern sds pmwebapi_event_parameter(sds, pmEventParam *, int, int *);
 
 extern void pmwebapi_release_value(int, pmAtomValue *);
 
@@ -32,6 +32,8 @@ static unsigned int default_timeout;	/* timeout in milliseconds */
 #define DEFAULT_BATCHSIZE 256
 static unsigned int default_batchsize;	/* for groups of metrics */
 
+#define DEFAULT_SCRAPE_PLANS 32		/* cached scrape plans per context */
+
 /* constant string keys (initialized during setup) */
 static sds PARAM_HOSTNAME, PARAM_HOSTSPEC, PARAM_CTXNUM, PARAM_CTXID,
            PARAM_POLLTIME, PARAM_PREFIX, PARAM_MNAME, PARAM_MNAMES,
@@ -681,6 +683,33 @@ webgroup_encode_value(sds value, int type, pmAtomValue *atom)
     return sdscatlen(value, "null", 4);
 }
 
+/*
+ * PMCD reports namespace, agent or label changes - every scrape plan
+ * cached for this context is stale, not only any plan being fetched.
+ * Plans are rebuilt (and relabelled, if needed) when next used.
+ */
+static void
+webgroup_scrape_invalidate(context_t *cp, int sts)
+{
+    dictIterator	*iterator;
+    dictEntry		*entry;
+    scrapeplan_t	*plan;
+
+    if (!(sts & (PMCD_AGENT_CHANGE | PMCD_NAMES_CHANGE | PMCD_LABEL_CHANGE)))
+	return;
+    if (cp->scrapes == NULL)
+	return;
+
+    iterator = dictGetIterator(cp->scrapes);
+    while ((entry = dictNext(iterator)) != NULL) {
+	plan = (scrapeplan_t *)dictGetVal(entry);
+	plan->invalid = 1;
+	if (sts & PMCD_LABEL_CHANGE)
+	    plan->relabel = 1;
+    }
+    dictReleaseIterator(iterator);
+}
+
 static int
 webgroup_fetch(pmWebGroupSettings *settings, context_t *cp,
 		int numpmid, struct metric **mplist, pmID *pmidlist,
@@ -700,6 +729,8 @@ webgroup_fetch(pmWebGroupSettings *settings, context_t *cp,
     int			i, j, k, sts, inst, type, status = 0;
 
     if ((sts = pmFetchHighRes(numpmid, pmidlist, &result)) >= 0) {
+	webgroup_scrape_invalidate(cp, sts);
+
 	webresult.seconds = result->timestamp.tv_sec;
 	webresult.nanoseconds = result->timestamp.tv_nsec;
 
@@ -1729,55 +1760,136 @@ scrape_instance_labelsets(metric_t *metric, indom_t *indom, instance_t *inst,
     labels->instname = inst->name.sds;
 }
 
+/*
+ * Instances of an indom have been refreshed - drop the labels rendered
+ * for instances of every metric in the plan sharing that indom.
+ */
+static void
+webgroup_scrape_reindom(scrapeplan_t *plan, struct indom *indom)
+{
+    scrapemetric_t	*entry;
+    unsigned int	i;
+
+    for (i = 0; i < plan->numpmid; i++) {
+	entry = &plan->metrics[i];
+	if (entry->metric->indom == indom && entry->instlabels)
+	    dictEmpty(entry->instlabels, NULL);
+    }
+}
+
+/*
+ * PMCD reports label changes - discard labels held for the metrics
+ * in the plan, so that they are fetched afresh when next rebuilt.
+ */
+static void
+webgroup_scrape_relabel(scrapeplan_t *plan)
+{
+    struct metric	*metric;
+    unsigned int	i;
+
+    for (i = 0; i < plan->numpmid; i++) {
+	metric = plan->metrics[i].metric;
+	if (metric->labelset) {
+	    pmFreeLabelSets(metric->labelset, 1);
+	    metric->labelset = NULL;
+	}
+	sdsfree(metric->labels);
+	metric->labels = NULL;
+	if (metric->cluster->labelset) {
+	    pmFreeLabelSets(metric->cluster->labelset, 1);
+	    metric->cluster->labelset = NULL;
+	}
+	if (metric->cluster->domain->labelset) {
+	    pmFreeLabelSets(metric->cluster->domain->labelset, 1);
+	    metric->cluster->domain->labelset = NULL;
+	}
+	if (metric->indom) {
+	    if (metric->indom->labelset) {
+		pmFreeLabelSets(metric->indom->labelset, 1);
+		metric->indom->labelset = NULL;
+	    }
+	    sdsfree(metric->indom->labels);
+	    metric->indom->labels = NULL;
+	    metric->indom->updated = 0;
+	}
+    }
+}
+
+/*
+ * First scrape of a metric from this plan - lookup its labels and help
+ * text, and render the metric metadata strings sent with each scrape.
+ */
+static void
+webgroup_scrape_prepare(context_t *cp, scrapemetric_t *entry)
+{
+    struct metric	*metric = entry->metric;
+    char		buffer[64];
+
+    pmwebapi_add_domain_labels(cp, metric->cluster->domain);
+    pmwebapi_add_cluster_labels(cp, metric->cluster);
+    pmwebapi_add_item_labels(cp, metric);
+    pmwebapi_metric_help(cp, metric);
+
+    entry->sem = sdsnew(pmwebapi_semantics_str(metric, buffer, sizeof(buffer)));
+    entry->type = sdsnew(pmwebapi_type_str(metric, buffer, sizeof(buffer)));
+    entry->units = sdsnew(pmwebapi_units_str(metric, buffer, sizeof(buffer)));
+    if (metric->desc.indom != PM_INDOM_NULL)
+	entry->instlabels = dictCreate(&intSdsDictCallBacks, NULL);
+}
+
 static int
 webgroup_scrape(pmWebGroupSettings *settings, context_t *cp,
-		int numpmid, struct metric **mplist, pmID *pmidlist,
+		scrapeplan_t *plan, unsigned int start, unsigned int numpmid,
 		sds *msg, void *arg)
 {
     struct instance	*instance;
     struct metric	*metric;
     struct indom	*indom;
     struct value	*value;
+    scrapemetric_t	*entry;
     pmWebLabelSet	labels;
     pmWebScrape		scrape;
     pmHighResResult	*result;
-    sds			sems, types, units;
-    sds			v = sdsempty(), series = NULL;
-    int			i, j, k, sts, type;
+    sds			cached, v = sdsempty(), series = NULL;
+    unsigned int	i;
+    int			j, k, sts, type;
 
-    /* pre-allocate buffers for metric metadata */
-    sems = sdsnewlen(NULL, 20); sdsclear(sems);
-    types = sdsnewlen(NULL, 20); sdsclear(types);
-    units = sdsnewlen(NULL, 64); sdsclear(units);
     labels.buffer = sdsnewlen(NULL, PM_MAXLABELJSONLEN);
     sdsclear(labels.buffer);
 
-    if ((sts = pmFetchHighRes(numpmid, pmidlist, &result)) >= 0) {
+    if ((sts = pmFetchHighRes(numpmid, plan->pmidlist + start, &result)) >= 0) {
+	/* namespace or label changes invalidate all cached scrape plans */
+	webgroup_scrape_invalidate(cp, sts);
+	if (sts & (PMCD_AGENT_CHANGE | PMCD_NAMES_CHANGE | PMCD_LABEL_CHANGE))
+	    plan->invalid = 1;
+	if (sts & PMCD_LABEL_CHANGE)
+	    plan->relabel = 1;
+
 	scrape.seconds = result->timestamp.tv_sec;
 	scrape.nanoseconds = result->timestamp.tv_nsec;
 
 	/* extract all values from the result for later stages */
 	for (i = 0; i < numpmid; i++)
-	    if ((metric = mplist[i]) != NULL)
-		pmwebapi_add_valueset(metric, result->vset[i]);
+	    pmwebapi_add_valueset(plan->metrics[start + i].metric,
+				  result->vset[i]);
 
 	/* for each metric, send all metadata and fresh values */
 	for (i = 0; i < numpmid; i++) {
-	    if ((metric = mplist[i]) == NULL)
-		continue;
+	    entry = &plan->metrics[start + i];
+	    metric = entry->metric;
 
 	    if (metric->updated == 0)
 		continue;
-	    pmwebapi_add_domain_labels(cp, metric->cluster->domain);
-    	    pmwebapi_add_cluster_labels(cp, metric->cluster);
-	    pmwebapi_add_item_labels(cp, metric);
-	    pmwebapi_metric_help(cp, metric);
+	    if (entry->sem == NULL)
+		webgroup_scrape_prepare(cp, entry);
 
 	    type = metric->desc.type;
 	    indom = metric->indom;
 	    if (indom && indom->updated == 0 &&
-		pmwebapi_add_indom_instances(cp, indom) > 0)
+		pmwebapi_add_indom_instances(cp, indom) > 0) {
 		pmwebapi_add_instances_labels(cp, indom);
+		webgroup_scrape_reindom(plan, indom);
+	    }
 	    if (indom)
 		pmwebapi_add_indom_labels(indom);
 
@@ -1787,16 +1899,9 @@ webgroup_scrape(pmWebGroupSettings *settings, context_t *cp,
 		scrape.metric.name = metric->names[j].sds;
 		scrape.metric.pmid = metric->desc.pmid;
 		scrape.metric.indom = metric->desc.indom;
-
-		pmwebapi_semantics_str(metric, sems, 20);
-		scrape.metric.sem = sems;
-		sdsupdatelen(sems);
-		pmwebapi_type_str(metric, types, 20);
-		scrape.metric.type = types;
-		sdsupdatelen(types);
-		pmwebapi_units_str(metric, units, 64);
-		scrape.metric.units = units;
-		sdsupdatelen(units);
+		scrape.metric.sem = entry->sem;
+		scrape.metric.type = entry->type;
+		scrape.metric.units = entry->units;
 		scrape.metric.labels = NULL;
 		scrape.metric.oneline = metric->oneline;
 		scrape.metric.helptext = metric->helptext;
@@ -1809,13 +1914,16 @@ webgroup_scrape(pmWebGroupSettings *settings, context_t *cp,
 		    memset(&scrape.instance, 0, sizeof(scrape.instance));
 		    scrape.instance.inst = PM_IN_NULL;
 
-		    if (metric->labels == NULL)
-			pmwebapi_metric_hash(metric);
-		    scrape_metric_labelsets(metric, &labels);
-		    if (settings->callbacks.on_scrape_labels)
-			settings->callbacks.on_scrape_labels(
+		    if (entry->labels == NULL) {
+			if (metric->labels == NULL)
+			    pmwebapi_metric_hash(metric);
+			scrape_metric_labelsets(metric, &labels);
+			if (settings->callbacks.on_scrape_labels)
+			    settings->callbacks.on_scrape_labels(
 					cp->origin, &labels, arg);
-		    scrape.metric.labels = labels.buffer;
+			entry->labels = sdsdup(labels.buffer);
+		    }
+		    scrape.metric.labels = entry->labels;
 
 		    settings->callbacks.on_scrape(cp->origin, &scrape, arg);
 		    continue;
@@ -1835,13 +1943,18 @@ webgroup_scrape(pmWebGroupSettings *settings, context_t *cp,
 		    scrape.instance.inst = instance->inst;
 		    scrape.instance.name = instance->name.sds;
 
-		    if (instance->labels == NULL)
-			pmwebapi_instance_hash(indom, instance);
-		    scrape_instance_labelsets(metric, indom, instance, &labels);
-		    if (settings->callbacks.on_scrape_labels)
-			settings->callbacks.on_scrape_labels(
+		    cached = dictFetchValue(entry->instlabels, &value->inst);
+		    if (cached == NULL) {
+			if (instance->labels == NULL)
+			    pmwebapi_instance_hash(indom, instance);
+			scrape_instance_labelsets(metric, indom, instance, &labels);
+			if (settings->callbacks.on_scrape_labels)
+			    settings->callbacks.on_scrape_labels(
 					cp->origin, &labels, arg);
-		    scrape.instance.labels = labels.buffer;
+			cached = sdsdup(labels.buffer);
+			dictAdd(entry->instlabels, &value->inst, cached);
+		    }
+		    scrape.instance.labels = cached;
 
 		    settings->callbacks.on_scrape(cp->origin, &scrape, arg);
 		}
@@ -1851,120 +1964,149 @@ webgroup_scrape(pmWebGroupSettings *settings, context_t *cp,
     } else {
 	char		err[PM_MAXERRMSGLEN];
 
-	if (sts == PM_ERR_IPC)
+	if (sts == PM_ERR_IPC) {
 	    cp->setup = 0;
+	    plan->invalid = 1;
+	}
 
 	infofmt(*msg, "%s", pmErrStr_r(sts, err, sizeof(err)));
     }
 
     sdsfree(v);
-    sdsfree(sems);
-    sdsfree(types);
-    sdsfree(units);
     sdsfree(series);
     sdsfree(labels.buffer);
 
     return sts < 0 ? sts : 0;
 }
 
-static int
-webgroup_scrape_names(pmWebGroupSettings *settings, context_t *cp,
-	int numnames, sds *names, struct metric **mplist, pmID *pmidlist,
-	sds *msg, void *arg)
-{
-    struct metric	*metric;
-    int			i, sts = 0;
-
-    if (webgroup_use_context(cp, &sts, msg, arg) == NULL)
-	return sts;
-
-    for (i = 0; i < numnames; i++) {
-	metric = mplist[i] = webgroup_lookup_metric(settings, cp, names[i], arg);
-	pmidlist[i] = metric ? metric->desc.pmid : PM_ID_NULL;
-    }
-    return webgroup_scrape(settings, cp, numnames, mplist, pmidlist, msg, arg);
-}
-
 typedef struct webscrape {
     pmWebGroupSettings	*settings;
     struct context	*context;
     sds			*msg;
     int			status;
     unsigned int	numnames;	/* current count of metric names */
-    sds			*names;		/* metric names for batched up scrape */
-    struct metric	**mplist;
-    pmID		*pmidlist;
+    unsigned int	maxnames;	/* allocated count of metric names */
+    sds			*names;		/* metric names from PMNS traversal */
     void		*arg;
 } webscrape_t;
 
 /* Metric namespace traversal callback for use with pmTraversePMNS_r(3) */
 static void
-webgroup_scrape_batch(const char *name, void *arg)
+webgroup_scrape_name(const char *name, void *arg)
 {
     struct webscrape	*scrape = (struct webscrape *)arg;
-    int			i, sts;
-
-    if (scrape->names == NULL) {
-	scrape->names = calloc(DEFAULT_BATCHSIZE, sizeof(sds));
-	scrape->mplist = calloc(DEFAULT_BATCHSIZE, sizeof(metric_t *));
-	scrape->pmidlist = calloc(DEFAULT_BATCHSIZE, sizeof(pmID));
-	scrape->numnames = 0;
-    }
-
-    scrape->names[scrape->numnames] = sdsnew(name);
-    scrape->numnames++;
+    sds			*names;
 
-    if (scrape->numnames == DEFAULT_BATCHSIZE) {
-	sts = webgroup_scrape_names(scrape->settings, scrape->context,
-			scrape->numnames, scrape->names,
-			scrape->mplist, scrape->pmidlist,
-			scrape->msg, scrape->arg);
-	for (i = 0; i < scrape->numnames; i++)
-	    sdsfree(scrape->names[i]);
-	scrape->numnames = 0;
-	if (sts < 0)
-	    scrape->status = sts;
+    if (scrape->numnames == scrape->maxnames) {
+	names = realloc(scrape->names,
+		(scrape->maxnames + DEFAULT_BATCHSIZE) * sizeof(sds));
+	if (names == NULL) {
+	    scrape->status = -ENOMEM;
+	    return;
+	}
+	scrape->names = names;
+	scrape->maxnames += DEFAULT_BATCHSIZE;
     }
+    scrape->names[scrape->numnames++] = sdsnew(name);
 }
 
 static int
 webgroup_scrape_tree(const char *prefix, struct webscrape *scrape)
 {
-    int			i, sts;
+    int			sts;
     char		err[PM_MAXERRMSGLEN];
 
     if (pmDebugOptions.libweb)
 	fprintf(stderr, "%s: scraping namespace prefix \"%s\"\n",
 			"pmWebGroupScrape", prefix);
 
-    sts = pmTraversePMNS_r(prefix, webgroup_scrape_batch, scrape);
-    if (sts >= 0 && scrape->status >= 0 && scrape->numnames) {
-	/* complete any remaining (sub-batchsize) leftovers */
-	sts = webgroup_scrape_names(scrape->settings, scrape->context,
-				    scrape->numnames, scrape->names,
-				    scrape->mplist, scrape->pmidlist,
-				    scrape->msg, scrape->arg);
-	for (i = 0; i < scrape->numnames; i++)
-	    sdsfree(scrape->names[i]);
-	scrape->numnames = 0;
-    } else {
+    sts = pmTraversePMNS_r(prefix, webgroup_scrape_name, scrape);
+    if (sts < 0 || scrape->status < 0) {
+	if (sts >= 0)
+	    sts = scrape->status;
+	if (sts == PM_ERR_IPC)
+	    scrape->context->setup = 0;
 	infofmt(*scrape->msg, "'%s' - %s", prefix,
 		pmErrStr_r(sts, err, sizeof(err)));
+	return sts;
     }
+    return 0;
+}
 
-    if (sts >= 0)
-	sts = (scrape->status < 0) ? scrape->status : 0;
-    return sts;
+/*
+ * Traverse the namespace below each of the comma-separated metric names
+ * (else the entire namespace) and lookup every metric found, producing
+ * a scrape plan.  Plans are marked invalid (not to be cached) if any
+ * part of the namespace or any metric could not be resolved.
+ */
+static scrapeplan_t *
+webgroup_scrape_plan(pmWebGroupSettings *settings, context_t *cp,
+		sds metrics, int *status, sds *msg, void *arg)
+{
+    struct webscrape	scrape = {0};
+    struct metric	*metric;
+    scrapeplan_t	*plan;
+    unsigned int	i;
+    int			sts = 0, failed = 0, numnames = 0;
+    sds			*names = NULL;
+
+    scrape.settings = settings;
+    scrape.context = cp;
+    scrape.msg = msg;
+    scrape.arg = arg;
+
+    /* handle scrape via metric name list traversal (else entire namespace) */
+    if (sdslen(metrics)) {
+	if ((names = sdssplitlen(metrics, sdslen(metrics), ",", 1, &numnames)) == NULL)
+	    failed = sts = webgroup_scrape_tree("", &scrape);
+	for (i = 0; i < numnames; i++)
+	    if ((sts = webgroup_scrape_tree(names[i], &scrape)) < 0)
+		failed = sts;
+	sdsfreesplitres(names, numnames);
+    } else {
+	failed = sts = webgroup_scrape_tree("", &scrape);
+    }
+
+    if ((plan = (scrapeplan_t *)calloc(1, sizeof(*plan))) == NULL ||
+	(scrape.numnames > 0 &&
+	 ((plan->metrics = calloc(scrape.numnames, sizeof(scrapemetric_t))) == NULL ||
+	  (plan->pmidlist = calloc(scrape.numnames, sizeof(pmID))) == NULL))) {
+	if (plan)
+	    pmwebapi_free_scrapeplan(plan);
+	plan = NULL;
+	sts = -ENOMEM;
+    } else if (failed < 0) {
+	plan->invalid = 1;
+    }
+
+    for (i = 0; i < scrape.numnames; i++) {
+	if (plan != NULL) {
+	    metric = webgroup_lookup_metric(settings, cp, scrape.names[i], arg);
+	    if (metric == NULL) {
+		plan->invalid = 1;
+	    } else {
+		plan->metrics[plan->numpmid].metric = metric;
+		plan->pmidlist[plan->numpmid] = metric->desc.pmid;
+		plan->numpmid++;
+	    }
+	}
+	sdsfree(scrape.names[i]);
+    }
+    free(scrape.names);
+
+    if (sts < 0)
+	*status = sts;
+    return plan;
 }
 
 void
 pmWebGroupScrape(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
 {
-    struct webscrape	scrape = {0};
     struct context	*cp;
-    size_t		length;
-    int			sts = 0, i, numnames = 0;
-    sds			msg = NULL, *names = NULL, metrics;
+    scrapeplan_t	*plan = NULL;
+    unsigned int	i, count;
+    int			sts = 0, fetched, cached = 0;
+    sds			msg = NULL, metrics;
 
     if (params) {
 	if ((metrics = dictFetchValue(params, PARAM_MNAMES)) == NULL)
@@ -1974,32 +2116,57 @@ pmWebGroupScrape(pmWebGroupSettings *settings, sds id, dict *params, void *arg)
     } else {
 	metrics = NULL;
     }
+    if (metrics == NULL)
+	metrics = EMPTYSTRING;
 
     if (!(cp = webgroup_lookup_context(settings, &id, params, &sts, &msg, arg)))
 	goto done;
     id = cp->origin;
 
-    scrape.settings = settings;
-    scrape.context = cp;
-    scrape.msg = &msg;
-    scrape.arg = arg;
+    if (webgroup_use_context(cp, &sts, &msg, arg) == NULL)
+	goto done;
 
-    /* handle scrape via metric name list traversal (else entire namespace) */
-    if (metrics && sdslen(metrics)) {
-	length = sdslen(metrics);
-	if ((names = sdssplitlen(metrics, length, ",", 1, &numnames)) == NULL)
-	    sts = webgroup_scrape_tree("", &scrape);
-	for (i = 0; i < numnames; i++)
-	    sts = webgroup_scrape_tree(names[i], &scrape);
-	sdsfreesplitres(names, numnames);
-    } else {
-	sts = webgroup_scrape_tree("", &scrape);
+    /* use the cached plan for these names, else traverse the namespace */
+    if (cp->scrapes == NULL)
+	cp->scrapes = dictCreate(&sdsKeyDictCallBacks, NULL);
+    if ((plan = dictFetchValue(cp->scrapes, metrics)) != NULL) {
+	if (plan->invalid) {
+	    /* invalidated by a fetch since it was cached - rebuild it */
+	    if (plan->relabel)
+		webgroup_scrape_relabel(plan);
+	    dictDelete(cp->scrapes, metrics);
+	    pmwebapi_free_scrapeplan(plan);
+	    plan = NULL;
+	} else {
+	    cached = 1;
+	}
+    }
+    if (plan == NULL &&
+	(plan = webgroup_scrape_plan(settings, cp, metrics,
+				     &sts, &msg, arg)) == NULL)
+	goto done;
+
+    for (i = 0; i < plan->numpmid; i += count) {
+	count = plan->numpmid - i;
+	if (count > DEFAULT_BATCHSIZE)
+	    count = DEFAULT_BATCHSIZE;
+	if ((fetched = webgroup_scrape(settings, cp, plan, i, count, &msg, arg)) < 0) {
+	    sts = fetched;
+	    break;
+	}
     }
 
-    if (scrape.names) {
-	free(scrape.names);
-	free(scrape.mplist);
-	free(scrape.pmidlist);
+    if (plan->relabel)
+	webgroup_scrape_relabel(plan);
+    if (plan->invalid || cp->setup == 0) {
+	if (cached)
+	    dictDelete(cp->scrapes, metrics);
+	pmwebapi_free_scrapeplan(plan);
+    } else if (!cached) {
+	if (dictSize(cp->scrapes) < DEFAULT_SCRAPE_PLANS)
+	    dictAdd(cp->scrapes, metrics, plan);
+	else
+	    pmwebapi_free_scrapeplan(plan);
     }
 
 done:
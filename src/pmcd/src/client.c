@@ -24,6 +24,26 @@ __pmFdSet	clientFds;		/* for client select() */
 
 static int	clientSize;
 
+/*
+ * Tell a DSO PMDA (PMDA_INTERFACE_5 or later) that a context has
+ * been closed.
+ */
+void
+DsoEndContext(AgentInfo *ap, int ctx)
+{
+    pmdaInterface	*dp = &ap->ipc.dso.dispatch;
+
+    if (dp->comm.pmda_interface >= PMDA_INTERFACE_5) {
+	if (dp->version.four.ext->e_endCallBack != NULL) {
+	    if (pmDebugOptions.context) {
+		fprintf(stderr, "NotifyEndContext: DSO PMDA %s (%d) notified of context %d close\n",
+		    ap->pmDomainLabel, ap->pmDomainId, ctx);
+	    }
+	    (*(dp->version.four.ext->e_endCallBack))(ctx);
+	}
+    }
+}
+
 /*
  * For PMDA_INTERFACE_5 or later PMDAs, post a notification that
  * a context has been closed.
@@ -37,19 +57,11 @@ NotifyEndContext(int ctx)
 	if (!agent[i].status.connected ||
 	    agent[i].status.busy || agent[i].status.notReady)
 	    continue;
-	if (agent[i].ipcType == AGENT_DSO) {
-	    pmdaInterface	*dp = &agent[i].ipc.dso.dispatch;
-	    if (dp->comm.pmda_interface >= PMDA_INTERFACE_5) {
-		if (dp->version.four.ext->e_endCallBack != NULL) {
-		    if (pmDebugOptions.context) {
-			fprintf(stderr, "NotifyEndContext: DSO PMDA %s (%d) notified of context %d close\n",
-			    agent[i].pmDomainLabel, agent[i].pmDomainId,
-			    ctx);
-		    }
-		    (*(dp->version.four.ext->e_endCallBack))(ctx);
-		}
-	    }
-	}
+	if (DsoOffloadBusy(&agent[i]))
+	    /* notified once the offload worker is out of the DSO */
+	    DsoOffloadEndContext(ctx);
+	else if (agent[i].ipcType == AGENT_DSO)
+	    DsoEndContext(&agent[i], ctx);
 	else {
 	    /*
 	     * Daemon PMDA case ... we don't know the PMDA_INTERFACE
@@ -113,12 +125,31 @@ AcceptNewClient(int reqfd)
 	DeleteClient(&client[i]);
 	return NULL;	
     }
+    if (!IOEventActive() && fd >= FD_SETSIZE) {
+	/* select(2) fallback cannot multiplex this descriptor */
+	pmNotifyErr(LOG_ERR, "AcceptNewClient(%d): "
+		    "fd %d exceeds FD_SETSIZE (%d), connection refused\n",
+		    reqfd, fd, FD_SETSIZE);
+	__pmCloseSocket(fd);
+	client[i].fd = -1;
+	DeleteClient(&client[i]);
+	return NULL;
+    }
     if (fd > maxClientFd)
 	maxClientFd = fd;
 
     pmcd_openfds_sethi(fd);
 
-    __pmFD_SET(fd, &clientFds);
+    if (IOEventActive()) {
+	if (IOEventAdd(fd, IOEVENT_CLIENT, i) < 0) {
+	    __pmCloseSocket(fd);
+	    client[i].fd = -1;
+	    DeleteClient(&client[i]);
+	    return NULL;
+	}
+    }
+    else
+	__pmFD_SET(fd, &clientFds);
     __pmSetVersionIPC(fd, UNKNOWN_VERSION);	/* before negotiation */
     __pmSetSocketIPC(fd);
 
@@ -196,7 +227,10 @@ DeleteClient(ClientInfo *cp)
 	return;
     }
     if (cp->fd != -1) {
-	__pmFD_CLR(cp->fd, &clientFds);
+	if (IOEventActive())
+	    IOEventDel(cp->fd);
+	else
+	    __pmFD_CLR(cp->fd, &clientFds);
 	__pmCloseSocket(cp->fd);
     }
     if (i == nClients-1) {
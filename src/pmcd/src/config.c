@@ -1389,6 +1389,8 @@ DoAttributes(AgentInfo *ap, int clientID)
 
     if ((ap->status.flags & (PDU_FLAG_AUTH|PDU_FLAG_CONTAINER)) == 0)
 	return 0;
+    if (DsoOffloadBusy(ap))
+	return PM_ERR_AGAIN;
 
     if (ap->ipcType == AGENT_DSO) {
 	if (ap->ipc.dso.dispatch.comm.pmda_interface < PMDA_INTERFACE_6 ||
@@ -2431,37 +2433,33 @@ ParseRestartAgents(char *fileName)
     AgentInfo	*oldAgent;
     int		oldNAgents;
     AgentInfo	*ap;
-    __pmFdSet	fds;
 
     /* Clean up any deceased agents.  We haven't seen an agent's death unless
      * a PDU transfer involving the agent has occurred.  This cleans up others
      * as well.
      */
-    __pmFD_ZERO(&fds);
-    j = -1;
+    AgentWaitReset();
+    j = 0;
     for (i = 0; i < nAgents; i++) {
 	ap = &agent[i];
 	if (ap->status.connected &&
 	    (ap->ipcType == AGENT_SOCKET || ap->ipcType == AGENT_PIPE)) {
 
-	    __pmFD_SET(ap->outFd, &fds);
-	    if (ap->outFd > j)
-		j = ap->outFd;
+	    if (AgentWaitAdd(ap->outFd) == 0)
+		j++;
 	}
     }
-    if (++j) {
+    if (j) {
 	/* any agent with output ready has either closed the file descriptor or
 	 * sent an unsolicited PDU.  Clean up the agent in either case.
 	 */
-	struct timeval	timeout = {0, 0};
-
-	sts = __pmSelectRead(j, &fds, &timeout);
+	sts = AgentWaitPoll(0);
 	if (sts > 0) {
 	    for (i = 0; i < nAgents; i++) {
 		ap = &agent[i];
 		if (ap->status.connected &&
 		    (ap->ipcType == AGENT_SOCKET || ap->ipcType == AGENT_PIPE) &&
-		    __pmFD_ISSET(ap->outFd, &fds)) {
+		    AgentWaitReady(ap->outFd)) {
 
 		    /* try to discover more ... */
 		    __pmPDU	*pb;
@@ -2481,7 +2479,7 @@ ParseRestartAgents(char *fileName)
 	    }
 	}
 	else if (sts < 0)
-	    fprintf(stderr, "pmcd: deceased agents select: %s\n",
+	    fprintf(stderr, "pmcd: deceased agents poll: %s\n",
 			 netstrerror());
     }
 
@@ -241,6 +241,12 @@ SendFetch(DomPmidList *dpList, AgentInfo *aPtr, ClientInfo *cPtr, int ctxnum)
      */
     aPtr->status.madeDsoResult = 0;
 
+    if (DsoOffloadBusy(aPtr)) {
+	/* overrunning offloaded fetch is still in the DSO */
+	aPtr->status.madeDsoResult = 1;
+	return MakeBadResult(dpList->listSize, dpList->list, PM_ERR_AGAIN);
+    }
+
     if (aPtr->profClient != cPtr || ctxnum != aPtr->profIndex) {
 	hcp = &cPtr->profile;
 	hp = __pmHashSearch(ctxnum, hcp);
@@ -392,6 +398,31 @@ ExtractState(int i, void *timestamp)
     return (int)byte;
 }
 
+/*
+ * Gather the results for the DSO agents whose fetches were offloaded.
+ * If sts < 0 the worker has not finished, so all of those metrics get
+ * sts as their error.
+ */
+static void
+CollectDsoResults(DomPmidList *dList, pmResult **results, int sts,
+		  unsigned int *changes)
+{
+    int		i, j, s;
+
+    for (i = 0; dList[i].domain != -1; i++) {
+	j = mapdom[dList[i].domain];
+	if (agent[j].ipcType != AGENT_DSO || results[j] != NULL)
+	    continue;
+	s = (sts < 0) ? sts : DsoOffloadResult(j, &results[j]);
+	if (s < 0) {
+	    agent[j].status.madeDsoResult = 1;
+	    results[j] = MakeBadResult(dList[i].listSize, dList[i].list, s);
+	}
+	else
+	    *changes |= ExtractState(j, &results[j]->timestamp);
+    }
+}
+
 /*
  * Handle both the original and high resolution fetch PDU requests.
  * The input handling and PMDA interactions are the same, difference
@@ -402,6 +433,7 @@ static int
 HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
 {
     int			i, j;
+    int			pass;
     int 		sts;
     int			ctxnum;
     unsigned int	changes = 0;
@@ -413,11 +445,9 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
     static int		nDoms;
     static pmResult	**results;	/* array of replies from PMDAs */
     static int		*resIndex;
-    __pmFdSet		waitFds;
-    __pmFdSet		readyFds;
     int			nWait;
-    int			maxFd;
-    struct timeval	timeout;
+    int			nDso;
+    int			polled;
     __pmHashCtl		*hcp;
     __pmHashNode	*hp;
     pmProfile		*profile;
@@ -483,41 +513,72 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
      * come back immediately.  If a request cannot be sent to an agent, a
      * suitable pmResult (containing metric not available values) will be
      * returned.
+     *
+     * Requests are sent to all of the daemon agents first (pass 0), so
+     * they are all working concurrently while pmcd calls into each of
+     * the DSO agents (pass 1), and then the daemon agent replies are
+     * gathered below.  The elapsed time for the fetch is then bounded by
+     * the larger of the DSO agents' time and the slowest daemon agent's
+     * time, rather than the sum of all the agents' times.
+     *
+     * With PMCD_DSO_OFFLOAD, the DSO agent fetches are queued for the
+     * offload worker thread instead, and the worker is waited on (with
+     * the same pmcd_timeout bound) along with the daemon agents.
      */
-    __pmFD_ZERO(&waitFds);
+    AgentWaitReset();
     nWait = 0;
-    maxFd = -1;
-    for (i = 0; dList[i].domain != -1; i++) {
-	j = mapdom[dList[i].domain];
-	results[j] = SendFetch(&dList[i], &agent[j], cip, ctxnum);
-	if (results[j] == NULL) { /* Wait for agent's response */
-	    int fd = agent[j].outFd;
-	    agent[j].status.busy = 1;
-	    __pmFD_SET(fd, &waitFds);
-	    if (fd > maxFd)
-		maxFd = fd;
-	    nWait++;
-	} else {
-	    changes |= ExtractState(i, &results[j]->timestamp);
+    nDso = 0;
+    for (pass = 0; pass < 2; pass++) {
+	for (i = 0; dList[i].domain != -1; i++) {
+	    j = mapdom[dList[i].domain];
+	    if ((agent[j].ipcType == AGENT_DSO) != (pass == 1))
+		continue;
+	    if (pass == 1 && DsoOffloadAdd(&agent[j], (int)(cip - client),
+				profile, dList[i].listSize, dList[i].list) == 0) {
+		agent[j].status.madeDsoResult = 0;
+		agent[j].profClient = NULL;	/* DSO has a private copy */
+		nDso++;
+		continue;
+	    }
+	    results[j] = SendFetch(&dList[i], &agent[j], cip, ctxnum);
+	    if (results[j] == NULL) { /* Wait for agent's response */
+		if ((sts = AgentWaitAdd(agent[j].outFd)) < 0) {
+		    results[j] = MakeBadResult(dList[i].listSize,
+					       dList[i].list, sts);
+		    CleanupAgent(&agent[j], AT_COMM, agent[j].inFd);
+		    continue;
+		}
+		agent[j].status.busy = 1;
+		nWait++;
+	    } else {
+		changes |= ExtractState(j, &results[j]->timestamp);
+	    }
 	}
     }
     /* Construct pmResult for bad-pmID list */
     if (dList[i].listSize != 0)
 	results[nAgents] = MakeBadResult(dList[i].listSize, dList[i].list, PM_ERR_NOAGENT);
 
-    /* Wait for results to roll in from agents */
-    while (nWait > 0) {
-        __pmFD_COPY(&readyFds, &waitFds);
-	if (nWait > 1) {
-	    timeout.tv_sec = pmcd_timeout;
-	    timeout.tv_usec = 0;
+    if (nDso > 0) {
+	DsoOffloadStart();
+	if ((sts = AgentWaitAdd(DsoOffloadFd())) < 0) {
+	    /* cannot wait for the worker, treat as overrun */
+	    DsoOffloadAbandon();
+	    CollectDsoResults(dList, results, PM_ERR_AGAIN, &changes);
+	    nDso = 0;
+	}
+    }
 
+    /* Wait for results to roll in from agents */
+    while (nWait > 0 || nDso > 0) {
+	/* with only one agent left, __pmGetPDU() does the waiting */
+	if ((polled = (nWait > 1 || nDso > 0))) {
             retry:
 	    setoserror(0);
-	    sts = __pmSelectRead(maxFd+1, &readyFds, &timeout);
+	    sts = AgentWaitPoll(pmcd_timeout);
 
 	    if (sts == 0) {
-		pmNotifyErr(LOG_INFO, "DoFetch: select timeout");
+		pmNotifyErr(LOG_INFO, "DoFetch: poll timeout");
 
 		/* Timeout, terminate agents with undelivered results */
 		for (i = 0; i < nAgents; i++) {
@@ -533,27 +594,39 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
 			CleanupAgent(&agent[i], AT_COMM, agent[i].inFd);
 		    }
 		}
+		if (nDso > 0) {
+		    /* worker is still in a DSO, results come later if at all */
+		    DsoOffloadAbandon();
+		    CollectDsoResults(dList, results, PM_ERR_TIMEOUT, &changes);
+		}
 		break;
 	    }
 	    else if (sts < 0) {
 		if (neterror() == EINTR)
 		    goto retry;
 		/* this is not expected to happen! */
-		pmNotifyErr(LOG_ERR, "DoFetch: fatal select failure: %s\n",
+		pmNotifyErr(LOG_ERR, "DoFetch: fatal poll failure: %s\n",
 			netstrerror());
 		Shutdown();
 		exit(1);
 	    }
 	}
 
+	if (nDso > 0 && AgentWaitReady(DsoOffloadFd())) {
+	    AgentWaitDel(DsoOffloadFd());
+	    DsoOffloadDone();
+	    CollectDsoResults(dList, results, 0, &changes);
+	    nDso = 0;
+	}
+
 	/* Read results from agents that have them ready */
 	for (i = 0; i < nAgents; i++) {
 	    AgentInfo	*ap = &agent[i];
 	    int		pinpdu;
-	    if (!ap->status.busy || !__pmFD_ISSET(ap->outFd, &readyFds))
+	    if (!ap->status.busy || (polled && !AgentWaitReady(ap->outFd)))
 		continue;
 	    ap->status.busy = 0;
-	    __pmFD_CLR(ap->outFd, &waitFds);
+	    AgentWaitDel(ap->outFd);
 	    nWait--;
 	    pinpdu = sts = __pmGetPDU(ap->outFd, ANY_SIZE, pmcd_timeout, &pb);
 	    if (sts > 0)
@@ -71,6 +71,8 @@ DoText(ClientInfo *cp, __pmPDU* pb)
 	return PM_ERR_NOAGENT;
     if (ap->status.fenced)
 	return PM_ERR_PMDAFENCED;
+    if (DsoOffloadBusy(ap))
+	return PM_ERR_AGAIN;
 
     if (ap->ipcType == AGENT_DSO) {
 	if (ap->ipc.dso.dispatch.comm.pmda_interface >= PMDA_INTERFACE_5)
@@ -195,6 +197,11 @@ GetDescs(ClientInfo *cp, int numpmid, pmID *pmids, pmDesc *descs)
 	    sts = PM_ERR_PMDAFENCED;
 	    continue;
 	}
+	if (DsoOffloadBusy(ap)) {
+	    descs[i].pmid = PM_ID_NULL;
+	    sts = PM_ERR_AGAIN;
+	    continue;
+	}
 
 	if (ap->ipcType == AGENT_DSO) {
 	    if (ap->ipc.dso.dispatch.comm.pmda_interface >= PMDA_INTERFACE_5)
@@ -341,6 +348,10 @@ DoInstance(ClientInfo *cp, __pmPDU *pb)
 	if (name != NULL) free(name);
 	return PM_ERR_PMDAFENCED;
     }
+    if (DsoOffloadBusy(ap)) {
+	if (name != NULL) free(name);
+	return PM_ERR_AGAIN;
+    }
 
     if (ap->ipcType == AGENT_DSO) {
 	if (ap->ipc.dso.dispatch.comm.pmda_interface >= PMDA_INTERFACE_5)
@@ -533,6 +544,8 @@ DoLabel(ClientInfo *cp, __pmPDU *pb)
 	return PM_ERR_NOAGENT;
     if (ap->status.fenced)
 	return PM_ERR_PMDAFENCED;
+    if (DsoOffloadBusy(ap))
+	return PM_ERR_AGAIN;
 
     if (ap->ipcType == AGENT_DSO) {
 	if (ap->ipc.dso.dispatch.comm.pmda_interface >= PMDA_INTERFACE_5)
@@ -680,6 +693,10 @@ DoPMNSIDs(ClientInfo *cp, __pmPDU *pb)
 	    sts = PM_ERR_PMDAFENCED;
 	    goto fail;
 	}
+	if (DsoOffloadBusy(ap)) {
+	    sts = PM_ERR_AGAIN;
+	    goto fail;
+	}
 	if (ap->ipcType == AGENT_DSO) {
 	    if (ap->ipc.dso.dispatch.comm.pmda_interface >= PMDA_INTERFACE_5)
 		ap->ipc.dso.dispatch.version.four.ext->e_context = cp - client;
@@ -801,6 +818,9 @@ DoPMNSNames(ClientInfo *cp, __pmPDU *pb)
 	else if (ap->status.fenced) {
 	    lsts = PM_ERR_PMDAFENCED;
 	}
+	else if (DsoOffloadBusy(ap)) {
+	    lsts = PM_ERR_AGAIN;
+	}
 	else {
 	    if (ap->ipcType == AGENT_DSO) {
 		if (ap->ipc.dso.dispatch.comm.pmda_interface >= PMDA_INTERFACE_5)
@@ -933,6 +953,10 @@ DoPMNSChild(ClientInfo *cp, __pmPDU *pb)
 	    sts = PM_ERR_PMDAFENCED;
 	    goto done;
 	}
+	if (DsoOffloadBusy(ap)) {
+	    sts = PM_ERR_AGAIN;
+	    goto done;
+	}
 	if (ap->ipcType == AGENT_DSO) {
 	    if (ap->ipc.dso.dispatch.comm.pmda_interface >= PMDA_INTERFACE_5)
 		ap->ipc.dso.dispatch.version.four.ext->e_context = cp - client;
@@ -1121,6 +1145,8 @@ traverse_dynamic(ClientInfo *cp, char *start, int *num_names, char ***names)
 		continue;
 	    if (ap->status.fenced)
 		continue;
+	    if (DsoOffloadBusy(ap))
+		continue;
 	    if (ap->ipcType == AGENT_DSO) {
 		if (ap->ipc.dso.dispatch.comm.pmda_interface >= PMDA_INTERFACE_5)
 		    ap->ipc.dso.dispatch.version.four.ext->e_context = cp - client;
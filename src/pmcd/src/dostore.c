@@ -137,13 +137,10 @@ DoStore(ClientInfo *cp, __pmPDU* pb)
     __pmResult	*result;
     __pmResult	**dResult;
     int		i;
-    __pmFdSet	readyFds;
-    __pmFdSet	waitFds;
     int		nWait = 0;
-    int		maxFd = -1;
+    int		polled;
     int		badStore;		/* != 0 => store to nonexistent agent */
     int		notReady = 0;		/* != 0 => store to agent that's not ready */
-    struct timeval	timeout;
 
 
     if ((sts = __pmDecodeResult(pb, &result)) < 0)
@@ -153,14 +150,16 @@ DoStore(ClientInfo *cp, __pmPDU* pb)
 
     /* Send the per-domain results to their respective agents */
 
-    __pmFD_ZERO(&waitFds);
+    AgentWaitReset();
     for (i = 0; dResult[i]->numpmid > 0; i++) {
-	int fd;
 	ap = pmcd_agent(((__pmID_int *)&dResult[i]->vset[0]->pmid)->domain);
 	/* If it's in a "good" list, pmID has agent that is connected */
 	assert(ap != NULL);
 
-	if (ap->ipcType == AGENT_DSO) {
+	if (DsoOffloadBusy(ap))
+	    /* offload worker is still in the DSO, like not ready */
+	    notReady = 1;
+	else if (ap->ipcType == AGENT_DSO) {
 	    if (ap->ipc.dso.dispatch.comm.pmda_interface >= PMDA_INTERFACE_5)
 		ap->ipc.dso.dispatch.version.four.ext->e_context = cp - client;
 	    s = ap->ipc.dso.dispatch.version.any.store(
@@ -173,12 +172,12 @@ DoStore(ClientInfo *cp, __pmPDU* pb)
 		pmcd_trace(TR_XMIT_PDU, ap->inFd, PDU_RESULT, dResult[i]->numpmid);
 		s = __pmSendResult(ap->inFd, cp - client, dResult[i]);
 		if (s >= 0) {
-		    ap->status.busy = 1;
-		    fd = ap->outFd;
-		    __pmFD_SET(fd, &waitFds);
-		    if (fd > maxFd)
-			maxFd = fd;
-		    nWait++;
+		    if ((s = AgentWaitAdd(ap->outFd)) < 0)
+			CleanupAgent(ap, AT_COMM, ap->inFd);
+		    else {
+			ap->status.busy = 1;
+			nWait++;
+		    }
 		}
 		else if (s == PM_ERR_IPC || sts == PM_ERR_TIMEOUT || s == -EPIPE) {
 		    pmcd_trace(TR_XMIT_ERR, ap->inFd, PDU_RESULT, sts);
@@ -204,17 +203,14 @@ DoStore(ClientInfo *cp, __pmPDU* pb)
     /* Collect error PDUs containing store status from each active agent */
 
     while (nWait > 0) {
-        __pmFD_COPY(&readyFds, &waitFds);
-	if (nWait > 1) {
-	    timeout.tv_sec = pmcd_timeout;
-	    timeout.tv_usec = 0;
-
+	/* with only one agent left, __pmGetPDU() does the waiting */
+	if ((polled = (nWait > 1))) {
 	    retry:
 	    setoserror(0);
-	    s = __pmSelectRead(maxFd+1, &readyFds, &timeout);
+	    s = AgentWaitPoll(pmcd_timeout);
 
 	    if (s == 0) {
-		pmNotifyErr(LOG_INFO, "DoStore: select timeout");
+		pmNotifyErr(LOG_INFO, "DoStore: poll timeout");
 
 		/* Timeout, terminate agents that haven't responded */
 		for (i = 0; i < nAgents; i++) {
@@ -230,7 +226,7 @@ DoStore(ClientInfo *cp, __pmPDU* pb)
 		if (neterror() == EINTR)
 		    goto retry;
 		/* this is not expected to happen! */
-		pmNotifyErr(LOG_ERR, "DoStore: fatal select failure: %s\n",
+		pmNotifyErr(LOG_ERR, "DoStore: fatal poll failure: %s\n",
 			netstrerror());
 		Shutdown();
 		exit(1);
@@ -240,10 +236,10 @@ DoStore(ClientInfo *cp, __pmPDU* pb)
 	for (i = 0; i < nAgents; i++) {
 	    int		pinpdu;
 	    ap = &agent[i];
-	    if (!ap->status.busy || !__pmFD_ISSET(ap->outFd, &readyFds))
+	    if (!ap->status.busy || (polled && !AgentWaitReady(ap->outFd)))
 		continue;
 	    ap->status.busy = 0;
-	    __pmFD_CLR(ap->outFd, &waitFds);
+	    AgentWaitDel(ap->outFd);
 	    nWait--;
 	    pinpdu = s = __pmGetPDU(ap->outFd, ANY_SIZE, pmcd_timeout, &pb);
 	    if (s > 0)
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Event notification for the pmcd main loop.
+ *
+ * When epoll(7) is available each request port, client socket and
+ * not-ready agent descriptor is registered once, and ClientLoop() is
+ * only told about descriptors that actually have input pending - the
+ * cost per wakeup is proportional to the number of ready descriptors
+ * rather than the number of connected clients, and there is no
+ * FD_SETSIZE limit on the number of clients.
+ *
+ * Registrations are level-triggered: the PDU handlers consume exactly
+ * one PDU per wakeup, and any further input queued on a descriptor
+ * must cause another wakeup on the next epoll_wait(2) call.
+ *
+ * If epoll is not available (or PMCD_EPOLL=0 is set in the environment)
+ * ClientLoop() falls back to the traditional select(2) scheme.
+ *
+ * Once there can be more than FD_SETSIZE clients, an agent started or
+ * restarted later may also be given a descriptor beyond FD_SETSIZE, so
+ * the waits for agent replies in DoFetch(), DoStore() and when agents
+ * are restarted use the AgentWait*() routines below (poll(2) where it
+ * is available) rather than an fd_set.
+ */
+
+#include "pmcd.h"
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+
+static int	epollfd = -1;
+
+#ifdef HAVE_SYS_EPOLL_H
+/*
+ * epoll_event.data layout:  type (8 bits) | index (24 bits) | fd (32 bits)
+ */
+#define IOEVENT_PACK(t,i,f) \
+	(((__uint64_t)(t) << 56) | \
+	 ((__uint64_t)((i) & 0xffffff) << 32) | \
+	 ((__uint64_t)(unsigned int)(f)))
+#define IOEVENT_TYPE(d)		((int)((d) >> 56))
+#define IOEVENT_INDEX(d)	((int)(((d) >> 32) & 0xffffff))
+#define IOEVENT_FD(d)		((int)((d) & 0xffffffff))
+#endif
+
+/*
+ * Returns 1 if epoll is in use, else 0 and the caller is expected
+ * to use select(2).
+ */
+int
+IOEventInit(void)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    char	*envstr;
+
+    if ((envstr = getenv("PMCD_EPOLL")) != NULL && strcmp(envstr, "0") == 0) {
+	fprintf(stderr, "Warning: epoll disabled from PMCD_EPOLL=%s in environment\n", envstr);
+	return 0;
+    }
+    if ((epollfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+	pmNotifyErr(LOG_WARNING, "IOEventInit: epoll_create1 failed, "
+			"falling back to select: %s\n", osstrerror());
+	epollfd = -1;
+	return 0;
+    }
+    if (pmDebugOptions.appl3)
+	fprintf(stderr, "IOEventInit: using epoll (fd %d)\n", epollfd);
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+int
+IOEventActive(void)
+{
+    return epollfd >= 0;
+}
+
+int
+IOEventAdd(int fd, int type, int index)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event	ev;
+    int			sts;
+
+    if (epollfd < 0)
+	return 0;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = IOEVENT_PACK(type, index, fd);
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+	sts = -oserror();
+	if (sts != -EEXIST) {
+	    pmNotifyErr(LOG_ERR, "IOEventAdd: epoll_ctl(ADD, fd %d): %s\n",
+			fd, pmErrStr(sts));
+	    return sts;
+	}
+	/* descriptor number reused, refresh the associated data */
+	if (epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &ev) < 0)
+	    return -oserror();
+    }
+    if (pmDebugOptions.appl3)
+	fprintf(stderr, "IOEventAdd: fd %d type %d index %d\n", fd, type, index);
+#endif
+    return 0;
+}
+
+void
+IOEventDel(int fd)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event	ev;	/* non-NULL for pre-2.6.9 kernels */
+
+    if (epollfd < 0 || fd < 0)
+	return;
+    /* ENOENT and EBADF are expected after close(2), so ignore errors */
+    epoll_ctl(epollfd, EPOLL_CTL_DEL, fd, &ev);
+    if (pmDebugOptions.appl3)
+	fprintf(stderr, "IOEventDel: fd %d\n", fd);
+#endif
+}
+
+/*
+ * Block until at least one registered descriptor is readable, filling
+ * in at most maxevents entries.  Returns the number of ready entries or
+ * -1 with errno/neterror set (EINTR when a signal arrives, as for
+ * select(2)).
+ */
+int
+IOEventWait(IOEvent *events, int maxevents)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event	ready[IOEVENT_MAXEVENTS];
+    __uint64_t		data;
+    int			i, n;
+
+    if (maxevents > IOEVENT_MAXEVENTS)
+	maxevents = IOEVENT_MAXEVENTS;
+    if ((n = epoll_wait(epollfd, ready, maxevents, -1)) <= 0)
+	return n;
+    for (i = 0; i < n; i++) {
+	data = ready[i].data.u64;
+	events[i].type = IOEVENT_TYPE(data);
+	events[i].index = IOEVENT_INDEX(data);
+	events[i].fd = IOEVENT_FD(data);
+    }
+    return n;
+#else
+    setoserror(EOPNOTSUPP);
+    return -1;
+#endif
+}
+
+/*
+ * Set of agent descriptors with replies outstanding - there is only
+ * ever one such set in use at a time (pmcd is single-threaded), so
+ * the storage is static and grown as needed.
+ */
+#ifdef HAVE_POLL_H
+static struct pollfd	*waitfds;
+static int		nwaitfds;
+static int		maxwaitfds;
+#else
+static __pmFdSet	waitfds;
+static __pmFdSet	readyfds;
+static int		maxwaitfd = -1;
+#endif
+
+void
+AgentWaitReset(void)
+{
+#ifdef HAVE_POLL_H
+    nwaitfds = 0;
+#else
+    __pmFD_ZERO(&waitfds);
+    __pmFD_ZERO(&readyfds);
+    maxwaitfd = -1;
+#endif
+}
+
+int
+AgentWaitAdd(int fd)
+{
+#ifdef HAVE_POLL_H
+    struct pollfd	*tmp;
+    int			need;
+
+    if (nwaitfds == maxwaitfds) {
+	need = maxwaitfds ? maxwaitfds * 2 : 16;
+	if ((tmp = realloc(waitfds, need * sizeof(*tmp))) == NULL)
+	    pmNoMem("AgentWaitAdd", need * sizeof(*tmp), PM_FATAL_ERR);
+	waitfds = tmp;
+	maxwaitfds = need;
+    }
+    waitfds[nwaitfds].fd = fd;
+    waitfds[nwaitfds].events = POLLIN;
+    waitfds[nwaitfds].revents = 0;
+    nwaitfds++;
+#else
+    if (fd >= FD_SETSIZE) {
+	pmNotifyErr(LOG_ERR, "AgentWaitAdd: agent fd %d exceeds FD_SETSIZE (%d)\n",
+			fd, FD_SETSIZE);
+	return -EMFILE;
+    }
+    __pmFD_SET(fd, &waitfds);
+    if (fd > maxwaitfd)
+	maxwaitfd = fd;
+#endif
+    return 0;
+}
+
+/*
+ * No longer interested in this descriptor (reply has been read).
+ */
+void
+AgentWaitDel(int fd)
+{
+#ifdef HAVE_POLL_H
+    int		i;
+
+    for (i = 0; i < nwaitfds; i++) {
+	if (waitfds[i].fd == fd) {
+	    waitfds[i].fd = -1;		/* ignored by poll(2) */
+	    waitfds[i].revents = 0;
+	}
+    }
+#else
+    __pmFD_CLR(fd, &waitfds);
+    __pmFD_CLR(fd, &readyfds);
+#endif
+}
+
+/*
+ * Wait up to timeout seconds (0 to just check) for any of the agent
+ * descriptors to become readable.  Returns the number of readable
+ * descriptors, 0 on timeout or -1 with errno/neterror set, as for
+ * select(2).
+ */
+int
+AgentWaitPoll(int timeout)
+{
+#ifdef HAVE_POLL_H
+    return poll(waitfds, nwaitfds, timeout * 1000);
+#else
+    struct timeval	tv;
+
+    tv.tv_sec = timeout;
+    tv.tv_usec = 0;
+    __pmFD_COPY(&readyfds, &waitfds);
+    return __pmSelectRead(maxwaitfd+1, &readyfds, &tv);
+#endif
+}
+
+/*
+ * After AgentWaitPoll(), is there input (or EOF or an error) pending
+ * on this descriptor?
+ */
+int
+AgentWaitReady(int fd)
+{
+#ifdef HAVE_POLL_H
+    int		i;
+
+    if (fd < 0)
+	return 0;
+    for (i = 0; i < nwaitfds; i++) {
+	if (waitfds[i].fd == fd)
+	    return (waitfds[i].revents & (POLLIN|POLLHUP|POLLERR)) != 0;
+    }
+    return 0;
+#else
+    return __pmFD_ISSET(fd, &readyfds);
+#endif
+}
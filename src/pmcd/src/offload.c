@@ -0,0 +1,460 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Optional offload of DSO agent fetches to a worker thread.
+ *
+ * With PMCD_DSO_OFFLOAD=1 in the environment, HandleFetch() hands the
+ * per-domain fetch requests for DSO agents to a worker thread, then waits
+ * for the worker (via a pipe) along with the daemon agents.  DSO fetches
+ * overlap the daemon agent fetches and, as for a daemon agent, pmcd stops
+ * waiting for them after pmcd_timeout seconds, so one slow DSO no longer
+ * holds up every other client indefinitely.
+ *
+ * There is exactly one worker, so there is never more than one DSO call
+ * in progress: the DSOs share libpcp_pmda state (pmdaCache, the pmdaFetch
+ * instance domain helpers, event queues) that is not thread-safe, so the
+ * calls remain serialized, they are just not made on the main thread.
+ * The pmcd PMDA reports on pmcd's own tables and is always called from
+ * the main thread.
+ *
+ * If the worker overruns, the DSO metrics in that fetch get PM_ERR_TIMEOUT
+ * and the offloaded DSO agents are "busy" until the worker is done and
+ * DsoOffloadReap() has been called from the main loop.  In the meantime
+ * requests to those agents fail with PM_ERR_AGAIN, end of context
+ * notifications for them are deferred, and agent restarts are postponed.
+ */
+
+#include "pmcd.h"
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+typedef struct {
+    int		agent;		/* index into agent[] */
+    int		(*profile)(pmProfile *, pmdaExt *);
+    int		(*fetch)(int, pmID *, pmResult **, pmdaExt *);
+    pmdaExt	*ext;
+    int		context;	/* for e_context, -1 before PMDA_INTERFACE_5 */
+    pmProfile	*prof;		/* private copy of the client's profile */
+    int		numpmid;
+    pmID	*pmidlist;	/* private copy of the pmIDs */
+    pmResult	*result;	/* from the DSO */
+    int		sts;
+} DsoJob;
+
+static int		active;
+static int		overdue;	/* worker overran, results abandoned */
+static int		donefd[2] = { -1, -1 };
+static DsoJob		*jobs;
+static int		njobs;
+static int		maxjobs;
+static int		*endctx;	/* deferred end of context notices */
+static int		nendctx;
+static int		maxendctx;
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t	lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	cond = PTHREAD_COND_INITIALIZER;
+static int		queued;		/* jobs[] handed to the worker */
+static int		abandoned;	/* worker skips remaining jobs */
+static pmProfile	**lastprof;	/* per-agent copy the DSO now holds */
+static int		nlastprof;
+
+static pmProfile *
+DupProfile(pmProfile *prof)
+{
+    pmProfile		*copy;
+    pmInDomProfile	*p;
+    size_t		need;
+    int			i;
+
+    if ((copy = (pmProfile *)calloc(1, sizeof(pmProfile))) == NULL)
+	pmNoMem("DupProfile", sizeof(pmProfile), PM_FATAL_ERR);
+    copy->state = prof->state;
+    if (prof->profile_len <= 0)
+	return copy;
+    need = prof->profile_len * sizeof(pmInDomProfile);
+    if ((copy->profile = (pmInDomProfile *)malloc(need)) == NULL)
+	pmNoMem("DupProfile.profile", need, PM_FATAL_ERR);
+    copy->profile_len = prof->profile_len;
+    for (i = 0; i < prof->profile_len; i++) {
+	p = &copy->profile[i];
+	*p = prof->profile[i];
+	if (p->instances_len <= 0) {
+	    p->instances = NULL;
+	    continue;
+	}
+	need = p->instances_len * sizeof(int);
+	if ((p->instances = (int *)malloc(need)) == NULL)
+	    pmNoMem("DupProfile.instances", need, PM_FATAL_ERR);
+	memcpy(p->instances, prof->profile[i].instances, need);
+    }
+    return copy;
+}
+
+/*
+ * Runs on the worker thread - must not touch pmcd's agent or client
+ * tables, nor call pmcd_trace(); everything needed is in the job.
+ */
+static void
+RunJob(DsoJob *jp)
+{
+    int		sts;
+
+    if (jp->context >= 0)
+	jp->ext->e_context = jp->context;
+    if ((sts = jp->profile(jp->prof, jp->ext)) >= 0) {
+	/* the DSO now refers to this copy, release the previous one */
+	if (lastprof[jp->agent] != NULL)
+	    __pmFreeProfile(lastprof[jp->agent]);
+	lastprof[jp->agent] = jp->prof;
+	jp->prof = NULL;
+	sts = jp->fetch(jp->numpmid, jp->pmidlist, &jp->result, jp->ext);
+    }
+    jp->sts = sts;
+}
+
+static void *
+Worker(void *arg)
+{
+    char	c = 'd';
+    int		i, skip;
+
+    (void)arg;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+	while (!queued)
+	    pthread_cond_wait(&cond, &lock);
+	pthread_mutex_unlock(&lock);
+	for (i = 0; i < njobs; i++) {
+	    pthread_mutex_lock(&lock);
+	    skip = abandoned;
+	    pthread_mutex_unlock(&lock);
+	    if (skip)
+		jobs[i].sts = PM_ERR_TIMEOUT;
+	    else
+		RunJob(&jobs[i]);
+	}
+	pthread_mutex_lock(&lock);
+	queued = 0;
+	if (write(donefd[1], &c, 1) != 1)
+	    pmNotifyErr(LOG_ERR, "DSO offload worker: write: %s\n", osstrerror());
+    }
+    /* NOTREACHED */
+    return NULL;
+}
+#endif
+
+/*
+ * Returns 1 if DSO fetches are to be offloaded, else 0.
+ */
+int
+DsoOffloadInit(void)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_t	tid;
+    sigset_t	all, saved;
+    char	*envstr;
+    int		sts;
+
+    if ((envstr = getenv("PMCD_DSO_OFFLOAD")) == NULL ||
+	strcmp(envstr, "0") == 0)
+	return 0;
+    if (pipe(donefd) < 0) {
+	pmNotifyErr(LOG_WARNING, "DsoOffloadInit: pipe failed, "
+			"DSO fetches not offloaded: %s\n", osstrerror());
+	return 0;
+    }
+    fcntl(donefd[0], F_SETFL, fcntl(donefd[0], F_GETFL) | O_NONBLOCK);
+    fcntl(donefd[0], F_SETFD, FD_CLOEXEC);
+    fcntl(donefd[1], F_SETFD, FD_CLOEXEC);
+
+    /* signals are for the main thread */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &saved);
+    sts = pthread_create(&tid, NULL, Worker, NULL);
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    if (sts != 0) {
+	pmNotifyErr(LOG_WARNING, "DsoOffloadInit: pthread_create failed, "
+			"DSO fetches not offloaded: %s\n", pmErrStr(-sts));
+	close(donefd[0]);
+	close(donefd[1]);
+	donefd[0] = donefd[1] = -1;
+	return 0;
+    }
+    pthread_detach(tid);
+    fprintf(stderr, "Warning: DSO fetches offloaded to a worker thread from PMCD_DSO_OFFLOAD=%s in environment\n", envstr);
+    active = 1;
+#endif
+    return active;
+}
+
+int
+DsoOffloadActive(void)
+{
+    return active;
+}
+
+/*
+ * Descriptor that becomes readable when the worker is done.
+ */
+int
+DsoOffloadFd(void)
+{
+    return donefd[0];
+}
+
+static int
+Offloadable(AgentInfo *ap)
+{
+    return active && ap->ipcType == AGENT_DSO &&
+	   strcmp(ap->ipc.dso.entryPoint, "pmcd_init") != 0;
+}
+
+/*
+ * Is an overrunning offloaded fetch still using this agent (or any agent,
+ * if ap is NULL)?  If so, the agent must not be called.
+ */
+int
+DsoOffloadBusy(AgentInfo *ap)
+{
+    if (!overdue)
+	return 0;
+    return ap == NULL || Offloadable(ap);
+}
+
+/*
+ * Queue a fetch for a DSO agent, to be started by DsoOffloadStart().
+ * Returns 0 if queued, else -1 and the caller should call the agent
+ * directly (or report it busy).
+ */
+int
+DsoOffloadAdd(AgentInfo *ap, int ctx, pmProfile *profile,
+		int numpmid, pmID *pmidlist)
+{
+#ifdef HAVE_PTHREAD_H
+    pmdaInterface	*dp = &ap->ipc.dso.dispatch;
+    DsoJob		*jp;
+    size_t		need;
+    int			i = (int)(ap - agent);
+
+    if (!Offloadable(ap) || overdue)
+	return -1;
+
+    if (nlastprof < nAgents) {
+	need = nAgents * sizeof(pmProfile *);
+	if ((lastprof = (pmProfile **)realloc(lastprof, need)) == NULL)
+	    pmNoMem("DsoOffloadAdd.lastprof", need, PM_FATAL_ERR);
+	memset(&lastprof[nlastprof], 0, (nAgents - nlastprof) * sizeof(pmProfile *));
+	nlastprof = nAgents;
+    }
+    if (njobs == maxjobs) {
+	maxjobs = maxjobs ? maxjobs * 2 : 8;
+	need = maxjobs * sizeof(DsoJob);
+	if ((jobs = (DsoJob *)realloc(jobs, need)) == NULL)
+	    pmNoMem("DsoOffloadAdd.jobs", need, PM_FATAL_ERR);
+    }
+    jp = &jobs[njobs];
+    memset(jp, 0, sizeof(*jp));
+    jp->agent = i;
+    jp->profile = dp->version.any.profile;
+    jp->fetch = dp->version.any.fetch;
+    jp->ext = dp->version.any.ext;
+    jp->context = (dp->comm.pmda_interface >= PMDA_INTERFACE_5) ? ctx : -1;
+    jp->prof = DupProfile(profile);
+    jp->numpmid = numpmid;
+    need = numpmid * sizeof(pmID);
+    if ((jp->pmidlist = (pmID *)malloc(need)) == NULL)
+	pmNoMem("DsoOffloadAdd.pmidlist", need, PM_FATAL_ERR);
+    memcpy(jp->pmidlist, pmidlist, need);
+    njobs++;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/*
+ * Hand the queued fetches to the worker.  Returns the descriptor to wait
+ * on for completion, or -1 if nothing was queued.
+ */
+int
+DsoOffloadStart(void)
+{
+#ifdef HAVE_PTHREAD_H
+    if (njobs == 0)
+	return -1;
+    pthread_mutex_lock(&lock);
+    abandoned = 0;
+    queued = 1;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+    return donefd[0];
+#else
+    return -1;
+#endif
+}
+
+static int
+ReadDone(void)
+{
+    char	c;
+
+    return read(donefd[0], &c, 1) == 1;
+}
+
+static void
+FreeJobs(void)
+{
+    int		i;
+
+    for (i = 0; i < njobs; i++) {
+	if (jobs[i].prof != NULL)
+	    __pmFreeProfile(jobs[i].prof);
+	free(jobs[i].pmidlist);
+    }
+    njobs = 0;
+}
+
+/*
+ * Worker is done (DsoOffloadFd() was readable) - called before the
+ * results are collected with DsoOffloadResult().
+ */
+void
+DsoOffloadDone(void)
+{
+    ReadDone();
+}
+
+/*
+ * Result for agent[i] from the completed fetches.  Returns 0 and sets
+ * *rp (a DSO managed pmResult skeleton), else an error code.  The jobs
+ * are released once the last result has been collected.
+ */
+int
+DsoOffloadResult(int i, pmResult **rp)
+{
+    DsoJob	*jp;
+    int		j, sts = PM_ERR_NOAGENT;
+
+    for (j = 0; j < njobs; j++) {
+	jp = &jobs[j];
+	if (jp->agent != i)
+	    continue;
+	if ((sts = jp->sts) >= 0) {
+	    if (jp->result == NULL) {
+		pmNotifyErr(LOG_WARNING,
+			    "\"%s\" agent (DSO) returned a null result\n",
+			    agent[i].pmDomainLabel);
+		sts = PM_ERR_PMID;
+	    }
+	    else if (jp->result->numpmid != jp->numpmid) {
+		pmNotifyErr(LOG_WARNING,
+			    "\"%s\" agent (DSO) returned %d pmIDs (%d expected)\n",
+			    agent[i].pmDomainLabel,
+			    jp->result->numpmid, jp->numpmid);
+		sts = PM_ERR_PMID;
+	    }
+	    else {
+		*rp = jp->result;
+		sts = 0;
+	    }
+	}
+	else if (pmDebugOptions.appl0)
+	    fprintf(stderr, "FETCH error: \"%s\" agent : %s\n",
+			    agent[i].pmDomainLabel, pmErrStr(sts));
+	jp->agent = -1;
+	break;
+    }
+    for (j = 0; j < njobs; j++) {
+	if (jobs[j].agent != -1)
+	    break;
+    }
+    if (j == njobs)
+	FreeJobs();
+    return sts;
+}
+
+/*
+ * Stop waiting for the worker - any fetches it has not started are
+ * skipped, and the results are discarded in DsoOffloadReap().
+ */
+void
+DsoOffloadAbandon(void)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_lock(&lock);
+    abandoned = 1;
+    pthread_mutex_unlock(&lock);
+#endif
+    overdue = 1;
+    pmNotifyErr(LOG_WARNING, "DSO agent fetch has not completed after "
+		"%d seconds, DSO agents busy\n", pmcd_timeout);
+}
+
+/*
+ * The worker has finished after overrunning, free the abandoned results
+ * and make the DSO agents available again.
+ */
+void
+DsoOffloadReap(void)
+{
+    DsoJob	*jp;
+    int		i, j;
+
+    if (!ReadDone() || !overdue)
+	return;
+    for (i = 0; i < njobs; i++) {
+	jp = &jobs[i];
+	if (jp->sts >= 0 && jp->result != NULL &&
+	    jp->result->numpmid == jp->numpmid)
+	    __pmFreeResultValues(jp->result);
+    }
+    FreeJobs();
+    overdue = 0;
+    pmNotifyErr(LOG_INFO, "DSO agent fetch completed, DSO agents available\n");
+
+    for (i = 0; i < nendctx; i++) {
+	for (j = 0; j < nAgents; j++) {
+	    if (agent[j].status.connected && Offloadable(&agent[j]))
+		DsoEndContext(&agent[j], endctx[i]);
+	}
+    }
+    nendctx = 0;
+}
+
+/*
+ * Client context ctx has been closed while the DSO agents were busy,
+ * tell them later, from DsoOffloadReap().
+ */
+void
+DsoOffloadEndContext(int ctx)
+{
+    size_t	need;
+    int		i;
+
+    for (i = 0; i < nendctx; i++) {
+	if (endctx[i] == ctx)
+	    return;
+    }
+    if (nendctx == maxendctx) {
+	maxendctx = maxendctx ? maxendctx * 2 : 16;
+	need = maxendctx * sizeof(int);
+	if ((endctx = (int *)realloc(endctx, need)) == NULL)
+	    pmNoMem("DsoOffloadEndContext", need, PM_FATAL_ERR);
+    }
+    endctx[nendctx++] = ctx;
+}
@@ -391,149 +391,158 @@ CheckHostnameChange(void)
 }
 
 /*
- * Determine which clients (if any) have sent data to the server and handle it
+ * Read one PDU from client[i] (known to have data pending) and handle it
  * as required.
  */
-void
-HandleClientInput(__pmFdSet *fdsPtr)
+static void
+HandleClientPDU(int i)
 {
     int		sts;
-    int		i;
+    int		pinpdu;
     __pmPDU	*pb;
     __pmPDUHdr	*php;
     ClientInfo	*cp;
 
-    for (i = 0; i < nClients; i++) {
-	int		pinpdu;
+    cp = &client[i];
+    this_client_id = i;
 
-	if (!client[i].status.connected || !__pmFD_ISSET(client[i].fd, fdsPtr))
-	    continue;
+    pinpdu = sts = __pmGetPDU(cp->fd, LIMIT_SIZE, pmcd_timeout, &pb);
+    if (sts > 0) {
+	pmcd_trace(TR_RECV_PDU, cp->fd, sts, (int)((__psint_t)pb & 0xffffffff));
+    } else {
+	CleanupClient(cp, sts);
+	return;
+    }
 
-	cp = &client[i];
-	this_client_id = i;
+    php = (__pmPDUHdr *)pb;
+    if (__pmVersionIPC(cp->fd) == UNKNOWN_VERSION && php->type != PDU_CREDS) {
+	/* old V1 client protocol, no longer supported */
+	sts = PM_ERR_IPC;
+	CleanupClient(cp, sts);
+	__pmUnpinPDUBuf(pb);
+	return;
+    }
 
-	pinpdu = sts = __pmGetPDU(cp->fd, LIMIT_SIZE, pmcd_timeout, &pb);
-	if (sts > 0) {
-	    pmcd_trace(TR_RECV_PDU, cp->fd, sts, (int)((__psint_t)pb & 0xffffffff));
-	} else {
-	    CleanupClient(cp, sts);
-	    continue;
-	}
+    if (pmDebugOptions.appl3)
+	ShowClients(stderr);
 
-	php = (__pmPDUHdr *)pb;
-	if (__pmVersionIPC(cp->fd) == UNKNOWN_VERSION && php->type != PDU_CREDS) {
-	    /* old V1 client protocol, no longer supported */
-	    sts = PM_ERR_IPC;
-	    CleanupClient(cp, sts);
-	    __pmUnpinPDUBuf(pb);
-	    continue;
-	}
+    switch (php->type) {
+	case PDU_PROFILE:
+	    CheckHostnameChange();
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoProfile(cp, pb);
+	    break;
 
-	if (pmDebugOptions.appl3)
-	    ShowClients(stderr);
+	case PDU_FETCH:
+	    CheckHostnameChange();
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoFetch(cp, pb);
+	    break;
 
-	switch (php->type) {
-	    case PDU_PROFILE:
-		CheckHostnameChange();
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoProfile(cp, pb);
-		break;
+	case PDU_HIGHRES_FETCH:
+	    CheckHostnameChange();
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoHighResFetch(cp, pb);
+	    break;
 
-	    case PDU_FETCH:
-		CheckHostnameChange();
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoFetch(cp, pb);
-		break;
+	case PDU_INSTANCE_REQ:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoInstance(cp, pb);
+	    break;
 
-	    case PDU_HIGHRES_FETCH:
-		CheckHostnameChange();
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoHighResFetch(cp, pb);
-		break;
+	case PDU_LABEL_REQ:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoLabel(cp, pb);
+	    break;
 
-	    case PDU_INSTANCE_REQ:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoInstance(cp, pb);
-		break;
+	case PDU_DESC_REQ:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoDesc(cp, pb);
+	    break;
 
-	    case PDU_LABEL_REQ:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoLabel(cp, pb);
-		break;
+	case PDU_DESC_IDS:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoDescIDs(cp, pb);
+	    break;
 
-	    case PDU_DESC_REQ:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoDesc(cp, pb);
-		break;
+	case PDU_TEXT_REQ:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoText(cp, pb);
+	    break;
 
-	    case PDU_DESC_IDS:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoDescIDs(cp, pb);
-		break;
+	case PDU_RESULT:
+	    sts = (cp->denyOps & PMCD_OP_STORE) ?
+		  PM_ERR_PERMISSION : DoStore(cp, pb);
+	    break;
 
-	    case PDU_TEXT_REQ:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoText(cp, pb);
-		break;
+	case PDU_PMNS_IDS:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoPMNSIDs(cp, pb);
+	    break;
 
-	    case PDU_RESULT:
-		sts = (cp->denyOps & PMCD_OP_STORE) ?
-		      PM_ERR_PERMISSION : DoStore(cp, pb);
-		break;
+	case PDU_PMNS_NAMES:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoPMNSNames(cp, pb);
+	    break;
 
-	    case PDU_PMNS_IDS:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoPMNSIDs(cp, pb);
-		break;
+	case PDU_PMNS_CHILD:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoPMNSChild(cp, pb);
+	    break;
 
-	    case PDU_PMNS_NAMES:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoPMNSNames(cp, pb);
-		break;
+	case PDU_PMNS_TRAVERSE:
+	    sts = (cp->denyOps & PMCD_OP_FETCH) ?
+		  PM_ERR_PERMISSION : DoPMNSTraverse(cp, pb);
+	    break;
 
-	    case PDU_PMNS_CHILD:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoPMNSChild(cp, pb);
-		break;
+	case PDU_CREDS:
+	    sts = DoCreds(cp, pb);
+	    break;
 
-	    case PDU_PMNS_TRAVERSE:
-		sts = (cp->denyOps & PMCD_OP_FETCH) ?
-		      PM_ERR_PERMISSION : DoPMNSTraverse(cp, pb);
-		break;
+	default:
+	    sts = PM_ERR_IPC;
+    }
+    if (sts < 0) {
+	if (pmDebugOptions.appl0)
+	    fprintf(stderr, "PDU:  %s client[%d]: %s\n",
+		__pmPDUTypeStr(php->type), i, pmErrStr(sts));
+	/* Make sure client still alive before sending. */
+	if (cp->status.connected) {
+	    pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_ERROR, sts);
+	    sts = __pmSendError(cp->fd, FROM_ANON, sts);
+	    if (sts < 0)
+		pmNotifyErr(LOG_ERR, "HandleClientInput: "
+		    "error sending Error PDU to client[%d] %s\n", i, pmErrStr(sts));
+	}
+    }
+    if (pinpdu > 0)
+	__pmUnpinPDUBuf(pb);
 
-	    case PDU_CREDS:
-		sts = DoCreds(cp, pb);
-		break;
+    /*
+     * May need to send connection attributes to interested PMDAs, if
+     * something changed for this client during this PDU exchange.
+     */
+    if (client[i].status.attributes) {
+	if (pmDebugOptions.appl5)
+	    fprintf(stderr, "Client idx=%d,seq=%d attrs reset\n",
+			    i, client[i].seq);
+	AgentsAttributes(i);
+    }
+}
 
-	    default:
-		sts = PM_ERR_IPC;
-	}
-	if (sts < 0) {
-	    if (pmDebugOptions.appl0)
-		fprintf(stderr, "PDU:  %s client[%d]: %s\n",
-		    __pmPDUTypeStr(php->type), i, pmErrStr(sts));
-	    /* Make sure client still alive before sending. */
-	    if (cp->status.connected) {
-		pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_ERROR, sts);
-		sts = __pmSendError(cp->fd, FROM_ANON, sts);
-		if (sts < 0)
-		    pmNotifyErr(LOG_ERR, "HandleClientInput: "
-			"error sending Error PDU to client[%d] %s\n", i, pmErrStr(sts));
-	    }
-	}
-	if (pinpdu > 0)
-	    __pmUnpinPDUBuf(pb);
+/*
+ * Determine which clients (if any) have sent data to the server and handle it
+ * as required.
+ */
+void
+HandleClientInput(__pmFdSet *fdsPtr)
+{
+    int		i;
 
-	/*
-	 * May need to send connection attributes to interested PMDAs, if
-	 * something changed for this client during this PDU exchange.
-	 */
-	if (client[i].status.attributes) {
-	    if (pmDebugOptions.appl5)
-		fprintf(stderr, "Client idx=%d,seq=%d attrs reset\n",
-				i, client[i].seq);
-	    AgentsAttributes(i);
-	}
+    for (i = 0; i < nClients; i++) {
+	if (!client[i].status.connected || !__pmFD_ISSET(client[i].fd, fdsPtr))
+	    continue;
+	HandleClientPDU(i);
     }
 }
 
@@ -717,70 +726,78 @@ SignalReloadPMNS(void)
     }
 }
 
+/* Process I/O on the file descriptor from an agent that was marked as not
+ * ready to handle PDUs.  Returns 1 if the agent has become ready, else 0.
+ */
+static int
+HandleReadyAgent(AgentInfo *ap)
+{
+    int		s, sts;
+    int		fd = ap->outFd;
+    int		reason;
+    int		ready = 0;
+    int		pinpdu;
+    __pmPDU	*pb;
+
+    /* Expect an error PDU containing PM_ERR_PMDAREADY */
+    reason = AT_COMM;	/* most errors are protocol failures */
+    pinpdu = sts = __pmGetPDU(ap->outFd, ANY_SIZE, pmcd_timeout, &pb);
+    if (sts > 0)
+	pmcd_trace(TR_RECV_PDU, ap->outFd, sts, (int)((__psint_t)pb & 0xffffffff));
+    if (sts == PDU_ERROR) {
+	s = __pmDecodeError(pb, &sts);
+	if (s < 0) {
+	    sts = s;
+	    pmcd_trace(TR_RECV_ERR, ap->outFd, PDU_ERROR, sts);
+	}
+	else {
+	    /* sts is the status code from the error PDU */
+	    if (pmDebugOptions.appl0)
+		pmNotifyErr(LOG_INFO,
+		     "%s agent (not ready) sent %s status(%d)\n",
+		     ap->pmDomainLabel,
+		     sts == PM_ERR_PMDAREADY ?
+				 "ready" : "unknown", sts);
+	    if (sts == PM_ERR_PMDAREADY) {
+		ap->status.notReady = 0;
+		sts = 1;
+		ready++;
+	    }
+	    else {
+		pmcd_trace(TR_RECV_ERR, ap->outFd, PDU_ERROR, sts);
+		sts = PM_ERR_IPC;
+	    }
+	}
+    }
+    else {
+	if (sts < 0)
+	    pmcd_trace(TR_RECV_ERR, ap->outFd, PDU_RESULT, sts);
+	else
+	    pmcd_trace(TR_WRONG_PDU, ap->outFd, PDU_ERROR, sts);
+	sts = PM_ERR_IPC; /* Wrong PDU type */
+    }
+    if (pinpdu > 0)
+	__pmUnpinPDUBuf(pb);
+
+    if (ap->ipcType != AGENT_DSO && sts <= 0)
+	CleanupAgent(ap, reason, fd);
+    return ready;
+}
+
 /* Process I/O on file descriptors from agents that were marked as not ready
  * to handle PDUs.
  */
 static int
 HandleReadyAgents(__pmFdSet *readyFds)
 {
-    int		i, s, sts;
-    int		fd;
-    int		reason;
+    int		i;
     int		ready = 0;
     AgentInfo	*ap;
-    __pmPDU	*pb;
 
     for (i = 0; i < nAgents; i++) {
 	ap = &agent[i];
-	if (ap->status.notReady) {
-	    fd = ap->outFd;
-	    if (__pmFD_ISSET(fd, readyFds)) {
-		int		pinpdu;
-
-		/* Expect an error PDU containing PM_ERR_PMDAREADY */
-		reason = AT_COMM;	/* most errors are protocol failures */
-		pinpdu = sts = __pmGetPDU(ap->outFd, ANY_SIZE, pmcd_timeout, &pb);
-		if (sts > 0)
-		    pmcd_trace(TR_RECV_PDU, ap->outFd, sts, (int)((__psint_t)pb & 0xffffffff));
-		if (sts == PDU_ERROR) {
-		    s = __pmDecodeError(pb, &sts);
-		    if (s < 0) {
-			sts = s;
-			pmcd_trace(TR_RECV_ERR, ap->outFd, PDU_ERROR, sts);
-		    }
-		    else {
-			/* sts is the status code from the error PDU */
-			if (pmDebugOptions.appl0)
-			    pmNotifyErr(LOG_INFO,
-				 "%s agent (not ready) sent %s status(%d)\n",
-				 ap->pmDomainLabel,
-				 sts == PM_ERR_PMDAREADY ?
-					     "ready" : "unknown", sts);
-			if (sts == PM_ERR_PMDAREADY) {
-			    ap->status.notReady = 0;
-			    sts = 1;
-			    ready++;
-			}
-			else {
-			    pmcd_trace(TR_RECV_ERR, ap->outFd, PDU_ERROR, sts);
-			    sts = PM_ERR_IPC;
-			}
-		    }
-		}
-		else {
-		    if (sts < 0)
-			pmcd_trace(TR_RECV_ERR, ap->outFd, PDU_RESULT, sts);
-		    else
-			pmcd_trace(TR_WRONG_PDU, ap->outFd, PDU_ERROR, sts);
- 		    sts = PM_ERR_IPC; /* Wrong PDU type */
-		}
-		if (pinpdu > 0)
-		    __pmUnpinPDUBuf(pb);
-
-		if (ap->ipcType != AGENT_DSO && sts <= 0)
-		    CleanupAgent(ap, reason, fd);
-	    }
-	}
+	if (ap->status.notReady && __pmFD_ISSET(ap->outFd, readyFds))
+	    ready += HandleReadyAgent(ap);
     }
     return ready;
 }
@@ -868,62 +885,173 @@ CheckNewClient(__pmFdSet *fdset, int rfd, int family)
     }
 }
 
-/* Loop, synchronously processing requests from clients. */
-
-static void
-ClientLoop(void)
+/*
+ * Wait for input using select(2), then dispatch to the handlers.
+ * Returns -1 on fatal error, else 0.
+ */
+static int
+SelectClients(int *reload_namespace)
 {
     int		i, fd, sts;
     int		maxFd;
     int		checkAgents;
-    int		reload_namespace = 0;
-    int		restartAgents = -1;	/* initial state unknown */
     __pmFdSet	readableFds;
 
-    for (;;) {
+    /* Figure out which file descriptors to wait for input on.  Keep
+     * track of the highest numbered descriptor for the select call.
+     */
+    readableFds = clientFds;
+    maxFd = maxClientFd + 1;
 
-	/* Figure out which file descriptors to wait for input on.  Keep
-	 * track of the highest numbered descriptor for the select call.
-	 */
-	readableFds = clientFds;
-	maxFd = maxClientFd + 1;
+    /* If an agent was not ready, it may send an ERROR PDU to indicate it
+     * is now ready.  Add such agents to the list of file descriptors.
+     */
+    checkAgents = 0;
+    for (i = 0; i < nAgents; i++) {
+	AgentInfo	*ap = &agent[i];
 
-	/* If an agent was not ready, it may send an ERROR PDU to indicate it
-	 * is now ready.  Add such agents to the list of file descriptors.
-	 */
-	checkAgents = 0;
-	for (i = 0; i < nAgents; i++) {
-	    AgentInfo	*ap = &agent[i];
-
-	    if (ap->status.notReady) {
-		fd = ap->outFd;
-		__pmFD_SET(fd, &readableFds);
-		if (fd > maxFd)
-		    maxFd = fd + 1;
-		checkAgents = 1;
-		if (pmDebugOptions.appl0)
-		    pmNotifyErr(LOG_INFO,
-				 "not ready: check %s agent on fd %d (max = %d)\n",
-				 ap->pmDomainLabel, fd, maxFd);
-	    }
+	if (ap->status.notReady && ap->outFd >= 0) {
+	    fd = ap->outFd;
+	    __pmFD_SET(fd, &readableFds);
+	    if (fd > maxFd)
+		maxFd = fd + 1;
+	    checkAgents = 1;
+	    if (pmDebugOptions.appl0)
+		pmNotifyErr(LOG_INFO,
+			     "not ready: check %s agent on fd %d (max = %d)\n",
+			     ap->pmDomainLabel, fd, maxFd);
 	}
+    }
+
+    /* An overrunning offloaded DSO fetch signals completion on a pipe */
+    if (DsoOffloadBusy(NULL)) {
+	fd = DsoOffloadFd();
+	__pmFD_SET(fd, &readableFds);
+	if (fd >= maxFd)
+	    maxFd = fd + 1;
+    }
+
+    sts = __pmSelectRead(maxFd, &readableFds, NULL);
+    if (sts > 0) {
+	if (DsoOffloadBusy(NULL) && __pmFD_ISSET(DsoOffloadFd(), &readableFds))
+	    DsoOffloadReap();
+	if (pmDebugOptions.appl0)
+	    for (i = 0; i <= maxClientFd; i++)
+		if (__pmFD_ISSET(i, &readableFds))
+		    fprintf(stderr, "DATA: from %s (fd %d)\n",
+			    FdToString(i), i);
+	__pmServerAddNewClients(&readableFds, CheckNewClient);
+	if (checkAgents)
+	    *reload_namespace = HandleReadyAgents(&readableFds);
+	HandleClientInput(&readableFds);
+    }
+    else if (sts == -1 && neterror() != EINTR) {
+	pmNotifyErr(LOG_ERR, "ClientLoop select: %s\n", netstrerror());
+	return -1;
+    }
+    return 0;
+}
 
-	sts = __pmSelectRead(maxFd, &readableFds, NULL);
-	if (sts > 0) {
+/*
+ * Wait for input using epoll(7), then dispatch to the handlers only
+ * for those descriptors that are ready.
+ * Returns -1 on fatal error, else 0.
+ */
+static int
+PollClients(int *reload_namespace)
+{
+    static IOEvent	events[IOEVENT_MAXEVENTS];
+    int			i, j, n;
+    IOEvent		*ep;
+    AgentInfo		*ap;
+    __pmFdSet		requestFd;
+
+    /*
+     * Not-ready agents may send an ERROR PDU to indicate they are
+     * now ready - track registration of their descriptors as their
+     * state changes.  Agent fds closed by CleanupAgent are removed
+     * from the epoll set by the kernel (and status.polled cleared).
+     */
+    for (i = 0; i < nAgents; i++) {
+	ap = &agent[i];
+	if (ap->status.notReady && ap->outFd >= 0) {
+	    if (!ap->status.polled &&
+		IOEventAdd(ap->outFd, IOEVENT_AGENT, i) == 0)
+		ap->status.polled = 1;
 	    if (pmDebugOptions.appl0)
-		for (i = 0; i <= maxClientFd; i++)
-		    if (__pmFD_ISSET(i, &readableFds))
-			fprintf(stderr, "DATA: from %s (fd %d)\n",
-				FdToString(i), i);
-	    __pmServerAddNewClients(&readableFds, CheckNewClient);
-	    if (checkAgents)
-		reload_namespace = HandleReadyAgents(&readableFds);
-	    HandleClientInput(&readableFds);
+		pmNotifyErr(LOG_INFO, "not ready: check %s agent on fd %d\n",
+			     ap->pmDomainLabel, ap->outFd);
 	}
-	else if (sts == -1 && neterror() != EINTR) {
-	    pmNotifyErr(LOG_ERR, "ClientLoop select: %s\n", netstrerror());
-	    break;
+	else if (ap->status.polled) {
+	    IOEventDel(ap->outFd);
+	    ap->status.polled = 0;
+	}
+    }
+
+    n = IOEventWait(events, IOEVENT_MAXEVENTS);
+    if (n < 0) {
+	if (oserror() == EINTR)
+	    return 0;
+	pmNotifyErr(LOG_ERR, "ClientLoop epoll: %s\n", osstrerror());
+	return -1;
+    }
+
+    for (i = 0; i < n; i++) {
+	ep = &events[i];
+	if (pmDebugOptions.appl0)
+	    fprintf(stderr, "DATA: from %s (fd %d)\n",
+			    FdToString(ep->fd), ep->fd);
+	switch (ep->type) {
+	    case IOEVENT_REQUEST:
+		__pmFD_ZERO(&requestFd);
+		__pmFD_SET(ep->fd, &requestFd);
+		__pmServerAddNewClients(&requestFd, CheckNewClient);
+		break;
+
+	    case IOEVENT_AGENT:
+		/* agent table may be rebuilt on restart, so match on fd */
+		for (j = 0; j < nAgents; j++) {
+		    ap = &agent[j];
+		    if (ap->status.notReady && ap->outFd == ep->fd) {
+			*reload_namespace |= HandleReadyAgent(ap);
+			break;
+		    }
+		}
+		break;
+
+	    case IOEVENT_CLIENT:
+		/* client may have gone away earlier in this batch */
+		j = ep->index;
+		if (j < nClients && client[j].status.connected &&
+		    client[j].fd == ep->fd)
+		    HandleClientPDU(j);
+		break;
+
+	    case IOEVENT_DSO:
+		DsoOffloadReap();
+		break;
 	}
+    }
+    return 0;
+}
+
+/* Loop, synchronously processing requests from clients. */
+
+static void
+ClientLoop(void)
+{
+    int		i, sts;
+    int		reload_namespace = 0;
+    int		restartAgents = -1;	/* initial state unknown */
+
+    for (;;) {
+
+	if (IOEventActive())
+	    sts = PollClients(&reload_namespace);
+	else
+	    sts = SelectClients(&reload_namespace);
+	if (sts < 0)
+	    break;
 	if (AgentDied) {
 	    if (restartAgents == -1) {
 		char *args;
@@ -948,7 +1076,8 @@ ClientLoop(void)
 		restart = 1;
 	    }
 	}
-	if (restart) {
+	if (restart && !DsoOffloadBusy(NULL)) {
+	    /* not while a DSO is in use by the offload worker */
 	    restart = 0;
 	    reload_namespace = 1;
 	    SignalRestart();
@@ -1145,6 +1274,17 @@ main(int argc, char *argv[])
 	DontStart();
     maxReqPortFd = maxClientFd = sts;
 
+    /* prefer epoll for the main loop, request ports registered once */
+    if (IOEventInit()) {
+	int	fd;
+
+	for (fd = 0; fd <= maxReqPortFd; fd++) {
+	    if (__pmFD_ISSET(fd, &clientFds) &&
+		IOEventAdd(fd, IOEVENT_REQUEST, 0) < 0)
+		DontStart();
+	}
+    }
+
     /*
      * would prefer open log earlier so any messages up to this point
      * are not lost, but that's not possible ... it has to be after the
@@ -1189,6 +1329,11 @@ main(int argc, char *argv[])
 	DontStart();
     }
 
+    /* after the DSOs are initialized, before any fetch */
+    if (DsoOffloadInit() && IOEventActive() &&
+	IOEventAdd(DsoOffloadFd(), IOEVENT_DSO, 0) < 0)
+	DontStart();
+
     if (run_daemon) {
 	/* notify service manager, if any, we are ready */
 	__pmServerNotifyServiceManagerReady(getpid());
@@ -93,7 +93,8 @@ typedef struct {
 	    notReady : 1,		/* Agent not ready to process PDUs */
 	    startNotReady : 1,		/* Agent starts in non-ready state */
 	    fenced : 1,			/* Agent fenced; no sampling */
-	    unused : 7,			/* Zero-padded, unused space */
+	    polled : 1,			/* outFd registered for I/O events */
+	    unused : 6,			/* Zero-padded, unused space */
 	    flags : 16;			/* Agent-supplied connection flags */
     } status;
     int		reason;			/* if ! connected */
@@ -241,6 +242,52 @@ extern int ClientsAttributes(AgentInfo *);
 extern int AgentsAttributes(int);
 extern int CheckError(AgentInfo *, int);
 
+/*
+ * I/O event notification for the main loop (epoll, else select)
+ */
+#define IOEVENT_MAXEVENTS	256
+#define IOEVENT_REQUEST		1	/* request port, index unused */
+#define IOEVENT_CLIENT		2	/* client socket, index into client[] */
+#define IOEVENT_AGENT		3	/* not-ready agent, index unused */
+#define IOEVENT_DSO		4	/* DSO offload worker done, index unused */
+
+typedef struct {
+    int		type;			/* IOEVENT_* */
+    int		index;			/* type-specific table index */
+    int		fd;			/* ready descriptor */
+} IOEvent;
+
+extern int IOEventInit(void);
+extern int IOEventActive(void);
+extern int IOEventAdd(int, int, int);
+extern void IOEventDel(int);
+extern int IOEventWait(IOEvent *, int);
+
+/*
+ * Waiting for replies from agents, not limited by FD_SETSIZE
+ */
+extern void AgentWaitReset(void);
+extern int AgentWaitAdd(int);
+extern void AgentWaitDel(int);
+extern int AgentWaitPoll(int);
+extern int AgentWaitReady(int);
+
+/*
+ * Offload of DSO agent fetches to a worker thread (PMCD_DSO_OFFLOAD)
+ */
+extern int DsoOffloadInit(void);
+extern int DsoOffloadActive(void);
+extern int DsoOffloadFd(void);
+extern int DsoOffloadBusy(AgentInfo *);
+extern int DsoOffloadAdd(AgentInfo *, int, pmProfile *, int, pmID *);
+extern int DsoOffloadStart(void);
+extern void DsoOffloadDone(void);
+extern int DsoOffloadResult(int, pmResult **);
+extern void DsoOffloadAbandon(void);
+extern void DsoOffloadReap(void);
+extern void DsoOffloadEndContext(int);
+extern void DsoEndContext(AgentInfo *, int);
+
 /*
  * Highest known file descriptor used for a Client or an Agent connection.
  * This is reported in the pmcd.openfds metric.
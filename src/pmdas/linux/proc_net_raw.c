@@ -13,6 +13,7 @@
  */
 #include "linux.h"
 #include "proc_net_raw.h"
+#include "sock_diag.h"
 
 static int
 refresh_rawconn_stats(rawconn_stats_t *conn, const char *path)
@@ -39,11 +40,15 @@ refresh_rawconn_stats(rawconn_stats_t *conn, const char *path)
 int
 refresh_proc_net_raw(proc_net_raw_t *proc_net_raw)
 {
+    if (sock_diag_rawconn(AF_INET, proc_net_raw) == 0)
+	return 0;
     return refresh_rawconn_stats(proc_net_raw, "/proc/net/raw");
 }
 
 int
 refresh_proc_net_raw6(proc_net_raw6_t *proc_net_raw6)
 {
+    if (sock_diag_rawconn(AF_INET6, proc_net_raw6) == 0)
+	return 0;
     return refresh_rawconn_stats(proc_net_raw6, "/proc/net/raw6");
 }
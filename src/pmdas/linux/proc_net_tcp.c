@@ -16,6 +16,7 @@
 #include <ctype.h>
 #include "linux.h"
 #include "proc_net_tcp.h"
+#include "sock_diag.h"
 
 static int
 refresh_tcpconn_stats(tcpconn_stats_t *conn, const char *path)
@@ -59,11 +60,15 @@ refresh_tcpconn_stats(tcpconn_stats_t *conn, const char *path)
 int
 refresh_proc_net_tcp(proc_net_tcp_t *proc_net_tcp)
 {
+    if (sock_diag_tcpconn(AF_INET, proc_net_tcp) == 0)
+	return 0;
     return refresh_tcpconn_stats(proc_net_tcp, "/proc/net/tcp");
 }
 
 int
 refresh_proc_net_tcp6(proc_net_tcp6_t *proc_net_tcp6)
 {
+    if (sock_diag_tcpconn(AF_INET6, proc_net_tcp6) == 0)
+	return 0;
     return refresh_tcpconn_stats(proc_net_tcp6, "/proc/net/tcp6");
 }
@@ -14,6 +14,7 @@
 #include <ctype.h>
 #include "linux.h"
 #include "proc_net_udp.h"
+#include "sock_diag.h"
 
 static int
 refresh_udpconn_stats(udpconn_stats_t *conn, const char *path)
@@ -61,11 +62,15 @@ refresh_udpconn_stats(udpconn_stats_t *conn, const char *path)
 int
 refresh_proc_net_udp(proc_net_udp_t *proc_net_udp)
 {
+    if (sock_diag_udpconn(AF_INET, proc_net_udp) == 0)
+	return 0;
     return refresh_udpconn_stats(proc_net_udp, "/proc/net/udp");
 }
 
 int
 refresh_proc_net_udp6(proc_net_udp6_t *proc_net_udp6)
 {
+    if (sock_diag_udpconn(AF_INET6, proc_net_udp6) == 0)
+	return 0;
     return refresh_udpconn_stats(proc_net_udp6, "/proc/net/udp6");
 }
@@ -13,9 +13,10 @@
  */
 #include "linux.h"
 #include "proc_net_unix.h"
+#include "sock_diag.h"
 
-int
-refresh_proc_net_unix(proc_net_unix_t *up)
+static int
+refresh_unix_stats(proc_net_unix_t *up)
 {
     char		buf[BUFSIZ]; 
     char		*q, *p = buf;
@@ -61,3 +62,11 @@ refresh_proc_net_unix(proc_net_unix_t *up)
     fclose(fp);
     return 0;
 }
+
+int
+refresh_proc_net_unix(proc_net_unix_t *up)
+{
+    if (sock_diag_unix(up) == 0)
+	return 0;
+    return refresh_unix_stats(up);
+}
@@ -0,0 +1,250 @@
+/*
+ * Linux socket counts via NETLINK_SOCK_DIAG
+ *
+ * Copyright (c) 2026 Red Hat.
+ * 
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/netlink.h>
+#include <linux/sock_diag.h>
+#include <linux/inet_diag.h>
+#include <linux/unix_diag.h>
+#include "linux.h"
+#include "proc_net_tcp.h"
+#include "proc_net_udp.h"
+#include "proc_net_raw.h"
+#include "proc_net_unix.h"
+#include "sock_diag.h"
+
+/*
+ * Counting sockets from /proc/net/{tcp,udp,raw,unix} means the kernel
+ * formats, and we then scan, one line of text per socket.  A sock_diag
+ * dump instead streams a small fixed-size binary record per socket,
+ * from which only the state is needed.
+ *
+ * Each kind of request is attempted until the kernel first rejects it
+ * (e.g. the udp_diag or raw_diag modules are unavailable), and never
+ * when the stats files are being redirected via linux_statspath.
+ */
+enum {
+    DIAG_TCP	= 0x1,
+    DIAG_TCP6	= 0x2,
+    DIAG_UDP	= 0x4,
+    DIAG_UDP6	= 0x8,
+    DIAG_RAW	= 0x10,
+    DIAG_RAW6	= 0x20,
+    DIAG_UNIX	= 0x40,
+};
+static unsigned int	diag_unsupported;
+
+typedef void (*diag_callback)(const struct nlmsghdr *, void *);
+
+static int
+diag_dump(unsigned int kind, void *req, size_t reqlen,
+	  diag_callback callback, void *arg)
+{
+    struct sockaddr_nl	nladdr = { .nl_family = AF_NETLINK };
+    struct nlmsghdr	nlh = { 0 };
+    struct nlmsghdr	*h;
+    struct iovec	iov[2];
+    struct msghdr	msg = { 0 };
+    const unsigned int	seq = 1;
+    long		buf[8192];	/* aligned for struct nlmsghdr */
+    ssize_t		bytes;
+    int			fd, sts = 0;
+
+    if ((diag_unsupported & kind) || linux_statspath[0] != '\0')
+	return -EOPNOTSUPP;
+
+    /* created per refresh - dumps are of the current network namespace */
+    if ((fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG)) < 0) {
+	sts = -oserror();
+	diag_unsupported |= kind;
+	return sts;
+    }
+
+    nlh.nlmsg_len = NLMSG_LENGTH(reqlen);
+    nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    nlh.nlmsg_seq = seq;
+    iov[0].iov_base = &nlh;
+    iov[0].iov_len = sizeof(nlh);
+    iov[1].iov_base = req;
+    iov[1].iov_len = reqlen;
+    msg.msg_name = &nladdr;
+    msg.msg_namelen = sizeof(nladdr);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    if (sendmsg(fd, &msg, 0) < 0) {
+	sts = -oserror();
+	goto done;
+    }
+
+    for (;;) {
+	if ((bytes = recv(fd, buf, sizeof(buf), 0)) < 0) {
+	    if (oserror() == EINTR)
+		continue;
+	    sts = -oserror();
+	    goto done;
+	}
+	if (bytes == 0) {
+	    sts = -EPROTO;
+	    goto done;
+	}
+	for (h = (struct nlmsghdr *)buf; NLMSG_OK(h, bytes); h = NLMSG_NEXT(h, bytes)) {
+	    if (h->nlmsg_seq != seq)
+		continue;
+	    if (h->nlmsg_type == NLMSG_DONE)
+		goto done;
+	    if (h->nlmsg_type == NLMSG_ERROR) {
+		struct nlmsgerr	*err = (struct nlmsgerr *)NLMSG_DATA(h);
+
+		/* request rejected, e.g. no diag module for this protocol */
+		sts = (err->error < 0) ? err->error : -EPROTO;
+		diag_unsupported |= kind;
+		if (pmDebugOptions.appl0)
+		    fprintf(stderr, "%s: kind 0x%x rejected: %s\n",
+			    "diag_dump", kind, pmErrStr(sts));
+		goto done;
+	    }
+	    callback(h, arg);
+	}
+    }
+
+done:
+    close(fd);
+    return sts;
+}
+
+static int
+inet_dump(unsigned int kind, int family, int protocol,
+	  diag_callback callback, void *arg)
+{
+    struct inet_diag_req_v2	req;
+
+    memset(&req, 0, sizeof(req));
+    req.sdiag_family = family;
+    req.sdiag_protocol = protocol;
+    req.idiag_states = ~0U;	/* all states */
+    return diag_dump(kind, &req, sizeof(req), callback, arg);
+}
+
+static void
+tcpconn_callback(const struct nlmsghdr *h, void *arg)
+{
+    const struct inet_diag_msg	*r = NLMSG_DATA(h);
+    tcpconn_stats_t		*conn = (tcpconn_stats_t *)arg;
+    unsigned int		state = r->idiag_state;
+
+    if (state == 12)	/* TCP_NEW_SYN_RECV, as in /proc/net/tcp */
+	state = _PM_TCP_SYN_RECV;
+    if (state < _PM_TCP_LAST)
+	conn->stat[state]++;
+}
+
+int
+sock_diag_tcpconn(int family, tcpconn_stats_t *conn)
+{
+    unsigned int	kind = (family == AF_INET6) ? DIAG_TCP6 : DIAG_TCP;
+    int			sts;
+
+    memset(conn, 0, sizeof(*conn));
+    if ((sts = inet_dump(kind, family, IPPROTO_TCP, tcpconn_callback, conn)) < 0)
+	memset(conn, 0, sizeof(*conn));
+    return sts;
+}
+
+static void
+udpconn_callback(const struct nlmsghdr *h, void *arg)
+{
+    const struct inet_diag_msg	*r = NLMSG_DATA(h);
+    udpconn_stats_t		*conn = (udpconn_stats_t *)arg;
+
+    /* same unconnected (TCP_CLOSE) and connected states as /proc/net/udp */
+    if (r->idiag_state == _PM_TCP_CLOSE)
+	conn->listen++;
+    else if (r->idiag_state == _PM_TCP_ESTABLISHED)
+	conn->established++;
+}
+
+int
+sock_diag_udpconn(int family, udpconn_stats_t *conn)
+{
+    unsigned int	kind = (family == AF_INET6) ? DIAG_UDP6 : DIAG_UDP;
+    int			sts;
+
+    memset(conn, 0, sizeof(*conn));
+    if ((sts = inet_dump(kind, family, IPPROTO_UDP, udpconn_callback, conn)) < 0)
+	memset(conn, 0, sizeof(*conn));
+    return sts;
+}
+
+static void
+rawconn_callback(const struct nlmsghdr *h, void *arg)
+{
+    rawconn_stats_t		*conn = (rawconn_stats_t *)arg;
+
+    (void)h;
+    conn->count++;
+}
+
+int
+sock_diag_rawconn(int family, rawconn_stats_t *conn)
+{
+    unsigned int	kind = (family == AF_INET6) ? DIAG_RAW6 : DIAG_RAW;
+    int			sts;
+
+    /* IPPROTO_RAW selects raw_diag, and all raw sockets of the family */
+    memset(conn, 0, sizeof(*conn));
+    if ((sts = inet_dump(kind, family, IPPROTO_RAW, rawconn_callback, conn)) < 0)
+	memset(conn, 0, sizeof(*conn));
+    return sts;
+}
+
+static void
+unix_callback(const struct nlmsghdr *h, void *arg)
+{
+    const struct unix_diag_msg	*r = NLMSG_DATA(h);
+    proc_net_unix_t		*up = (proc_net_unix_t *)arg;
+
+    if (r->udiag_type == SOCK_DGRAM)
+	up->datagram_count++;
+    else if (r->udiag_type == SOCK_STREAM) {
+	/*
+	 * /proc/net/unix reports connected (SS_CONNECTED) and other
+	 * (SS_UNCONNECTED, including listening) stream sockets, which
+	 * here are those in and not in the TCP_ESTABLISHED state.
+	 */
+	if (r->udiag_state == _PM_TCP_ESTABLISHED)
+	    up->stream_established++;
+	else
+	    up->stream_listen++;
+	up->stream_count++;
+    }
+}
+
+int
+sock_diag_unix(proc_net_unix_t *up)
+{
+    struct unix_diag_req	req;
+    int				sts;
+
+    memset(&req, 0, sizeof(req));
+    req.sdiag_family = AF_UNIX;
+    req.udiag_states = ~0U;	/* all states */
+    memset(up, 0, sizeof(*up));
+    if ((sts = diag_dump(DIAG_UNIX, &req, sizeof(req), unix_callback, up)) < 0)
+	memset(up, 0, sizeof(*up));
+    return sts;
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ * 
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Socket counts from NETLINK_SOCK_DIAG, each returning zero on success
+ * else a negative error code, whereupon callers use /proc/net instead.
+ */
+struct tcpconn_stats;
+struct udpconn_stats;
+struct rawconn_stats;
+struct proc_net_unix;
+
+extern int sock_diag_tcpconn(int, struct tcpconn_stats *);
+extern int sock_diag_udpconn(int, struct udpconn_stats *);
+extern int sock_diag_rawconn(int, struct rawconn_stats *);
+extern int sock_diag_unix(struct proc_net_unix *);
@@ -21,10 +21,13 @@
 #include "clusters.h"
 #include "proc_pid.h"
 #include <sys/stat.h>
+#include <sys/inotify.h>
 #include <ctype.h>
 
 unsigned int	cgroup_version;
 
+static const pmProfile *cgroup2_profile;	/* instances for this fetch */
+
 /*
  * Parts of the following two functions are based on systemd code, see
  * https://github.com/systemd/systemd/blob/main/src/basic/unit-name.c
@@ -502,6 +505,28 @@ check_refresh(const char *cgroup, const char *container, int container_length)
     return 1;
 }
 
+static int
+cgroup_subdir(const char *cgpath, struct dirent *dp)
+{
+    if (dp->d_type == DT_UNKNOWN) {
+	/*
+	 * This a bit sad, and probably only seen in QA where
+	 * PROC_STATSPATH is set and the test "/proc" files are
+	 * on a file system that does not support d_type from
+	 * readdir() ... go the old-style way with stat()
+	 */
+	int		lsts;
+	struct stat	statbuf;
+	if ((lsts = stat(cgpath, &statbuf)) != 0) {
+	    if (pmDebugOptions.appl0)
+		fprintf(stderr, "cgroup_scan: stat(%s) -> %d\n", cgpath, lsts);
+	    return 0;
+	}
+	return (statbuf.st_mode & S_IFMT) == S_IFDIR;
+    }
+    return dp->d_type == DT_DIR;
+}
+
 static void
 cgroup_scan(const char *mnt, const char *path, cgroup_refresh_t refresh,
 		const char *container, int container_length, void *arg)
@@ -537,24 +562,7 @@ cgroup_scan(const char *mnt, const char *path, cgroup_refresh_t refresh,
 	else
 	    pmsprintf(cgpath, sizeof(cgpath), "%s%s/%s/%s",
 			proc_statspath, mnt, path, dp->d_name);
-	if (dp->d_type == DT_UNKNOWN) {
-	    /*
-	     * This a bit sad, and probably only seen in QA where
-	     * PROC_STATSPATH is set and the test "/proc" files are
-	     * on a file system that does not support d_type from
-	     * readdir() ... go the old-style way with stat()
-	     */
-	    int		lsts;
-	    struct stat	statbuf;
-	    if ((lsts = stat(cgpath, &statbuf)) != 0) {
-		if (pmDebugOptions.appl0)
-		    fprintf(stderr, "cgroup_scan: stat(%s) -> %d\n", cgpath, lsts);
-		continue;
-	    }
-	    if ((statbuf.st_mode & S_IFMT) != S_IFDIR)
-		continue;
-	}
-	else if (dp->d_type != DT_DIR)
+	if (!cgroup_subdir(cgpath, dp))
 	    continue;
 
 	cgname = cgroup_name(cgpath, length);
@@ -595,6 +603,242 @@ refresh_cgroups(const char *subsys, const char *container, size_t length,
     }
 }
 
+/*
+ * Optional incremental tracking of the cgroup v2 hierarchy.  Instead
+ * of walking the whole tree on every fetch, each cgroup directory is
+ * watched with inotify and the set of known cgroups is updated from
+ * the queued mkdir/rmdir events.  A full rescan is only done when
+ * first started, or if the kernel event queue overflows or a cgroup
+ * is renamed.  If watches cannot be added (e.g. fs.inotify limits)
+ * we fall back to scanning the tree on each refresh.
+ */
+typedef struct cgroup_watch {
+    int		wd;
+    filesys_t	*fs;		/* cgroup2 mount this cgroup is below */
+    char	*name;		/* "/" for the root, else "/a/b" */
+} cgroup_watch_t;
+
+#define CGROUP_WATCH_EVENTS \
+	(IN_CREATE|IN_MOVED_FROM|IN_MOVED_TO|IN_DELETE_SELF|IN_ONLYDIR)
+
+static int		cgroup_watching;	/* -1: failed, 0: off, 1: on */
+static int		cgroup_watch_fd = -1;
+static int		cgroup_watch_rescan;
+static __pmHashCtl	cgroup_watches;		/* keyed by watch descriptor */
+
+void
+cgroup_watch_init(void)
+{
+    cgroup_watching = 1;
+}
+
+static void
+cgroup_watch_path(filesys_t *fs, const char *name, char *buffer, size_t buflen)
+{
+    if (strcmp(name, "/") == 0)
+	pmsprintf(buffer, buflen, "%s%s", proc_statspath, fs->path);
+    else
+	pmsprintf(buffer, buflen, "%s%s%s", proc_statspath, fs->path, name);
+}
+
+static void
+cgroup_watch_remove(int wd)
+{
+    __pmHashNode	*node;
+    cgroup_watch_t	*cwp;
+
+    if ((node = __pmHashSearch(wd, &cgroup_watches)) == NULL)
+	return;
+    cwp = (cgroup_watch_t *)node->data;
+    if (pmDebugOptions.appl0)
+	fprintf(stderr, "cgroup_watch_remove: wd=%d \"%s\"\n", wd, cwp->name);
+    __pmHashDel(wd, cwp, &cgroup_watches);
+    free(cwp->name);
+    free(cwp);
+}
+
+static void
+cgroup_watch_stop(void)
+{
+    __pmHashNode	*node;
+    cgroup_watch_t	*cwp;
+    int			i;
+
+    for (i = 0; i < cgroup_watches.hsize; i++) {
+	for (node = cgroup_watches.hash[i]; node != NULL; node = node->next) {
+	    cwp = (cgroup_watch_t *)node->data;
+	    free(cwp->name);
+	    free(cwp);
+	}
+    }
+    __pmHashClear(&cgroup_watches);
+    if (cgroup_watch_fd >= 0)
+	close(cgroup_watch_fd);
+    cgroup_watch_fd = -1;
+}
+
+/*
+ * Watch one cgroup directory, then any below it - these may have been
+ * created before the watch on their parent was in place.  Returns -1
+ * only if no more watches can be added.
+ */
+static int
+cgroup_watch_add(filesys_t *fs, const char *name)
+{
+    cgroup_watch_t	*cwp;
+    struct dirent	*dp;
+    DIR			*dirp;
+    char		path[MAXPATHLEN], child[MAXPATHLEN];
+    int			wd, sts = 0;
+
+    cgroup_watch_path(fs, name, path, sizeof(path));
+    if ((wd = inotify_add_watch(cgroup_watch_fd, path, CGROUP_WATCH_EVENTS)) < 0) {
+	if (oserror() == ENOSPC || oserror() == ENOMEM) {
+	    pmNotifyErr(LOG_WARNING, "cgroup: cannot watch %s (%s), "
+			"reverting to cgroup rescans\n", path, osstrerror());
+	    return -1;
+	}
+	return 0;	/* already gone */
+    }
+    if (__pmHashSearch(wd, &cgroup_watches) != NULL)
+	return 0;	/* already watched */
+    if ((cwp = (cgroup_watch_t *)malloc(sizeof(cgroup_watch_t))) == NULL ||
+	(cwp->name = strdup(name)) == NULL) {
+	free(cwp);
+	inotify_rm_watch(cgroup_watch_fd, wd);
+	return -1;
+    }
+    cwp->wd = wd;
+    cwp->fs = fs;
+    __pmHashAdd(wd, cwp, &cgroup_watches);
+    if (pmDebugOptions.appl0)
+	fprintf(stderr, "cgroup_watch_add: wd=%d \"%s\"\n", wd, name);
+
+    if ((dirp = opendir(path)) == NULL)
+	return 0;
+    while (sts == 0 && (dp = readdir(dirp)) != NULL) {
+	if (dp->d_name[0] == '.' || dp->d_type == DT_REG)
+	    continue;
+	pmsprintf(child, sizeof(child), "%s/%s", path, dp->d_name);
+	if (!cgroup_subdir(child, dp))
+	    continue;
+	pmsprintf(child, sizeof(child), "%s/%s",
+			strcmp(name, "/") == 0 ? "" : name, dp->d_name);
+	sts = cgroup_watch_add(fs, child);
+    }
+    closedir(dirp);
+    return sts;
+}
+
+static int
+cgroup_watch_start(void)
+{
+    int sts;
+    filesys_t *fs;
+    pmInDom mounts = INDOM(CGROUP_MOUNTS_INDOM);
+
+    cgroup_watch_stop();
+    cgroup_watch_rescan = 0;
+    if ((cgroup_watch_fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC)) < 0) {
+	pmNotifyErr(LOG_WARNING, "cgroup: inotify_init1 failed (%s), "
+			"reverting to cgroup rescans\n", osstrerror());
+	return -1;
+    }
+    pmdaCacheOp(mounts, PMDA_CACHE_WALK_REWIND);
+    while ((sts = pmdaCacheOp(mounts, PMDA_CACHE_WALK_NEXT)) != -1) {
+	if (!pmdaCacheLookup(mounts, sts, NULL, (void **)&fs))
+	    continue;
+	if (fs->version > 1 && cgroup_watch_add(fs, "/") < 0) {
+	    cgroup_watch_stop();
+	    return -1;
+	}
+    }
+    return 0;
+}
+
+/*
+ * Absorb the queued inotify events, keeping the set of watched cgroups
+ * in step with the hierarchy.  Returns -1 if watching had to stop.
+ */
+static int
+cgroup_watch_events(void)
+{
+    char		buf[8192]
+			__attribute__ ((aligned(__alignof__(struct inotify_event))));
+    char		name[MAXPATHLEN];
+    struct inotify_event *event;
+    __pmHashNode	*node;
+    cgroup_watch_t	*cwp;
+    ssize_t		bytes;
+    char		*p;
+
+    while ((bytes = read(cgroup_watch_fd, buf, sizeof(buf))) > 0) {
+	for (p = buf; p < buf + bytes; p += sizeof(*event) + event->len) {
+	    event = (struct inotify_event *)p;
+	    if (event->mask & IN_Q_OVERFLOW) {
+		cgroup_watch_rescan = 1;
+		continue;
+	    }
+	    if (event->mask & (IN_DELETE_SELF|IN_IGNORED)) {
+		cgroup_watch_remove(event->wd);
+		continue;
+	    }
+	    if (!(event->mask & IN_ISDIR) || event->len == 0 ||
+		(node = __pmHashSearch(event->wd, &cgroup_watches)) == NULL)
+		continue;
+	    if (event->mask & IN_MOVED_FROM) {
+		/* renamed cgroups keep their watches, under old names */
+		cgroup_watch_rescan = 1;
+		continue;
+	    }
+	    cwp = (cgroup_watch_t *)node->data;
+	    pmsprintf(name, sizeof(name), "%s/%s",
+			strcmp(cwp->name, "/") == 0 ? "" : cwp->name, event->name);
+	    if (cgroup_watch_add(cwp->fs, name) < 0)
+		return -1;
+	}
+    }
+    if (bytes < 0 && oserror() != EAGAIN && oserror() != EINTR)
+	cgroup_watch_rescan = 1;
+    return 0;
+}
+
+/*
+ * Equivalent of refresh_cgroups for watched cgroup v2 hierarchies,
+ * visiting each known cgroup without reading any directories.
+ */
+static int
+refresh_cgroups_watched(const char *container, size_t length,
+		cgroup_setup_t setup, cgroup_refresh_t refresh, void *arg)
+{
+    __pmHashNode	*node;
+    cgroup_watch_t	*cwp;
+    char		path[MAXPATHLEN];
+    int			i;
+
+    if (cgroup_watch_fd < 0 || cgroup_watch_rescan) {
+	if (cgroup_watch_start() < 0)
+	    return -1;
+    }
+    if (cgroup_watch_events() < 0 ||
+	(cgroup_watch_rescan && cgroup_watch_start() < 0)) {
+	cgroup_watch_stop();
+	return -1;
+    }
+
+    setup(arg);
+    for (i = 0; i < cgroup_watches.hsize; i++) {
+	for (node = cgroup_watches.hash[i]; node != NULL; node = node->next) {
+	    cwp = (cgroup_watch_t *)node->data;
+	    if (!check_refresh(cwp->name, container, length))
+		continue;
+	    cgroup_watch_path(cwp->fs, cwp->name, path, sizeof(path));
+	    refresh(path, cwp->name, arg);
+	}
+    }
+    return 0;
+}
+
 static void
 read_pressure(FILE *fp, const char *type, cgroup_pressure_t *pp)
 {
@@ -1058,17 +1302,22 @@ refresh_memory(const char *path, const char *name, void *arg)
     char *escname, escbuf[MAXPATHLEN];
     char file[MAXPATHLEN];
     char id[MAXCIDLEN];
-    int sts;
+    int inst, sts;
 
     (void)arg;
     escname = unit_name_unescape(name, escbuf);
-    sts = pmdaCacheLookupName(indom, escname, NULL, (void **)&memory);
+    sts = pmdaCacheLookupName(indom, escname, &inst, (void **)&memory);
     if (sts == PMDA_CACHE_ACTIVE)
 	return;
     if (sts != PMDA_CACHE_INACTIVE &&
 	(memory = (cgroup_memory_t *)calloc(1, sizeof(cgroup_memory_t))) == NULL)
 	return;
 
+    /* as for refresh_all, skip known cgroup v2 instances not in the profile */
+    if (sts == PMDA_CACHE_INACTIVE && cgroup2_profile != NULL &&
+	!__pmInProfile(indom, cgroup2_profile, inst))
+	goto done;
+
     pmsprintf(file, sizeof(file), "%s/%s", path, "memory.stat");
     read_memory_stats(file, &memory->stat);
     pmsprintf(file, sizeof(file), "%s/%s", path, "memory.current");
@@ -1079,6 +1328,7 @@ refresh_memory(const char *path, const char *name, void *arg)
     read_oneline_ull(file, &memory->usage);
     pmsprintf(file, sizeof(file), "%s/%s", path, "memory.failcnt");
     read_oneline_ull(file, &memory->failcnt);
+done:
     cgroup_container(name, id, sizeof(id), &memory->container);
 
     pmdaCacheStore(indom, PMDA_CACHE_ADD, escname, memory);
@@ -1511,16 +1761,21 @@ refresh_all(const char *path, const char *name, void *arg)
     pmInDom indom = INDOM(CGROUP2_INDOM);
     char file[MAXPATHLEN], id[MAXCIDLEN];
     char *escname, escbuf[MAXPATHLEN+16];
-    int sts, *need_refresh = (int *)arg;
+    int inst, sts, *need_refresh = (int *)arg;
 
     escname = unit_name_unescape(name, escbuf);
-    sts = pmdaCacheLookupName(indom, escname, NULL, (void **)&cgroup);
+    sts = pmdaCacheLookupName(indom, escname, &inst, (void **)&cgroup);
     if (sts == PMDA_CACHE_ACTIVE)
 	goto v1;
     if (sts != PMDA_CACHE_INACTIVE &&
 	(cgroup = (cgroup2_t *)calloc(1, sizeof(cgroup2_t))) == NULL)
 	goto v1;
 
+    /* known cgroups excluded from the fetch profile need not be read */
+    if (sts == PMDA_CACHE_INACTIVE && cgroup2_profile != NULL &&
+	!__pmInProfile(indom, cgroup2_profile, inst))
+	goto iostat;
+
     if (need_refresh[CLUSTER_CGROUP2_CPU_PRESSURE]) {
 	pmsprintf(file, sizeof(file), "%s/%s", path, "cpu.pressure");
 	read_pressures(file, &cgroup->cpu_pressures, CG_PSI_SOME);
@@ -1536,11 +1791,6 @@ refresh_all(const char *path, const char *name, void *arg)
 	read_pressures(file, &cgroup->io_pressures, CG_PSI_SOME|CG_PSI_FULL);
     }
 
-    if (need_refresh[CLUSTER_CGROUP2_IO_STAT]) {
-	pmsprintf(file, sizeof(file), "%s/%s", path, "io.stat");
-	read_io_stats(file, name);
-    }
-
     if (need_refresh[CLUSTER_CGROUP2_MEM_PRESSURE]) {
 	pmsprintf(file, sizeof(file), "%s/%s", path, "memory.pressure");
 	read_pressures(file, &cgroup->mem_pressures, CG_PSI_SOME|CG_PSI_FULL);
@@ -1551,6 +1801,13 @@ refresh_all(const char *path, const char *name, void *arg)
 	read_pressures(file, &cgroup->irq_pressures, CG_PSI_FULL);
     }
 
+iostat:
+    /* per-device values, in a separate (cgroup::device) instance domain */
+    if (need_refresh[CLUSTER_CGROUP2_IO_STAT]) {
+	pmsprintf(file, sizeof(file), "%s/%s", path, "io.stat");
+	read_io_stats(file, name);
+    }
+
     cgroup_container(name, id, sizeof(id), &cgroup->container);
     pmdaCacheStore(indom, PMDA_CACHE_ADD, escname, cgroup);
 
@@ -1598,7 +1855,14 @@ v1:
 }
 
 void
-refresh_cgroups2(const char *cgroup, size_t cgrouplen, void *arg)
+refresh_cgroups2(const char *cgroup, size_t cgrouplen,
+		const pmProfile *profile, void *arg)
 {
-    refresh_cgroups(NULL, cgroup, cgrouplen, setup_all, refresh_all, arg);
+    cgroup2_profile = profile;
+    if (cgroup_watching > 0 &&
+	refresh_cgroups_watched(cgroup, cgrouplen, setup_all, refresh_all, arg) < 0)
+	cgroup_watching = -1;
+    if (cgroup_watching <= 0)
+	refresh_cgroups(NULL, cgroup, cgrouplen, setup_all, refresh_all, arg);
+    cgroup2_profile = NULL;
 }
@@ -494,7 +494,8 @@ extern char *cgroup_find_subsys(pmInDom, filesys_t *);
 extern void refresh_cgroup_subsys(void);
 extern void refresh_cgroup_filesys(void);
 extern void refresh_cgroups1(const char *, size_t, void *);
-extern void refresh_cgroups2(const char *, size_t, void *);
+extern void refresh_cgroups2(const char *, size_t, const pmProfile *, void *);
+extern void cgroup_watch_init(void);
 
 extern char *cgroup_container_path(char *, size_t, const char *);
 extern char *cgroup_container_search(const char *, char *, int);
@@ -1427,7 +1427,7 @@ refresh_sched_autogroup(void)
 }
 
 static int
-proc_refresh(pmdaExt *pmda, int *need_refresh)
+proc_refresh(pmdaExt *pmda, int *need_refresh, unsigned int files)
 {
     char cgroup[MAXPATHLEN];
     proc_container_t *container;
@@ -1472,7 +1472,7 @@ proc_refresh(pmdaExt *pmda, int *need_refresh)
 	if (cgroup_version < 2)
 	    refresh_cgroups1(cgroup, cgrouplen, need_refresh);
 	else
-	    refresh_cgroups2(cgroup, cgrouplen, need_refresh);
+	    refresh_cgroups2(cgroup, cgrouplen, pmda->e_prof, need_refresh);
     }
 
     if (need_refresh[CLUSTER_ACCT] &&
@@ -1495,6 +1495,7 @@ proc_refresh(pmdaExt *pmda, int *need_refresh)
 	need_refresh[CLUSTER_PROC_RUNQ]) {
 	refresh_proc_pid(&proc_pid,
 		need_refresh[CLUSTER_PROC_RUNQ]? &proc_runq : NULL,
+		files, pmda->e_prof,
 		proc_ctx_threads(pmda->e_context, threads),
 		proc_ctx_cgroups(pmda->e_context, cgroups),
 		container ? cgroup : NULL, cgrouplen);
@@ -1629,7 +1630,7 @@ proc_instance(pmInDom indom, int inst, char *name, pmInResult **result, pmdaExt
 
     if (have_access ||
 	((serial != PROC_INDOM) && (serial != HOTPROC_INDOM))) {
-	if ((sts = proc_refresh(pmda, need_refresh)) == 0)
+	if ((sts = proc_refresh(pmda, need_refresh, 0)) == 0)
 	    sts = pmdaInstance(indom, inst, name, result, pmda);
     }
 
@@ -3545,6 +3546,7 @@ static int
 proc_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 {
     int			i, sts, need_refresh[MAX_CLUSTER] = { 0 };
+    unsigned int	files = 0;
 
     for (i = 0; i < numpmid; i++) {
 	unsigned int	cluster = pmID_cluster(pmidlist[i]);
@@ -3559,7 +3561,19 @@ proc_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 		"proc_fetch", have_access, all_access,
 		proc_ctx_access(pmda->e_context));
 
-    if ((sts = proc_refresh(pmda, need_refresh)) == 0)
+    /* per-process files that may be read ahead by /proc scan threads */
+    if (have_access) {
+	if (need_refresh[CLUSTER_PID_STAT])
+	    files |= PROC_PID_FLAG_STAT;
+	if (need_refresh[CLUSTER_PID_STATM])
+	    files |= PROC_PID_FLAG_STATM;
+	if (need_refresh[CLUSTER_PID_SCHEDSTAT])
+	    files |= PROC_PID_FLAG_SCHEDSTAT;
+	if (need_refresh[CLUSTER_PID_IO])
+	    files |= PROC_PID_FLAG_IO;
+    }
+
+    if ((sts = proc_refresh(pmda, need_refresh, files)) == 0)
 	sts = pmdaFetch(numpmid, pmidlist, resp, pmda);
 
     have_access = all_access || proc_ctx_revert(pmda->e_context);
@@ -4019,13 +4033,16 @@ pmLongOptions	longopts[] = {
     PMDAOPT_LOGFILE,
     { "with-threads", 0, 'L', 0, "include threads in the all-processes instance domain" },
     { "from-cgroup", 1, 'r', "NAME", "restrict monitoring to processes in the named cgroup" },
+    { "fd-cache", 1, 'F', "N", "hold up to N per-process files open between samples" },
+    { "scan-threads", 1, 'T', "N", "use N threads to read per-process files" },
+    { "watch-cgroups", 0, 'W', 0, "track cgroup v2 hierarchy changes with inotify" },
     PMDAOPT_USERNAME,
     PMOPT_HELP,
     PMDA_OPTIONS_END
 };
 
 pmdaOptions	opts = {
-    .short_options = "AD:d:l:Lr:U:?",
+    .short_options = "AD:d:F:l:Lr:T:U:W?",
     .long_options = longopts,
 };
 
@@ -4036,6 +4053,9 @@ main(int argc, char **argv)
     pmdaInterface	dispatch;
     char		helppath[MAXPATHLEN];
     char		*username = "root";
+    char		*endnum;
+    int			fdcache = 0;
+    int			nthreads = 1;
 
     _isDSO = 0;
     pmSetProgname(argv[0]);
@@ -4051,9 +4071,30 @@ main(int argc, char **argv)
 	case 'L':
 	    threads = 1;
 	    break;
+	case 'F':
+	    fdcache = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || fdcache < 0) {
+		pmprintf("%s: invalid file descriptor cache size '%s'\n",
+			    pmGetProgname(), opts.optarg);
+		opts.errors++;
+	    }
+	    break;
 	case 'r':
 	    cgroups = opts.optarg;
 	    break;
+	case 'T':
+	    nthreads = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || nthreads < 1) {
+		pmprintf("%s: invalid number of scan threads '%s'\n",
+			    pmGetProgname(), opts.optarg);
+		opts.errors++;
+	    }
+	    else if (nthreads > PROC_SCAN_MAXTHREADS)
+		nthreads = PROC_SCAN_MAXTHREADS;
+	    break;
+	case 'W':
+	    cgroup_watch_init();
+	    break;
 	}
     }
 
@@ -4067,6 +4108,8 @@ main(int argc, char **argv)
     pmdaOpenLog(&dispatch);
     pmSetProcessIdentity(username);
 
+    proc_fdcache_init(fdcache);
+    proc_scan_init(nthreads);
     proc_init(&dispatch);
     pmdaConnect(&dispatch);
     pmdaMain(&dispatch);
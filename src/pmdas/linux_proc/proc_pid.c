@@ -26,6 +26,9 @@
 #include <sys/stat.h>
 #include <sys/syslog.h>
 #include <sys/types.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <signal.h>
 #include <pwd.h>
 #include <grp.h>
 #include "proc_pid.h"
@@ -37,11 +40,15 @@ static size_t	procbuflen;
 static char	*procbuf;
 
 static proc_pid_list_t procpids; /* previous pids list that the proc pmda uses */
-static void refresh_proc_pidlist(proc_pid_t *, proc_pid_list_t *, proc_runq_t *);
-static int refresh_proc_pid_stat(proc_pid_entry_t *);
-static int refresh_proc_pid_status(proc_pid_entry_t *);
-static int refresh_proc_pid_io(proc_pid_entry_t *);
-static int refresh_proc_pid_schedstat(proc_pid_entry_t *);
+static int proc_fdcache_max;	/* limit on cached /proc/<pid> files */
+static int proc_fdcache_count;	/* cached /proc/<pid> files, all pid tables (atomic) */
+static void proc_fdcache_drop(proc_pid_entry_t *, int);
+static void refresh_proc_pidlist(proc_pid_t *, proc_pid_list_t *, proc_runq_t *, unsigned int);
+static int refresh_proc_pid_stat(proc_pid_entry_t *, size_t *, char **);
+static int refresh_proc_pid_statm(proc_pid_entry_t *, size_t *, char **);
+static int refresh_proc_pid_status(proc_pid_entry_t *, size_t *, char **);
+static int refresh_proc_pid_io(proc_pid_entry_t *, size_t *, char **);
+static int refresh_proc_pid_schedstat(proc_pid_entry_t *, size_t *, char **);
 
 /* Hotproc variables */
 
@@ -456,7 +463,7 @@ hotproc_eval_procs(void)
 
     /* Whats running right now */
     refresh_global_pidlist(0, &hotpids);
-    refresh_proc_pidlist(hotproc_poss_pid, &hotpids, NULL);
+    refresh_proc_pidlist(hotproc_poss_pid, &hotpids, NULL, 0);
 
     pmtimevalNow(&timestamp);
 
@@ -472,10 +479,10 @@ hotproc_eval_procs(void)
 	}
 
 	/* Collect all the stat/status/statm info */
-	refresh_proc_pid_stat(entry);
-	refresh_proc_pid_status(entry);
-	refresh_proc_pid_io(entry);
-	refresh_proc_pid_schedstat(entry);
+	refresh_proc_pid_stat(entry, &procbuflen, &procbuf);
+	refresh_proc_pid_status(entry, &procbuflen, &procbuf);
+	refresh_proc_pid_io(entry, &procbuflen, &procbuf);
+	refresh_proc_pid_schedstat(entry, &procbuflen, &procbuf);
 
         /* Note: /proc/pid/schedstat and /proc/pid/io not on all platforms */
 	if (!(entry->success & PROC_PID_FLAG_STAT) ||
@@ -761,14 +768,325 @@ refresh_proc_runq(proc_pid_entry_t *ep, proc_runq_t *runq)
     }
 }
 
+/*
+ * Build the "<pid> <cmdline>" name of a new entry, falling back to the
+ * status Name: field and an <exiting> marker.  May run concurrently for
+ * different entries, see proc_scan().
+ */
 static void
-refresh_proc_pidlist(proc_pid_t *proc_pid, proc_pid_list_t *pids, proc_runq_t *runq)
+refresh_proc_pid_name(proc_pid_entry_t *ep)
 {
-    int			i, fd, numinst, idx = 0;
+    int			fd, k = 0;
     char		*p, buf[MAXPATHLEN];
+
+    pmsprintf(buf, sizeof(buf), "%s/proc/%d/cmdline", proc_statspath, ep->id);
+    if ((fd = open(buf, O_RDONLY)) >= 0) {
+	int numlen = pmsprintf(buf, sizeof(buf), "%06d ", ep->id);
+	if ((k = read(fd, buf+numlen, sizeof(buf)-numlen)) > 0) {
+	    p = buf + k + numlen;
+	    if (p - buf >= sizeof(buf))
+		p--;
+	    *p-- = '\0';
+	    /* Skip trailing nils, i.e. don't replace them */
+	    while (buf+numlen < p) {
+		if (*p-- != '\0') {
+			break;
+		}
+	    }
+	    /* Remove NULL terminators from cmdline string array */
+	    while (buf+numlen < p) {
+		if (*p == '\0') *p = ' ';
+		p--;
+	    }
+	}
+	close(fd);
+    }
+    else if (pmDebugOptions.appl1 && pmDebugOptions.desperate) {
+	fprintf(stderr, "%s: open(\"%s\", O_RDONLY) failed: %s\n",
+		"refresh_proc_pid_name", buf, pmErrStr(-oserror()));
+    }
+    if (k == 0) {
+	/*
+	 * If a process is swapped out, /proc/<pid>/cmdline
+	 * returns an empty string so we have to get it
+	 * from /proc/<pid>/status or /proc/<pid>/stat
+	 */
+	pmsprintf(buf, sizeof(buf), "%s/proc/%d/status", proc_statspath, ep->id);
+	if ((fd = open(buf, O_RDONLY)) >= 0) {
+	    /* We engage in a bit of a hanky-panky here:
+	     * the string should look like "123456 (name)",
+	     * we get it from /proc/XX/status as "Name:   name\n...",
+	     * to fit the 6 digits of PID and opening parenthesis, 
+	     * save 2 bytes at the start of the buffer. 
+	     * And don't forget to leave 2 bytes for the trailing 
+	     * parenthesis and the nil. Here is
+	     * an example of what we're trying to achieve:
+	     * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+	     * |  |  | N| a| m| e| :|\t| i| n| i| t|\n| S|...
+	     * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+	     * | 0| 0| 0| 0| 0| 1|  | (| i| n| i| t| )|\0|...
+	     * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+ */
+	    if ((k = read(fd, buf+2, sizeof(buf)-4)) > 0) {
+		int bc;
+
+		if ((p = strchr(buf+2, '\n')) == NULL)
+		    p = buf+k;
+		p[0] = ')'; 
+		p[1] = '\0';
+		bc = pmsprintf(buf, sizeof(buf), "%06d ", ep->id); 
+		buf[bc] = '(';
+	    }
+	    close(fd);
+	}
+	else if (pmDebugOptions.appl1 && pmDebugOptions.desperate) {
+	    fprintf(stderr, "%s: open(\"%s\", O_RDONLY) failed: %s\n",
+		    "refresh_proc_pid_name", buf, pmErrStr(-oserror()));
+	}
+    }
+
+    if (k <= 0) {
+	/* hmm .. must be exiting */
+	pmsprintf(buf, sizeof(buf), "%06d <exiting>", ep->id);
+    }
+
+    if ((ep->name = strdup(buf)) != NULL)
+	ep->psargs = index(ep->name, ' ') + 1;
+    else
+	ep->psargs = NULL;
+}
+
+/*
+ * Optional parallel refresh of /proc/<pid> files.  The entries of one
+ * scan are split into contiguous shards, each worked on by one thread
+ * with its own read buffer and run queue accumulator.  Shards only ever
+ * touch their own entries; hash table updates, instance names and the
+ * run queue totals are done afterwards by the calling thread, in order.
+ *
+ * The worker threads are started once, by proc_scan_init(), and wait
+ * for each new scan (proc_scan_gen) under proc_scan_lock.
+ */
+#define PROC_SHARD_MIN	32	/* fewest entries worth a thread */
+
+typedef struct proc_shard {
+    proc_pid_entry_t	**entries;
+    int			count;
+    unsigned int	files;		/* PROC_PID_FLAG_* files to refresh */
+    int			want_runq;
+    proc_runq_t		runq;
+    int			nread;		/* entries with files read ahead */
+    size_t		buflen;		/* read buffer private to this shard */
+    char		*buf;
+    void		(*work)(struct proc_shard *);
+    pthread_t		tid;
+    int			started;	/* tid is a running worker */
+} proc_shard_t;
+
+static int proc_nworkers = 1;	/* threads sharing each scan, 1 is serial */
+static proc_shard_t *proc_shards;
+static pthread_mutex_t proc_scan_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t proc_scan_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t proc_scan_done = PTHREAD_COND_INITIALIZER;
+static unsigned int proc_scan_gen;	/* bumped for each parallel scan */
+static int proc_scan_nshards;	/* shards in the current scan */
+static int proc_scan_busy;	/* workers still on the current scan */
+
+/* fetch profile for the read ahead, see refresh_proc_pid() */
+static pmInDom proc_scan_indom;
+static const pmProfile *proc_scan_profile;
+
+/*
+ * /proc/<pid>/status is not in this list - parsing it interns strings in
+ * the (shared) strings indom cache, so it stays with the fetching thread.
+ */
+static const struct {
+    unsigned int	flag;
+    int			(*refresh)(proc_pid_entry_t *, size_t *, char **);
+} proc_scan_files[] = {
+    { PROC_PID_FLAG_STAT,	refresh_proc_pid_stat },
+    { PROC_PID_FLAG_STATM,	refresh_proc_pid_statm },
+    { PROC_PID_FLAG_SCHEDSTAT,	refresh_proc_pid_schedstat },
+    { PROC_PID_FLAG_IO,		refresh_proc_pid_io },
+};
+
+static void *
+proc_shard_worker(void *arg)
+{
+    proc_shard_t	*sp = (proc_shard_t *)arg;
+    unsigned int	gen = 0;
+
+    pthread_mutex_lock(&proc_scan_lock);
+    for (;;) {
+	while (gen == proc_scan_gen)
+	    pthread_cond_wait(&proc_scan_start, &proc_scan_lock);
+	gen = proc_scan_gen;
+	if (sp - proc_shards >= proc_scan_nshards)
+	    continue;	/* not needed for this scan */
+	pthread_mutex_unlock(&proc_scan_lock);
+	sp->work(sp);
+	pthread_mutex_lock(&proc_scan_lock);
+	if (--proc_scan_busy == 0)
+	    pthread_cond_signal(&proc_scan_done);
+    }
+    return NULL;
+}
+
+/*
+ * Start the worker threads with all signals blocked, so that timer
+ * callbacks (hotproc) are only ever run by the main thread.  Shard 0
+ * is always worked on by the thread doing the scan.
+ */
+void
+proc_scan_init(int nworkers)
+{
+    sigset_t		all, saved;
+    int			i, nstarted = 0;
+
+    if (nworkers <= 1)
+	return;
+    if ((proc_shards = (proc_shard_t *)calloc(nworkers, sizeof(proc_shard_t))) == NULL) {
+	pmNoMem("proc_scan_init", nworkers * sizeof(proc_shard_t), PM_RECOV_ERR);
+	return;
+    }
+    proc_nworkers = nworkers;
+
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &saved);
+    for (i = 1; i < nworkers; i++) {
+	proc_shards[i].started = (pthread_create(&proc_shards[i].tid, NULL,
+				proc_shard_worker, &proc_shards[i]) == 0);
+	if (proc_shards[i].started)
+	    nstarted++;
+    }
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    /* shards without a worker are done by the scanning thread */
+    pmNotifyErr(LOG_INFO, "%d of %d /proc scan worker threads started",
+		nstarted, nworkers - 1);
+}
+
+static void
+proc_shard_names(proc_shard_t *sp)
+{
+    int			i;
+
+    for (i = 0; i < sp->count; i++)
+	refresh_proc_pid_name(sp->entries[i]);
+}
+
+static void
+proc_shard_files(proc_shard_t *sp)
+{
+    proc_pid_entry_t	*ep;
+    unsigned int	files;
+    int			i, j;
+
+    sp->nread = 0;
+    for (i = 0; i < sp->count; i++) {
+	ep = sp->entries[i];
+	/* only processes in the fetch profile, except stat for runq */
+	files = sp->files;
+	if (files && !__pmInProfile(proc_scan_indom, proc_scan_profile, ep->id))
+	    files = 0;
+	else if (files)
+	    sp->nread++;
+	if (sp->want_runq)
+	    files |= PROC_PID_FLAG_STAT;
+	for (j = 0; j < sizeof(proc_scan_files)/sizeof(proc_scan_files[0]); j++) {
+	    if (files & proc_scan_files[j].flag)
+		proc_scan_files[j].refresh(ep, &sp->buflen, &sp->buf);
+	}
+	if (sp->want_runq)
+	    refresh_proc_runq(ep, &sp->runq);
+    }
+}
+
+/*
+ * Run one scan over count entries, the calling thread works on the
+ * first shard (and any without a worker thread) itself.  Returns the
+ * number of shards used.
+ */
+static int
+proc_scan(proc_pid_entry_t **entries, int count, unsigned int files,
+		proc_runq_t *runq, void (*work)(proc_shard_t *))
+{
+    proc_shard_t	*sp;
+    int			i, nshards, offset = 0;
+
+    nshards = (count + PROC_SHARD_MIN - 1) / PROC_SHARD_MIN;
+    if (nshards > proc_nworkers)
+	nshards = proc_nworkers;
+    if (nshards < 1)
+	nshards = 1;
+
+    for (i = 0; i < nshards; i++) {
+	sp = &proc_shards[i];
+	sp->entries = entries + offset;
+	sp->count = count / nshards + (i < count % nshards);
+	sp->files = files;
+	sp->want_runq = (runq != NULL);
+	memset(&sp->runq, 0, sizeof(sp->runq));
+	sp->nread = 0;
+	sp->work = work;
+	offset += sp->count;
+    }
+
+    pthread_mutex_lock(&proc_scan_lock);
+    proc_scan_nshards = nshards;
+    proc_scan_busy = 0;
+    for (i = 1; i < nshards; i++)
+	if (proc_shards[i].started)
+	    proc_scan_busy++;
+    proc_scan_gen++;
+    pthread_cond_broadcast(&proc_scan_start);
+    pthread_mutex_unlock(&proc_scan_lock);
+
+    work(&proc_shards[0]);
+    for (i = 1; i < nshards; i++) {
+	if (!proc_shards[i].started)	/* soldier on without this worker */
+	    work(&proc_shards[i]);
+    }
+
+    pthread_mutex_lock(&proc_scan_lock);
+    while (proc_scan_busy > 0)
+	pthread_cond_wait(&proc_scan_done, &proc_scan_lock);
+    pthread_mutex_unlock(&proc_scan_lock);
+
+    if (runq == NULL)
+	return nshards;
+    for (i = 0; i < nshards; i++) {
+	sp = &proc_shards[i];
+	runq->runnable += sp->runq.runnable;
+	runq->blocked += sp->runq.blocked;
+	runq->sleeping += sp->runq.sleeping;
+	runq->stopped += sp->runq.stopped;
+	runq->swapped += sp->runq.swapped;
+	runq->kernel += sp->runq.kernel;
+	runq->defunct += sp->runq.defunct;
+	runq->unknown += sp->runq.unknown;
+    }
+    return nshards;
+}
+
+static void
+refresh_proc_pidlist(proc_pid_t *proc_pid, proc_pid_list_t *pids,
+		proc_runq_t *runq, unsigned int files)
+{
+    int			i, k, numinst, nentries = 0, nfresh = 0, idx = 0;
+    char		*p;
     __pmHashNode	*node, *next, *prev;
     proc_pid_entry_t	*ep;
+    proc_pid_entry_t	**entries;	/* valid entries, in pids order */
+    proc_pid_entry_t	**fresh;	/* new entries, in pids order */
     pmdaIndom		*indomp = proc_pid->indom;
+    size_t		size = (pids->count + 1) * sizeof(proc_pid_entry_t *);
+    /* not for hotproc, which may be refreshed from a timer callback */
+    int			parallel = (proc_nworkers > 1 && pids == &procpids);
+
+    if ((entries = (proc_pid_entry_t **)malloc(2 * size)) == NULL) {
+	pmNoMem("refresh_proc_pidlist", 2 * size, PM_RECOV_ERR);
+	return;
+    }
+    fresh = entries + pids->count + 1;
 
     /*
      * invalidate all entries so we can harvest pids that have exited
@@ -786,95 +1104,38 @@ refresh_proc_pidlist(proc_pid_t *proc_pid, proc_pid_list_t *pids, proc_runq_t *r
      */
     for (i=0; i < pids->count; i++) {
 	node = __pmHashSearch(pids->pids[i], &proc_pid->pidhash);
-	if (node)
+	if (node) {
 	    ep = (proc_pid_entry_t *)node->data;
+	    if (ep->fetched & PROC_PID_FLAG_VALID)
+		continue;	/* duplicate pid */
+	}
 	else {
-	    int k = 0;
-
 	    ep = (proc_pid_entry_t *)malloc(sizeof(proc_pid_entry_t));
 	    memset(ep, 0, sizeof(proc_pid_entry_t));
 
 	    ep->id = pids->pids[i];
-
-	    pmsprintf(buf, sizeof(buf), "%s/proc/%d/cmdline", proc_statspath, pids->pids[i]);
-	    if ((fd = open(buf, O_RDONLY)) >= 0) {
-		int numlen = pmsprintf(buf, sizeof(buf), "%06d ", pids->pids[i]);
-		if ((k = read(fd, buf+numlen, sizeof(buf)-numlen)) > 0) {
-		    p = buf + k + numlen;
-		    if (p - buf >= sizeof(buf))
-			p--;
-		    *p-- = '\0';
-		    /* Skip trailing nils, i.e. don't replace them */
-		    while (buf+numlen < p) {
-			if (*p-- != '\0') {
-				break;
-			}
-		    }
-		    /* Remove NULL terminators from cmdline string array */
-		    while (buf+numlen < p) {
-			if (*p == '\0') *p = ' ';
-			p--;
-		    }
-		}
-		close(fd);
-	    }
-	    else if (pmDebugOptions.appl1 && pmDebugOptions.desperate) {
-		fprintf(stderr, "%s: open(\"%s\", O_RDONLY) failed: %s\n",
-			"refresh_proc_pidlist", buf, pmErrStr(-oserror()));
-	    }
-	    if (k == 0) {
-		/*
-		 * If a process is swapped out, /proc/<pid>/cmdline
-		 * returns an empty string so we have to get it
-		 * from /proc/<pid>/status or /proc/<pid>/stat
-		 */
-		pmsprintf(buf, sizeof(buf), "%s/proc/%d/status", proc_statspath, pids->pids[i]);
-		if ((fd = open(buf, O_RDONLY)) >= 0) {
-		    /* We engage in a bit of a hanky-panky here:
-		     * the string should look like "123456 (name)",
-		     * we get it from /proc/XX/status as "Name:   name\n...",
-		     * to fit the 6 digits of PID and opening parenthesis, 
-	             * save 2 bytes at the start of the buffer. 
-	             * And don't forget to leave 2 bytes for the trailing 
-		     * parenthesis and the nil. Here is
-		     * an example of what we're trying to achieve:
-		     * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+
-		     * |  |  | N| a| m| e| :|\t| i| n| i| t|\n| S|...
-		     * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+
-		     * | 0| 0| 0| 0| 0| 1|  | (| i| n| i| t| )|\0|...
-		     * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+ */
-		    if ((k = read(fd, buf+2, sizeof(buf)-4)) > 0) {
-			int bc;
-
-			if ((p = strchr(buf+2, '\n')) == NULL)
-			    p = buf+k;
-			p[0] = ')'; 
-			p[1] = '\0';
-			bc = pmsprintf(buf, sizeof(buf), "%06d ", pids->pids[i]); 
-			buf[bc] = '(';
-		    }
-		    close(fd);
-		}
-		else if (pmDebugOptions.appl1 && pmDebugOptions.desperate) {
-		    fprintf(stderr, "%s: open(\"%s\", O_RDONLY) failed: %s\n",
-			    "refresh_proc_pidlist", buf, pmErrStr(-oserror()));
-		}
-	    }
-
-	    if (k <= 0) {
-		/* hmm .. must be exiting */
-	    	pmsprintf(buf, sizeof(buf), "%06d <exiting>", pids->pids[i]);
-	    }
-
-	    if ((ep->name = strdup(buf)) != NULL)
-		ep->psargs = index(ep->name, ' ') + 1;
-	    else
-		ep->psargs = NULL;
+	    for (k = 0; k < PROC_PID_FD_COUNT; k++)
+		ep->fds[k] = -1;
 
 	    __pmHashAdd(pids->pids[i], (void *)ep, &proc_pid->pidhash);
 	    //fprintf(stderr, "key %d : ADDED \"%s\" to hash table\n", pids->pids[i], buf);
+	    fresh[nfresh++] = ep;
 	}
 
+	/* mark pid as valid (new or still running) */
+	ep->fetched |= PROC_PID_FLAG_VALID;
+	ep->success |= PROC_PID_FLAG_VALID;
+	entries[nentries++] = ep;
+    }
+
+    /* names of the new processes */
+    if (parallel)
+	proc_scan(fresh, nfresh, 0, NULL, proc_shard_names);
+    else for (i=0; i < nfresh; i++)
+	refresh_proc_pid_name(fresh[i]);
+
+    for (i=0; i < nentries; i++) {
+	ep = entries[i];
 	if (ep->instname == NULL) {
 	   /*
 	     * The external instance name is the pid followed by
@@ -884,21 +1145,17 @@ refresh_proc_pidlist(proc_pid_t *proc_pid, proc_pid_list_t *pids, proc_runq_t *r
 	     * available in the proc.psinfo.psargs metric.
 	     */
 	    if ((p = strchr(ep->name, ' ')) != NULL) {
-	        if ((p = strchr(p+1, ' ')) != NULL) {
-	            int len = p - ep->name;
+		if ((p = strchr(p+1, ' ')) != NULL) {
+		    int len = p - ep->name;
 		    if (len > PROC_PID_STAT_CMD_MAXLEN)
 			len = PROC_PID_STAT_CMD_MAXLEN;
-	            ep->instname = (char *)malloc(len+1);
-	            pmstrncpy(ep->instname, len+1, ep->name);
-	        }
+		    ep->instname = (char *)malloc(len+1);
+		    pmstrncpy(ep->instname, len+1, ep->name);
+		}
 	    }
 	    if (ep->instname == NULL) /* no spaces found, so use the full name */
-	        ep->instname = strndup(ep->name, PROC_PID_STAT_CMD_MAXLEN);
+		ep->instname = strndup(ep->name, PROC_PID_STAT_CMD_MAXLEN);
 	}
-	
-	/* mark pid as valid (new or still running) */
-	ep->fetched |= PROC_PID_FLAG_VALID;
-	ep->success |= PROC_PID_FLAG_VALID;
     }
 
     /* 
@@ -930,6 +1187,7 @@ refresh_proc_pidlist(proc_pid_t *proc_pid, proc_pid_list_t *pids, proc_runq_t *r
 		    free(ep->wchan_buf);
 		if (ep->environ_buf != NULL)
 		    free(ep->environ_buf);
+		proc_fdcache_drop(ep, -1);
 	    	if (prev == NULL)
 		    proc_pid->pidhash.hash[i] = node->next;
 		else
@@ -955,23 +1213,41 @@ refresh_proc_pidlist(proc_pid_t *proc_pid, proc_pid_list_t *pids, proc_runq_t *r
      *   active processes and accumulate the values - and do this in a way
      *   that sets the FETCHED flag for these files such that they're only
      *   read once for each sample (fetch).
+     * - with worker threads, those stat files and any others requested
+     *   for this fetch (for processes in the fetch profile) are read in
+     *   parallel.
      */
+    if (parallel && (runq || files)) {
+	int	nshards, nread = 0;
+
+	nshards = proc_scan(entries, nentries, files, runq, proc_shard_files);
+	runq = NULL;	/* accumulated above */
+	if (pmDebugOptions.appl1) {
+	    for (i = 0; i < nshards; i++)
+		nread += proc_shards[i].nread;
+	    fprintf(stderr, "%s: files 0x%x read ahead for %d of %d pids in %d shards\n",
+		    "refresh_proc_pidlist", files, nread, nentries, nshards);
+	}
+    }
+
     indomp->it_numinst = numinst;
     indomp->it_set = (pmdaInstid *)realloc(indomp->it_set, numinst * sizeof(pmdaInstid));
     for (i=0; i < proc_pid->pidhash.hsize; i++) {
 	for (node=proc_pid->pidhash.hash[i]; node != NULL; node=node->next) {
 	    ep = (proc_pid_entry_t *)node->data;
 	    if (runq) {
-		refresh_proc_pid_stat(ep);
+		refresh_proc_pid_stat(ep, &procbuflen, &procbuf);
 		refresh_proc_runq(ep, runq);
 	    }
 	    refresh_proc_indom_entry(ep, indomp, idx++);
 	}
     }
+    free(entries);
 }
 
 int
 refresh_proc_pid(proc_pid_t *proc_pid, proc_runq_t *proc_runq,
+		 unsigned int files, const pmProfile *profile,
 		 int want_threads, const char *cgroups,
 		 const char *container, int namelen)
 {
@@ -999,7 +1275,10 @@ refresh_proc_pid(proc_pid_t *proc_pid, proc_runq_t *proc_runq,
 		"refresh_proc_pid", procpids.count, procpids.threads,
 		container ? "container" : "cgroups", filter ? filter : "");
 
-    refresh_proc_pidlist(proc_pid, &procpids, proc_runq);
+    proc_scan_indom = proc_pid->indom->it_indom;
+    proc_scan_profile = profile;
+    refresh_proc_pidlist(proc_pid, &procpids, proc_runq, files);
+    proc_scan_profile = NULL;
     return 0;
 }
 
@@ -1014,7 +1293,7 @@ refresh_hotproc_pid(proc_pid_t *proc_pid, int threads, const char *cgroups)
     if ((sts = refresh_hotproc_pidlist(&hotpids)) < 0)
 	return sts;
 
-    refresh_proc_pidlist(proc_pid, &hotpids, NULL);
+    refresh_proc_pidlist(proc_pid, &hotpids, NULL, 0);
     return 0;
 }
 
@@ -1131,15 +1410,19 @@ maperr(void)
     return sts;
 }
 
+/*
+ * Read an entire file using explicit offsets, so that descriptors
+ * held open by proc_fdcache_read() need no lseek(2) between samples.
+ */
 static int
 read_proc_entry(int fd, size_t *lenp, char **bufp)
 {
     size_t		len = 0;
-    char		*p = *bufp, buf[1024];
+    char		*p = *bufp, buf[4096];
     int			n, sts = 0;
 
     for (len=0;;) {
-	if ((n = read(fd, buf, sizeof(buf))) <= 0)
+	if ((n = pread(fd, buf, sizeof(buf), len)) <= 0)
 	    break;
 	len += n;
 	if (*lenp < len) {
@@ -1167,6 +1450,103 @@ read_proc_entry(int fd, size_t *lenp, char **bufp)
     return sts;
 }
 
+/*
+ * Optional cache of open /proc/<pid> files, so that a refresh costs a
+ * single pread(2) rather than open(2), read(2) until EOF, and close(2).
+ * Only files for which the kernel applies access checks at read time
+ * are cached, so reading via a descriptor opened with the credentials
+ * of another client discloses nothing more than a fresh open would.
+ *
+ * A descriptor refers to the task it was opened for, not the pid, so
+ * once that process has exited (and perhaps the pid reused) its reads
+ * fail with ESRCH; the entry is then dropped and the file reopened.
+ * A change in process start time also drops all files for the pid.
+ */
+void
+proc_fdcache_init(int limit)
+{
+    struct rlimit	rlim;
+    rlim_t		need;
+    const int		reserve = 256;	/* uncached opens, clients, ... */
+
+    if (limit <= 0)
+	return;
+    if (getrlimit(RLIMIT_NOFILE, &rlim) == 0 && rlim.rlim_cur != RLIM_INFINITY) {
+	need = (rlim_t)limit + reserve;
+	if (rlim.rlim_cur < need) {
+	    if (rlim.rlim_max != RLIM_INFINITY && rlim.rlim_max < need)
+		rlim.rlim_cur = rlim.rlim_max;
+	    else
+		rlim.rlim_cur = need;
+	    if (setrlimit(RLIMIT_NOFILE, &rlim) < 0)
+		getrlimit(RLIMIT_NOFILE, &rlim);
+	}
+	if (rlim.rlim_cur < need) {
+	    limit = (rlim.rlim_cur > reserve) ? rlim.rlim_cur - reserve : 0;
+	    pmNotifyErr(LOG_INFO, "file descriptor cache limited to %d files", limit);
+	}
+    }
+    proc_fdcache_max = limit;
+}
+
+/* close one cached file, or all of them for this pid when slot is -1 */
+static void
+proc_fdcache_drop(proc_pid_entry_t *ep, int slot)
+{
+    int			i;
+
+    for (i = 0; i < PROC_PID_FD_COUNT; i++) {
+	if ((slot == -1 || slot == i) && ep->fds[i] >= 0) {
+	    close(ep->fds[i]);
+	    ep->fds[i] = -1;
+	    __sync_fetch_and_sub(&proc_fdcache_count, 1);
+	}
+    }
+}
+
+/* return a cached descriptor for this file, else open it afresh */
+static int
+proc_fdcache_open(int slot, const char *base, proc_pid_entry_t *ep)
+{
+    if (ep->fds[slot] >= 0) {
+	if (ep->fdthreads == procpids.threads)
+	    return ep->fds[slot];
+	proc_fdcache_drop(ep, -1);	/* opened via the other path */
+    }
+    return proc_open(base, ep);
+}
+
+/*
+ * Read from a proc_fdcache_open() descriptor, which is then either
+ * kept open for the next sample or closed.
+ */
+static int
+proc_fdcache_read(int slot, const char *base, proc_pid_entry_t *ep, int fd,
+		size_t *lenp, char **bufp)
+{
+    int			sts;
+
+    if (fd == ep->fds[slot]) {
+	if ((sts = read_proc_entry(fd, lenp, bufp)) >= 0)
+	    return sts;
+	/* process exited or different credentials, so try a fresh open */
+	proc_fdcache_drop(ep, slot);
+	if ((fd = proc_open(base, ep)) < 0)
+	    return maperr();
+    }
+    sts = read_proc_entry(fd, lenp, bufp);
+    if (sts >= 0 && proc_fdcache_max > 0 &&
+	__sync_add_and_fetch(&proc_fdcache_count, 1) <= proc_fdcache_max) {
+	ep->fds[slot] = fd;
+	ep->fdthreads = procpids.threads;
+    } else {
+	if (sts >= 0 && proc_fdcache_max > 0)
+	    __sync_fetch_and_sub(&proc_fdcache_count, 1);
+	close(fd);
+    }
+    return sts;
+}
+
 static void
 parse_proc_stat(proc_pid_entry_t *ep, size_t buflen, char *buf)
 {
@@ -1233,19 +1613,26 @@ parse_proc_stat(proc_pid_entry_t *ep, size_t buflen, char *buf)
 }
 
 static int
-refresh_proc_pid_stat(proc_pid_entry_t *ep)
+refresh_proc_pid_stat(proc_pid_entry_t *ep, size_t *lenp, char **bufp)
 {
     int			fd, sts;
 
     if (ep->success & PROC_PID_FLAG_STAT)
 	return 0;
-    if ((fd = proc_open("stat", ep)) < 0)
+    if ((fd = proc_fdcache_open(PROC_PID_FD_STAT, "stat", ep)) < 0)
 	return maperr();
-    if ((sts = read_proc_entry(fd, &procbuflen, &procbuf)) >= 0) {
-	parse_proc_stat(ep, procbuflen, procbuf);
+    sts = proc_fdcache_read(PROC_PID_FD_STAT, "stat", ep, fd,
+			    lenp, bufp);
+    if (sts >= 0) {
+	parse_proc_stat(ep, *lenp, *bufp);
 	ep->success |= PROC_PID_FLAG_STAT;
+	/* a different process with this pid, keep none of the old files */
+	if (ep->fdstart != ep->stat.start_time) {
+	    if (ep->fdstart != 0)
+		proc_fdcache_drop(ep, -1);
+	    ep->fdstart = ep->stat.start_time;
+	}
     }
-    close(fd);
     return sts;
 }
 
@@ -1261,7 +1648,7 @@ fetch_proc_pid_stat(int id, proc_pid_t *proc_pid, int *sts)
     if (!ep)
 	return NULL;
     if (!(ep->fetched & PROC_PID_FLAG_STAT)) {
-	*sts = refresh_proc_pid_stat(ep);
+	*sts = refresh_proc_pid_stat(ep, &procbuflen, &procbuf);
 	ep->fetched |= PROC_PID_FLAG_STAT;
     }
     return (*sts < 0) ? NULL : ep;
@@ -1274,9 +1661,9 @@ refresh_proc_pid_wchan(proc_pid_entry_t *ep)
 
     if (ep->wchan_buflen > 0)
 	ep->wchan_buf[0] = '\0';
-    if ((fd = proc_open("wchan", ep)) >= 0) {
-	sts = read_proc_entry(fd, &ep->wchan_buflen, &ep->wchan_buf);
-	close(fd);
+    if ((fd = proc_fdcache_open(PROC_PID_FD_WCHAN, "wchan", ep)) >= 0) {
+	sts = proc_fdcache_read(PROC_PID_FD_WCHAN, "wchan", ep, fd,
+				&ep->wchan_buflen, &ep->wchan_buf);
     } /* else - ignore failure here, backwards compat */
     return sts;
 }
@@ -1564,19 +1951,20 @@ parse_proc_status(proc_pid_entry_t *ep, size_t buflen, char *buf)
 }
 
 static int
-refresh_proc_pid_status(proc_pid_entry_t *ep)
+refresh_proc_pid_status(proc_pid_entry_t *ep, size_t *lenp, char **bufp)
 {
     int			fd, sts;
 
     if (ep->success & PROC_PID_FLAG_STATUS)
 	return 0;
-    if ((fd = proc_open("status", ep)) < 0)
+    if ((fd = proc_fdcache_open(PROC_PID_FD_STATUS, "status", ep)) < 0)
 	return maperr();
-    if ((sts = read_proc_entry(fd, &procbuflen, &procbuf)) == 0) {
-	parse_proc_status(ep, procbuflen, procbuf);
+    sts = proc_fdcache_read(PROC_PID_FD_STATUS, "status", ep, fd,
+			    lenp, bufp);
+    if (sts == 0) {
+	parse_proc_status(ep, *lenp, *bufp);
 	ep->success |= PROC_PID_FLAG_STATUS;
     }
-    close(fd);
     return sts;
 }
 
@@ -1593,7 +1981,7 @@ fetch_proc_pid_status(int id, proc_pid_t *proc_pid, int *sts)
 	return NULL;
 
     if (!(ep->fetched & PROC_PID_FLAG_STATUS)) {
-	*sts = refresh_proc_pid_status(ep);
+	*sts = refresh_proc_pid_status(ep, &procbuflen, &procbuf);
 	ep->fetched |= PROC_PID_FLAG_STATUS;
     }
     return (*sts < 0) ? NULL : ep;
@@ -1614,19 +2002,20 @@ parse_proc_statm(proc_pid_entry_t *ep, size_t buflen, char *buf)
 }
 
 static int
-refresh_proc_pid_statm(proc_pid_entry_t *ep)
+refresh_proc_pid_statm(proc_pid_entry_t *ep, size_t *lenp, char **bufp)
 {
     int			fd, sts;
 
     if (ep->success & PROC_PID_FLAG_STATM)
 	return 0;
-    if ((fd = proc_open("statm", ep)) < 0)
+    if ((fd = proc_fdcache_open(PROC_PID_FD_STATM, "statm", ep)) < 0)
 	return maperr();
-    if ((sts = read_proc_entry(fd, &procbuflen, &procbuf)) == 0) {
-	parse_proc_statm(ep, procbuflen, procbuf);
+    sts = proc_fdcache_read(PROC_PID_FD_STATM, "statm", ep, fd,
+			    lenp, bufp);
+    if (sts == 0) {
+	parse_proc_statm(ep, *lenp, *bufp);
 	ep->success |= PROC_PID_FLAG_STATM;
     }
-    close(fd);
     return sts;
 }
 
@@ -1643,7 +2032,7 @@ fetch_proc_pid_statm(int id, proc_pid_t *proc_pid, int *sts)
     	return NULL;
 
     if (!(ep->fetched & PROC_PID_FLAG_STATM)) {
-	*sts = refresh_proc_pid_statm(ep);
+	*sts = refresh_proc_pid_statm(ep, &procbuflen, &procbuf);
 	ep->fetched |= PROC_PID_FLAG_STATM;
     }
     return (*sts < 0) ? NULL : ep;
@@ -1710,19 +2099,20 @@ parse_proc_schedstat(proc_pid_entry_t *ep, size_t buflen, char *buf)
 }
 
 static int 
-refresh_proc_pid_schedstat(proc_pid_entry_t *ep)
+refresh_proc_pid_schedstat(proc_pid_entry_t *ep, size_t *lenp, char **bufp)
 {
     int			fd, sts;
 
     if (ep->success & PROC_PID_FLAG_SCHEDSTAT)
 	return 0;
-    if ((fd = proc_open("schedstat", ep)) < 0)
+    if ((fd = proc_fdcache_open(PROC_PID_FD_SCHEDSTAT, "schedstat", ep)) < 0)
 	return maperr();
-    if ((sts = read_proc_entry(fd, &procbuflen, &procbuf)) >= 0) {
-	parse_proc_schedstat(ep, procbuflen, procbuf);
+    sts = proc_fdcache_read(PROC_PID_FD_SCHEDSTAT, "schedstat", ep, fd,
+			    lenp, bufp);
+    if (sts >= 0) {
+	parse_proc_schedstat(ep, *lenp, *bufp);
 	ep->success |= PROC_PID_FLAG_SCHEDSTAT;
     }
-    close(fd);
     return sts;
 }
 
@@ -1739,7 +2129,7 @@ fetch_proc_pid_schedstat(int id, proc_pid_t *proc_pid, int *sts)
 	return NULL;
 
     if (!(ep->fetched & PROC_PID_FLAG_SCHEDSTAT)) {
-	*sts = refresh_proc_pid_schedstat(ep);
+	*sts = refresh_proc_pid_schedstat(ep, &procbuflen, &procbuf);
 	ep->fetched |= PROC_PID_FLAG_SCHEDSTAT;
     }
     return (*sts < 0) ? NULL : ep;
@@ -1789,19 +2179,20 @@ parse_proc_io(proc_pid_entry_t *ep, size_t buflen, char *buf)
 }
 
 static int
-refresh_proc_pid_io(proc_pid_entry_t *ep)
+refresh_proc_pid_io(proc_pid_entry_t *ep, size_t *lenp, char **bufp)
 {
     int			fd, sts;
 
     if (ep->success & PROC_PID_FLAG_IO)
 	return 0;
-    if ((fd = proc_open("io", ep)) < 0)
+    if ((fd = proc_fdcache_open(PROC_PID_FD_IO, "io", ep)) < 0)
 	return maperr();
-    if ((sts = read_proc_entry(fd, &procbuflen, &procbuf)) >= 0) {
-	parse_proc_io(ep, procbuflen, procbuf);
+    sts = proc_fdcache_read(PROC_PID_FD_IO, "io", ep, fd,
+			    lenp, bufp);
+    if (sts >= 0) {
+	parse_proc_io(ep, *lenp, *bufp);
 	ep->success |= PROC_PID_FLAG_IO;
     }
-    close(fd);
     return sts;
 }
 
@@ -1824,7 +2215,7 @@ fetch_proc_pid_io(int id, proc_pid_t *proc_pid, int *sts)
 	return NULL;
 
     if (!(ep->fetched & PROC_PID_FLAG_IO)) {
-	*sts = refresh_proc_pid_io(ep);
+	*sts = refresh_proc_pid_io(ep, &procbuflen, &procbuf);
 	ep->fetched |= PROC_PID_FLAG_IO;
     }
     return (*sts < 0) ? NULL : ep;
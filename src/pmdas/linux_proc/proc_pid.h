@@ -247,6 +247,18 @@ enum {
     PROC_PID_FLAG_FDINFO	= 1<<17,
 };
 
+/* /proc/<pid> files that may be held open between samples */
+enum {
+    PROC_PID_FD_STAT		= 0,
+    PROC_PID_FD_STATM,
+    PROC_PID_FD_STATUS,
+    PROC_PID_FD_SCHEDSTAT,
+    PROC_PID_FD_IO,
+    PROC_PID_FD_WCHAN,
+
+    PROC_PID_FD_COUNT
+};
+
 typedef struct {
     int			id;	/* pid, hash key and internal instance id */
     int			pad;
@@ -313,6 +325,11 @@ typedef struct {
 
     /* /proc/<pid>/fdinfo cluster */
     proc_pid_fdinfo_t	fdinfo;
+
+    /* cached open files, see proc_fdcache_init() */
+    int			fds[PROC_PID_FD_COUNT];	/* -1 if not open */
+    int			fdthreads; /* procpids.threads when opened */
+    uint64_t		fdstart;   /* stat.start_time when opened */
 } proc_pid_entry_t;
 
 typedef struct {
@@ -327,11 +344,18 @@ typedef struct {
     int			threads;	/* /proc/PID/{xxx,task/PID/xxx} flag */
 } proc_pid_list_t;
 
+/* set the limit on /proc/<pid> files held open between samples */
+extern void proc_fdcache_init(int);
+
 /* lookup a proc hash entry */
 extern proc_pid_entry_t *proc_pid_entry_lookup(int, proc_pid_t *);
 
+/* set the number of threads sharing each /proc scan */
+#define PROC_SCAN_MAXTHREADS	64
+extern void proc_scan_init(int);
+
 /* refresh the proc indom, reset all "fetched" flags */
-extern int refresh_proc_pid(proc_pid_t *, proc_runq_t *, int, const char *, const char *, int);
+extern int refresh_proc_pid(proc_pid_t *, proc_runq_t *, unsigned int, const pmProfile *, int, const char *, const char *, int);
 
 /* refresh the hotproc indom, checking against the current configuration */
 extern int refresh_hotproc_pid(proc_pid_t *, int, const char *);
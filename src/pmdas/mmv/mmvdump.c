@@ -182,6 +182,9 @@ metrictype(int mtype)
     case MMV_TYPE_ELAPSED:
 	type = "elapsed";
 	break;
+    case MMV_TYPE_HISTOGRAM:
+	type = "histogram";
+	break;
     default:
 	type = "?";
 	break;
@@ -352,6 +355,7 @@ int
 dump_value(void *addr, size_t size, mmv_disk_value_t *vals, int i, int toc, int type)
 {
     mmv_disk_string_t *string;
+    mmv_disk_histogram_t *hist;
     struct timeval tv;
     __int64_t t;
 
@@ -395,6 +399,19 @@ dump_value(void *addr, size_t size, mmv_disk_value_t *vals, int i, int toc, int
 	    printf("Bad (positive) ELAPSED 'extra' value found!");
 	}
 	break;
+    case MMV_TYPE_HISTOGRAM:
+	hist = (mmv_disk_histogram_t *)((char *)addr + vals[i].extra);
+	if (size < vals[i].extra + sizeof(mmv_disk_histogram_t)) {
+	    printf(" = ?\n");
+	    printf("Bad file size: toc[%d] histogram value[%d] extra\n", toc, i);
+	    return 1;
+	}
+	if (hist->count == 0)
+	    printf(" = (count=0)");
+	else
+	    printf(" = (count=%"PRIu64"/sum=%"PRIu64"/min=%"PRIu64"/max=%"PRIu64")",
+			hist->count, hist->sum, hist->min, hist->max);
+	break;
     default:
 	printf("Unknown type %d", type);
     }
@@ -560,6 +577,70 @@ dump_labels(void *addr, size_t size, int idx, long base, __uint64_t offset, __in
     return 0;
 }
 
+int
+dump_shards(void *addr, size_t size, int idx, long base, __uint64_t offset, __int32_t count)
+{
+    int i, j, nvalues = 0;
+    __uint64_t off, stride;
+    pmAtomValue *shard;
+    mmv_disk_header_t *hdr = (mmv_disk_header_t *)addr;
+    mmv_disk_toc_t *toc = (mmv_disk_toc_t *)((char *)addr + sizeof(mmv_disk_header_t));
+
+    printf("\nTOC[%d]: offset %ld, shards offset %"PRIu64" (%d entries)\n",
+		idx, base, offset, count);
+
+    for (i = 0; i < hdr->tocs; i++)
+	if (toc[i].type == MMV_TOC_VALUES)
+	    nvalues = toc[i].count;
+    stride = MMV_SHARD_STRIDE(nvalues);
+
+    for (i = 0; i < count; i++) {
+	off = offset + i * stride;
+	if (size < off + stride) {
+	    printf("Bad file size: too small for toc[%d] shard[%d]\n", idx, i);
+	    return 1;
+	}
+	/* only values that have been updated via this shard */
+	shard = (pmAtomValue *)((char *)addr + off);
+	for (j = 0; j < nvalues; j++) {
+	    if (shard[j].ull == 0)
+		continue;
+	    printf("  [%u/%"PRIu64"] shard %d value %d = 0x%"PRIx64"\n",
+		i+1, off + j * sizeof(pmAtomValue), i, j, shard[j].ull);
+	}
+    }
+    return 0;
+}
+
+int
+dump_histograms(void *addr, size_t size, int idx, long base, __uint64_t offset, __int32_t count)
+{
+    int i, j;
+    __uint64_t off;
+    mmv_disk_histogram_t *hist;
+
+    printf("\nTOC[%d]: offset %ld, histograms offset %"PRIu64" (%d entries)\n",
+		idx, base, offset, count);
+
+    for (i = 0; i < count; i++) {
+	off = offset + i * sizeof(mmv_disk_histogram_t);
+	if (size < off + sizeof(mmv_disk_histogram_t)) {
+	    printf("Bad file size: too small for toc[%d] histogram[%d]\n", idx, i);
+	    return 1;
+	}
+	hist = (mmv_disk_histogram_t *)((char *)addr + off);
+	printf("  [%u/%"PRIu64"] count %"PRIu64", sum %"PRIu64"\n",
+		i+1, off, hist->count, hist->sum);
+	/* only buckets holding values */
+	for (j = 0; j < MMV_HIST_BUCKETS; j++) {
+	    if (hist->buckets[j] == 0)
+		continue;
+	    printf("       bucket %d = %"PRIu64"\n", j, hist->buckets[j]);
+	}
+    }
+    return 0;
+}
+
 static char *
 flagstr(int flags)
 {
@@ -576,8 +657,11 @@ flagstr(int flags)
 	strcat(buf, "process, ");
     if (flags & MMV_FLAG_SENTINEL)
 	strcat(buf, "sentinel, ");
+    if (flags & MMV_FLAG_SHARDED)
+	strcat(buf, "sharded, ");
 
-    flags &= ~(MMV_FLAG_NOPREFIX | MMV_FLAG_PROCESS | MMV_FLAG_SENTINEL);
+    flags &= ~(MMV_FLAG_NOPREFIX | MMV_FLAG_PROCESS | MMV_FLAG_SENTINEL |
+	       MMV_FLAG_SHARDED);
 
     /* unrecognised bits */
     if (flags) {
@@ -613,7 +697,8 @@ dump(const char *file, void *addr, size_t size)
     }
     version = hdr->version;
     if (version != MMV_VERSION1 && version != MMV_VERSION2 &&
-	version != MMV_VERSION3)
+	version != MMV_VERSION3 && version != MMV_VERSION4 &&
+	version != MMV_VERSION5)
     {
 	printf("Version %d not supported\n", version);
 	return 1;
@@ -685,6 +770,14 @@ dump(const char *file, void *addr, size_t size)
 	    if (dump_labels(addr, size, i, base, offset, count))
 		sts = 1;
 	    break;    
+	case MMV_TOC_SHARDS:
+	    if (dump_shards(addr, size, i, base, offset, count))
+		sts = 1;
+	    break;
+	case MMV_TOC_HISTOGRAMS:
+	    if (dump_histograms(addr, size, i, base, offset, count))
+		sts = 1;
+	    break;
 	default:
 	    printf("Unrecognised TOC[%d] type: 0x%x\n", i, type);
 	    sts = 1;
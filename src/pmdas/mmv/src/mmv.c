@@ -66,23 +66,43 @@ typedef struct {
     mmv_disk_metric_t	*metrics1;	/* v1 metric descs in mmap */
     mmv_disk_metric2_t	*metrics2;	/* v2 metric descs in mmap */
     mmv_disk_label_t	*labels; 	/* labels desc in mmap */
+    char		*shards;	/* v4 per-CPU shards in mmap */
     int			vcnt;		/* number of values */
     int			mcnt1;		/* number of metrics */
     int			mcnt2;		/* number of v2 metrics */
     int			lcnt;		/* number of labels */
-    int			version;	/* v1/v2/v3 version number */
+    int			shcnt;		/* number of shards */
+    int			version;	/* v1/v2/v3/v4 version number */
     int			cluster;	/* cluster identifier */
     pid_t		pid;		/* process identifier */
     __int64_t		len;		/* mmap region len */
     __uint64_t		gen;		/* generation number on open */
 } stats_t;
 
+/*
+ * Index from pmID to the values of each metric, built when the stats
+ * files are mapped so that fetches need not search the values array.
+ * Metrics with the same pmID (duplicate clusters across files, or
+ * duplicate items within one) are chained in stats file order.
+ */
+typedef struct mmv_index {
+    stats_t		*stats;		/* stats file holding the metric */
+    mmv_disk_value_t	*first;		/* first value of the metric */
+    __pmOAHashCtl	insts;		/* internal instance -> value */
+    __uint64_t		shorttext;
+    __uint64_t		helptext;
+    int			type;
+    int			singular;
+    struct mmv_index	*next;		/* next metric with this pmID */
+} mmv_index_t;
+
 typedef struct {
     pmdaMetric		*metrics;
     pmdaIndom		*indoms;
     pmdaNameSpace	*pmns;
     stats_t		*slist;
     int			scnt;
+    __pmOAHashCtl	index;		/* pmID -> mmv_index_t */
     int			mtot;
     int			intot;
     int			reload;		/* require reload of maps */
@@ -98,6 +118,24 @@ typedef struct {
     char		buffer[MMV_STRINGMAX];	/* temporary fetch buffer */
 } agent_t;
 
+/*
+ * Histogram metrics (v5) are exported as two metrics, with instance
+ * domains of their own in the (otherwise control) cluster zero: the
+ * count of values in each bucket, and a summary of the distribution.
+ */
+#define HIST_BUCKET_INDOM	1
+#define HIST_SUMMARY_INDOM	2
+
+enum {
+    HIST_MIN, HIST_MAX, HIST_MEDIAN, HIST_AVERAGE, HIST_P90, HIST_P95,
+    HIST_P99, HIST_P999, HIST_COUNT, HIST_NSTATS
+};
+static char *hist_stats[HIST_NSTATS] = {
+    "min", "max", "median", "average", "percentile90", "percentile95",
+    "percentile99", "percentile999", "count"
+};
+static char hist_names[MMV_HIST_BUCKETS][24];	/* bucket upper bounds */
+
 /* enforce reasonable limits for various data structures */
 #define MAX_MMV_ITEMS	((1<<10)-1)
 #define MAX_MMV_SERIAL	((1<<22)-1)
@@ -189,7 +227,9 @@ create_client_stat(agent_t *ap, const char *client, const char *path, size_t siz
 
 	    if (header.version != MMV_VERSION1 &&
 		header.version != MMV_VERSION2 &&
-		header.version != MMV_VERSION3) {
+		header.version != MMV_VERSION3 &&
+		header.version != MMV_VERSION4 &&
+		header.version != MMV_VERSION5) {
 		pmNotifyErr(LOG_ERR,
 		    "%s: %s version %d unsupported (current is %d)",
 		    ap->prefix, client, header.version, MMV_VERSION);
@@ -471,7 +511,7 @@ update_indom(pmdaExt *pmda, stats_t *s, __uint64_t offset, __uint32_t count,
 	    if (j == ip->it_numinst)
 		newinsts++;
 	}
-    } else if (s->version == MMV_VERSION2 || s->version == MMV_VERSION3) {
+    } else {
 	in2 = (mmv_disk_instance2_t *)((char *)s->addr + offset);
 	for (i = 0; i < count; i++) {
 	    for (j = 0; j < ip->it_numinst; j++) {
@@ -513,7 +553,7 @@ update_indom(pmdaExt *pmda, stats_t *s, __uint64_t offset, __uint32_t count,
 		ip->it_numinst++;
 	    }
 	}
-    } else if (s->version == MMV_VERSION2 || s->version == MMV_VERSION3) {
+    } else {
 	for (i = 0; i < count; i++) {
 	    for (j = 0; j < ip->it_numinst; j++)
 		if (ip->it_set[j].i_inst == in2[i].internal)
@@ -574,7 +614,7 @@ create_indom(pmdaExt *pmda, stats_t *s, __uint64_t offset, __uint32_t count,
 	    ip->it_set[i].i_inst = in1[i].internal;
 	    ip->it_set[i].i_name = in1[i].external;
 	}
-    } else if (s->version == MMV_VERSION2 || s->version == MMV_VERSION3) {
+    } else {
 	in2 = (mmv_disk_instance2_t *)((char *)s->addr + offset);
 	ip->it_numinst = count;
 	for (i = 0; i < count; i++) {
@@ -587,6 +627,257 @@ create_indom(pmdaExt *pmda, stats_t *s, __uint64_t offset, __uint32_t count,
     return 0;
 }
 
+/*
+ * Lowest and highest values counted in a histogram bucket
+ */
+static void
+hist_bucket_bounds(int index, __uint64_t *lo, __uint64_t *hi)
+{
+    int			shift;
+
+    if (index < (1 << MMV_HIST_SUBBITS)) {
+	*lo = *hi = index;
+	return;
+    }
+    shift = (index >> (MMV_HIST_SUBBITS - 1)) - 1;
+    *lo = (__uint64_t)(index - (shift << (MMV_HIST_SUBBITS - 1))) << shift;
+    *hi = *lo + (((__uint64_t)1 << shift) - 1);
+}
+
+static int
+create_histogram_indom(pmdaExt *pmda, int serial)
+{
+    agent_t		*ap = (agent_t *)pmdaExtGetData(pmda);
+    pmInDom		indom = pmInDom_build(pmda->e_domain, serial);
+    pmdaIndom		*ip;
+    __uint64_t		lo, hi;
+    int			i, count;
+
+    for (i = 0; i < ap->intot; i++)
+	if (ap->indoms[i].it_indom == indom)
+	    return 0;
+
+    count = (serial == HIST_BUCKET_INDOM) ? MMV_HIST_BUCKETS : HIST_NSTATS;
+    ip = realloc(ap->indoms, sizeof(pmdaIndom) * (ap->intot + 1));
+    if (ip == NULL) {
+	pmNotifyErr(LOG_ERR, "%s: realloc indom list failed", ap->prefix);
+	return -ENOMEM;
+    }
+    ap->indoms = ip;
+    ip = &ap->indoms[ap->intot];
+    if ((ip->it_set = (pmdaInstid *)calloc(count, sizeof(pmdaInstid))) == NULL) {
+	pmNotifyErr(LOG_ERR, "%s: histogram indom alloc inst list failed",
+			ap->prefix);
+	return -ENOMEM;
+    }
+    ip->it_indom = indom;
+    ip->it_numinst = count;
+    ap->intot++;
+
+    for (i = 0; i < count; i++) {
+	ip->it_set[i].i_inst = i;
+	if (serial == HIST_SUMMARY_INDOM) {
+	    ip->it_set[i].i_name = hist_stats[i];
+	} else {
+	    if (hist_names[i][0] == '\0') {
+		hist_bucket_bounds(i, &lo, &hi);
+		pmsprintf(hist_names[i], sizeof(hist_names[i]), "%"PRIu64, hi);
+	    }
+	    ip->it_set[i].i_name = hist_names[i];
+	}
+    }
+    return 0;
+}
+
+/*
+ * Export a histogram metric as <name>.bucket and <name>.summary, the
+ * latter using the item with the MMV_HIST_SUMMARY bit set.
+ */
+static int
+create_histogram(pmdaExt *pmda, stats_t *s, mmv_disk_metric2_t *ml, int k,
+	const char *name)
+{
+    agent_t		*ap = (agent_t *)pmdaExtGetData(pmda);
+    mmv_disk_metric2_t	*mp = &ml[k];
+    pmUnits		count = PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE);
+    char		buf[MAXPATHLEN];
+    pmID		pmid;
+    int			j, sts;
+
+    if (s->version < MMV_VERSION5 || (mp->item & MMV_HIST_SUMMARY) ||
+	(mp->indom != PM_INDOM_NULL && mp->indom != 0)) {
+	pmNotifyErr(LOG_ERR, "%s: %s: invalid histogram metric %s, ignored",
+			ap->prefix, s->name, name);
+	return -EINVAL;
+    }
+    for (j = 0; j < s->mcnt2; j++) {
+	if (ml[j].item == (mp->item | MMV_HIST_SUMMARY)) {
+	    pmNotifyErr(LOG_ERR, "%s: %s: histogram %s summary item %u in use,"
+			" ignored", ap->prefix, s->name, name, ml[j].item);
+	    return -EINVAL;
+	}
+    }
+    if ((sts = create_histogram_indom(pmda, HIST_BUCKET_INDOM)) < 0 ||
+	(sts = create_histogram_indom(pmda, HIST_SUMMARY_INDOM)) < 0)
+	return sts;
+
+    pmsprintf(buf, sizeof(buf), "%s.bucket", name);
+    pmid = pmID_build(pmda->e_domain, s->cluster, mp->item);
+    if ((sts = create_metric(pmda, s, buf, pmid, 0, MMV_TYPE_U64,
+				MMV_SEM_COUNTER, count)) < 0)
+	return sts;
+    ap->metrics[ap->mtot-1].m_desc.indom =
+		pmInDom_build(pmda->e_domain, HIST_BUCKET_INDOM);
+
+    pmsprintf(buf, sizeof(buf), "%s.summary", name);
+    pmid = pmID_build(pmda->e_domain, s->cluster, mp->item | MMV_HIST_SUMMARY);
+    if ((sts = create_metric(pmda, s, buf, pmid, 0, MMV_TYPE_DOUBLE,
+				MMV_SEM_INSTANT, mp->dimension)) < 0)
+	return sts;
+    ap->metrics[ap->mtot-1].m_desc.indom =
+		pmInDom_build(pmda->e_domain, HIST_SUMMARY_INDOM);
+    return 0;
+}
+
+static void
+free_index(agent_t *ap)
+{
+    __pmOAHashNode	*hp;
+    mmv_index_t		*ip, *next;
+
+    for (hp = __pmOAHashWalk(&ap->index, PM_HASH_WALK_START);
+	 hp != NULL;
+	 hp = __pmOAHashWalk(&ap->index, PM_HASH_WALK_NEXT)) {
+	for (ip = (mmv_index_t *)hp->data; ip != NULL; ip = next) {
+	    next = ip->next;
+	    __pmOAHashFree(&ip->insts);
+	    free(ip);
+	}
+    }
+    __pmOAHashFree(&ap->index);
+}
+
+static mmv_index_t *
+create_index(pmdaExt *pmda, stats_t *s, int item, int indom, int type,
+	__uint64_t shorttext, __uint64_t helptext)
+{
+    agent_t		*ap = (agent_t *)pmdaExtGetData(pmda);
+    __pmOAHashNode	*hp;
+    mmv_index_t		*ip, *tail;
+    pmID		pmid;
+
+    if (pmID_item(item) != item)
+	return NULL;
+    if ((ip = (mmv_index_t *)calloc(1, sizeof(mmv_index_t))) == NULL)
+	return NULL;
+    ip->stats = s;
+    ip->type = type;
+    ip->singular = (indom == PM_INDOM_NULL || indom == 0);
+    ip->shorttext = shorttext;
+    ip->helptext = helptext;
+
+    pmid = pmID_build(pmda->e_domain, s->cluster, item);
+    if ((hp = __pmOAHashSearch(pmid, &ap->index)) != NULL) {
+	for (tail = (mmv_index_t *)hp->data; tail->next; tail = tail->next)
+	    ;	/* keep stats file order for duplicate pmIDs */
+	tail->next = ip;
+    } else if (__pmOAHashAdd(pmid, ip, &ap->index) < 0) {
+	free(ip);
+	return NULL;
+    }
+    return ip;
+}
+
+/*
+ * Index the values of each metric in a stats file, by instance for
+ * metrics with an instance domain.  Values referring to anything but
+ * a metric descriptor, or to instances outside the file, are skipped.
+ */
+static void
+index_stats(pmdaExt *pmda, stats_t *s)
+{
+    agent_t		*ap = (agent_t *)pmdaExtGetData(pmda);
+    mmv_index_t		**metrics, *summary;
+    mmv_index_t		*ip;
+    __uint64_t		base, offset, size, isize;
+    int			i, mi, count;
+
+    if (s->version == MMV_VERSION1) {
+	count = s->mcnt1;
+	base = (char *)s->metrics1 - (char *)s->addr;
+	size = sizeof(mmv_disk_metric_t);
+	isize = sizeof(mmv_disk_instance_t);
+    } else {
+	count = s->mcnt2;
+	base = (char *)s->metrics2 - (char *)s->addr;
+	size = sizeof(mmv_disk_metric2_t);
+	isize = sizeof(mmv_disk_instance2_t);
+    }
+    if (count <= 0 || s->vcnt <= 0)
+	return;
+    if ((metrics = (mmv_index_t **)calloc(count, sizeof(*metrics))) == NULL) {
+	pmNotifyErr(LOG_ERR, "%s: %s: cannot index %d metrics",
+			ap->prefix, s->name, count);
+	return;
+    }
+
+    __pmOAHashPreAlloc(ap->index.nodes + count, &ap->index);
+    for (mi = 0; mi < count; mi++) {
+	if (s->version == MMV_VERSION1) {
+	    mmv_disk_metric_t *mp = &s->metrics1[mi];
+	    metrics[mi] = create_index(pmda, s, mp->item, mp->indom,
+				mp->type, mp->shorttext, mp->helptext);
+	} else {
+	    mmv_disk_metric2_t *mp = &s->metrics2[mi];
+	    metrics[mi] = create_index(pmda, s, mp->item, mp->indom,
+				mp->type, mp->shorttext, mp->helptext);
+	}
+    }
+    for (i = 0; i < s->vcnt; i++) {
+	mmv_disk_value_t *v = &s->values[i];
+	unsigned int inst;
+
+	offset = v->metric;
+	if (offset < base || (offset - base) % size != 0 ||
+	    (offset - base) / size >= count)
+	    continue;
+	mi = (offset - base) / size;
+	if ((ip = metrics[mi]) == NULL)
+	    continue;
+	if (ip->first == NULL)
+	    ip->first = v;
+	if (ip->singular)
+	    continue;
+
+	offset = v->instance;
+	if (offset + isize > (__uint64_t)s->len || offset + isize < offset)
+	    continue;
+	if (s->version == MMV_VERSION1)
+	    inst = ((mmv_disk_instance_t *)((char *)s->addr + offset))->internal;
+	else
+	    inst = ((mmv_disk_instance2_t *)((char *)s->addr + offset))->internal;
+	/* as for a linear search, the first value for an instance wins */
+	__pmOAHashAdd(inst, v, &ip->insts);
+    }
+
+    /*
+     * Histogram summaries share the value of the histogram, indexed
+     * after all other metrics so any (invalid) item clash resolves to
+     * the regular metric, as for the exported names.
+     */
+    for (mi = 0; s->version >= MMV_VERSION5 && mi < count; mi++) {
+	mmv_disk_metric2_t *mp = &s->metrics2[mi];
+
+	if (mp->type != MMV_TYPE_HISTOGRAM || (ip = metrics[mi]) == NULL)
+	    continue;
+	summary = create_index(pmda, s, mp->item | MMV_HIST_SUMMARY, mp->indom,
+				mp->type, mp->shorttext, mp->helptext);
+	if (summary != NULL)
+	    summary->first = ip->first;
+    }
+    free(metrics);
+}
+
 static void
 map_stats(pmdaExt *pmda)
 {
@@ -632,6 +923,7 @@ map_stats(pmdaExt *pmda)
 	ap->intot = 0;
     }
 
+    free_index(ap);
     if (ap->slist != NULL) {
 	for (i = 0; i < ap->scnt; i++) {
 	    free(ap->slist[i].name);
@@ -721,7 +1013,7 @@ map_stats(pmdaExt *pmda)
 					mp->type, mp->semantics, mp->dimension);
 		    }
 		}
-		else if (s->version == MMV_VERSION2 || s->version == MMV_VERSION3) {
+		else {
 		    mmv_disk_metric2_t *ml = (mmv_disk_metric2_t *)
 					((char *)s->addr + offset);
 
@@ -770,6 +1062,10 @@ map_stats(pmdaExt *pmda)
 			if (verify_metric_item2(ml, k, path, s) != 0)
 			    continue;
 
+			if (mp->type == MMV_TYPE_HISTOGRAM) {
+			    create_histogram(pmda, s, ml, k, path);
+			    continue;
+			}
 			pmid = pmID_build(pmda->e_domain, s->cluster, mp->item);
 			create_metric(pmda, s, path, pmid, mp->indom,
 					mp->type, mp->semantics, mp->dimension);
@@ -852,6 +1148,17 @@ map_stats(pmdaExt *pmda)
 	    case MMV_TOC_INSTANCES:
 	    case MMV_TOC_STRINGS:
 		break;
+
+	    case MMV_TOC_HISTOGRAMS:	/* value offsets checked on fetch */
+		if (s->version < MMV_VERSION5)
+		    continue;
+		offset += (count * sizeof(mmv_disk_histogram_t));
+		if (s->len < offset) {
+		    pmNotifyErr(LOG_ERR, "%s: %s:"
+				    " histograms offset: %"PRIu64" < %"PRIu64,
+				    ap->prefix, s->name, s->len, offset);
+		}
+		break;
 		
 	    case MMV_TOC_LABELS:
 	        if (count > MAX_MMV_LABELS) {
@@ -881,12 +1188,35 @@ map_stats(pmdaExt *pmda)
 		s->lcnt = count;
 	    	break;
 
+	    case MMV_TOC_SHARDS:
+		if (s->version < MMV_VERSION4)
+		    continue;
+		s->shcnt = count;
+		s->shards = (char *)s->addr + offset;
+		break;
+
 	    default:
 		pmNotifyErr(LOG_ERR, "%s: %s: bad TOC type (%x)",
 				    ap->prefix, s->name, type);
 		break;
 	    }
 	}
+
+	/* shards hold an entry for every value, so check them last */
+	if (s->shcnt > 0) {
+	    __uint64_t offset = (s->shards - (char *)s->addr) +
+				s->shcnt * MMV_SHARD_STRIDE(s->vcnt);
+
+	    if (s->len < offset) {
+		pmNotifyErr(LOG_ERR, "%s: %s:"
+				" shards offset: %"PRIu64" < %"PRIu64,
+				ap->prefix, s->name, s->len, offset);
+		s->shards = NULL;
+		s->shcnt = 0;
+	    }
+	}
+
+	index_stats(pmda, s);
     }
 
     pmdaTreeRebuildHash(ap->pmns, ap->mtot); /* for reverse (pmid->name) lookups */
@@ -894,106 +1224,179 @@ map_stats(pmdaExt *pmda)
 }
 
 static int
-mmv_lookup_item1(int item, unsigned int inst,
-	stats_t *s, mmv_disk_value_t **value,
+mmv_lookup_stat_metric(agent_t *agent, pmID pmid, unsigned int inst,
+	stats_t **stats, mmv_disk_value_t **value,
 	__uint64_t *shorttext, __uint64_t *helptext)
 {
-    mmv_disk_metric_t	*m1 = s->metrics1;
-    mmv_disk_value_t	*v = s->values;
-    int			mi, vi, sts = PM_ERR_PMID;
+    __pmOAHashNode	*hp;
+    mmv_disk_value_t	*v;
+    mmv_index_t		*ip;
+    int			sts = PM_ERR_PMID;
 
-    for (mi = 0; mi < s->mcnt1; mi++) {
-	if (m1[mi].item != item)
-	    continue;
+    if ((hp = __pmOAHashSearch(pmid, &agent->index)) == NULL)
+	return sts;
 
-	sts = PM_ERR_INST;
-	for (vi = 0; vi < s->vcnt; vi++) {
-	    mmv_disk_metric_t *mt = (mmv_disk_metric_t *)
-			((char *)s->addr + v[vi].metric);
-	    mmv_disk_instance_t *is = (mmv_disk_instance_t *)
-			((char *)s->addr + v[vi].instance);
-
-	    if ((mt == &m1[mi]) &&
-		(mt->indom == PM_INDOM_NULL || mt->indom == 0 ||
-		inst == PM_IN_NULL || is->internal == inst)) {
-		if (shorttext)
-		    *shorttext = m1[mi].shorttext;
-		if (helptext)
-		    *helptext = m1[mi].helptext;
-		*value = &v[vi];
-		return m1[mi].type;
-	    }
+    for (ip = (mmv_index_t *)hp->data; ip != NULL; ip = ip->next) {
+	if (ip->singular || inst == PM_IN_NULL)
+	    v = ip->first;
+	else if ((hp = __pmOAHashSearch(inst, &ip->insts)) != NULL)
+	    v = (mmv_disk_value_t *)hp->data;
+	else
+	    v = NULL;
+	if (v == NULL) {
+	    sts = PM_ERR_INST;
+	    continue;
+	}
+	if (ip->type == MMV_TYPE_NOSUPPORT) {
+	    sts = PM_ERR_APPVERSION;
+	    continue;
 	}
+	if (shorttext)
+	    *shorttext = ip->shorttext;
+	if (helptext)
+	    *helptext = ip->helptext;
+	*stats = ip->stats;
+	*value = v;
+	return ip->type;
     }
     return sts;
 }
 
 static int
-mmv_lookup_item2(int item, unsigned int inst,
-	stats_t *s, mmv_disk_value_t **value,
-	__uint64_t *shorttext, __uint64_t *helptext)
+mmv_lookup_stat_metric_value(agent_t *agent, pmID pmid, unsigned int inst,
+	stats_t **stats, mmv_disk_value_t **value)
 {
-    mmv_disk_metric2_t	*m2 = s->metrics2;
-    mmv_disk_value_t	*v = s->values;
-    int			mi, vi, sts = PM_ERR_PMID;
+    return mmv_lookup_stat_metric(agent, pmid, inst, stats, value, NULL, NULL);
+}
 
-    for (mi = 0; mi < s->mcnt2; mi++) {
-	if (m2[mi].item != item)
-	    continue;
+/*
+ * Add the per-CPU shard entries (v4) of a value to the fetched value
+ */
+static void
+mmv_sum_shards(stats_t *s, mmv_disk_value_t *v, int type, pmAtomValue *atom)
+{
+    pmAtomValue		*shard;
+    __uint64_t		stride = MMV_SHARD_STRIDE(s->vcnt);
+    char		*entry;
+    int			i;
 
-	sts = PM_ERR_INST;
-	for (vi = 0; vi < s->vcnt; vi++) {
-	    mmv_disk_metric2_t *mt = (mmv_disk_metric2_t *)
-			((char *)s->addr + v[vi].metric);
-	    mmv_disk_instance2_t *is = (mmv_disk_instance2_t *)
-			((char *)s->addr + v[vi].instance);
-
-	    if ((mt == &m2[mi]) &&
-		(mt->indom == PM_INDOM_NULL || mt->indom == 0 ||
-		inst == PM_IN_NULL || is->internal == inst)) {
-		if (shorttext)
-		    *shorttext = m2[mi].shorttext;
-		if (helptext)
-		    *helptext = m2[mi].helptext;
-		*value = &v[vi];
-		return m2[mi].type;
-	    }
+    entry = s->shards + (v - s->values) * sizeof(pmAtomValue);
+    for (i = 0; i < s->shcnt; i++, entry += stride) {
+	shard = (pmAtomValue *)entry;
+	switch (type) {
+	    case MMV_TYPE_I32:
+		atom->l += shard->l;
+		break;
+	    case MMV_TYPE_U32:
+		atom->ul += shard->ul;
+		break;
+	    case MMV_TYPE_I64:
+		atom->ll += shard->ll;
+		break;
+	    case MMV_TYPE_U64:
+		atom->ull += shard->ull;
+		break;
+	    case MMV_TYPE_FLOAT:
+		atom->f += shard->f;
+		break;
+	    case MMV_TYPE_DOUBLE:
+		atom->d += shard->d;
+		break;
 	}
     }
-    return sts;
 }
 
-static int
-mmv_lookup_stat_metric(agent_t *agent, pmID pmid, unsigned int inst,
-	stats_t **stats, mmv_disk_value_t **value,
-	__uint64_t *shorttext, __uint64_t *helptext)
+/*
+ * Estimate the q quantile of a histogram from the midpoint of the
+ * bucket holding it, within the exact minimum and maximum values.
+ */
+static double
+mmv_hist_quantile(mmv_disk_histogram_t *hp, __uint64_t total, double q)
 {
-    int			si, sts = PM_ERR_PMID;
-
-    for (si = 0; si < agent->scnt; si++) {
-	stats_t *s = &agent->slist[si];
-
-	if (s->cluster != pmID_cluster(pmid))
-	    continue;
+    __uint64_t		rank, sum = 0, lo, hi;
+    double		value;
+    int			i;
 
-	sts = (s->version == MMV_VERSION1) ?
-	    mmv_lookup_item1(pmID_item(pmid), inst, s, value, shorttext, helptext):
-	    mmv_lookup_item2(pmID_item(pmid), inst, s, value, shorttext, helptext);
-	if (sts == MMV_TYPE_NOSUPPORT)
-	    sts = PM_ERR_APPVERSION;
-	if (sts >= 0) {
-	    *stats = s;
+    if ((rank = (__uint64_t)ceil(q * total)) < 1)
+	rank = 1;
+    for (i = 0; i < MMV_HIST_BUCKETS - 1; i++) {
+	if ((sum += hp->buckets[i]) >= rank)
 	    break;
-	}
     }
-    return sts;
+    hist_bucket_bounds(i, &lo, &hi);
+    value = (double)lo + (double)(hi - lo) / 2.0;
+    if (value < (double)hp->min)
+	value = (double)hp->min;
+    if (value > (double)hp->max)
+	value = (double)hp->max;
+    return value;
 }
 
 static int
-mmv_lookup_stat_metric_value(agent_t *agent, pmID pmid, unsigned int inst,
-	stats_t **stats, mmv_disk_value_t **value)
+mmv_fetch_histogram(agent_t *ap, stats_t *s, mmv_disk_value_t *v,
+	pmID pmid, unsigned int inst, pmAtomValue *atom)
 {
-    return mmv_lookup_stat_metric(agent, pmid, inst, stats, value, NULL, NULL);
+    mmv_disk_histogram_t *hp;
+    __uint64_t		offset = v->extra, total = 0;
+    int			i;
+
+    if (s->len < offset + sizeof(mmv_disk_histogram_t) ||
+	offset + sizeof(mmv_disk_histogram_t) < offset) {
+	pmNotifyErr(LOG_ERR, "%s: %s:"
+		" bad histogram value offset: %"PRIu64" < %"PRIu64,
+		ap->prefix, s->name, s->len,
+		offset + sizeof(mmv_disk_histogram_t));
+	return PM_ERR_GENERIC;
+    }
+    hp = (mmv_disk_histogram_t *)((char *)s->addr + offset);
+
+    if (!(pmID_item(pmid) & MMV_HIST_SUMMARY)) {
+	if (inst >= MMV_HIST_BUCKETS)
+	    return PM_ERR_INST;
+	if ((atom->ull = hp->buckets[inst]) == 0)
+	    return PMDA_FETCH_NOVALUES;
+	return PMDA_FETCH_STATIC;
+    }
+
+    if (inst >= HIST_NSTATS)
+	return PM_ERR_INST;
+    /* the header is updated after the buckets, so use the bucket total */
+    for (i = 0; i < MMV_HIST_BUCKETS; i++)
+	total += hp->buckets[i];
+    if (inst == HIST_COUNT) {
+	atom->d = (double)total;
+	return PMDA_FETCH_STATIC;
+    }
+    if (total == 0 || hp->count == 0)
+	return PMDA_FETCH_NOVALUES;
+
+    switch (inst) {
+	case HIST_MIN:
+	    atom->d = (double)hp->min;
+	    break;
+	case HIST_MAX:
+	    atom->d = (double)hp->max;
+	    break;
+	case HIST_AVERAGE:
+	    atom->d = (double)hp->sum / (double)hp->count;
+	    break;
+	case HIST_MEDIAN:
+	    atom->d = mmv_hist_quantile(hp, total, 0.5);
+	    break;
+	case HIST_P90:
+	    atom->d = mmv_hist_quantile(hp, total, 0.9);
+	    break;
+	case HIST_P95:
+	    atom->d = mmv_hist_quantile(hp, total, 0.95);
+	    break;
+	case HIST_P99:
+	    atom->d = mmv_hist_quantile(hp, total, 0.99);
+	    break;
+	case HIST_P999:
+	    atom->d = mmv_hist_quantile(hp, total, 0.999);
+	    break;
+    }
+    return PMDA_FETCH_STATIC;
 }
 
 /*
@@ -1048,16 +1451,22 @@ mmv_fetchCallBack(pmdaMetric *mdesc, unsigned int inst, pmAtomValue *atom)
 		if ((flags & MMV_FLAG_SENTINEL) &&
 		    (memcmp(atom, &aNaN, sizeof(*atom)) == 0))
 		    return PMDA_FETCH_NOVALUES;
+		if (s->shcnt > 0)
+		    mmv_sum_shards(s, v, sts, atom);
 		break;
 	    case MMV_TYPE_FLOAT:
 		memcpy(atom, &v->value, sizeof(pmAtomValue));
 		if ((flags & MMV_FLAG_SENTINEL) && isnan(atom->f))
 		    return PMDA_FETCH_NOVALUES;
+		if (s->shcnt > 0)
+		    mmv_sum_shards(s, v, sts, atom);
 		break;
 	    case MMV_TYPE_DOUBLE:
 		memcpy(atom, &v->value, sizeof(pmAtomValue));
 		if ((flags & MMV_FLAG_SENTINEL) && isnan(atom->d))
 		    return PMDA_FETCH_NOVALUES;
+		if (s->shcnt > 0)
+		    mmv_sum_shards(s, v, sts, atom);
 		break;
 	    case MMV_TYPE_ELAPSED: {
 		atom->ll = v->value.ll;
@@ -1088,6 +1497,8 @@ mmv_fetchCallBack(pmdaMetric *mdesc, unsigned int inst, pmAtomValue *atom)
 		atom->cp = ap->buffer;
 		break;
 	    }
+	    case MMV_TYPE_HISTOGRAM:
+		return mmv_fetch_histogram(ap, s, v, pmid, inst, atom);
 	}
 	return PMDA_FETCH_STATIC;
     }
@@ -97,6 +97,12 @@ static pmDesc	desctab[] = {
     { PMDA_PMID(0,29), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
 /* control.creds_timeout */
     { PMDA_PMID(0,30), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,1,0,0,PM_TIME_SEC,0) },
+/* buf.hits */
+    { PMDA_PMID(0,31), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* buf.misses */
+    { PMDA_PMID(0,32), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* buf.bytes */
+    { PMDA_PMID(0,33), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(1,0,0,PM_SPACE_BYTE,0,0) },
 
 /* pdu_in.error */
     { PMDA_PMID(1,0), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
@@ -1356,6 +1362,7 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
     pmDesc		*dp = NULL;	/* initialize to pander to gcc */
     pmAtomValue		atom;
     __pmLogPort		*lpp;
+    __pmPDUBufStats	bufstats;
 
     if (numpmid > maxnpmids) {
 	if (res != NULL)
@@ -1587,6 +1594,21 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 				atom.ul = creds_timeout;
 				break;
 
+			case 31:	/* buf.hits */
+				__pmGetPDUBufStats(&bufstats);
+				atom.ull = bufstats.hits;
+				break;
+
+			case 32:	/* buf.misses */
+				__pmGetPDUBufStats(&bufstats);
+				atom.ull = bufstats.misses;
+				break;
+
+			case 33:	/* buf.bytes */
+				__pmGetPDUBufStats(&bufstats);
+				atom.ull = bufstats.bytes;
+				break;
+
 			default:
 				sts = atom.l = PM_ERR_PMID;
 				break;
@@ -49,7 +49,8 @@ static pmdaOptions opts = {
 };
 
 /*
- * simulate PMDA busy (not responding to PDUs)
+ * simulate PMDA busy (not responding to PDUs), or for the DSO
+ * (there are no PDUs) simulate a callback that takes a long time
  */
 int
 limbo(void)
@@ -58,6 +59,13 @@ limbo(void)
 
     delay.tv_sec = not_ready / 1000;
     delay.tv_usec = (not_ready % 1000) * 1000;
+    if (_isDSO) {
+	pmNotifyErr(LOG_INFO, "Stalling DSO for %ld.%06ldsec", (long)delay.tv_sec, (long)delay.tv_usec);
+	__pmtimevalSleep(delay);
+	pmNotifyErr(LOG_INFO, "DSO stall over");
+	not_ready = 0;
+	return PM_ERR_AGAIN;
+    }
     pmNotifyErr(LOG_INFO, "Going NOTREADY for %ld.%06ldsec", (long)delay.tv_sec, (long)delay.tv_usec);
     __pmSendError(dispatch.version.two.ext->e_outfd, FROM_ANON, PM_ERR_PMDANOTREADY);
     __pmtimevalSleep(delay);
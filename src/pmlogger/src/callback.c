@@ -314,23 +314,8 @@ check_inst(pmValueSet *vsp, int hint, __pmResult *lrp)
     return 0;
 }
 
-/* Return 1 (true) if the sets are the same, 0 (false) otherwise */
 static int
-samelabels(int na, const pmLabelSet *a, int nb, const pmLabelSet *b)
-{
-    int	i;
-
-    if (na != nb)
-	return 0;
-    for (i = 0; i < na; i++) {
-	if (!__pmEqualLabelSet(&a[i], &b[i]))            
-	    break;
-    }
-    return i == na;
-}
-
-static int
-putlabels(unsigned int type, unsigned int ident, const __pmTimestamp *tsp, int np, pmLabelSet *prior)
+putlabels(unsigned int type, unsigned int ident, const __pmTimestamp *tsp)
 {
     int		len, sts;
     pmLabelSet	*label;
@@ -345,14 +330,6 @@ putlabels(unsigned int type, unsigned int ident, const __pmTimestamp *tsp, int n
 	len = pmGetInDomLabels(ident, &label);
     else if (type == PM_LABEL_ITEM)
 	len = pmGetItemLabels(ident, &label);
-    else if (type == PM_LABEL_INSTANCES) {
-	len = pmGetInstancesLabels(ident, &label);
-	/* do not log exactly the same instance sets as previously written */
-	if (len > 0 && np > 0 && samelabels(np, prior, len, label)) {
-	    pmFreeLabelSets(label, len);
-	    return 0;
-	}
-    }
     else
 	len = 0;
 
@@ -369,8 +346,44 @@ putlabels(unsigned int type, unsigned int ident, const __pmTimestamp *tsp, int n
     return sts;
 }
 
+/*
+ * Instance labels are cached by (indom, instance), so when an instance
+ * domain changes only the labels of new instances are requested, and
+ * the instance labelsets are logged again only if the cache changed.
+ */
+static __pmLabelCache	labelcache;
+
 static int
-manageLabels(pmDesc *desc, const __pmTimestamp *tsp, int only_instances)
+putinstlabels(pmInDom indom, const __pmTimestamp *tsp, int numinst, int *instlist)
+{
+    int		len, sts, prior;
+    pmLabelSet	*label;
+
+    prior = __pmLabelCacheGeneration(&labelcache, indom);
+    if ((sts = __pmLabelCacheUpdate(&labelcache, indom, numinst, instlist)) < 0)
+	return 0;
+    /* do not log exactly the same instance sets as previously written */
+    if (sts == prior &&
+	__pmLogLookupLabel(&archctl, PM_LABEL_INSTANCES, indom, &label, tsp) >= 0)
+	return 0;
+
+    if ((len = __pmLabelCacheGetSets(&labelcache, indom, &label)) <= 0)
+	return 0;
+
+    if ((sts = __pmLogPutLabels(&archctl, PM_LABEL_INSTANCES, indom, len, label, tsp)) < 0)
+	/* on success, labels are stashed by __pmLogPutLabels() */
+	pmFreeLabelSets(label, len);
+
+    return sts;
+}
+
+/*
+ * For a changed instance domain (only_instances), numinst and instlist
+ * give the current instances, else numinst is -1.
+ */
+static int
+manageLabels(pmDesc *desc, const __pmTimestamp *tsp, int only_instances,
+		int numinst, int *instlist)
 {
     int		i = 0;
     int		sts = 0;
@@ -414,10 +427,14 @@ manageLabels(pmDesc *desc, const __pmTimestamp *tsp, int only_instances)
 	 * (as we must log label metadata in that special case) - unless
 	 * the labelsets are all exactly the same as those already logged.
 	 */
-	if ((sts = __pmLogLookupLabel(&archctl, type, ident, &label, tsp)) >= 0
-	    && !only_instances)
+	if (!only_instances &&
+	    __pmLogLookupLabel(&archctl, type, ident, &label, tsp) >= 0)
 	    continue;
-	if ((sts = putlabels(type, ident, tsp, sts, label)) < 0)
+	if (type == PM_LABEL_INSTANCES)
+	    sts = putinstlabels(ident, tsp, numinst, instlist);
+	else
+	    sts = putlabels(type, ident, tsp);
+	if (sts < 0)
 	    break;
     }
     return sts;
@@ -792,7 +809,12 @@ do_work(task_t *tp)
 	    /*
 	     * Change to the context labels associated with logged host
 	     */
-	    putlabels(PM_LABEL_CONTEXT, PM_IN_NULL, &resp->timestamp, 0, NULL);
+	    putlabels(PM_LABEL_CONTEXT, PM_IN_NULL, &resp->timestamp);
+	    /*
+	     * ... and any cached instance labels may now be stale, so
+	     * the next change to each instance domain fetches them all
+	     */
+	    __pmLabelCacheFree(&labelcache);
 	}
 
 	needti = 0;
@@ -831,7 +853,7 @@ do_work(task_t *tp)
 		    /* derived metric, restore cluster field ... */
 		    desc.pmid = CLEAR_DERIVED_LOGGED(desc.pmid);
 		free(names);
-		manageLabels(&desc, &resp->timestamp, 0);
+		manageLabels(&desc, &resp->timestamp, 0, -1, NULL);
 		manageText(&desc);
 	    }
 	    if (desc.type == PM_TYPE_EVENT) {
@@ -973,6 +995,7 @@ do_work(task_t *tp)
 			    fprintf(stderr, "__pmLogPutInDom(%s): full: %s\n", pmInDomStr(desc.indom), pmErrStr(sts));
 			    exit(1);
 			}
+			manageLabels(&desc, &new.stamp, 1, new.numinst, new.instlist);
 			if (sts == PMLOGPUTINDOM_DUP) {
 			    if (pmDebugOptions.logmeta && pmDebugOptions.desperate) {
 				fprintf(stderr, "__pmLogPutInDom -> PMLOGPUTINDOM_DUP\n");
@@ -980,7 +1003,6 @@ do_work(task_t *tp)
 			    free(new.instlist);
 			    free(new.namelist);
 			}
-			manageLabels(&desc, &new.stamp, 1);
 			needti = 1;
 		    }
 		    else if (needindom == 2) {
@@ -1004,7 +1026,7 @@ do_work(task_t *tp)
 			}
 			free(new_delta.instlist);
 			free(new_delta.namelist);
-			manageLabels(&desc, &new_delta.stamp, 1);
+			manageLabels(&desc, &new_delta.stamp, 1, new.numinst, new.instlist);
 			needti = 1;
 		    }
 		    else {
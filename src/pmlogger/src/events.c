@@ -21,8 +21,8 @@
 /*
  * Handle event records.
  *
- * Walk the packed array of events using similar logic to
- * pmUnpackEventRecords() but we don't need any allocations.
+ * Walk the packed array of events in place with pmEventIter, so
+ * no allocations are needed.
  *
  * For each embedded event parameter, make sure the metadata for
  * the associated metric is added to the archive.
@@ -30,43 +30,26 @@
 int
 do_events(pmValueSet *vsp)
 {
-    pmEventArray	*eap;
-    char		*base;
-    pmEventRecord	*erp;
-    pmEventParameter	*epp;
-    int			r;	/* records */
-    int			p;	/* parameters in a record ... */
+    pmEventIter		iter;
+    pmEventParam	param;
     int			i;	/* instances ... */
     int			sts;
     pmDesc		desc;
 
     for (i = 0; i < vsp->numval; i++) {
-	if ((sts = __pmCheckEventRecords(vsp, i)) < 0) {
-	    __pmDumpEventRecords(stderr, vsp, i);
+	if ((sts = pmEventIterInit(&iter, vsp, i)) < 0)
 	    return sts;
-	}
-	eap = (pmEventArray *)vsp->vlist[i].value.pval;
-	if (eap->ea_nrecords == 0)
-	    return 0;
-	base = (char *)&eap->ea_record[0];
-	for (r = 0; r < eap->ea_nrecords; r++) {
-	    erp = (pmEventRecord *)base;
-	    base += sizeof(erp->er_timestamp) + sizeof(erp->er_flags) + sizeof(erp->er_nparams);
-	    if (erp->er_flags & PM_EVENT_FLAG_MISSED) {
-		/*
-		 * no event "parameters" here, just a missed records count
-		 * in er_nparams
-		 */
-		continue;
-	    }
-	    for (p = 0; p < erp->er_nparams; p++) {
-		epp = (pmEventParameter *)base;
-		base += sizeof(epp->ep_pmid) + PM_PDU_SIZE_BYTES(epp->ep_len);
-		sts = __pmLogLookupDesc(&archctl, epp->ep_pmid, &desc);
+	while (pmEventIterNextRecord(&iter)) {
+	    /*
+	     * PM_EVENT_FLAG_MISSED records have no event "parameters",
+	     * just a missed records count
+	     */
+	    while (pmEventIterNextParam(&iter, &param)) {
+		sts = __pmLogLookupDesc(&archctl, param.pmid, &desc);
 		if (sts < 0) {
 		    int	numnames;
 		    char	**names;
-		    numnames = pmNameAll(epp->ep_pmid, &names);
+		    numnames = pmNameAll(param.pmid, &names);
 		    if (numnames < 0) {
 			/*
 			 * Event parameter metric not defined in the PMNS.
@@ -81,10 +64,10 @@ do_events(pmValueSet *vsp)
 			    return -oserror();
 			name = (char *)&names[1];
 			names[0] = name;
-			pmsprintf(name, name_size, "event_param.%s", pmIDStr(epp->ep_pmid));
-			fprintf(stderr, "Warning: metric %s has no name, using %s\n", pmIDStr(epp->ep_pmid), name);
+			pmsprintf(name, name_size, "event_param.%s", pmIDStr(param.pmid));
+			fprintf(stderr, "Warning: metric %s has no name, using %s\n", pmIDStr(param.pmid), name);
 		    }
-		    sts = pmLookupDesc(epp->ep_pmid, &desc);
+		    sts = pmLookupDesc(param.pmid, &desc);
 		    if (sts < 0) {
 			/* Event parameter metric does not have a pmDesc.
 			 * This should not happen, but is probably not entirely
@@ -92,12 +75,12 @@ do_events(pmValueSet *vsp)
 			 * name), issue a warning and construct a minimalist
 			 * pmDesc
 			 */
-			desc.pmid = epp->ep_pmid;
+			desc.pmid = param.pmid;
 			desc.type = PM_TYPE_AGGREGATE;
 			desc.indom = PM_INDOM_NULL;
 			desc.sem = PM_SEM_DISCRETE;
 			memset(&desc.units, '\0', sizeof(desc.units));
-			fprintf(stderr, "Warning: metric %s (%s) has no descriptor, using a default one\n", names[0], pmIDStr(epp->ep_pmid));
+			fprintf(stderr, "Warning: metric %s (%s) has no descriptor, using a default one\n", names[0], pmIDStr(param.pmid));
 		    }
 		    if ((sts = __pmLogPutDesc(&archctl, &desc, numnames, names)) < 0) {
 			fprintf(stderr, "__pmLogPutDesc: %s\n", pmErrStr(sts));
@@ -66,6 +66,7 @@ char		*last_timezone = NULL;	/* local timezone & offset ([+-]hhmm) */
 int		pmlc_ipc_version = LOG_PDU_VERSION;
 int		rflag;			/* report sizes */
 int		Cflag;			/* parse config and exit */
+static int	iflag;			/* write dense temporal index */
 __pmTimestamp	epoch;
 struct timeval	delta = { 60, 0 };	/* default logging interval */
 int		sig_code;		/* caught signal */
@@ -463,6 +464,7 @@ static pmLongOptions longopts[] = {
     PMOPT_DEBUG,
     PMOPT_HOST,
     { "labelhost", 1, 'H', "LABELHOST", "override the hostname written into the label" },
+    { "dense-index", 0, 'i', 0, "also write a dense temporal index for fast seeking" },
     { "pmlc-ipc-version", 1, 'I', "VERSION", "set IPC version for pmlc port [defaily LOG_PDU_VERSION]" },
     { "log", 1, 'l', "FILE", "redirect diagnostics and trace output" },
     { "linger", 0, 'L', 0, "run even if not primary logger instance and nothing to log" },
@@ -488,7 +490,7 @@ static pmLongOptions longopts[] = {
 };
 
 static pmOptions opts = {
-    .short_options = "c:Cd:D:h:H:I:l:K:Lm:Nn:op:Prs:T:t:uU:v:V:x:y?",
+    .short_options = "c:Cd:D:h:H:iI:l:K:Lm:Nn:op:Prs:T:t:uU:v:V:x:y?",
     .long_options = longopts,
     .short_usage = "[options] archive",
 };
@@ -920,6 +922,10 @@ main(int argc, char **argv)
 	    pmcd_host_label = strndup(opts.optarg, PM_LOG_MAXHOSTLEN-1);
 	    break;
 
+	case 'i':		/* dense temporal index */
+	    iflag = 1;
+	    break;
+
 	case 'I':
 	    pmlc_ipc_version = (int)strtol(opts.optarg, &endnum, 10);
 	    if (*endnum != '\0') {
@@ -1417,6 +1423,9 @@ main(int argc, char **argv)
 	fprintf(stderr, "__pmLogCreate(%s, %s, ...): %s\n", pmcd_host, archName, pmErrStr(sts));
 	exit(1);
     }
+    /* not fatal, pmlogindex(1) can build the dense index later */
+    if (iflag)
+	__pmLogTIdxCreate(&archctl, archName);
 
     /*
      * Get FQDN of host where pmlogger is running ... do this before
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Build (or rebuild) the dense temporal index for a PCP archive,
+ * see __pmLogTIdxBuild() in libpcp.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+
+static pmLongOptions longopts[] = {
+    PMAPI_OPTIONS_HEADER("Options"),
+    PMOPT_DEBUG,
+    { "dump", 0, 'd', 0, "report the dense index entries after building" },
+    { "metric", 1, 'm', "metric", "report the records containing metric" },
+    PMOPT_HELP,
+    PMAPI_OPTIONS_END
+};
+
+static pmOptions opts = {
+    .short_options = "dD:m:?",
+    .long_options = longopts,
+    .short_usage = "[options] archive",
+};
+
+static void
+dump(__pmLogCtl *lcp, int dflag, pmID pmid)
+{
+    __pmLogTIdxEntry	ent;
+    int			i, n;
+
+    n = __pmLogTIdxCount(lcp);
+    printf("Dense temporal index: %d entries\n", n);
+    if (dflag) {
+	for (i = 0; i < n; i++) {
+	    __pmLogTIdxGet(lcp, i, &ent);
+	    printf("[%d] ", i);
+	    __pmPrintTimestamp(stdout, &ent.stamp);
+	    printf(" vol %d offset %lld\n", ent.vol, (long long)ent.off);
+	}
+    }
+    if (pmid != PM_ID_NULL) {
+	printf("Records containing %s:", pmIDStr(pmid));
+	for (i = 0; ; i++) {
+	    if ((i = __pmLogTIdxFindPMID(lcp, pmid, i, PM_MODE_FORW)) < 0)
+		break;
+	    printf(" %d", i);
+	}
+	putchar('\n');
+    }
+}
+
+/*
+ * metric name (from the archive's PMNS) or dotted PMID
+ */
+static pmID
+lookup(const char *metric)
+{
+    unsigned int	domain, cluster, item;
+    pmID		pmid;
+    char		tail;
+
+    if (pmLookupName(1, &metric, &pmid) == 1)
+	return pmid;
+    if (sscanf(metric, "%u.%u.%u%c", &domain, &cluster, &item, &tail) == 3)
+	return pmID_build(domain, cluster, item);
+    fprintf(stderr, "%s: unknown metric \"%s\"\n", pmGetProgname(), metric);
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    int		sts;
+    int		ctx;
+    int		dflag = 0;
+    char	*metric = NULL;
+    char	*archive;
+    pmID	pmid = PM_ID_NULL;
+    __pmContext	*ctxp;
+
+    while ((c = pmGetOptions(argc, argv, &opts)) != EOF) {
+	switch (c) {
+	case 'd':
+	    dflag = 1;
+	    break;
+	case 'm':
+	    metric = opts.optarg;
+	    break;
+	}
+    }
+    if (opts.errors || (opts.flags & PM_OPTFLAG_EXIT) || opts.optind != argc - 1) {
+	pmUsageMessage(&opts);
+	exit(1);
+    }
+    archive = argv[opts.optind];
+
+    if ((ctx = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0) {
+	fprintf(stderr, "%s: cannot open archive \"%s\": %s\n",
+		pmGetProgname(), archive, pmErrStr(ctx));
+	exit(1);
+    }
+    if ((ctxp = __pmHandleToPtr(ctx)) == NULL) {
+	fprintf(stderr, "%s: botch: __pmHandleToPtr(%d) returns NULL!\n",
+		pmGetProgname(), ctx);
+	exit(1);
+    }
+    if (ctxp->c_archctl->ac_num_logs > 1) {
+	fprintf(stderr, "%s: \"%s\" is a multi-archive context, "
+		"index each archive separately\n", pmGetProgname(), archive);
+	PM_UNLOCK(ctxp->c_lock);
+	exit(1);
+    }
+    /*
+     * __pmLogRead() may need to find this context again, so release
+     * c_lock ... we are single-threaded, so this is safe
+     */
+    PM_UNLOCK(ctxp->c_lock);
+    sts = __pmLogTIdxBuild(ctxp->c_archctl);
+    if (sts < 0) {
+	fprintf(stderr, "%s: cannot build dense index for \"%s\": %s\n",
+		pmGetProgname(), archive, pmErrStr(sts));
+	exit(1);
+    }
+    pmDestroyContext(ctx);
+
+    if (dflag || metric != NULL) {
+	/* reopen to load and report the new index */
+	if ((ctx = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0) {
+	    fprintf(stderr, "%s: cannot reopen archive \"%s\": %s\n",
+		    pmGetProgname(), archive, pmErrStr(ctx));
+	    exit(1);
+	}
+	pmNewContextZone();
+	if (metric != NULL)
+	    pmid = lookup(metric);
+	if ((ctxp = __pmHandleToPtr(ctx)) == NULL) {
+	    fprintf(stderr, "%s: botch: __pmHandleToPtr(%d) returns NULL!\n",
+		    pmGetProgname(), ctx);
+	    exit(1);
+	}
+	dump(ctxp->c_archctl->ac_log, dflag, pmid);
+	PM_UNLOCK(ctxp->c_lock);
+	pmDestroyContext(ctx);
+    }
+
+    exit(0);
+}
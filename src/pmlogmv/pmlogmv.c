@@ -60,6 +60,7 @@ static char	*srcname;
 static char	dstname[MAXPATHLEN];
 /* need a sentinel that is < 0 and ! PM_LOG_VOL_TI amd ! PM_LOG_VOL_META */
 #define PM_LOG_VOL_NONE -100
+#define PM_LOG_VOL_TIDX -3	/* optional dense temporal index */
 static int	lastvol = PM_LOG_VOL_NONE;
 static __pmContext	*ctxp = NULL;
 static char	**sufftab;
@@ -244,6 +245,9 @@ do_link(int vol)
 	    case PM_LOG_VOL_META:
 		    snprintf(src, sizeof(src), "%s.meta%s", srcname, *suff);
 		    break;
+	    case PM_LOG_VOL_TIDX:
+		    snprintf(src, sizeof(src), "%s.tidx%s", srcname, *suff);
+		    break;
 	    default:
 		    snprintf(src, sizeof(src), "%s.%d%s", srcname, vol, *suff);
 		    break;
@@ -257,6 +261,9 @@ do_link(int vol)
 		case PM_LOG_VOL_META:
 			snprintf(dst, sizeof(src), "%s.meta%s", dstname, *suff);
 			break;
+		case PM_LOG_VOL_TIDX:
+			snprintf(dst, sizeof(src), "%s.tidx%s", dstname, *suff);
+			break;
 		default:
 			snprintf(dst, sizeof(src), "%s.%d%s", dstname, vol, *suff);
 			break;
@@ -338,6 +345,10 @@ do_link(int vol)
 		if (verbose)
 		    fprintf(stderr, "%s: Warning: source file %s.meta not found\n", progname, srcname);
 		break;
+	case PM_LOG_VOL_TIDX:
+		if (verbose > 1)
+		    fprintf(stderr, "%s: Warning: source file %s.tidx not found\n", progname, srcname);
+		break;
 	default:
 		if (verbose > 1)
 		    fprintf(stderr, "%s: Warning: source file %s.%d not found\n", progname, srcname, vol);
@@ -364,6 +375,9 @@ do_unlink(int cleanup, char *name, int vol)
 	    case PM_LOG_VOL_META:
 		    snprintf(src, sizeof(src), "%s.meta%s", name, *suff);
 		    break;
+	    case PM_LOG_VOL_TIDX:
+		    snprintf(src, sizeof(src), "%s.tidx%s", name, *suff);
+		    break;
 	    default:
 		    snprintf(src, sizeof(src), "%s.%d%s", name, vol, *suff);
 		    break;
@@ -395,6 +409,11 @@ cleanup(int sig)
     }
 
     /* order here is the _reverse_ order of creation in main() */
+    if (lastvol == PM_LOG_VOL_TIDX) {
+	/* dstname.tidx was created */
+	do_unlink(1, dstname, PM_LOG_VOL_TIDX);
+	lastvol = PM_LOG_VOL_META;
+    }
     if (lastvol == PM_LOG_VOL_META) {
 	/* dstname.meta was created */
 	do_unlink(1, dstname, PM_LOG_VOL_META);
@@ -547,6 +566,8 @@ main(int argc, char **argv)
 	goto abandon;
     if (do_link(PM_LOG_VOL_META) < 0)
 	goto abandon;
+    if (do_link(PM_LOG_VOL_TIDX) < 0)
+	goto abandon;
 
     /* if pmlogmv remove srcname files */
     if (mode == MV) {
@@ -555,6 +576,7 @@ main(int argc, char **argv)
 	}
 	do_unlink(0, srcname, PM_LOG_VOL_TI);
 	do_unlink(0, srcname, PM_LOG_VOL_META);
+	do_unlink(0, srcname, PM_LOG_VOL_TIDX);
     }
     return 0;
 
@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Compress files with zstd in the "seekable format" - a sequence of
+ * independent frames followed by a seek table - so that libpcp can
+ * decompress any part of the file on demand, see io_zstd.c in libpcp.
+ * The output can be decompressed by zstd(1) as usual.
+ */
+
+#include <sys/stat.h>
+#include <zstd.h>
+#include "pmapi.h"
+#include "libpcp.h"
+
+#define SEEKTABLE_SKIPPABLE	0x184D2A5E
+#define SEEKTABLE_MAGIC		0x8F92EAB1
+
+static pmLongOptions longopts[] = {
+    PMAPI_OPTIONS_HEADER("Options"),
+    PMOPT_DEBUG,
+    { "frame-size", 1, 'b', "SIZE", "uncompressed bytes per frame [default 1M]" },
+    { "keep", 0, 'k', 0, "keep (do not remove) the input files" },
+    { "level", 1, 'l', "N", "zstd compression level [default 3]" },
+    { "verbose", 0, 'v', 0, "report compression ratio for each file" },
+    PMOPT_HELP,
+    PMAPI_OPTIONS_END
+};
+
+static pmOptions opts = {
+    .short_options = "b:D:kl:v?",
+    .long_options = longopts,
+    .short_usage = "[options] file ...",
+};
+
+static size_t	framesize = 1024 * 1024;
+static int	level = 3;		/* as for zstd(1) */
+static int	keep;
+static int	verbose;
+
+static void
+put32(unsigned char *p, __uint32_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+static int
+writeall(int fd, const void *buf, size_t len)
+{
+    const char	*p = buf;
+    ssize_t	n;
+
+    while (len > 0) {
+	if ((n = write(fd, p, len)) < 0) {
+	    if (oserror() == EINTR)
+		continue;
+	    return -oserror();
+	}
+	p += n;
+	len -= n;
+    }
+    return 0;
+}
+
+static ssize_t
+readall(int fd, void *buf, size_t len)
+{
+    char	*p = buf;
+    ssize_t	n;
+    size_t	got = 0;
+
+    while (got < len) {
+	if ((n = read(fd, p + got, len - got)) < 0) {
+	    if (oserror() == EINTR)
+		continue;
+	    return -oserror();
+	}
+	if (n == 0)
+	    break;
+	got += n;
+    }
+    return got;
+}
+
+/*
+ * Compress path into path.zst, one frame per framesize bytes of input.
+ */
+static int
+compress(ZSTD_CCtx *cctx, const char *path)
+{
+    char		outpath[MAXPATHLEN];
+    struct stat		sbuf;
+    struct timespec	times[2];
+    unsigned char	*in = NULL, *out = NULL;
+    unsigned char	*table = NULL, *tp;
+    size_t		bound, csize;
+    ssize_t		n;
+    __uint64_t		total = 0, ctotal = 0;
+    __uint32_t		nframes = 0, maxframes;
+    int			infd, outfd = -1;
+    int			sts;
+
+    pmsprintf(outpath, sizeof(outpath), "%s.zst", path);
+    if ((infd = open(path, O_RDONLY)) < 0) {
+	sts = -oserror();
+	fprintf(stderr, "%s: cannot open \"%s\": %s\n",
+		pmGetProgname(), path, pmErrStr(sts));
+	return sts;
+    }
+    if (fstat(infd, &sbuf) < 0) {
+	sts = -oserror();
+	goto fail;
+    }
+    if ((outfd = open(outpath, O_WRONLY|O_CREAT|O_EXCL, sbuf.st_mode & 0777)) < 0) {
+	sts = -oserror();
+	fprintf(stderr, "%s: cannot create \"%s\": %s\n",
+		pmGetProgname(), outpath, pmErrStr(sts));
+	close(infd);
+	return sts;
+    }
+
+    /* one seek table entry per frame, plus the skippable frame header */
+    maxframes = sbuf.st_size / framesize + 2;
+    bound = ZSTD_compressBound(framesize);
+    if ((in = malloc(framesize)) == NULL ||
+	(out = malloc(bound)) == NULL ||
+	(table = malloc(8 + (size_t)maxframes * 8 + 9)) == NULL) {
+	sts = -ENOMEM;
+	goto fail;
+    }
+    tp = table + 8;
+
+    for (;;) {
+	if ((n = readall(infd, in, framesize)) < 0) {
+	    sts = n;
+	    goto fail;
+	}
+	if (n == 0)
+	    break;
+	if (nframes == maxframes) {
+	    /* file is growing underneath us */
+	    sts = -EAGAIN;
+	    goto fail;
+	}
+	csize = ZSTD_compress2(cctx, out, bound, in, n);
+	if (ZSTD_isError(csize)) {
+	    fprintf(stderr, "%s: \"%s\": %s\n",
+		    pmGetProgname(), path, ZSTD_getErrorName(csize));
+	    sts = PM_ERR_GENERIC;
+	    goto fail;
+	}
+	if ((sts = writeall(outfd, out, csize)) < 0)
+	    goto fail;
+	put32(tp, csize);
+	put32(tp + 4, n);
+	tp += 8;
+	nframes++;
+	total += n;
+	ctotal += csize;
+	if (n < framesize)
+	    break;
+    }
+
+    /* seek table: skippable frame header, entries, footer */
+    put32(table, SEEKTABLE_SKIPPABLE);
+    put32(table + 4, nframes * 8 + 9);
+    put32(tp, nframes);
+    tp[4] = 0;			/* descriptor, no checksums */
+    put32(tp + 5, SEEKTABLE_MAGIC);
+    tp += 9;
+    if ((sts = writeall(outfd, table, tp - table)) < 0)
+	goto fail;
+    ctotal += tp - table;
+
+    /* like zstd(1), keep the timestamps of the original */
+    times[0] = sbuf.st_atim;
+    times[1] = sbuf.st_mtim;
+    futimens(outfd, times);
+    if (close(outfd) < 0) {
+	outfd = -1;
+	sts = -oserror();
+	goto fail;
+    }
+    close(infd);
+    free(in);
+    free(out);
+    free(table);
+
+    if (verbose)
+	fprintf(stderr, "%s: %llu -> %llu bytes (%.1f%%), %u frames\n",
+		path, (unsigned long long)total, (unsigned long long)ctotal,
+		total ? 100.0 * ctotal / total : 100.0, nframes);
+    if (!keep && unlink(path) < 0) {
+	sts = -oserror();
+	fprintf(stderr, "%s: cannot remove \"%s\": %s\n",
+		pmGetProgname(), path, pmErrStr(sts));
+	return sts;
+    }
+    return 0;
+
+fail:
+    if (sts != PM_ERR_GENERIC)
+	fprintf(stderr, "%s: cannot compress \"%s\": %s\n",
+		pmGetProgname(), path, pmErrStr(sts));
+    if (outfd >= 0) {
+	close(outfd);
+	unlink(outpath);
+    }
+    close(infd);
+    free(in);
+    free(out);
+    free(table);
+    return sts;
+}
+
+/* size in bytes, with an optional K or M suffix */
+static size_t
+parse_size(const char *arg)
+{
+    char	*end;
+    long	size;
+
+    size = strtol(arg, &end, 10);
+    if (*end == 'k' || *end == 'K') {
+	size *= 1024;
+	end++;
+    }
+    else if (*end == 'm' || *end == 'M') {
+	size *= 1024 * 1024;
+	end++;
+    }
+    if (end == arg || *end != '\0' || size <= 0 || size > 0x7fffffff)
+	return 0;
+    return size;
+}
+
+int
+main(int argc, char **argv)
+{
+    ZSTD_CCtx	*cctx;
+    char	*end;
+    int		c;
+    int		sts = 0;
+
+    while ((c = pmGetOptions(argc, argv, &opts)) != EOF) {
+	switch (c) {
+	case 'b':
+	    if ((framesize = parse_size(opts.optarg)) == 0) {
+		pmprintf("%s: invalid frame size \"%s\"\n",
+			pmGetProgname(), opts.optarg);
+		opts.errors++;
+	    }
+	    break;
+	case 'k':
+	    keep = 1;
+	    break;
+	case 'l':
+	    level = (int)strtol(opts.optarg, &end, 10);
+	    if (*end != '\0' || level < ZSTD_minCLevel() || level > ZSTD_maxCLevel()) {
+		pmprintf("%s: invalid compression level \"%s\"\n",
+			pmGetProgname(), opts.optarg);
+		opts.errors++;
+	    }
+	    break;
+	case 'v':
+	    verbose = 1;
+	    break;
+	}
+    }
+    if (opts.errors || (opts.flags & PM_OPTFLAG_EXIT) || opts.optind >= argc) {
+	pmflush();
+	pmUsageMessage(&opts);
+	exit((opts.flags & PM_OPTFLAG_EXIT) ? 0 : 1);
+    }
+
+    if ((cctx = ZSTD_createCCtx()) == NULL) {
+	fprintf(stderr, "%s: cannot create zstd context\n", pmGetProgname());
+	exit(1);
+    }
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+
+    for (c = opts.optind; c < argc; c++) {
+	if (compress(cctx, argv[c]) < 0)
+	    sts = 1;
+    }
+    ZSTD_freeCCtx(cctx);
+
+    exit(sts);
+}
@@ -215,5 +215,10 @@ main(int argc, char **argv)
 	exit(1);
     }
 
+    /* binary image for pmLoadNameSpace(3), failure is not fatal */
+    if ((sts = __pmSavePMNSImage(pmnsfile)) < 0)
+	fprintf(stderr, "%s: Warning: cannot save image for PMNS file \"%s\": %s\n",
+		pmGetProgname(), pmnsfile, pmErrStr(sts));
+
     exit(0);
 }
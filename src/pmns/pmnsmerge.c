@@ -1,5 +1,6 @@
 /*
  * pmnsmerge [-adfv] infile [...] outfile
+ * pmnsmerge -i pmnsfile
  *
  * Merge PCP PMNS files
  *
@@ -33,6 +34,7 @@ static pmLongOptions longopts[] = {
     { "", 0, 'a', 0, "process files in order, ignoring embedded _DATESTAMP control lines" },
     { "dupok", 0, 'd', 0, "duplicate names for the same PMID are allowed [default]" },
     { "force", 0, 'f', 0, "force overwriting of the output file if it exists" },
+    { "image", 0, 'i', 0, "only (re)build the binary image for one PMNS file" },
     { "nodups", 0, 'x', 0, "duplicate names for the same PMID are not allowed" },
     { "verbose", 0, 'v', 0, "verbose, echo input file names as processed" },
     PMOPT_HELP,
@@ -40,7 +42,7 @@ static pmLongOptions longopts[] = {
 };
 
 static pmOptions opts = {
-    .short_options = "aD:dfvx?",
+    .short_options = "aD:dfivx?",
     .long_options = longopts,
     .short_usage = "[options] infile [...] outfile",
 };
@@ -208,6 +210,7 @@ main(int argc, char **argv)
     int		force = 0;
     int		asis = 0;
     int		dupok = 1;
+    int		image = 0;
     __pmnsNode	*tmp;
 
     umask((mode_t)022);		/* anything else is pretty silly */
@@ -239,6 +242,10 @@ main(int argc, char **argv)
 	    force = 1;
 	    break;
 
+	case 'i':	/* binary image only */
+	    image = 1;
+	    break;
+
 	case 'x':	/* duplicate PMIDs are NOT OK */
 	    dupok = 0;
 	    break;
@@ -254,6 +261,19 @@ main(int argc, char **argv)
 	}
     }
 
+    if (image) {
+	if (opts.errors || opts.optind != argc - 1) {
+	    pmUsageMessage(&opts);
+	    exit(1);
+	}
+	if ((sts = __pmSavePMNSImage(argv[opts.optind])) < 0) {
+	    fprintf(stderr, "%s: Error: cannot save image for PMNS file \"%s\": %s\n",
+		pmGetProgname(), argv[opts.optind], pmErrStr(sts));
+	    exit(1);
+	}
+	exit(0);
+    }
+
     if (opts.errors || opts.optind > argc - 2) {
 	pmUsageMessage(&opts);
 	exit(1);
@@ -540,7 +540,7 @@ class pmConfig(object):
         if curr:
             return self.util.context.pmGetInstancesLabels(indom)
         inst_labels = []
-        indom_labels = self.util.context.pmGetInstancesLabels(indom)
+        indom_labels = self.util.context.pmGetInstancesLabelsList(indom, insts)
         for i in insts:
             inst_labels.append(indom_labels[i] if i in indom_labels else {})
         return inst_labels